@@ -215,7 +215,7 @@ Options *parse_command_line(int argc, char *argv[],
     Options *op;
     int n, c;
     char *strval;
-    int boolval;
+    int boolval, intval;
 
     op = nvalloc(sizeof(Options));
     op->config = DEFAULT_RC_FILE;
@@ -229,7 +229,7 @@ Options *parse_command_line(int argc, char *argv[],
     while (1) {
         c = nvgetopt(argc, argv, __options, &strval,
                      &boolval,  /* boolval */
-                     NULL,  /* intval */
+                     &intval,  /* intval */
                      NULL,  /* doubleval */
                      NULL); /* disable_val */
 
@@ -299,6 +299,32 @@ Options *parse_command_line(int argc, char *argv[],
         case 'w': op->write_config = boolval; break;
         case 'i': op->use_gtk2 = NV_TRUE; break;
         case 'I': op->gtk_lib_path = strval; break;
+        case NVML_SAMPLE_INTERVAL_OPTION:
+            if (intval <= 0) {
+                nv_error_msg("Invalid NVML sample interval: %d.", intval);
+                exit(1);
+            }
+            op->nvml_sample_interval = intval;
+            break;
+        case PARALLEL_CONNECT_OPTION: op->parallel_connect = NV_TRUE; break;
+        case ATTRIBUTE_CACHE_OPTION: op->attribute_cache = NV_TRUE; break;
+        case STATS_OPTION:
+            op->stats = NV_TRUE;
+            if (!strval || nv_strcasecmp(strval, "text") == NV_TRUE) {
+                op->stats_format = CTRL_STATS_FORMAT_TEXT;
+            } else if (nv_strcasecmp(strval, "json") == NV_TRUE) {
+                op->stats_format = CTRL_STATS_FORMAT_JSON;
+            } else {
+                nv_error_msg("Invalid statistics format '%s'.  Please run "
+                             "`%s --help` for usage information.\n",
+                             strval, argv[0]);
+                exit(1);
+            }
+            NvCtrlEnableStats();
+            break;
+        case RECORD_TRACE_OPTION: op->record_trace = strval; break;
+        case REPLAY_TRACE_OPTION: op->replay_trace = strval; break;
+        case REPLAY_TIMING_OPTION: op->replay_timing = NV_TRUE; break;
         default:
             nv_error_msg("Invalid commandline, please run `%s --help` "
                          "for usage information.\n", argv[0]);
@@ -306,6 +332,22 @@ Options *parse_command_line(int argc, char *argv[],
         }
     }
 
+    /* traces must be started before connecting to any system */
+
+    if (op->record_trace && op->replay_trace) {
+        nv_error_msg("A trace cannot be recorded while replaying one.");
+        exit(1);
+    }
+
+    if (op->record_trace && !NvCtrlStartTraceRecording(op->record_trace)) {
+        exit(1);
+    }
+
+    if (op->replay_trace &&
+        !NvCtrlStartTraceReplay(op->replay_trace, op->replay_timing)) {
+        exit(1);
+    }
+
     /* do tilde expansion on the config file path */
 
     op->config = tilde_expansion(op->config);
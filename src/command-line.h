@@ -30,6 +30,13 @@ struct _CtrlSystemList;
 #define DEFAULT_RC_FILE "~/.nvidia-settings-rc"
 #define CONFIG_FILE_OPTION 1
 #define DISPLAY_OPTION 2
+#define NVML_SAMPLE_INTERVAL_OPTION 3
+#define STATS_OPTION 4
+#define PARALLEL_CONNECT_OPTION 5
+#define RECORD_TRACE_OPTION 6
+#define REPLAY_TRACE_OPTION 7
+#define REPLAY_TIMING_OPTION 8
+#define ATTRIBUTE_CACHE_OPTION 9
 
 /*
  * Options structure -- stores the parameters specified on the
@@ -122,6 +129,48 @@ typedef struct {
                           * ignored.
                           */
 
+    int nvml_sample_interval; /*
+                               * If positive, sample the GPU telemetry on a
+                               * background thread every this many
+                               * milliseconds.
+                               */
+
+    int parallel_connect; /*
+                           * If true, connect to the X servers referenced
+                           * by the commandline or the configuration file
+                           * concurrently.
+                           */
+
+    int attribute_cache; /*
+                          * If true, cache the integer attribute values
+                          * read from the control system.
+                          */
+
+    int stats;           /*
+                          * If true, print statistics about the calls made
+                          * to each backend on exit.
+                          */
+
+    int stats_format;    /*
+                          * The CtrlStatsFormat used to print the
+                          * statistics.
+                          */
+
+    char *record_trace;  /*
+                          * If non-NULL, the file to record the calls made
+                          * to the backends to.
+                          */
+
+    char *replay_trace;  /*
+                          * If non-NULL, the trace file to answer the calls
+                          * made to the backends from.
+                          */
+
+    int replay_timing;   /*
+                          * If true, replayed calls take as long as they
+                          * did when recorded.
+                          */
+
 } Options;
 
 
@@ -84,6 +84,8 @@ static void write_config_properties(FILE *stream, const ConfigProperties *conf,
 static char *create_display_device_target_string(CtrlTarget *t,
                                                  const ConfigProperties *conf);
 
+static CtrlAttributeQuery *query_config_attributes(CtrlTarget *t);
+
 /*
  * set_dynamic_verbosity() - Sets the __dynamic_verbosity variable which
  * allows temporary toggling of the verbosity level to hide some output
@@ -235,7 +237,7 @@ int nv_write_config_file(const char *filename, const CtrlSystem *system,
     FILE *stream;
     time_t now;
     ReturnStatus status;
-    CtrlAttributePerms perms;
+    CtrlAttributeQuery *values;
     CtrlTargetNode *node;
     CtrlTarget *t;
     char *prefix, scratch[4];
@@ -316,6 +318,8 @@ int nv_write_config_file(const char *filename, const CtrlSystem *system,
             prefix = scratch;
         }
 
+        values = query_config_attributes(t);
+
         /* loop over all the entries in the table */
 
         for (entry = 0; entry < attributeTableLen; entry++) {
@@ -367,17 +371,12 @@ int nv_write_config_file(const char *filename, const CtrlSystem *system,
              * write attributes that can be written for an X screen target
              */
 
-            status = NvCtrlGetAttributePerms(t, a->type, a->attr, &perms);
-            if (status != NvCtrlSuccess || !(perms.write) ||
-                !(perms.valid_targets & CTRL_TARGET_PERM_BIT(X_SCREEN_TARGET)) ||
-                (perms.valid_targets & CTRL_TARGET_PERM_BIT(DISPLAY_TARGET))) {
+            if (!values[entry].target ||
+                values[entry].status != NvCtrlSuccess) {
                 continue;
             }
 
-            status = NvCtrlGetAttribute(t, a->attr, &val);
-            if (status != NvCtrlSuccess) {
-                continue;
-            }
+            val = values[entry].val;
 
             if (a->f.int_flags.is_display_id) {
                 const char *name = NvCtrlGetDisplayConfigName(system, val);
@@ -393,6 +392,8 @@ int nv_write_config_file(const char *filename, const CtrlSystem *system,
 
         } /* entry */
 
+        nvfree(values);
+
     } /* screen */
 
     /*
@@ -423,6 +424,8 @@ int nv_write_config_file(const char *filename, const CtrlSystem *system,
 
         prefix = create_display_device_target_string(t, conf);
 
+        values = query_config_attributes(t);
+
         /* loop over all the entries in the table */
 
         for (entry = 0; entry < attributeTableLen; entry++) {
@@ -464,19 +467,15 @@ int nv_write_config_file(const char *filename, const CtrlSystem *system,
 
             /* Make sure this is a display and writable attribute */
 
-            status = NvCtrlGetAttributePerms(t, a->type, a->attr, &perms);
-            if (status != NvCtrlSuccess || !(perms.write) ||
-                !(perms.valid_targets & CTRL_TARGET_PERM_BIT(DISPLAY_TARGET))) {
-                continue;
-            }
-
-            status = NvCtrlGetAttribute(t, a->attr, &val);
-            if (status == NvCtrlSuccess) {
+            if (values[entry].target &&
+                values[entry].status == NvCtrlSuccess) {
                 fprintf(stream, "%s%c%s=%d\n", prefix,
-                        DISPLAY_NAME_SEPARATOR, a->name, val);
+                        DISPLAY_NAME_SEPARATOR, a->name,
+                        (int) values[entry].val);
             }
         }
 
+        nvfree(values);
         free(prefix);
     }
     
@@ -663,6 +662,7 @@ static int process_config_file_attributes(const Options *op,
                                           const char *display_name,
                                           CtrlSystemList *systems)
 {
+    const char **displays;
     int i;
     
     NvVerbosity old_verbosity = nv_get_verbosity();
@@ -685,8 +685,19 @@ static int process_config_file_attributes(const Options *op,
 
     /* connect to all the systems referenced in the config file */
 
+    for (i = 0; w[i].line != -1; i++);
+
+    displays = nvalloc((i + 1) * sizeof(char *));
+
+    for (i = 0; w[i].line != -1; i++) {
+        displays[i] = w[i].a.display;
+    }
+
+    NvCtrlConnectToSystems(displays, i, systems);
+    nvfree(displays);
+
     for (i = 0; w[i].line != -1; i++) {
-        w[i].system = NvCtrlConnectToSystem(w[i].a.display, systems);
+        w[i].system = NvCtrlGetSystem(w[i].a.display, systems);
     }
 
     /* now process each attribute, passing in the correct system */
@@ -738,6 +749,63 @@ static void save_gui_parsed_attributes(ParsedAttributeWrapper *w,
 
 
 
+/*
+ * query_config_attributes() - query the values of the integer attributes
+ * of the given X screen or display target that nv_write_config_file()
+ * saves: the writable attributes addressable by X screen (but not by
+ * display) for X screens, and the writable display attributes for
+ * displays.  They are all queried at once rather than with a round trip
+ * per attribute.  Returns an array indexed like attributeTable, which the
+ * caller must free; the entries of the attributes not to be saved have a
+ * NULL target.
+ */
+
+static CtrlAttributeQuery *query_config_attributes(CtrlTarget *t)
+{
+    CtrlAttributeQuery *queries;
+    CtrlAttributePerms perms;
+    ReturnStatus status;
+    Bool is_display = (NvCtrlGetTargetType(t) == DISPLAY_TARGET);
+    int entry;
+
+    queries = nvalloc(attributeTableLen * sizeof(CtrlAttributeQuery));
+
+    for (entry = 0; entry < attributeTableLen; entry++) {
+        const AttributeTableEntry *a = &attributeTable[entry];
+
+        if (a->flags.no_config_write ||
+            (a->type != CTRL_ATTRIBUTE_TYPE_INTEGER)) {
+            continue;
+        }
+
+        status = NvCtrlGetAttributePerms(t, a->type, a->attr, &perms);
+        if (status != NvCtrlSuccess || !(perms.write)) {
+            continue;
+        }
+
+        if (is_display) {
+            if (!(perms.valid_targets &
+                  CTRL_TARGET_PERM_BIT(DISPLAY_TARGET))) {
+                continue;
+            }
+        } else if (!(perms.valid_targets &
+                     CTRL_TARGET_PERM_BIT(X_SCREEN_TARGET)) ||
+                   (perms.valid_targets &
+                    CTRL_TARGET_PERM_BIT(DISPLAY_TARGET))) {
+            continue;
+        }
+
+        queries[entry].target = t;
+        queries[entry].attr = a->attr;
+    }
+
+    NvCtrlGetDisplayAttributesBatch(queries, attributeTableLen);
+
+    return queries;
+}
+
+
+
 static float get_color_value(int attr, float c[3], float b[3], float g[3])
 {
     switch (attr & (ALL_VALUES | ALL_CHANNELS)) {
@@ -1529,8 +1529,8 @@ Bool display_add_modelines_from_server(nvDisplayPtr display, nvGpuPtr gpu,
                                        gchar **err_str)
 {
     nvModeLinePtr modeline;
-    char *modeline_strs = NULL;
-    char *str;
+    const unsigned char *modeline_strs = NULL;
+    const char *str;
     int len;
     ReturnStatus ret, ret1;
     int major = 0, minor = 0;
@@ -1563,9 +1563,9 @@ Bool display_add_modelines_from_server(nvDisplayPtr display, nvGpuPtr gpu,
 
 
     /* Get the validated modelines for the display */
-    ret = NvCtrlGetBinaryAttribute(ctrl_target, 0,
-                                   NV_CTRL_BINARY_DATA_MODELINES,
-                                   (unsigned char **)&modeline_strs, &len);
+    ret = NvCtrlGetBinaryAttributeScratch(ctrl_target, 0,
+                                          NV_CTRL_BINARY_DATA_MODELINES,
+                                          &modeline_strs, &len);
     if (ret != NvCtrlSuccess) {
         *err_str = g_strdup_printf("Failed to query modelines of display "
                                   "device %d '%s'.",
@@ -1577,7 +1577,7 @@ Bool display_add_modelines_from_server(nvDisplayPtr display, nvGpuPtr gpu,
 
 
     /* Parse each modeline */
-    str = modeline_strs;
+    str = (const char *) modeline_strs;
     while (strlen(str)) {
 
         modeline = modeline_parse(display, gpu, str,
@@ -1602,14 +1602,12 @@ Bool display_add_modelines_from_server(nvDisplayPtr display, nvGpuPtr gpu,
         str += strlen(str) +1;
     }
 
-    free(modeline_strs);
     return TRUE;
 
 
     /* Handle the failure case */
  fail:
     display_remove_modelines(display);
-    free(modeline_strs);
     return FALSE;
 
 } /* display_add_modelines_from_server() */
@@ -224,7 +224,7 @@ static const char *memory_location_label(const int index, int sram_value)
  * detailed ECC information.
  */
 static void update_detailed_widgets(CtkEccDetailedTableRow errors[],
-                                    gboolean vol, int *counts)
+                                    gboolean vol, const int *counts)
 {
     int loc;
     int value;
@@ -302,60 +302,27 @@ static void hide_unavailable_rows(CtkEcc *ctk_ecc)
 
 
 /*
- * update_ecc_info() - update ECC status and configuration
+ * update_ecc_errors() - update ECC error counts
  */
 
-static gboolean update_ecc_info(gpointer user_data)
+static void update_ecc_errors(CtkEcc *ctk_ecc)
 {
-    CtkEcc *ctk_ecc = CTK_ECC(user_data);
     CtrlTarget *ctrl_target = ctk_ecc->ctrl_target;
     int64_t val;
-    gboolean status;
     ReturnStatus ret;
-    unsigned char *cdata;
-    int *counts, len;
-
-
-    if (!ctk_ecc->ecc_config_supported && !ctk_ecc->ecc_enabled ) {
-        return FALSE;
-    }
-
-    /*
-     * The ECC Configuration may be changed by non NV-CONTROL clients so we
-     * can't rely on an event to update the configuration state.
-     */
-
-    if (ctk_ecc->ecc_config_supported) {
-
-        ret = NvCtrlGetAttribute(ctrl_target, NV_CTRL_GPU_ECC_CONFIGURATION,
-                                 &status);
-
-        if (ret != NvCtrlSuccess ||
-            status == NV_CTRL_GPU_ECC_CONFIGURATION_DISABLED) {
-                ctk_ecc->ecc_configured = FALSE;
-        } else {
-                ctk_ecc->ecc_configured = TRUE;
-        }
-
-        ecc_set_config_status(ctk_ecc);
-    }
-
-    /* If ECC is not enabled, don't query ECC details but continue updating */
-
-    if (ctk_ecc->ecc_enabled == FALSE) {
-        return TRUE;
-    }
+    const unsigned char *cdata;
+    const int *counts;
+    int len;
 
     /* Query ECC Errors */
 
     /* Detailed Single Bit Volatile */
     counts = NULL;
-    cdata = NULL;
-    ret = NvCtrlGetBinaryAttribute(ctrl_target, 0,
+    ret = NvCtrlGetBinaryAttributeScratch(ctrl_target, 0,
               NV_CTRL_BINARY_DATA_GPU_ECC_DETAILED_ERRORS_SINGLE_BIT,
               &cdata, &len);
     if (ret == NvCtrlSuccess) {
-        counts = (int *)cdata;
+        counts = (const int *)cdata;
     }
     update_detailed_widgets(ctk_ecc->single_errors, 1, counts);
 
@@ -368,16 +335,14 @@ static gboolean update_ecc_info(gpointer user_data)
         }
         set_label_value(ctk_ecc->sbit_error, val);
     }
-    nvfree(cdata);
 
     /* Detailed Double Bit Volatile */
     counts = NULL;
-    cdata = NULL;
-    ret = NvCtrlGetBinaryAttribute(ctrl_target, 0,
+    ret = NvCtrlGetBinaryAttributeScratch(ctrl_target, 0,
               NV_CTRL_BINARY_DATA_GPU_ECC_DETAILED_ERRORS_DOUBLE_BIT,
               &cdata, &len);
     if (ret == NvCtrlSuccess) {
-        counts = (int *)cdata;
+        counts = (const int *)cdata;
     }
 
     update_detailed_widgets(ctk_ecc->double_errors, 1, counts);
@@ -391,16 +356,14 @@ static gboolean update_ecc_info(gpointer user_data)
         }
         set_label_value(ctk_ecc->dbit_error, val);
     }
-    nvfree(cdata);
 
     /* Detailed Single Bit Aggregate */
     counts = NULL;
-    cdata = NULL;
-    ret = NvCtrlGetBinaryAttribute(ctrl_target, 0,
+    ret = NvCtrlGetBinaryAttributeScratch(ctrl_target, 0,
               NV_CTRL_BINARY_DATA_GPU_ECC_DETAILED_ERRORS_SINGLE_BIT_AGGREGATE,
               &cdata, &len);
     if (ret == NvCtrlSuccess) {
-        counts = (int *)cdata;
+        counts = (const int *)cdata;
     }
 
     update_detailed_widgets(ctk_ecc->single_errors, 0, counts);
@@ -414,16 +377,14 @@ static gboolean update_ecc_info(gpointer user_data)
         }
         set_label_value(ctk_ecc->aggregate_sbit_error, val);
     }
-    nvfree(cdata);
 
     /* Detailed Double Bit Aggregate */
     counts = NULL;
-    cdata = NULL;
-    ret = NvCtrlGetBinaryAttribute(ctrl_target, 0,
+    ret = NvCtrlGetBinaryAttributeScratch(ctrl_target, 0,
               NV_CTRL_BINARY_DATA_GPU_ECC_DETAILED_ERRORS_DOUBLE_BIT_AGGREGATE,
               &cdata, &len);
     if (ret == NvCtrlSuccess) {
-        counts = (int *)cdata;
+        counts = (const int *)cdata;
     }
 
     update_detailed_widgets(ctk_ecc->double_errors, 0, counts);
@@ -437,15 +398,101 @@ static gboolean update_ecc_info(gpointer user_data)
         }
         set_label_value(ctk_ecc->aggregate_dbit_error, val);
     }
-    nvfree(cdata);
 
     hide_unavailable_rows(ctk_ecc);
 
+} /* update_ecc_errors() */
+
+
+
+/*
+ * update_ecc_info() - update ECC status and configuration
+ */
+
+static gboolean update_ecc_info(gpointer user_data)
+{
+    CtkEcc *ctk_ecc = CTK_ECC(user_data);
+    CtrlTarget *ctrl_target = ctk_ecc->ctrl_target;
+    unsigned long long event_types;
+    gboolean status;
+    ReturnStatus ret;
+
+
+    if (!ctk_ecc->ecc_config_supported && !ctk_ecc->ecc_enabled ) {
+        return FALSE;
+    }
+
+    /*
+     * The ECC Configuration may be changed by non NV-CONTROL clients so we
+     * can't rely on an event to update the configuration state.
+     */
+
+    if (ctk_ecc->ecc_config_supported) {
+
+        ret = NvCtrlGetAttribute(ctrl_target, NV_CTRL_GPU_ECC_CONFIGURATION,
+                                 &status);
+
+        if (ret != NvCtrlSuccess ||
+            status == NV_CTRL_GPU_ECC_CONFIGURATION_DISABLED) {
+                ctk_ecc->ecc_configured = FALSE;
+        } else {
+                ctk_ecc->ecc_configured = TRUE;
+        }
+
+        ecc_set_config_status(ctk_ecc);
+    }
+
+    /* If ECC is not enabled, don't query ECC details but continue updating */
+
+    if (ctk_ecc->ecc_enabled == FALSE) {
+        return TRUE;
+    }
+
+    /*
+     * The error counts are refreshed on NVML ECC error events, if delivered;
+     * poll them again if NVML stopped delivering events.
+     */
+
+    if (ctk_ecc->ecc_error_events &&
+        (NvCtrlGetNvmlEventTypes(ctrl_target, &event_types) !=
+         NvCtrlSuccess)) {
+        ctk_ecc->ecc_error_events = FALSE;
+    }
+
+    if (!ctk_ecc->ecc_error_events) {
+        update_ecc_errors(ctk_ecc);
+    }
+
     return TRUE;
 } /* update_ecc_info() */
 
 
 
+/*
+ * ecc_errors_update_received() - this function is called when NVML reports
+ * a new single-bit or double-bit ECC error, or an XID error, on the GPU.
+ */
+
+static void ecc_errors_update_received(GObject *object,
+                                       CtrlEvent *event,
+                                       gpointer user_data)
+{
+    CtkEcc *ctk_ecc = CTK_ECC(user_data);
+
+    if (event->type == CTRL_EVENT_TYPE_XID_ERROR) {
+        ctk_config_statusbar_message(ctk_ecc->ctk_config,
+                                     "GPU %d reported XID error %llu.",
+                                     NvCtrlGetTargetId(ctk_ecc->ctrl_target),
+                                     event->xid_error.xid);
+    }
+
+    if (ctk_ecc->ecc_enabled) {
+        update_ecc_errors(ctk_ecc);
+    }
+}
+
+
+
 /*
  * post_ecc_configuration_update() - this function update status bar string.
  */
@@ -584,6 +631,8 @@ static void clear_ecc_errors_button_clicked(GtkWidget *widget,
                        NV_CTRL_GPU_ECC_RESET_ERROR_STATUS,
                        NV_CTRL_GPU_ECC_RESET_ERROR_STATUS_VOLATILE);
 
+    update_ecc_errors(ctk_ecc);
+
     ctk_config_statusbar_message(ctk_ecc->ctk_config,
                                  "ECC errors cleared.");
 } /* clear_ecc_errors_button_clicked() */
@@ -605,6 +654,8 @@ static void clear_aggregate_ecc_errors_button_clicked(GtkWidget *widget,
                        NV_CTRL_GPU_ECC_RESET_ERROR_STATUS,
                        NV_CTRL_GPU_ECC_RESET_ERROR_STATUS_AGGREGATE);
 
+    update_ecc_errors(ctk_ecc);
+
     ctk_config_statusbar_message(ctk_ecc->ctk_config,
                                  "ECC aggregate errors cleared.");
 } /* clear_aggregate_ecc_errors_button_clicked() */
@@ -793,10 +844,32 @@ GtkWidget* ctk_ecc_new(CtrlTarget *ctrl_target,
     gboolean aggregate_dbit_error_available;
     gboolean ecc_enabled;
     ReturnStatus ret;
+    unsigned long long event_types;
     gchar *ecc_enabled_string;
     gchar *str = NULL;
     int loc;
     gint xpad = 12, ypad = 2;
+    enum {
+        ECC_STATUS = 0,
+        ECC_CONFIGURATION,
+        ECC_DEFAULT_CONFIGURATION,
+        ECC_SBIT_ERRORS,
+        ECC_DBIT_ERRORS,
+        ECC_AGGREGATE_SBIT_ERRORS,
+        ECC_AGGREGATE_DBIT_ERRORS,
+    };
+    const int ecc_attrs[] = {
+        [ECC_STATUS]                = NV_CTRL_GPU_ECC_STATUS,
+        [ECC_CONFIGURATION]         = NV_CTRL_GPU_ECC_CONFIGURATION,
+        [ECC_DEFAULT_CONFIGURATION] = NV_CTRL_GPU_ECC_DEFAULT_CONFIGURATION,
+        [ECC_SBIT_ERRORS]           = NV_CTRL_GPU_ECC_SINGLE_BIT_ERRORS,
+        [ECC_DBIT_ERRORS]           = NV_CTRL_GPU_ECC_DOUBLE_BIT_ERRORS,
+        [ECC_AGGREGATE_SBIT_ERRORS] = NV_CTRL_GPU_ECC_AGGREGATE_SINGLE_BIT_ERRORS,
+        [ECC_AGGREGATE_DBIT_ERRORS] = NV_CTRL_GPU_ECC_AGGREGATE_DOUBLE_BIT_ERRORS,
+    };
+    int64_t ecc_vals[ARRAY_LEN(ecc_attrs)];
+    ReturnStatus ecc_status[ARRAY_LEN(ecc_attrs)];
+    int i;
 
     /* make sure we have a handle */
 
@@ -833,11 +906,23 @@ GtkWidget* ctk_ecc_new(CtrlTarget *ctrl_target,
     aggregate_sbit_error = 0;
     aggregate_dbit_error = 0;
 
-    /* Query ECC Status */
+    /*
+     * Query ECC status, configuration and error counts together; NVML can
+     * answer most of them in a single call.
+     */
 
-    ret = NvCtrlGetAttribute(ctrl_target, NV_CTRL_GPU_ECC_STATUS,
-                             &val);
-    if (ret != NvCtrlSuccess || val == NV_CTRL_GPU_ECC_STATUS_DISABLED) {
+    ret = NvCtrlGetAttributesBatch(ctrl_target, ARRAY_LEN(ecc_attrs),
+                                   ecc_attrs, ecc_vals, ecc_status);
+    if (ret != NvCtrlSuccess) {
+        for (i = 0; i < ARRAY_LEN(ecc_attrs); i++) {
+            ecc_status[i] = ret;
+        }
+    }
+
+    /* ECC Status */
+
+    if (ecc_status[ECC_STATUS] != NvCtrlSuccess ||
+        ecc_vals[ECC_STATUS] == NV_CTRL_GPU_ECC_STATUS_DISABLED) {
         ecc_enabled = FALSE;
         ecc_enabled_string = "Disabled";
     } else {
@@ -846,52 +931,45 @@ GtkWidget* ctk_ecc_new(CtrlTarget *ctrl_target,
     }
     ctk_ecc->ecc_enabled = ecc_enabled; 
 
-    /* Query ECC Configuration */
+    /* ECC Configuration */
 
-    ret = NvCtrlGetAttribute(ctrl_target, NV_CTRL_GPU_ECC_CONFIGURATION,
-                             &val);
-    if (ret != NvCtrlSuccess ||
-        val == NV_CTRL_GPU_ECC_CONFIGURATION_DISABLED) {
+    if (ecc_status[ECC_CONFIGURATION] != NvCtrlSuccess ||
+        ecc_vals[ECC_CONFIGURATION] == NV_CTRL_GPU_ECC_CONFIGURATION_DISABLED) {
             ctk_ecc->ecc_configured = FALSE;
     } else {
             ctk_ecc->ecc_configured = TRUE;
     }
 
-    /* get default status */
-    ret = NvCtrlGetAttribute(ctrl_target,
-                             NV_CTRL_GPU_ECC_DEFAULT_CONFIGURATION,
-                             &val);
-    if (ret != NvCtrlSuccess ||
-        val == NV_CTRL_GPU_ECC_DEFAULT_CONFIGURATION_DISABLED) {
+    /* default status */
+
+    if (ecc_status[ECC_DEFAULT_CONFIGURATION] != NvCtrlSuccess ||
+        ecc_vals[ECC_DEFAULT_CONFIGURATION] ==
+        NV_CTRL_GPU_ECC_DEFAULT_CONFIGURATION_DISABLED) {
         ctk_ecc->ecc_default_status = FALSE;
     } else {
         ctk_ecc->ecc_default_status = TRUE;
     }
 
-    /* Query ECC errors */
-    
-    ret = NvCtrlGetAttribute64(ctrl_target,
-                               NV_CTRL_GPU_ECC_SINGLE_BIT_ERRORS,
-                               &sbit_error);
-    if (ret != NvCtrlSuccess) {
+    /* ECC errors */
+
+    if (ecc_status[ECC_SBIT_ERRORS] == NvCtrlSuccess) {
+        sbit_error = ecc_vals[ECC_SBIT_ERRORS];
+    } else {
         sbit_error_available = FALSE;
     }
-    ret = NvCtrlGetAttribute64(ctrl_target,
-                               NV_CTRL_GPU_ECC_DOUBLE_BIT_ERRORS,
-                               &dbit_error);
-    if (ret != NvCtrlSuccess) {
+    if (ecc_status[ECC_DBIT_ERRORS] == NvCtrlSuccess) {
+        dbit_error = ecc_vals[ECC_DBIT_ERRORS];
+    } else {
         dbit_error_available = FALSE;
     }
-    ret = NvCtrlGetAttribute64(ctrl_target,
-                               NV_CTRL_GPU_ECC_AGGREGATE_SINGLE_BIT_ERRORS,
-                               &aggregate_sbit_error);
-    if (ret != NvCtrlSuccess) {
+    if (ecc_status[ECC_AGGREGATE_SBIT_ERRORS] == NvCtrlSuccess) {
+        aggregate_sbit_error = ecc_vals[ECC_AGGREGATE_SBIT_ERRORS];
+    } else {
         aggregate_sbit_error_available = FALSE;
     }
-    ret = NvCtrlGetAttribute64(ctrl_target,
-                               NV_CTRL_GPU_ECC_AGGREGATE_DOUBLE_BIT_ERRORS,
-                               &aggregate_dbit_error);
-    if (ret != NvCtrlSuccess) {
+    if (ecc_status[ECC_AGGREGATE_DBIT_ERRORS] == NvCtrlSuccess) {
+        aggregate_dbit_error = ecc_vals[ECC_AGGREGATE_DBIT_ERRORS];
+    } else {
         aggregate_dbit_error_available = FALSE;
     }
     ctk_ecc->sbit_error_available = sbit_error_available;
@@ -1142,6 +1220,29 @@ GtkWidget* ctk_ecc_new(CtrlTarget *ctrl_target,
                      G_CALLBACK(reset_default_config_button_clicked),
                      (gpointer) ctk_ecc);
 
+    /*
+     * Refresh the error counts when NVML reports new errors, rather than
+     * polling them, if the GPU delivers ECC error events.
+     */
+    if ((NvCtrlGetNvmlEventTypes(ctrl_target, &event_types) == NvCtrlSuccess) &&
+        ((event_types & (nvmlEventTypeSingleBitEccError |
+                         nvmlEventTypeDoubleBitEccError)) ==
+         (nvmlEventTypeSingleBitEccError | nvmlEventTypeDoubleBitEccError))) {
+        ctk_ecc->ecc_error_events = TRUE;
+    }
+
+    g_signal_connect(G_OBJECT(ctk_event),
+                     CTK_EVENT_NAME(NV_CTRL_GPU_ECC_SINGLE_BIT_ERRORS),
+                     G_CALLBACK(ecc_errors_update_received),
+                     (gpointer) ctk_ecc);
+    g_signal_connect(G_OBJECT(ctk_event),
+                     CTK_EVENT_NAME(NV_CTRL_GPU_ECC_DOUBLE_BIT_ERRORS),
+                     G_CALLBACK(ecc_errors_update_received),
+                     (gpointer) ctk_ecc);
+    g_signal_connect(G_OBJECT(ctk_event), "CTK_EVENT_XidCriticalError",
+                     G_CALLBACK(ecc_errors_update_received),
+                     (gpointer) ctk_ecc);
+
     /* Register a timer callback to update Ecc status info */
     str = g_strdup_printf("ECC Settings (GPU %d)",
                         NvCtrlGetTargetId(ctrl_target));
@@ -1157,6 +1258,9 @@ GtkWidget* ctk_ecc_new(CtrlTarget *ctrl_target,
     gtk_widget_show_all(GTK_WIDGET(ctk_ecc));
 
     update_ecc_info(ctk_ecc);
+    if (ctk_ecc->ecc_error_events && ctk_ecc->ecc_enabled) {
+        update_ecc_errors(ctk_ecc);
+    }
     update_detailed_label_for_values(ctk_ecc);
 
     return GTK_WIDGET(ctk_ecc);
@@ -84,6 +84,7 @@ struct _CtkEcc
     gboolean aggregate_dbit_error_available;
     gboolean ecc_config_supported;
     gboolean ecc_default_status;
+    gboolean ecc_error_events;  /* error counts are updated on NVML events */
 
     GtkWidget* detailed_table;
     CtkEccDetailedTableRow single_errors[NVML_MEMORY_LOCATION_COUNT];
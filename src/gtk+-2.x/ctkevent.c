@@ -26,6 +26,9 @@
  *
  * In short:
  *   NV-CONTROL -> event -> glib -> CtkEvent -> signal -> GUI
+ *
+ * NVML events (ECC errors, clock changes, XID errors) are forwarded by the
+ * NvCtrl library through a second file descriptor on the same event handle.
  */
 
 #include <string.h>
@@ -59,6 +62,7 @@ typedef struct __CtkEventSourceRec {
     GSource source;
     NvCtrlEventHandle *event_handle;
     GPollFD event_poll_fd;
+    GPollFD nvml_poll_fd;
 
     CtkEventNode *ctk_events;
     struct __CtkEventSourceRec *next;
@@ -68,6 +72,7 @@ static guint binary_signals[NV_CTRL_BINARY_DATA_LAST_ATTRIBUTE + 1];
 static guint string_signals[NV_CTRL_STRING_LAST_ATTRIBUTE + 1];
 static guint signals[NV_CTRL_LAST_ATTRIBUTE + 1];
 static guint signal_RRScreenChangeNotify;
+static guint signal_XidCriticalError;
 
 /* List of event sources to track (one per dpy) */
 CtkEventSource *event_sources = NULL;
@@ -224,6 +229,8 @@ static void ctk_event_class_init(CtkEventClass *ctk_event_class,
     MAKE_SIGNAL(NV_CTRL_THERMAL_COOLER_CONTROL_TYPE);
     MAKE_SIGNAL(NV_CTRL_THERMAL_COOLER_TARGET);
     MAKE_SIGNAL(NV_CTRL_GPU_ECC_CONFIGURATION);
+    MAKE_SIGNAL(NV_CTRL_GPU_ECC_SINGLE_BIT_ERRORS);
+    MAKE_SIGNAL(NV_CTRL_GPU_ECC_DOUBLE_BIT_ERRORS);
     MAKE_SIGNAL(NV_CTRL_GPU_POWER_MIZER_MODE);
     MAKE_SIGNAL(NV_CTRL_OVERSCAN_COMPENSATION);
     MAKE_SIGNAL(NV_CTRL_GPU_PCIE_GENERATION);
@@ -398,6 +405,14 @@ static void ctk_event_class_init(CtkEventClass *ctk_event_class,
                      g_cclosure_marshal_VOID__POINTER,
                      G_TYPE_NONE, 1, G_TYPE_POINTER);
 
+    /* Make NVML XID error signal */
+    signal_XidCriticalError =
+        g_signal_new("CTK_EVENT_XidCriticalError",
+                     G_OBJECT_CLASS_TYPE(ctk_event_class),
+                     G_SIGNAL_RUN_LAST, 0, NULL, NULL,
+                     g_cclosure_marshal_VOID__POINTER,
+                     G_TYPE_NONE, 1, G_TYPE_POINTER);
+
 
 } /* ctk_event_class_init */
 
@@ -446,7 +461,7 @@ static void ctk_event_register_source(CtkEvent *ctk_event)
     /* create a new input source */
     if (!event_source) {
         GSource *source;
-        int event_fd;
+        int event_fd, nvml_fd;
 
         static GSourceFuncs ctk_source_funcs = {
             ctk_event_prepare,
@@ -463,14 +478,31 @@ static void ctk_event_register_source(CtkEvent *ctk_event)
             return;
         }
         
-        NvCtrlEventHandleGetFD(event_handle, &event_fd);
         event_source->event_handle = event_handle;
-        event_source->event_poll_fd.fd = event_fd;
-        event_source->event_poll_fd.events = G_IO_IN;
-        
+        event_source->event_poll_fd.fd = -1;
+        event_source->nvml_poll_fd.fd = -1;
+
         /* add the input source to the glib main loop */
-        
-        g_source_add_poll(source, &event_source->event_poll_fd);
+
+        if (NvCtrlEventHandleGetFD(event_handle, &event_fd) == NvCtrlSuccess) {
+            event_source->event_poll_fd.fd = event_fd;
+            event_source->event_poll_fd.events = G_IO_IN;
+            g_source_add_poll(source, &event_source->event_poll_fd);
+        }
+
+        if (NvCtrlEventHandleGetNvmlFD(event_handle, &nvml_fd) ==
+            NvCtrlSuccess) {
+            event_source->nvml_poll_fd.fd = nvml_fd;
+            event_source->nvml_poll_fd.events = G_IO_IN;
+            g_source_add_poll(source, &event_source->nvml_poll_fd);
+        }
+
+        /*
+         * Only the latest value of an attribute matters to the pages, so
+         * have bursts of events delivered as one event per attribute
+         */
+        NvCtrlEventHandleSetCoalescing(event_handle, TRUE);
+
         g_source_attach(source, NULL);
 
         /* add the source to the global list of sources */
@@ -565,7 +597,12 @@ static void ctk_event_unregister_source(CtkEvent *ctk_event)
         }
 
         NvCtrlCloseEventHandle(event_source->event_handle);
-        g_source_remove_poll(source, &(event_source->event_poll_fd));
+        if (event_source->event_poll_fd.fd != -1) {
+            g_source_remove_poll(source, &(event_source->event_poll_fd));
+        }
+        if (event_source->nvml_poll_fd.fd != -1) {
+            g_source_remove_poll(source, &(event_source->nvml_poll_fd));
+        }
         g_source_destroy(source);
         g_source_unref(source);
     }
@@ -616,6 +653,25 @@ void ctk_event_destroy(GObject *object)
 
 
 
+/*
+ * Stop polling the NVML event pipe once the event handle no longer uses it,
+ * i.e. NVML stopped delivering events; the pages poll the values instead.
+ */
+static void check_nvml_poll_fd(CtkEventSource *event_source)
+{
+    int nvml_fd;
+
+    if ((event_source->nvml_poll_fd.fd != -1) &&
+        (NvCtrlEventHandleGetNvmlFD(event_source->event_handle, &nvml_fd) !=
+         NvCtrlSuccess)) {
+        g_source_remove_poll((GSource *) event_source,
+                             &event_source->nvml_poll_fd);
+        event_source->nvml_poll_fd.fd = -1;
+    }
+}
+
+
+
 static gboolean ctk_event_prepare(GSource *source, gint *timeout)
 {
     ReturnStatus status;
@@ -623,6 +679,8 @@ static gboolean ctk_event_prepare(GSource *source, gint *timeout)
     CtkEventSource *event_source = (CtkEventSource *) source;
     *timeout = -1;
 
+    check_nvml_poll_fd(event_source);
+
     /*
      * Check if any events are pending on the event handle
      */
@@ -648,6 +706,7 @@ static gboolean ctk_event_check(GSource *source)
      * the G_IO_OUT flag set which is odd.
      */
     status = NvCtrlEventHandlePending(event_source->event_handle, &pending);
+    check_nvml_poll_fd(event_source);
     if (status == NvCtrlSuccess) {
         return pending;
     }
@@ -677,10 +736,16 @@ static gboolean ctk_event_dispatch(GSource *source,
     CtrlEvent event;
     CtkEventSource *event_source = (CtkEventSource *) source;
 
+    /*
+     * Run the callbacks of the asynchronous attribute queries answered
+     * since the last dispatch
+     */
+    NvCtrlEventHandleDispatchReplies(event_source->event_handle);
+
     /*
      * if ctk_event_dispatch() is called, then either
      * ctk_event_prepare() or ctk_event_check() returned TRUE, so we
-     * know there is an event pending
+     * know there is an event (or an answered query) pending
      */
     status = NvCtrlEventHandleNextEvent(event_source->event_handle, &event);
     if (status != NvCtrlSuccess) {
@@ -759,6 +824,15 @@ static gboolean ctk_event_dispatch(GSource *source,
                                     &event);
             }
         }
+
+        /*
+         * Handle the CTRL_EVENT_TYPE_XID_ERROR event
+         */
+        else if (event.type == CTRL_EVENT_TYPE_XID_ERROR) {
+            CTK_EVENT_BROADCAST(event_source,
+                                signal_XidCriticalError,
+                                &event);
+        }
     }
     
     return TRUE;
@@ -808,43 +808,17 @@ static void probe_displays_received(GObject *object,
 
 
 
-static gboolean update_gpu_usage(gpointer user_data)
+/*
+ * set_gpu_utilization() - Update the utilization labels with the given
+ * NV_CTRL_STRING_GPU_UTILIZATION reading, or mark them as unknown if it
+ * could not be read.
+ */
+
+static void set_gpu_utilization(CtkGpu *ctk_gpu, ReturnStatus ret,
+                                const utilizationEntry *entry)
 {
-    CtkGpu *ctk_gpu;
-    gchar *memory_text;
     gchar *utilization_text = NULL;
-    ReturnStatus ret;
-    gchar *utilizationStr = NULL;
-    gint value = 0;
-    utilizationEntry entry;
-    CtrlTarget *ctrl_target;
-
-    ctk_gpu = CTK_GPU(user_data);
-    ctrl_target = ctk_gpu->ctrl_target;
-
-    ret = NvCtrlGetAttribute(ctrl_target, NV_CTRL_USED_DEDICATED_GPU_MEMORY,
-                             &value);
-    if (ret != NvCtrlSuccess || value > ctk_gpu->gpu_memory || value < 0) {
-        gtk_label_set_text(GTK_LABEL(ctk_gpu->gpu_memory_used_label), "Unknown");
-        return FALSE;
-    } else {
-        if (ctk_gpu->gpu_memory > 0) {
-            memory_text = g_strdup_printf("%d MB (%.0f%%)", 
-                                          value, 
-                                          100.0 * (double) value / 
-                                              (double) ctk_gpu->gpu_memory);
-        } else {
-            memory_text = g_strdup_printf("%d MB", value);
-        }
 
-        gtk_label_set_text(GTK_LABEL(ctk_gpu->gpu_memory_used_label), memory_text);
-        g_free(memory_text);
-    }
-
-    /* GPU utilization */
-    ret = NvCtrlGetStringAttribute(ctrl_target,
-                                   NV_CTRL_STRING_GPU_UTILIZATION,
-                                   &utilizationStr);
     if (ret != NvCtrlSuccess) {
         if (ctk_gpu->gpu_utilization_label) {
             gtk_label_set_text(GTK_LABEL(ctk_gpu->gpu_utilization_label),
@@ -858,43 +832,164 @@ static gboolean update_gpu_usage(gpointer user_data)
             gtk_label_set_text(GTK_LABEL(ctk_gpu->pcie_utilization_label),
                                "Unknown");
         }
-        return FALSE;
+        return;
     }
 
-    memset(&entry, 0, sizeof(entry));
-    parse_token_value_pairs(utilizationStr, apply_gpu_utilization_token,
-                            &entry);
-    if ((entry.graphics_specified) &&
+    if ((entry->graphics_specified) &&
         (ctk_gpu->gpu_utilization_label)) {
         utilization_text = g_strdup_printf("%d %%",
-                                           entry.graphics);
+                                           entry->graphics);
 
         gtk_label_set_text(GTK_LABEL(ctk_gpu->gpu_utilization_label),
                            utilization_text);
         g_free(utilization_text);
     }
-    if ((entry.video_specified) &&
+    if ((entry->video_specified) &&
         (ctk_gpu->video_utilization_label)) {
         utilization_text = g_strdup_printf("%d %%",
-                                           entry.video);
+                                           entry->video);
 
         gtk_label_set_text(GTK_LABEL(ctk_gpu->video_utilization_label),
                            utilization_text);
         g_free(utilization_text);
     }
-    if ((entry.pcie_specified) &&
+    if ((entry->pcie_specified) &&
         (ctk_gpu->pcie_utilization_label)) {
         utilization_text = g_strdup_printf("%d %%",
-                                           entry.pcie);
+                                           entry->pcie);
 
         gtk_label_set_text(GTK_LABEL(ctk_gpu->pcie_utilization_label),
                            utilization_text);
         g_free(utilization_text);
     }
+}
+
+
+
+/*
+ * gpu_utilization_received() - Completion of the asynchronous
+ * NV_CTRL_STRING_GPU_UTILIZATION query sent by update_gpu_usage().
+ */
+
+static void gpu_utilization_received(const CtrlTarget *ctrl_target, int attr,
+                                     ReturnStatus status, const char *str,
+                                     void *data)
+{
+    CtkGpu *ctk_gpu = CTK_GPU(data);
+    utilizationEntry entry;
+
+    ctk_gpu->utilization_pending = FALSE;
+
+    memset(&entry, 0, sizeof(entry));
+
+    if (status == NvCtrlSuccess) {
+        parse_token_value_pairs(str, apply_gpu_utilization_token, &entry);
+    }
+
+    set_gpu_utilization(ctk_gpu, status, &entry);
+
+    /* As update_gpu_usage() does when the query fails synchronously */
+    if (status != NvCtrlSuccess) {
+        ctk_config_stop_timer(ctk_gpu->ctk_config,
+                              (GSourceFunc) update_gpu_usage,
+                              (gpointer) ctk_gpu);
+    }
+}
+
+
+
+static gboolean update_gpu_usage(gpointer user_data)
+{
+    CtkGpu *ctk_gpu;
+    gchar *memory_text;
+    ReturnStatus ret;
+    gchar *utilizationStr = NULL;
+    gint value = 0;
+    utilizationEntry entry;
+    CtrlTarget *ctrl_target;
+    CtrlGpuTelemetry telemetry;
+
+    ctk_gpu = CTK_GPU(user_data);
+    ctrl_target = ctk_gpu->ctrl_target;
+
+    /*
+     * Read what we can from the NVML telemetry snapshot shared with the
+     * thermal and PowerMizer pages; fall back to individual attributes.
+     */
+    if (NvCtrlGetGpuTelemetry(ctrl_target, &telemetry) != NvCtrlSuccess) {
+        telemetry.valid = 0;
+    }
+
+    if (telemetry.valid & CTRL_GPU_TELEMETRY_MEMORY) {
+        value = telemetry.used_memory;
+        ret = NvCtrlSuccess;
+    } else {
+        ret = NvCtrlGetAttribute(ctrl_target,
+                                 NV_CTRL_USED_DEDICATED_GPU_MEMORY, &value);
+    }
+    if (ret != NvCtrlSuccess || value > ctk_gpu->gpu_memory || value < 0) {
+        gtk_label_set_text(GTK_LABEL(ctk_gpu->gpu_memory_used_label), "Unknown");
+        return FALSE;
+    } else {
+        if (ctk_gpu->gpu_memory > 0) {
+            memory_text = g_strdup_printf("%d MB (%.0f%%)", 
+                                          value, 
+                                          100.0 * (double) value / 
+                                              (double) ctk_gpu->gpu_memory);
+        } else {
+            memory_text = g_strdup_printf("%d MB", value);
+        }
+
+        gtk_label_set_text(GTK_LABEL(ctk_gpu->gpu_memory_used_label), memory_text);
+        g_free(memory_text);
+    }
+
+    /* GPU utilization */
+    memset(&entry, 0, sizeof(entry));
+
+    if (!ctrl_target->system->has_nv_control &&
+        (telemetry.valid & CTRL_GPU_TELEMETRY_UTILIZATION)) {
+        /*
+         * Without X, NV_CTRL_STRING_GPU_UTILIZATION would be answered by
+         * NVML with the same graphics rate.
+         */
+        entry.graphics = telemetry.gpu_utilization;
+        entry.graphics_specified = TRUE;
+        ret = NvCtrlSuccess;
+    } else {
+        /*
+         * Let the X server answer in the background, so that a slow server
+         * does not stall the GUI; the labels are updated when the reply is
+         * dispatched by the CtkEvent source.  Keep showing the previous
+         * values while the last query is not answered yet.
+         */
+        if (ctk_gpu->utilization_pending) {
+            return TRUE;
+        }
+
+        ret = NvCtrlGetStringAttributeAsync(ctrl_target,
+                                            NV_CTRL_STRING_GPU_UTILIZATION,
+                                            gpu_utilization_received,
+                                            ctk_gpu);
+        if (ret == NvCtrlSuccess) {
+            ctk_gpu->utilization_pending = TRUE;
+            return TRUE;
+        }
+
+        ret = NvCtrlGetStringAttribute(ctrl_target,
+                                       NV_CTRL_STRING_GPU_UTILIZATION,
+                                       &utilizationStr);
+        if (ret == NvCtrlSuccess) {
+            parse_token_value_pairs(utilizationStr,
+                                    apply_gpu_utilization_token, &entry);
+        }
+    }
+
+    set_gpu_utilization(ctk_gpu, ret, &entry);
 
     free(utilizationStr);
 
-    return TRUE;
+    return (ret == NvCtrlSuccess);
 }
 
 void ctk_gpu_page_select(GtkWidget *widget)
@@ -69,6 +69,7 @@ struct _CtkGpu
     gint memory_interface;
     gboolean resizable_bar;
     gboolean pcie_gen_queriable;
+    gboolean utilization_pending;  /* GPU utilization query not answered */
 };
 
 struct _CtkGpuClass
@@ -22,6 +22,7 @@
 
 #include <gtk/gtk.h>
 #include <NvCtrlAttributes.h>
+#include "nvml.h"
 
 #include "msg.h"
 
@@ -902,36 +903,16 @@ static void update_perf_mode_table(CtkPowermizer *ctk_powermizer,
 
 
 
-static gboolean update_powermizer_info(gpointer user_data)
+static void update_clock_info(CtkPowermizer *ctk_powermizer)
 {
-    gint power_source, adaptive_clock, perf_level;
     gint gpu_clock, memory_transfer_rate;
 
-    CtkPowermizer *ctk_powermizer = CTK_POWERMIZER(user_data);
     CtrlTarget *ctrl_target = ctk_powermizer->ctrl_target;
     gint ret;
     gchar *s;
     char *clock_string = NULL;
     perfModeEntry pEntry;
 
-    ret = NvCtrlGetAttribute(ctrl_target, NV_CTRL_GPU_ADAPTIVE_CLOCK_STATE,
-                             &adaptive_clock);
-    if (ret == NvCtrlSuccess && ctk_powermizer->adaptive_clock_status) { 
-
-        if (adaptive_clock == NV_CTRL_GPU_ADAPTIVE_CLOCK_STATE_ENABLED) {
-            s = g_strdup_printf("Enabled");
-        }
-        else if (adaptive_clock == NV_CTRL_GPU_ADAPTIVE_CLOCK_STATE_DISABLED) {
-            s = g_strdup_printf("Disabled");
-        }
-        else {
-            s = g_strdup_printf("Error");
-        }
-
-        gtk_label_set_text(GTK_LABEL(ctk_powermizer->adaptive_clock_status), s);
-        g_free(s);
-    }
-
     /* Get the current values of clocks */
 
     ret = NvCtrlGetStringAttribute(ctrl_target,
@@ -963,9 +944,149 @@ static gboolean update_powermizer_info(gpointer user_data)
         }
     }
     free(clock_string);
+}
+
+
+
+/*
+ * clock_change_event_received() - called when NVML reports a change of the
+ * GPU clocks, so that they need not be polled.
+ */
+
+static void clock_change_event_received(GObject *object,
+                                        CtrlEvent *event,
+                                        gpointer user_data)
+{
+    CtkPowermizer *ctk_powermizer = CTK_POWERMIZER(user_data);
+
+    update_clock_info(ctk_powermizer);
+}
+
+
+
+static void set_adaptive_clock_state(CtkPowermizer *ctk_powermizer,
+                                     gint adaptive_clock)
+{
+    gchar *s;
+
+    if (!ctk_powermizer->adaptive_clock_status) {
+        return;
+    }
+
+    if (adaptive_clock == NV_CTRL_GPU_ADAPTIVE_CLOCK_STATE_ENABLED) {
+        s = g_strdup_printf("Enabled");
+    }
+    else if (adaptive_clock == NV_CTRL_GPU_ADAPTIVE_CLOCK_STATE_DISABLED) {
+        s = g_strdup_printf("Disabled");
+    }
+    else {
+        s = g_strdup_printf("Error");
+    }
+
+    gtk_label_set_text(GTK_LABEL(ctk_powermizer->adaptive_clock_status), s);
+    g_free(s);
+}
+
+
+
+static void set_performance_level(CtkPowermizer *ctk_powermizer,
+                                  gint perf_level)
+{
+    gchar *s;
+
+    if (ctk_powermizer->performance_level) {
+        s = g_strdup_printf("%d", perf_level);
+        gtk_label_set_text(GTK_LABEL(ctk_powermizer->performance_level), s);
+        g_free(s);
+    }
+
+    if (ctk_powermizer->performance_level && ctk_powermizer->gpu_clock) {
+        update_perf_mode_table(ctk_powermizer, perf_level);
+    }
+}
+
+
+
+/*
+ * Completion of the asynchronous queries sent by update_powermizer_info()
+ */
+
+static void powermizer_attribute_received(const CtrlTarget *ctrl_target,
+                                          int attr, ReturnStatus status,
+                                          int64_t val, void *data)
+{
+    CtkPowermizer *ctk_powermizer = CTK_POWERMIZER(data);
+
+    if (status != NvCtrlSuccess) {
+        return;
+    }
+
+    switch (attr) {
+    case NV_CTRL_GPU_ADAPTIVE_CLOCK_STATE:
+        set_adaptive_clock_state(ctk_powermizer, val);
+        break;
+    case NV_CTRL_GPU_CURRENT_PERFORMANCE_LEVEL:
+        set_performance_level(ctk_powermizer, val);
+        break;
+    }
+}
+
+
+
+static gboolean update_powermizer_info(gpointer user_data)
+{
+    gint power_source, adaptive_clock, perf_level;
+
+    CtkPowermizer *ctk_powermizer = CTK_POWERMIZER(user_data);
+    CtrlTarget *ctrl_target = ctk_powermizer->ctrl_target;
+    unsigned long long event_types;
+    gint ret;
+    gchar *s;
+    CtrlGpuTelemetry telemetry;
+
+    /* Shared with the GPU and thermal pages; see NvCtrlGetGpuTelemetry() */
+    if (NvCtrlGetGpuTelemetry(ctrl_target, &telemetry) != NvCtrlSuccess) {
+        telemetry.valid = 0;
+    }
+
+    /*
+     * The adaptive clock state and performance level are only available
+     * from the X server: let it answer in the background, so that a slow
+     * server does not stall the GUI.
+     */
+    if (NvCtrlGetAttributeAsync(ctrl_target, NV_CTRL_GPU_ADAPTIVE_CLOCK_STATE,
+                                powermizer_attribute_received,
+                                ctk_powermizer) != NvCtrlSuccess) {
+        ret = NvCtrlGetAttribute(ctrl_target,
+                                 NV_CTRL_GPU_ADAPTIVE_CLOCK_STATE,
+                                 &adaptive_clock);
+        if (ret == NvCtrlSuccess) {
+            set_adaptive_clock_state(ctk_powermizer, adaptive_clock);
+        }
+    }
 
-    ret = NvCtrlGetAttribute(ctrl_target, NV_CTRL_GPU_POWER_SOURCE,
-                             &power_source);
+    /*
+     * The clocks are refreshed on NVML clock change events, if delivered;
+     * poll them again if NVML stopped delivering events.
+     */
+
+    if (ctk_powermizer->clock_events &&
+        (NvCtrlGetNvmlEventTypes(ctrl_target, &event_types) !=
+         NvCtrlSuccess)) {
+        ctk_powermizer->clock_events = FALSE;
+    }
+
+    if (!ctk_powermizer->clock_events) {
+        update_clock_info(ctk_powermizer);
+    }
+
+    if (telemetry.valid & CTRL_GPU_TELEMETRY_POWER_SOURCE) {
+        power_source = telemetry.power_source;
+        ret = NvCtrlSuccess;
+    } else {
+        ret = NvCtrlGetAttribute(ctrl_target, NV_CTRL_GPU_POWER_SOURCE,
+                                 &power_source);
+    }
     if (ret == NvCtrlSuccess && ctk_powermizer->power_source) {
 
         if (power_source == NV_CTRL_GPU_POWER_SOURCE_AC) {
@@ -984,8 +1105,12 @@ static gboolean update_powermizer_info(gpointer user_data)
 
     if (ctk_powermizer->link_width) {
         /* NV_CTRL_GPU_PCIE_CURRENT_LINK_WIDTH */
-        s = get_pcie_link_width_string(ctrl_target,
-                                       NV_CTRL_GPU_PCIE_CURRENT_LINK_WIDTH);
+        if (telemetry.valid & CTRL_GPU_TELEMETRY_PCIE_LINK_WIDTH) {
+            s = g_strdup_printf("x%d", telemetry.pcie_link_width);
+        } else {
+            s = get_pcie_link_width_string(ctrl_target,
+                                           NV_CTRL_GPU_PCIE_CURRENT_LINK_WIDTH);
+        }
         gtk_label_set_text(GTK_LABEL(ctk_powermizer->link_width), s);
         g_free(s);
     }
@@ -998,17 +1123,16 @@ static gboolean update_powermizer_info(gpointer user_data)
         g_free(s);
     }
 
-    ret = NvCtrlGetAttribute(ctrl_target,
-                             NV_CTRL_GPU_CURRENT_PERFORMANCE_LEVEL,
-                             &perf_level);
-    if (ret == NvCtrlSuccess && ctk_powermizer->performance_level) {
-        s = g_strdup_printf("%d", perf_level);
-        gtk_label_set_text(GTK_LABEL(ctk_powermizer->performance_level), s);
-        g_free(s);
-    }
-
-    if (ctk_powermizer->performance_level && ctk_powermizer->gpu_clock) {
-        update_perf_mode_table(ctk_powermizer, perf_level);
+    if (NvCtrlGetAttributeAsync(ctrl_target,
+                                NV_CTRL_GPU_CURRENT_PERFORMANCE_LEVEL,
+                                powermizer_attribute_received,
+                                ctk_powermizer) != NvCtrlSuccess) {
+        ret = NvCtrlGetAttribute(ctrl_target,
+                                 NV_CTRL_GPU_CURRENT_PERFORMANCE_LEVEL,
+                                 &perf_level);
+        if (ret == NvCtrlSuccess) {
+            set_performance_level(ctk_powermizer, perf_level);
+        }
     }
 
     update_powermizer_menu_info(ctk_powermizer);
@@ -1098,6 +1222,7 @@ GtkWidget* ctk_powermizer_new(CtrlTarget *ctrl_target,
     GtkWidget *banner, *label;
     CtkDropDownMenu *menu;
     ReturnStatus ret;
+    unsigned long long event_types;
     gint nvclock_attribute = 0, mem_transfer_rate_attribute = 0;
     gint val;
     gint row = 0;
@@ -1406,6 +1531,15 @@ GtkWidget* ctk_powermizer_new(CtrlTarget *ctrl_target,
         ctk_powermizer->performance_table_hbox1 = hbox;
     }
 
+    /*
+     * Refresh the clocks when NVML reports a change, rather than polling
+     * them, if the GPU delivers clock change events.
+     */
+    if ((NvCtrlGetNvmlEventTypes(ctrl_target, &event_types) == NvCtrlSuccess) &&
+        (event_types & nvmlEventTypeClock)) {
+        ctk_powermizer->clock_events = TRUE;
+    }
+
     /* Register a timer callback to update the temperatures */
 
     s = g_strdup_printf("PowerMizer Monitor (GPU %d)",
@@ -1521,6 +1655,9 @@ GtkWidget* ctk_powermizer_new(CtrlTarget *ctrl_target,
     /* Updating the powermizer page */
 
     update_powermizer_info(ctk_powermizer);
+    if (ctk_powermizer->clock_events) {
+        update_clock_info(ctk_powermizer);
+    }
 
     /* Add editable performance level table */
 
@@ -1537,6 +1674,11 @@ GtkWidget* ctk_powermizer_new(CtrlTarget *ctrl_target,
                      G_CALLBACK(update_powermizer_menu_event),
                      (gpointer) ctk_powermizer);
 
+    g_signal_connect(G_OBJECT(ctk_event),
+                     CTK_EVENT_NAME(NV_CTRL_STRING_GPU_CURRENT_CLOCK_FREQS),
+                     G_CALLBACK(clock_change_event_received),
+                     (gpointer) ctk_powermizer);
+
     if (nvclock_attribute == NV_CTRL_GPU_NVCLOCK_OFFSET_ALL_PERFORMANCE_LEVELS) {
         g_signal_connect(G_OBJECT(ctk_event),
                          CTK_EVENT_NAME(NV_CTRL_GPU_NVCLOCK_OFFSET_ALL_PERFORMANCE_LEVELS),
@@ -68,6 +68,7 @@ struct _CtkPowermizer
     gboolean  hasDecoupledClock;
     gboolean  hasEditablePerfLevel;
     gboolean  editable_performance_levels_unified;
+    gboolean  clock_events;  /* clocks are updated on NVML events */
     gint      nvclock_attribute;
     gint      mem_transfer_rate_attribute;
     gint      powermizer_default_mode;
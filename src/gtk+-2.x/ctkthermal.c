@@ -171,6 +171,7 @@ static gboolean update_cooler_info(gpointer user_data)
     gboolean cooler_extra_info = FALSE;
     int num_cols = 2;
     int current_speed_attr;
+    CtrlGpuTelemetry telemetry;
 
     ctk_thermal = CTK_THERMAL(user_data);
 
@@ -269,9 +270,18 @@ static gboolean update_cooler_info(gpointer user_data)
                          GTK_FILL, GTK_FILL | GTK_EXPAND, 5, 0);
         free(tmp_str);
 
-        ret = NvCtrlGetAttribute(ctk_thermal->cooler_control[i].ctrl_target,
-                                 current_speed_attr,
-                                 &speed);
+        if ((current_speed_attr == NV_CTRL_THERMAL_COOLER_CURRENT_LEVEL) &&
+            (NvCtrlGetGpuTelemetry(ctk_thermal->cooler_control[i].ctrl_target,
+                                   &telemetry) == NvCtrlSuccess) &&
+            (telemetry.valid & CTRL_GPU_TELEMETRY_FAN_SPEED) &&
+            (telemetry.fan_index >= 0)) {
+            speed = telemetry.fan_speed[telemetry.fan_index];
+            ret = NvCtrlSuccess;
+        } else {
+            ret = NvCtrlGetAttribute(ctk_thermal->cooler_control[i].ctrl_target,
+                                     current_speed_attr,
+                                     &speed);
+        }
         if (ret == NvCtrlSuccess) {
             tmp_str = g_strdup_printf("%d", speed);
         }
@@ -370,18 +380,87 @@ static gboolean update_cooler_info(gpointer user_data)
 
 
 
+/*
+ * set_sensor_reading() - Update the temperature label and gauge of a
+ * thermal sensor.
+ */
+
+static void set_sensor_reading(SensorInfoPtr sensor, int reading)
+{
+    gchar *s;
+
+    if (sensor->temp_label) {
+        s = g_strdup_printf(" %d C ", reading);
+        gtk_label_set_text(GTK_LABEL(sensor->temp_label), s);
+        g_free(s);
+    }
+
+    if (sensor->core_gauge) {
+        ctk_gauge_set_current(CTK_GAUGE(sensor->core_gauge), reading);
+        ctk_gauge_draw(CTK_GAUGE(sensor->core_gauge));
+    }
+}
+
+
+
+/*
+ * sensor_reading_received() - Completion of the asynchronous
+ * NV_CTRL_THERMAL_SENSOR_READING query sent by update_thermal_info().
+ */
+
+static void sensor_reading_received(const CtrlTarget *ctrl_target, int attr,
+                                    ReturnStatus status, int64_t val,
+                                    void *data)
+{
+    /* querying THERMAL_SENSOR_READING failed: assume the temperature is 0 */
+    set_sensor_reading((SensorInfoPtr) data,
+                       (status == NvCtrlSuccess) ? (int) val : 0);
+}
+
+
+
+/*
+ * ambient_temperature_received() - Completion of the asynchronous
+ * NV_CTRL_AMBIENT_TEMPERATURE query sent by update_thermal_info().
+ */
+
+static void ambient_temperature_received(const CtrlTarget *ctrl_target,
+                                         int attr, ReturnStatus status,
+                                         int64_t val, void *data)
+{
+    CtkThermal *ctk_thermal = CTK_THERMAL(data);
+    gchar *s;
+
+    if (status != NvCtrlSuccess) {
+        return;
+    }
+
+    s = g_strdup_printf(" %d C ", (int) val);
+    gtk_label_set_text(GTK_LABEL(ctk_thermal->ambient_label), s);
+    g_free(s);
+}
+
+
+
 static gboolean update_thermal_info(gpointer user_data)
 {
     gint reading, ambient;
     CtkThermal *ctk_thermal = CTK_THERMAL(user_data);
     gint ret, i, core;
     gchar *s;
+    CtrlGpuTelemetry telemetry;
 
     if (!ctk_thermal->thermal_sensor_target_type_supported) {
         CtrlTarget *ctrl_target = ctk_thermal->ctrl_target;
 
-        ret = NvCtrlGetAttribute(ctrl_target, NV_CTRL_GPU_CORE_TEMPERATURE,
-                                 &core);
+        if ((NvCtrlGetGpuTelemetry(ctrl_target, &telemetry) == NvCtrlSuccess) &&
+            (telemetry.valid & CTRL_GPU_TELEMETRY_TEMPERATURE)) {
+            core = telemetry.temperature;
+            ret = NvCtrlSuccess;
+        } else {
+            ret = NvCtrlGetAttribute(ctrl_target,
+                                     NV_CTRL_GPU_CORE_TEMPERATURE, &core);
+        }
         if (ret != NvCtrlSuccess) {
             /* thermal information no longer available */
             return FALSE;
@@ -394,7 +473,11 @@ static gboolean update_thermal_info(gpointer user_data)
         ctk_gauge_set_current(CTK_GAUGE(ctk_thermal->core_gauge), core);
         ctk_gauge_draw(CTK_GAUGE(ctk_thermal->core_gauge));
 
-        if (ctk_thermal->ambient_label) {
+        if (ctk_thermal->ambient_label &&
+            (NvCtrlGetAttributeAsync(ctrl_target,
+                                     NV_CTRL_AMBIENT_TEMPERATURE,
+                                     ambient_temperature_received,
+                                     ctk_thermal) != NvCtrlSuccess)) {
             ret = NvCtrlGetAttribute(ctrl_target,
                                      NV_CTRL_AMBIENT_TEMPERATURE,
                                      &ambient);
@@ -408,7 +491,25 @@ static gboolean update_thermal_info(gpointer user_data)
         }
     } else {
         for (i = 0; i < ctk_thermal->sensor_count; i++) {
-            CtrlTarget *ctrl_target = ctk_thermal->sensor_info[i].ctrl_target;
+            SensorInfoPtr sensor = &ctk_thermal->sensor_info[i];
+            CtrlTarget *ctrl_target = sensor->ctrl_target;
+
+            /* The GPU core temperature is also sampled through NVML */
+            if (sensor->gpu_core &&
+                (NvCtrlGetGpuTelemetry(ctk_thermal->ctrl_target,
+                                       &telemetry) == NvCtrlSuccess) &&
+                (telemetry.valid & CTRL_GPU_TELEMETRY_TEMPERATURE)) {
+                set_sensor_reading(sensor, telemetry.temperature);
+                continue;
+            }
+
+            /* The reading is shown once the X server answers */
+            if (NvCtrlGetAttributeAsync(ctrl_target,
+                                        NV_CTRL_THERMAL_SENSOR_READING,
+                                        sensor_reading_received,
+                                        sensor) == NvCtrlSuccess) {
+                continue;
+            }
 
             ret = NvCtrlGetAttribute(ctrl_target,
                                      NV_CTRL_THERMAL_SENSOR_READING,
@@ -417,20 +518,8 @@ static gboolean update_thermal_info(gpointer user_data)
             if (ret != NvCtrlSuccess) {
                 reading = 0;
             }
-            
-            if (ctk_thermal->sensor_info[i].temp_label) {
-                s = g_strdup_printf(" %d C ", reading);
-                gtk_label_set_text(
-                                   GTK_LABEL(ctk_thermal->sensor_info[i].temp_label), s);
-                g_free(s);
-            }
-            
-            if (ctk_thermal->sensor_info[i].core_gauge) {
-                ctk_gauge_set_current(
-                          CTK_GAUGE(ctk_thermal->sensor_info[i].core_gauge),
-                          reading);
-                ctk_gauge_draw(CTK_GAUGE(ctk_thermal->sensor_info[i].core_gauge));
-            }
+
+            set_sensor_reading(sensor, reading);
         }
     }
     if ( ctk_thermal->cooler_count ) {
@@ -1132,6 +1221,7 @@ GtkWidget* ctk_thermal_new(CtrlTarget *ctrl_target,
     Bool cooler_control_enabled;
     int cur_cooler_idx = 0;
     int cur_sensor_idx = 0;
+    int gpu_core_sensor_count = 0;
     Bool thermal_sensor_target_type_supported = FALSE;
 
     /* make sure we have a handle */
@@ -1312,6 +1402,13 @@ GtkWidget* ctk_thermal_new(CtrlTarget *ctrl_target,
                 /* sensor information unavailable */
                 provider = 0;
             }
+            ctk_thermal->sensor_info[cur_sensor_idx].gpu_core =
+                (target == NV_CTRL_THERMAL_SENSOR_TARGET_GPU) &&
+                (provider == NV_CTRL_THERMAL_SENSOR_PROVIDER_GPU_INTERNAL);
+            if (ctk_thermal->sensor_info[cur_sensor_idx].gpu_core) {
+                gpu_core_sensor_count++;
+            }
+
             /* print sensor related information */
             draw_sensor_gui(vbox, ctk_thermal, thermal_sensor_target_type_supported,
                             cur_sensor_idx,
@@ -1319,6 +1416,17 @@ GtkWidget* ctk_thermal_new(CtrlTarget *ctrl_target,
                             sensor_range.range.max, target, provider, slowdown);
             cur_sensor_idx++;
         }
+
+        /*
+         * NVML only reports the GPU core temperature: it can only stand for
+         * the reading of the sensor if that sensor is the GPU's only
+         * internal one.
+         */
+        if (gpu_core_sensor_count > 1) {
+            for (j = 0; j < cur_sensor_idx; j++) {
+                ctk_thermal->sensor_info[j].gpu_core = FALSE;
+            }
+        }
     } else {
         /* GPU Core Threshold Temperature */
 
@@ -64,6 +64,7 @@ typedef struct {
 
 typedef struct _SensorInfo {
     CtrlTarget *ctrl_target;
+    gboolean gpu_core;  /* the GPU's internal sensor, read through NVML */
     int currentTemp;
     int minTemp;
     int maxTemp;
@@ -437,6 +437,508 @@ Bool XNVCTRLQueryTargetAttribute64 (
 }
 
 
+/*
+ * State of the async reply handler of query_target_attributes(): the
+ * replies to the nvReqType requests with sequence numbers first_seq to
+ * first_seq + count - 1 are stored in queries[0] to queries[count - 1].
+ */
+
+typedef struct {
+    unsigned long first_seq;
+    int count;
+    int nvReqType;
+    NVCTRLAttributeQueryRec *queries;
+} QueryAttributesState;
+
+/*
+ * Stores the attribute reply 'repl' to an nvReqType request in 'query'; the
+ * X_nvCtrlQueryAttribute and X_nvCtrlQueryAttribute64 replies only differ
+ * in how the value is packed.
+ */
+
+static void store_attribute_reply(NVCTRLAttributeQueryRec *query,
+                                  int nvReqType, const xReply *repl)
+{
+    if (nvReqType == X_nvCtrlQueryAttribute64) {
+        const xnvCtrlQueryAttribute64Reply *rep64 =
+            (const xnvCtrlQueryAttribute64Reply *) repl;
+        query->exists = rep64->flags;
+        if (query->exists) query->value = rep64->value_64;
+    } else {
+        const xnvCtrlQueryAttributeReply *rep32 =
+            (const xnvCtrlQueryAttributeReply *) repl;
+        query->exists = rep32->flags;
+        if (query->exists) query->value = rep32->value;
+    }
+}
+
+static Bool query_attributes_handler(
+    Display *dpy,
+    xReply *rep,
+    char *buf,
+    int len,
+    XPointer data
+){
+    QueryAttributesState *state = (QueryAttributesState *) data;
+    xnvCtrlQueryAttribute64Reply replbuf;
+    xReply *repl;
+
+    if ((dpy->last_request_read < state->first_seq) ||
+        (dpy->last_request_read >= state->first_seq + state->count)) {
+        return False;
+    }
+
+    /* Errors go to the error handler; the query is left as not existing */
+    if (rep->generic.type == X_Error) {
+        return False;
+    }
+
+    /* Both attribute replies are 32 bytes long */
+    repl = (xReply *)
+        _XGetAsyncReply(dpy, (char *) &replbuf, rep, buf, len,
+                        (SIZEOF(xnvCtrlQueryAttribute64Reply) -
+                         SIZEOF(xReply)) >> 2,
+                        True);
+
+    store_attribute_reply(&state->queries[dpy->last_request_read -
+                                          state->first_seq],
+                          state->nvReqType, repl);
+
+    return True;
+}
+
+
+/*
+ * Sends the nvReqType (X_nvCtrlQueryAttribute or X_nvCtrlQueryAttribute64)
+ * requests of all the queries back to back, and collects their replies,
+ * within a single LockDisplay()/UnlockDisplay() section: the output buffer
+ * is only flushed by the _XReply() waiting for the last reply.
+ */
+
+static void query_target_attributes(
+    Display *dpy,
+    XExtDisplayInfo *info,
+    NVCTRLAttributeQueryRec *queries,
+    int count,
+    int nvReqType
+){
+    xnvCtrlQueryAttribute64Reply rep;
+    xnvCtrlQueryAttributeReq *req;
+    QueryAttributesState state;
+    _XAsyncHandler async;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        queries[i].exists = False;
+    }
+
+    /*
+     * Determine the NV-CONTROL version, which XNVCTRLCheckTargetData() needs,
+     * before locking the Display
+     */
+    version_flags(dpy, info);
+
+    LockDisplay(dpy);
+
+    /*
+     * Queue all the requests before reading any reply: the replies to all
+     * but the last request are picked up by the async handler while
+     * _XReply() waits for the last one.
+     */
+    state.first_seq = dpy->request + 1;
+    state.count = count - 1;
+    state.nvReqType = nvReqType;
+    state.queries = queries;
+
+    if (state.count > 0) {
+        async.next = dpy->async_handlers;
+        async.handler = query_attributes_handler;
+        async.data = (XPointer) &state;
+        dpy->async_handlers = &async;
+    }
+
+    for (i = 0; i < count; i++) {
+        int target_type = queries[i].target_type;
+        int target_id = queries[i].target_id;
+
+        XNVCTRLCheckTargetData(dpy, info, &target_type, &target_id);
+
+        GetReq(nvCtrlQueryAttribute, req);
+        req->reqType = info->codes->major_opcode;
+        req->nvReqType = nvReqType;
+        req->target_type = target_type;
+        req->target_id = target_id;
+        req->display_mask = queries[i].display_mask;
+        req->attribute = queries[i].attribute;
+    }
+
+    if (_XReply(dpy, (xReply *)&rep, 0, xTrue)) {
+        store_attribute_reply(&queries[count - 1], nvReqType,
+                              (xReply *) &rep);
+    }
+
+    if (state.count > 0) {
+        DeqAsyncHandler(dpy, &async);
+    }
+
+    UnlockDisplay(dpy);
+    SyncHandle();
+}
+
+
+Bool XNVCTRLQueryTargetAttributes64 (
+    Display *dpy,
+    NVCTRLAttributeQueryRec *queries,
+    int count
+){
+    XExtDisplayInfo *info = find_display(dpy);
+
+    if (!queries || count <= 0)
+        return False;
+
+    if (!XextHasExtension(info))
+        return False;
+
+    XNVCTRLCheckExtension(dpy, info, False);
+
+    if (!(version_flags(dpy, info) & NVCTRL_EXT_64_BIT_ATTRIBUTES))
+        return False;
+
+    query_target_attributes(dpy, info, queries, count,
+                            X_nvCtrlQueryAttribute64);
+    return True;
+}
+
+
+Bool XNVCTRLQueryTargetAttributesMulti (
+    Display *dpy,
+    NVCTRLAttributeQueryRec *queries,
+    int count
+){
+    XExtDisplayInfo *info = find_display(dpy);
+
+    if (!queries || count <= 0)
+        return False;
+
+    if (!XextHasExtension(info))
+        return False;
+
+    XNVCTRLCheckExtension(dpy, info, False);
+
+    query_target_attributes(dpy, info, queries, count,
+                            X_nvCtrlQueryAttribute);
+    return True;
+}
+
+
+/*
+ * A query sent by one of the XNVCTRL*Async() functions, whose reply is
+ * stored by an async reply handler whenever Xlib reads it from the
+ * connection.  nvReqType is the NV-CONTROL request that was sent; string
+ * and binary data replies are stored in data, of len bytes (strings are
+ * also NUL terminated).
+ */
+
+struct _XNVCTRLAsyncQueryRec {
+    _XAsyncHandler async;
+    unsigned long seq;
+    int nvReqType;
+    Bool done;
+    Bool exists;
+    int64_t value;
+    char *data;
+    int len;
+};
+
+static Bool async_query_handler(
+    Display *dpy,
+    xReply *rep,
+    char *buf,
+    int len,
+    XPointer data
+){
+    XNVCTRLAsyncQueryRec *query = (XNVCTRLAsyncQueryRec *) data;
+
+    if (dpy->last_request_read != query->seq) {
+        return False;
+    }
+
+    DeqAsyncHandler(dpy, &query->async);
+    query->done = True;
+
+    /* Errors go to the error handler; the query is left as not existing */
+    if (rep->generic.type == X_Error) {
+        return False;
+    }
+
+    if (query->nvReqType == X_nvCtrlQueryAttribute64) {
+        xnvCtrlQueryAttribute64Reply replbuf;
+        xnvCtrlQueryAttribute64Reply *repl;
+
+        repl = (xnvCtrlQueryAttribute64Reply *)
+            _XGetAsyncReply(dpy, (char *) &replbuf, rep, buf, len,
+                            (SIZEOF(xnvCtrlQueryAttribute64Reply) -
+                             SIZEOF(xReply)) >> 2,
+                            True);
+        query->exists = repl->flags;
+        if (query->exists) query->value = repl->value_64;
+    } else if (query->nvReqType == X_nvCtrlQueryTargetCount) {
+        xnvCtrlQueryTargetCountReply replbuf;
+        xnvCtrlQueryTargetCountReply *repl;
+
+        repl = (xnvCtrlQueryTargetCountReply *)
+            _XGetAsyncReply(dpy, (char *) &replbuf, rep, buf, len,
+                            (SIZEOF(xnvCtrlQueryTargetCountReply) -
+                             SIZEOF(xReply)) >> 2,
+                            True);
+        query->exists = True;
+        query->value = repl->count;
+    } else {
+        /*
+         * xnvCtrlQueryBinaryDataReply has the same layout as
+         * xnvCtrlQueryStringAttributeReply.
+         */
+        xnvCtrlQueryStringAttributeReply replbuf;
+        xnvCtrlQueryStringAttributeReply *repl;
+        int numbytes;
+
+        repl = (xnvCtrlQueryStringAttributeReply *)
+            _XGetAsyncReply(dpy, (char *) &replbuf, rep, buf, len,
+                            (SIZEOF(xnvCtrlQueryStringAttributeReply) -
+                             SIZEOF(xReply)) >> 2,
+                            False);
+        numbytes = repl->n;
+        query->exists = repl->flags;
+        if (query->exists) {
+            query->data = (char *) Xmalloc(numbytes + 1);
+        }
+        if (query->data) {
+            _XGetAsyncData(dpy, query->data, buf, len,
+                           SIZEOF(xnvCtrlQueryStringAttributeReply),
+                           numbytes, repl->length << 2);
+            query->data[numbytes] = '\0';
+            query->len = numbytes;
+        } else {
+            query->exists = False;
+            _XGetAsyncData(dpy, NULL, buf, len,
+                           SIZEOF(xnvCtrlQueryStringAttributeReply),
+                           0, repl->length << 2);
+        }
+    }
+
+    return True;
+}
+
+
+
+/*
+ * Installs the reply handler of the query for the request that was just
+ * queued.  Must be called with the display locked.
+ */
+
+static void install_async_query (
+    Display *dpy,
+    XNVCTRLAsyncQueryRec *query
+){
+    query->seq = dpy->request;
+    query->async.next = dpy->async_handlers;
+    query->async.handler = async_query_handler;
+    query->async.data = (XPointer) query;
+    dpy->async_handlers = &query->async;
+}
+
+
+static XNVCTRLAsyncQueryRec *send_async_query (
+    Display *dpy,
+    int nvReqType,
+    int target_type,
+    int target_id,
+    unsigned int display_mask,
+    unsigned int attribute
+){
+    XExtDisplayInfo *info = find_display(dpy);
+    XNVCTRLAsyncQueryRec *query;
+    xnvCtrlQueryAttributeReq *req;
+
+    if (!XextHasExtension(info))
+        return NULL;
+
+    XNVCTRLCheckExtension(dpy, info, NULL);
+
+    if ((nvReqType == X_nvCtrlQueryAttribute64) &&
+        !(version_flags(dpy, info) & NVCTRL_EXT_64_BIT_ATTRIBUTES))
+        return NULL;
+
+    query = (XNVCTRLAsyncQueryRec *) Xcalloc(1, sizeof(XNVCTRLAsyncQueryRec));
+    if (!query)
+        return NULL;
+
+    query->nvReqType = nvReqType;
+
+    XNVCTRLCheckTargetData(dpy, info, &target_type, &target_id);
+
+    /*
+     * xnvCtrlQueryStringAttributeReq and xnvCtrlQueryBinaryDataReq have the
+     * same layout as xnvCtrlQueryAttributeReq.
+     */
+    LockDisplay(dpy);
+    GetReq(nvCtrlQueryAttribute, req);
+    req->reqType = info->codes->major_opcode;
+    req->nvReqType = nvReqType;
+    req->target_type = target_type;
+    req->target_id = target_id;
+    req->display_mask = display_mask;
+    req->attribute = attribute;
+
+    install_async_query(dpy, query);
+
+    UnlockDisplay(dpy);
+    SyncHandle();
+    return query;
+}
+
+
+XNVCTRLAsyncQueryRec *XNVCTRLQueryTargetAttribute64Async (
+    Display *dpy,
+    int target_type,
+    int target_id,
+    unsigned int display_mask,
+    unsigned int attribute
+){
+    return send_async_query(dpy, X_nvCtrlQueryAttribute64, target_type,
+                            target_id, display_mask, attribute);
+}
+
+
+XNVCTRLAsyncQueryRec *XNVCTRLQueryTargetStringAttributeAsync (
+    Display *dpy,
+    int target_type,
+    int target_id,
+    unsigned int display_mask,
+    unsigned int attribute
+){
+    return send_async_query(dpy, X_nvCtrlQueryStringAttribute, target_type,
+                            target_id, display_mask, attribute);
+}
+
+
+XNVCTRLAsyncQueryRec *XNVCTRLQueryTargetBinaryDataAsync (
+    Display *dpy,
+    int target_type,
+    int target_id,
+    unsigned int display_mask,
+    unsigned int attribute
+){
+    return send_async_query(dpy, X_nvCtrlQueryBinaryData, target_type,
+                            target_id, display_mask, attribute);
+}
+
+
+XNVCTRLAsyncQueryRec *XNVCTRLQueryTargetCountAsync (
+    Display *dpy,
+    int target_type
+){
+    XExtDisplayInfo *info = find_display(dpy);
+    XNVCTRLAsyncQueryRec *query;
+    xnvCtrlQueryTargetCountReq *req;
+
+    if (!XextHasExtension(info))
+        return NULL;
+
+    XNVCTRLCheckExtension(dpy, info, NULL);
+
+    query = (XNVCTRLAsyncQueryRec *) Xcalloc(1, sizeof(XNVCTRLAsyncQueryRec));
+    if (!query)
+        return NULL;
+
+    query->nvReqType = X_nvCtrlQueryTargetCount;
+
+    LockDisplay(dpy);
+    GetReq(nvCtrlQueryTargetCount, req);
+    req->reqType = info->codes->major_opcode;
+    req->nvReqType = X_nvCtrlQueryTargetCount;
+    req->target_type = target_type;
+
+    install_async_query(dpy, query);
+
+    UnlockDisplay(dpy);
+    SyncHandle();
+    return query;
+}
+
+
+Bool XNVCTRLAsyncQueryDone (
+    Display *dpy,
+    XNVCTRLAsyncQueryRec *query
+){
+    Bool done;
+
+    LockDisplay(dpy);
+    done = query->done;
+    UnlockDisplay(dpy);
+    return done;
+}
+
+
+Bool XNVCTRLAsyncQueryAttribute64 (
+    XNVCTRLAsyncQueryRec *query,
+    int64_t *value
+){
+    if (query->exists && value) *value = query->value;
+    return query->exists;
+}
+
+
+Bool XNVCTRLAsyncQueryStringAttribute (
+    XNVCTRLAsyncQueryRec *query,
+    char **ptr
+){
+    if (!ptr || !query->exists) return False;
+    *ptr = query->data;
+    query->data = NULL;
+    return True;
+}
+
+
+Bool XNVCTRLAsyncQueryBinaryData (
+    XNVCTRLAsyncQueryRec *query,
+    unsigned char **ptr,
+    int *len
+){
+    if (!ptr || !query->exists) return False;
+    *ptr = (unsigned char *) query->data;
+    if (len) *len = query->len;
+    query->data = NULL;
+    return True;
+}
+
+
+Bool XNVCTRLAsyncQueryTargetCount (
+    XNVCTRLAsyncQueryRec *query,
+    int *value
+){
+    if (query->exists && value) *value = query->value;
+    return query->exists;
+}
+
+
+void XNVCTRLFreeAsyncQuery (
+    Display *dpy,
+    XNVCTRLAsyncQueryRec *query
+){
+    if (!query) return;
+
+    LockDisplay(dpy);
+    if (!query->done) {
+        DeqAsyncHandler(dpy, &query->async);
+    }
+    UnlockDisplay(dpy);
+
+    XFree(query->data);
+    XFree(query);
+}
+
+
 Bool XNVCTRLQueryTargetStringAttribute (
     Display *dpy,
     int target_type,
@@ -980,22 +1482,24 @@ Bool XNVCtrlSelectNotify (
     return True;
 }
 
-Bool XNVCTRLQueryTargetBinaryData (
+Bool XNVCTRLQueryTargetBinaryDataToBuffer (
     Display *dpy,
     int target_type,
     int target_id,
     unsigned int display_mask,
     unsigned int attribute,
-    unsigned char **ptr,
+    unsigned char **buf,
+    int *size,
     int *len
 ){
     XExtDisplayInfo *info = find_display (dpy);
     xnvCtrlQueryBinaryDataReply rep;
     xnvCtrlQueryBinaryDataReq   *req;
+    unsigned char *data;
     Bool exists;
     int length, numbytes, slop;
 
-    if (!ptr) return False;
+    if (!buf || !size) return False;
 
     if(!XextHasExtension(info))
         return False;
@@ -1020,16 +1524,21 @@ Bool XNVCTRLQueryTargetBinaryData (
     numbytes = rep.n;
     slop = numbytes & 3;
     exists = rep.flags;
-    if (exists) {
-        *ptr = (unsigned char *) Xmalloc(numbytes);
+    data = *buf;
+    if (exists && (!data || (numbytes > *size))) {
+        data = (unsigned char *) Xrealloc(data, numbytes);
+        if (data) {
+            *buf = data;
+            *size = numbytes;
+        }
     }
-    if (!exists || !*ptr) {
+    if (!exists || !data) {
         _XEatData(dpy, length);
         UnlockDisplay (dpy);
         SyncHandle ();
         return False;
     } else {
-        _XRead(dpy, (char *) *ptr, numbytes);
+        _XRead(dpy, (char *) data, numbytes);
         if (slop) _XEatData(dpy, 4-slop);
     }
     if (len) *len = numbytes;
@@ -1038,6 +1547,30 @@ Bool XNVCTRLQueryTargetBinaryData (
     return exists;
 }
 
+Bool XNVCTRLQueryTargetBinaryData (
+    Display *dpy,
+    int target_type,
+    int target_id,
+    unsigned int display_mask,
+    unsigned int attribute,
+    unsigned char **ptr,
+    int *len
+){
+    unsigned char *data = NULL;
+    int size = 0;
+
+    if (!ptr) return False;
+
+    if (!XNVCTRLQueryTargetBinaryDataToBuffer(dpy, target_type, target_id,
+                                              display_mask, attribute,
+                                              &data, &size, len)) {
+        return False;
+    }
+
+    *ptr = data;
+    return True;
+}
+
 Bool XNVCTRLQueryBinaryData (
     Display *dpy,
     int screen,
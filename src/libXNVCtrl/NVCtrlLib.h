@@ -265,6 +265,66 @@ Bool XNVCTRLQueryTargetAttribute64 (
 );
 
 
+/*
+ * XNVCTRLQueryTargetAttributes64 -
+ *
+ *  Queries several 64-bit integer attributes in a single round trip: the
+ *  requests for all 'count' entries of 'queries' are sent back to back,
+ *  and the replies are collected once they have all been queued.
+ *
+ *  For each query, target_type, target_id, display_mask and attribute are
+ *  given as for XNVCTRLQueryTargetAttribute64().  On return, exists is
+ *  True if the attribute exists, in which case value contains its value.
+ *
+ *  Returns False, without sending any request, if the NV-CONTROL
+ *  extension does not support 64-bit attributes.  Returns True otherwise.
+ *
+ *  Possible errors:
+ *     BadValue - A target doesn't exist.
+ *     BadMatch - The NVIDIA driver does not control a target.
+ */
+
+typedef struct {
+    int target_type;
+    int target_id;
+    unsigned int display_mask;
+    unsigned int attribute;
+    int64_t value;
+    Bool exists;
+} NVCTRLAttributeQueryRec;
+
+Bool XNVCTRLQueryTargetAttributes64 (
+    Display *dpy,
+    NVCTRLAttributeQueryRec *queries,
+    int count
+);
+
+
+/*
+ * XNVCTRLQueryTargetAttributesMulti -
+ *
+ *  Behaves like XNVCTRLQueryTargetAttributes64(), but streams
+ *  X_nvCtrlQueryAttribute requests, as sent by
+ *  XNVCTRLQueryTargetAttribute(): it works with all NV-CONTROL versions,
+ *  and the value of each existing attribute is a 32-bit integer.  All the
+ *  requests are sent, and all the replies read, while the Display is
+ *  locked, and the requests are only flushed once.
+ *
+ *  Returns False, without sending any request, if the NV-CONTROL
+ *  extension is not present.  Returns True otherwise.
+ *
+ *  Possible errors:
+ *     BadValue - A target doesn't exist.
+ *     BadMatch - The NVIDIA driver does not control a target.
+ */
+
+Bool XNVCTRLQueryTargetAttributesMulti (
+    Display *dpy,
+    NVCTRLAttributeQueryRec *queries,
+    int count
+);
+
+
 /*
  *  XNVCTRLQueryStringAttribute -
  *
@@ -292,6 +352,116 @@ Bool XNVCTRLQueryStringAttribute (
 );
 
 
+/*
+ * XNVCTRLQueryTargetAttribute64Async -
+ * XNVCTRLQueryTargetStringAttributeAsync -
+ * XNVCTRLQueryTargetBinaryDataAsync -
+ * XNVCTRLQueryTargetCountAsync -
+ *
+ *  Sends the same request as XNVCTRLQueryTargetAttribute64(),
+ *  XNVCTRLQueryTargetStringAttribute(), XNVCTRLQueryTargetBinaryData() or
+ *  XNVCTRLQueryTargetCount() and returns without waiting for the reply,
+ *  which is stored in the returned query whenever Xlib reads it from the
+ *  connection (e.g. from XPending() or a later round trip).  The request
+ *  is not flushed.
+ *
+ *  Returns NULL, without sending anything, if the NV-CONTROL extension is
+ *  missing (or, for 64-bit attributes, too old) or memory is exhausted.
+ *  The query must be released with XNVCTRLFreeAsyncQuery(), which may be
+ *  done before its reply arrived.
+ */
+
+typedef struct _XNVCTRLAsyncQueryRec XNVCTRLAsyncQueryRec;
+
+XNVCTRLAsyncQueryRec *XNVCTRLQueryTargetAttribute64Async (
+    Display *dpy,
+    int target_type,
+    int target_id,
+    unsigned int display_mask,
+    unsigned int attribute
+);
+
+XNVCTRLAsyncQueryRec *XNVCTRLQueryTargetStringAttributeAsync (
+    Display *dpy,
+    int target_type,
+    int target_id,
+    unsigned int display_mask,
+    unsigned int attribute
+);
+
+XNVCTRLAsyncQueryRec *XNVCTRLQueryTargetBinaryDataAsync (
+    Display *dpy,
+    int target_type,
+    int target_id,
+    unsigned int display_mask,
+    unsigned int attribute
+);
+
+XNVCTRLAsyncQueryRec *XNVCTRLQueryTargetCountAsync (
+    Display *dpy,
+    int target_type
+);
+
+
+/*
+ * XNVCTRLAsyncQueryDone -
+ *
+ *  Returns True once the reply (or error) to the query has been received.
+ */
+
+Bool XNVCTRLAsyncQueryDone (
+    Display *dpy,
+    XNVCTRLAsyncQueryRec *query
+);
+
+
+/*
+ * XNVCTRLAsyncQueryAttribute64 -
+ * XNVCTRLAsyncQueryStringAttribute -
+ * XNVCTRLAsyncQueryBinaryData -
+ * XNVCTRLAsyncQueryTargetCount -
+ *
+ *  Return the result of a completed query like the synchronous
+ *  XNVCTRLQueryTargetAttribute64(), XNVCTRLQueryTargetStringAttribute(),
+ *  XNVCTRLQueryTargetBinaryData() and XNVCTRLQueryTargetCount() functions
+ *  would have.  The string or data returned in *ptr is handed over to the
+ *  caller, who must free it with XFree().
+ */
+
+Bool XNVCTRLAsyncQueryAttribute64 (
+    XNVCTRLAsyncQueryRec *query,
+    int64_t *value
+);
+
+Bool XNVCTRLAsyncQueryStringAttribute (
+    XNVCTRLAsyncQueryRec *query,
+    char **ptr
+);
+
+Bool XNVCTRLAsyncQueryBinaryData (
+    XNVCTRLAsyncQueryRec *query,
+    unsigned char **ptr,
+    int *len
+);
+
+Bool XNVCTRLAsyncQueryTargetCount (
+    XNVCTRLAsyncQueryRec *query,
+    int *value
+);
+
+
+/*
+ * XNVCTRLFreeAsyncQuery -
+ *
+ *  Releases a query; a reply that has not arrived yet is discarded.
+ */
+
+void XNVCTRLFreeAsyncQuery (
+    Display *dpy,
+    XNVCTRLAsyncQueryRec *query
+);
+
+
 /*
  *  XNVCTRLQueryTargetStringAttribute -
  *
@@ -615,6 +785,30 @@ Bool XNVCTRLQueryTargetBinaryData (
 );
 
 
+/*
+ * XNVCTRLQueryTargetBinaryDataToBuffer -
+ *
+ *  Same as XNVCTRLQueryTargetBinaryData(), except that the binary data
+ *  is read into the caller's buffer *buf, of *size bytes, rather than
+ *  into a newly allocated one, so that the same buffer can be reused
+ *  across queries.  If *buf is NULL or smaller than the data, it is
+ *  grown with Xrealloc() first, and *buf and *size are updated.  *buf
+ *  may be changed even if the query fails; it is the caller's
+ *  responsibility to free the buffer with XFree() when done.
+ */
+
+Bool XNVCTRLQueryTargetBinaryDataToBuffer (
+    Display *dpy,
+    int target_type,
+    int target_id,
+    unsigned int display_mask,
+    unsigned int attribute,
+    unsigned char **buf,
+    int *size,
+    int *len
+);
+
+
 /*
  * XNVCTRLStringOperation -
  *
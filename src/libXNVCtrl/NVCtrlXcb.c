@@ -0,0 +1,348 @@
+/*
+ * Copyright (c) 2008 NVIDIA, Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * xcb implementation of the NV-CONTROL queries; see NVCtrlXcbLib.h.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <X11/Xmd.h>
+#include <xcb/xcb.h>
+#include <xcb/xcbext.h>
+#include "NVCtrlXcbLib.h"
+#include "nv_control.h"
+
+static xcb_extension_t nvctrl_xcb_id = { NV_CONTROL_NAME, 0 };
+
+
+/*
+ * Sends the NV-CONTROL request 'nvReqType', whose wire struct of 'size'
+ * bytes is pointed to by 'req'; xcb fills in its reqType, nvReqType and
+ * length fields.
+ */
+
+static xcb_nvctrl_cookie_t send_request(xcb_connection_t *c, int nvReqType,
+                                        void *req, size_t size)
+{
+    xcb_protocol_request_t xcb_req;
+    struct iovec parts[4];
+    xcb_nvctrl_cookie_t cookie = { 0 };
+
+    if (!xcb_nvctrl_query_extension(c)) {
+        return cookie;
+    }
+
+    xcb_req.count = 2;
+    xcb_req.ext = &nvctrl_xcb_id;
+    xcb_req.opcode = nvReqType;
+    xcb_req.isvoid = 0;
+
+    /* xcb needs the two entries before the request parts for itself */
+    parts[2].iov_base = req;
+    parts[2].iov_len = size;
+    parts[3].iov_base = NULL;
+    parts[3].iov_len = -size & 3;
+
+    /*
+     * The request is unchecked, so that an X error it causes is delivered
+     * through the event queue, i.e. to the Xlib error handler of the
+     * Display the connection belongs to, as for the Xlib client.
+     */
+    cookie.sequence = xcb_send_request(c, 0, parts + 2, &xcb_req);
+    return cookie;
+}
+
+/*
+ * Waits for the reply to the given cookie; returns NULL if the request
+ * could not be sent or failed with an error, which is reported to the Xlib
+ * error handler (see send_request()).  The reply must be freed.
+ */
+
+static void *wait_for_reply(xcb_connection_t *c, xcb_nvctrl_cookie_t cookie)
+{
+    if (cookie.sequence == 0) {
+        return NULL;
+    }
+
+    return xcb_wait_for_reply(c, cookie.sequence, NULL);
+}
+
+/*
+ * Sends one of the queries addressed to an attribute of a target, which
+ * all share the xnvCtrlQueryAttributeReq layout.
+ */
+
+static xcb_nvctrl_cookie_t send_target_query(xcb_connection_t *c,
+                                             int nvReqType,
+                                             int target_type,
+                                             int target_id,
+                                             unsigned int display_mask,
+                                             unsigned int attribute)
+{
+    xnvCtrlQueryAttributeReq req;
+
+    memset(&req, 0, sizeof(req));
+    req.target_type = target_type;
+    req.target_id = target_id;
+    req.display_mask = display_mask;
+    req.attribute = attribute;
+
+    return send_request(c, nvReqType, &req, sz_xnvCtrlQueryAttributeReq);
+}
+
+/*
+ * Copies the variable length data of a string or binary data reply, which
+ * share the same layout, to a newly allocated NUL terminated buffer.
+ */
+
+static int copy_reply_data(xnvCtrlQueryBinaryDataReply *rep,
+                           unsigned char **ptr, int *len)
+{
+    unsigned char *data;
+
+    if (!rep->flags || (rep->n > rep->length * 4)) {
+        return 0;
+    }
+
+    data = malloc(rep->n + 1);
+    if (!data) {
+        return 0;
+    }
+
+    memcpy(data, rep + 1, rep->n);
+    data[rep->n] = '\0';
+
+    *ptr = data;
+    if (len) *len = rep->n;
+
+    return 1;
+}
+
+
+int xcb_nvctrl_query_extension (
+    xcb_connection_t *c
+){
+    const xcb_query_extension_reply_t *ext;
+
+    ext = xcb_get_extension_data(c, &nvctrl_xcb_id);
+
+    return ext && ext->present;
+}
+
+
+xcb_nvctrl_cookie_t xcb_nvctrl_query_version (
+    xcb_connection_t *c
+){
+    xnvCtrlQueryExtensionReq req;
+
+    memset(&req, 0, sizeof(req));
+
+    return send_request(c, X_nvCtrlQueryExtension, &req,
+                        sz_xnvCtrlQueryExtensionReq);
+}
+
+int xcb_nvctrl_query_version_reply (
+    xcb_connection_t *c,
+    xcb_nvctrl_cookie_t cookie,
+    int *major,
+    int *minor
+){
+    xnvCtrlQueryExtensionReply *rep = wait_for_reply(c, cookie);
+
+    if (!rep) {
+        return 0;
+    }
+
+    if (major) *major = rep->major;
+    if (minor) *minor = rep->minor;
+
+    free(rep);
+    return 1;
+}
+
+
+xcb_nvctrl_cookie_t xcb_nvctrl_query_target_count (
+    xcb_connection_t *c,
+    int target_type
+){
+    xnvCtrlQueryTargetCountReq req;
+
+    memset(&req, 0, sizeof(req));
+    req.target_type = target_type;
+
+    return send_request(c, X_nvCtrlQueryTargetCount, &req,
+                        sz_xnvCtrlQueryTargetCountReq);
+}
+
+int xcb_nvctrl_query_target_count_reply (
+    xcb_connection_t *c,
+    xcb_nvctrl_cookie_t cookie,
+    int *value
+){
+    xnvCtrlQueryTargetCountReply *rep = wait_for_reply(c, cookie);
+
+    if (!rep) {
+        return 0;
+    }
+
+    if (value) *value = rep->count;
+
+    free(rep);
+    return 1;
+}
+
+
+xcb_nvctrl_cookie_t xcb_nvctrl_query_target_attribute (
+    xcb_connection_t *c,
+    int target_type,
+    int target_id,
+    unsigned int display_mask,
+    unsigned int attribute
+){
+    return send_target_query(c, X_nvCtrlQueryAttribute, target_type,
+                             target_id, display_mask, attribute);
+}
+
+int xcb_nvctrl_query_target_attribute_reply (
+    xcb_connection_t *c,
+    xcb_nvctrl_cookie_t cookie,
+    int *value
+){
+    xnvCtrlQueryAttributeReply *rep = wait_for_reply(c, cookie);
+    int exists;
+
+    if (!rep) {
+        return 0;
+    }
+
+    exists = rep->flags;
+    if (exists && value) *value = rep->value;
+
+    free(rep);
+    return exists;
+}
+
+
+xcb_nvctrl_cookie_t xcb_nvctrl_query_target_attribute64 (
+    xcb_connection_t *c,
+    int target_type,
+    int target_id,
+    unsigned int display_mask,
+    unsigned int attribute
+){
+    return send_target_query(c, X_nvCtrlQueryAttribute64, target_type,
+                             target_id, display_mask, attribute);
+}
+
+int xcb_nvctrl_query_target_attribute64_reply (
+    xcb_connection_t *c,
+    xcb_nvctrl_cookie_t cookie,
+    int64_t *value
+){
+    xnvCtrlQueryAttribute64Reply *rep = wait_for_reply(c, cookie);
+    int exists;
+
+    if (!rep) {
+        return 0;
+    }
+
+    exists = rep->flags;
+    if (exists && value) *value = rep->value_64;
+
+    free(rep);
+    return exists;
+}
+
+
+xcb_nvctrl_cookie_t xcb_nvctrl_query_target_string_attribute (
+    xcb_connection_t *c,
+    int target_type,
+    int target_id,
+    unsigned int display_mask,
+    unsigned int attribute
+){
+    return send_target_query(c, X_nvCtrlQueryStringAttribute, target_type,
+                             target_id, display_mask, attribute);
+}
+
+int xcb_nvctrl_query_target_string_attribute_reply (
+    xcb_connection_t *c,
+    xcb_nvctrl_cookie_t cookie,
+    char **ptr
+){
+    xnvCtrlQueryBinaryDataReply *rep = wait_for_reply(c, cookie);
+    int exists;
+
+    if (!rep) {
+        return 0;
+    }
+
+    exists = ptr && copy_reply_data(rep, (unsigned char **) ptr, NULL);
+
+    free(rep);
+    return exists;
+}
+
+
+xcb_nvctrl_cookie_t xcb_nvctrl_query_target_binary_data (
+    xcb_connection_t *c,
+    int target_type,
+    int target_id,
+    unsigned int display_mask,
+    unsigned int attribute
+){
+    return send_target_query(c, X_nvCtrlQueryBinaryData, target_type,
+                             target_id, display_mask, attribute);
+}
+
+int xcb_nvctrl_query_target_binary_data_reply (
+    xcb_connection_t *c,
+    xcb_nvctrl_cookie_t cookie,
+    unsigned char **ptr,
+    int *len
+){
+    xnvCtrlQueryBinaryDataReply *rep = wait_for_reply(c, cookie);
+    int exists;
+
+    if (!rep) {
+        return 0;
+    }
+
+    exists = ptr && copy_reply_data(rep, ptr, len);
+
+    free(rep);
+    return exists;
+}
+
+
+void xcb_nvctrl_discard_reply (
+    xcb_connection_t *c,
+    xcb_nvctrl_cookie_t cookie
+){
+    if (cookie.sequence != 0) {
+        xcb_discard_reply(c, cookie.sequence);
+    }
+}
@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2008 NVIDIA, Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __NVCTRLXCBLIB_H
+#define __NVCTRLXCBLIB_H
+
+#include <stdint.h>
+#include <xcb/xcb.h>
+
+#include "NVCtrl.h"
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+/*
+ * xcb client for the NV-CONTROL extension.
+ *
+ * Unlike the Xlib functions of NVCtrlLib.h, which each wait for their
+ * reply with the Display locked, every query is split into a request
+ * function, which sends the request and returns a cookie, and a reply
+ * function, which waits for and decodes the reply of a cookie.  Any
+ * number of requests can be sent before waiting on the first reply, so
+ * that they all cost a single round trip.
+ *
+ * The requests and replies use the wire structs of nv_control.h.  A
+ * cookie with a sequence of 0 means that the request could not be sent
+ * (e.g. the NV-CONTROL extension is not present); its reply function
+ * fails.  Each cookie must be passed to its reply function, or to
+ * xcb_nvctrl_discard_reply(), exactly once.
+ *
+ * The target_type and target_id fields are sent as given: callers
+ * talking to NV-CONTROL 1.8 or 1.9 servers, which expect them in
+ * reversed order, should use the Xlib functions instead.
+ */
+
+typedef struct {
+    unsigned int sequence;
+} xcb_nvctrl_cookie_t;
+
+
+/*
+ *  xcb_nvctrl_query_extension -
+ *
+ *  Returns nonzero if the NV-CONTROL extension exists on the connection.
+ *  The first call on a connection costs a round trip.
+ */
+
+int xcb_nvctrl_query_extension (
+    xcb_connection_t *c
+);
+
+
+/*
+ *  xcb_nvctrl_query_version -
+ *  xcb_nvctrl_query_version_reply -
+ *
+ *  Queries the NV-CONTROL extension version.  The reply function
+ *  returns nonzero on success, in which case major and minor contain
+ *  the version.
+ */
+
+xcb_nvctrl_cookie_t xcb_nvctrl_query_version (
+    xcb_connection_t *c
+);
+
+int xcb_nvctrl_query_version_reply (
+    xcb_connection_t *c,
+    xcb_nvctrl_cookie_t cookie,
+    int *major,
+    int *minor
+);
+
+
+/*
+ *  xcb_nvctrl_query_target_count -
+ *  xcb_nvctrl_query_target_count_reply -
+ *
+ *  Queries the number of targets of the given NV_CTRL_TARGET_TYPE_*.
+ *  The reply function returns nonzero on success, in which case value
+ *  contains the count.
+ */
+
+xcb_nvctrl_cookie_t xcb_nvctrl_query_target_count (
+    xcb_connection_t *c,
+    int target_type
+);
+
+int xcb_nvctrl_query_target_count_reply (
+    xcb_connection_t *c,
+    xcb_nvctrl_cookie_t cookie,
+    int *value
+);
+
+
+/*
+ *  xcb_nvctrl_query_target_attribute -
+ *  xcb_nvctrl_query_target_attribute_reply -
+ *  xcb_nvctrl_query_target_attribute64 -
+ *  xcb_nvctrl_query_target_attribute64_reply -
+ *
+ *  Query an integer attribute of a target, as
+ *  XNVCTRLQueryTargetAttribute() and XNVCTRLQueryTargetAttribute64()
+ *  do.  The reply functions return nonzero if the attribute exists, in
+ *  which case value contains its value.  The 64-bit variant requires
+ *  NV-CONTROL 1.21 or newer.
+ *
+ *  Possible errors:
+ *     BadValue - The target doesn't exist.
+ *     BadMatch - The NVIDIA driver does not control the target.
+ */
+
+xcb_nvctrl_cookie_t xcb_nvctrl_query_target_attribute (
+    xcb_connection_t *c,
+    int target_type,
+    int target_id,
+    unsigned int display_mask,
+    unsigned int attribute
+);
+
+int xcb_nvctrl_query_target_attribute_reply (
+    xcb_connection_t *c,
+    xcb_nvctrl_cookie_t cookie,
+    int *value
+);
+
+xcb_nvctrl_cookie_t xcb_nvctrl_query_target_attribute64 (
+    xcb_connection_t *c,
+    int target_type,
+    int target_id,
+    unsigned int display_mask,
+    unsigned int attribute
+);
+
+int xcb_nvctrl_query_target_attribute64_reply (
+    xcb_connection_t *c,
+    xcb_nvctrl_cookie_t cookie,
+    int64_t *value
+);
+
+
+/*
+ *  xcb_nvctrl_query_target_string_attribute -
+ *  xcb_nvctrl_query_target_string_attribute_reply -
+ *
+ *  Query a string attribute of a target, as
+ *  XNVCTRLQueryTargetStringAttribute() does.  The reply function
+ *  returns nonzero if the attribute exists, in which case ptr points to
+ *  a NUL terminated copy of the string; it is the caller's
+ *  responsibility to free() it.
+ */
+
+xcb_nvctrl_cookie_t xcb_nvctrl_query_target_string_attribute (
+    xcb_connection_t *c,
+    int target_type,
+    int target_id,
+    unsigned int display_mask,
+    unsigned int attribute
+);
+
+int xcb_nvctrl_query_target_string_attribute_reply (
+    xcb_connection_t *c,
+    xcb_nvctrl_cookie_t cookie,
+    char **ptr
+);
+
+
+/*
+ *  xcb_nvctrl_query_target_binary_data -
+ *  xcb_nvctrl_query_target_binary_data_reply -
+ *
+ *  Query a binary data attribute of a target, as
+ *  XNVCTRLQueryTargetBinaryData() does.  The reply function returns
+ *  nonzero if the attribute exists, in which case ptr points to a copy
+ *  of the data and len, if not NULL, contains its length in bytes; it
+ *  is the caller's responsibility to free() the data.
+ */
+
+xcb_nvctrl_cookie_t xcb_nvctrl_query_target_binary_data (
+    xcb_connection_t *c,
+    int target_type,
+    int target_id,
+    unsigned int display_mask,
+    unsigned int attribute
+);
+
+int xcb_nvctrl_query_target_binary_data_reply (
+    xcb_connection_t *c,
+    xcb_nvctrl_cookie_t cookie,
+    unsigned char **ptr,
+    int *len
+);
+
+
+/*
+ *  xcb_nvctrl_discard_reply -
+ *
+ *  Discards the reply of a cookie that will not be passed to its reply
+ *  function.
+ */
+
+void xcb_nvctrl_discard_reply (
+    xcb_connection_t *c,
+    xcb_nvctrl_cookie_t cookie
+);
+
+#if defined __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* __NVCTRLXCBLIB_H */
@@ -35,15 +35,29 @@ ifndef XNVCTRL_LDFLAGS
 endif
 
 XNVCTRL_CFLAGS ?=
+XNVCTRL_LIBS ?=
+
+# The xcb NV-CONTROL client (NVCtrlXcb.c), which the attribute layer uses
+# to pipeline NV-CONTROL queries, is experimental and only built with
+# NV_USE_XCB=1; it requires libxcb and libX11-xcb.  Users of the library
+# must then link with $(XNVCTRL_LIBS).
+NV_USE_XCB ?= 0
 
 
 LIBXNVCTRL = $(OUTPUTDIR)/libXNVCtrl.a
 
 LIBXNVCTRL_SRC = $(XNVCTRL_DIR)/NVCtrl.c
 
+ifeq ($(NV_USE_XCB),1)
+  LIBXNVCTRL_SRC += $(XNVCTRL_DIR)/NVCtrlXcb.c
+  XNVCTRL_CFLAGS += -DNV_USE_XCB
+  XNVCTRL_LIBS   += -lxcb -lX11-xcb
+endif
+
 LIBXNVCTRL_OBJ = $(call BUILD_OBJECT_LIST,$(LIBXNVCTRL_SRC))
 
-$(eval $(call DEFINE_OBJECT_RULE,TARGET,$(LIBXNVCTRL_SRC)))
+$(foreach src,$(LIBXNVCTRL_SRC),\
+    $(eval $(call DEFINE_OBJECT_RULE,TARGET,$(src))))
 
 $(LIBXNVCTRL) : $(LIBXNVCTRL_OBJ)
 	$(call quiet_cmd,AR) ru $@ $(LIBXNVCTRL_OBJ)
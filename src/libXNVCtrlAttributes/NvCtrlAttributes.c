@@ -33,6 +33,8 @@
 #include <math.h> /* pow(3) */
 
 #include <sys/utsname.h>
+#include <unistd.h>
+#include <poll.h>
 
 
 
@@ -117,6 +119,18 @@ const int targetTypeInfoTableLen = ARRAY_LEN(targetTypeInfoTable);
  * List of unique event handles to track
  */
 static NvCtrlEventPrivateHandleNode *__event_handles = NULL;
+static pthread_mutex_t __event_handles_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/*
+ * Returns the number of bytes of a string returned by a backend, for the
+ * call statistics.
+ */
+
+static size_t string_size(ReturnStatus ret, const char *str)
+{
+    return ((ret == NvCtrlSuccess) && str) ? (strlen(str) + 1) : 0;
+}
 
 
 Bool NvCtrlIsTargetTypeValid(CtrlTargetType target_type)
@@ -180,14 +194,21 @@ NvCtrlAttributeHandle *NvCtrlAttributeInit(CtrlSystem *system,
 
     /* initialize the display and screen to the parameter values */
 
+    h->system = system;
     h->dpy = system->dpy;
     h->target_type = target_type;
     h->target_id = target_id;
 
+    /* Replayed targets are answered from the trace rather than a backend */
+    if (NV_CTRL_TRACE_REPLAYING()) {
+        return (NvCtrlAttributeHandle *) h;
+    }
+
     /* initialize the NV-CONTROL attributes */
 
     if (subsystems & NV_CTRL_ATTRIBUTES_NV_CONTROL_SUBSYSTEM) {
-        h->nv = NvCtrlInitNvControlAttributes(h);
+        NV_CTRL_STATS_INIT_BACKEND(NV_CTRL_BACKEND_NV_CONTROL, h->nv,
+                                   NvCtrlInitNvControlAttributes(h));
 
         /* Give up if it failed and target needs NV-CONTROL */
         if (!h->nv && TARGET_TYPE_NEEDS_NVCONTROL(target_type)) {
@@ -196,55 +217,15 @@ NvCtrlAttributeHandle *NvCtrlAttributeInit(CtrlSystem *system,
     }
 
     /*
-     * initialize X Screen specific attributes for X Screen
-     * target types.
+     * The XF86VidMode, XVideo, GLX and EGL subsystems only apply to X
+     * Screen target types, while XRandR does not require an X screen.
+     * They are all initialized on first use, see NvCtrlLoadSubsystems().
      */
 
-    if (target_type == X_SCREEN_TARGET) {
-
-        /*
-         * initialize the XF86VidMode attributes; it is OK if this
-         * fails
-         */
-        
-        if (subsystems & NV_CTRL_ATTRIBUTES_XF86VIDMODE_SUBSYSTEM) {
-            h->vm = NvCtrlInitVidModeAttributes(h);
-        }
-        
-        /*
-         * initialize the XVideo extension and attributes; it is OK if
-         * this fails
-         */
-        
-        if (subsystems & NV_CTRL_ATTRIBUTES_XVIDEO_SUBSYSTEM) {
-            h->xv = NvCtrlInitXvAttributes(h);
-        }
-        
-        /*
-         * initialize the GLX extension and attributes; it is OK if
-         * this fails
-         */
-        
-        if (subsystems & NV_CTRL_ATTRIBUTES_GLX_SUBSYSTEM) {
-            h->glx = NvCtrlInitGlxAttributes(h);
-        }
-        
-        /*
-         * initialize the EGL extension and attributes; it is OK if
-         * this fails
-         */
-        
-        if (subsystems & NV_CTRL_ATTRIBUTES_EGL_SUBSYSTEM) {
-            h->egl = NvCtrlInitEglAttributes(h);
-        }
-    } /* X Screen target type attribute subsystems */
+    h->lazy_subsystems = subsystems & NV_CTRL_ATTRIBUTES_LAZY_SUBSYSTEMS;
 
-    /*
-     * initialize the XRandR extension and attributes; this does not
-     * require an X screen and it is OK if this fails
-     */
-    if (subsystems & NV_CTRL_ATTRIBUTES_XRANDR_SUBSYSTEM) {
-        h->xrandr = NvCtrlInitXrandrAttributes(h);
+    if (target_type != X_SCREEN_TARGET) {
+        h->lazy_subsystems &= NV_CTRL_ATTRIBUTES_XRANDR_SUBSYSTEM;
     }
 
     /*
@@ -254,7 +235,8 @@ NvCtrlAttributeHandle *NvCtrlAttributeInit(CtrlSystem *system,
     if ((subsystems & NV_CTRL_ATTRIBUTES_NVML_SUBSYSTEM) &&
         TARGET_TYPE_IS_NVML_COMPATIBLE(target_type)) {
 
-        h->nvml = NvCtrlInitNvmlAttributes(h);
+        NV_CTRL_STATS_INIT_BACKEND(NV_CTRL_BACKEND_NVML, h->nvml,
+                                   NvCtrlInitNvmlAttributes(h));
     }
 
     return (NvCtrlAttributeHandle *) h;
@@ -265,6 +247,56 @@ NvCtrlAttributeHandle *NvCtrlAttributeInit(CtrlSystem *system,
 
 } /* NvCtrlAttributeInit() */
 
+
+
+/*
+ * Initializes the given subsystems of the handle if that was deferred by
+ * NvCtrlAttributeInit(); it is OK if this fails, the subsystem is then
+ * reported as missing.  Subsystems are initialized at most once, so the
+ * handle is only logically const here.
+ */
+
+void NvCtrlLoadSubsystems(const NvCtrlAttributePrivateHandle *h_const,
+                          unsigned int subsystems)
+{
+    NvCtrlAttributePrivateHandle *h =
+        (NvCtrlAttributePrivateHandle *) h_const;
+
+    subsystems &= h->lazy_subsystems;
+    if (!subsystems) {
+        return;
+    }
+
+    h->lazy_subsystems &= ~subsystems;
+
+    if (subsystems & NV_CTRL_ATTRIBUTES_XF86VIDMODE_SUBSYSTEM) {
+        NV_CTRL_STATS_INIT_BACKEND(NV_CTRL_BACKEND_VIDMODE, h->vm,
+                                   NvCtrlInitVidModeAttributes(h));
+    }
+
+    if (subsystems & NV_CTRL_ATTRIBUTES_XVIDEO_SUBSYSTEM) {
+        NV_CTRL_STATS_INIT_BACKEND(NV_CTRL_BACKEND_XV, h->xv,
+                                   NvCtrlInitXvAttributes(h));
+    }
+
+    if (subsystems & NV_CTRL_ATTRIBUTES_GLX_SUBSYSTEM) {
+        NV_CTRL_STATS_INIT_BACKEND(NV_CTRL_BACKEND_GLX, h->glx,
+                                   NvCtrlInitGlxAttributes(h));
+    }
+
+    if (subsystems & NV_CTRL_ATTRIBUTES_EGL_SUBSYSTEM) {
+        NV_CTRL_STATS_INIT_BACKEND(NV_CTRL_BACKEND_EGL, h->egl,
+                                   NvCtrlInitEglAttributes(h));
+    }
+
+    if (subsystems & NV_CTRL_ATTRIBUTES_XRANDR_SUBSYSTEM) {
+        NV_CTRL_STATS_INIT_BACKEND(NV_CTRL_BACKEND_XRANDR, h->xrandr,
+                                   NvCtrlInitXrandrAttributes(h));
+    }
+}
+
+
+
 /*
  * Rebuild specified private subsystem handles
  */
@@ -276,6 +308,9 @@ void NvCtrlRebuildSubsystems(CtrlTarget *ctrl_target, unsigned int subsystem)
         return;
     }
 
+    /* Subsystems that were never initialized have nothing to rebuild */
+    subsystem &= ~h->lazy_subsystems;
+
     if (subsystem & NV_CTRL_ATTRIBUTES_XRANDR_SUBSYSTEM) {
         NvCtrlXrandrAttributesClose(h);
         h->xrandr = NvCtrlInitXrandrAttributes(h);
@@ -300,13 +335,22 @@ void NvCtrlRebuildSubsystems(CtrlTarget *ctrl_target, unsigned int subsystem)
 char *NvCtrlGetDisplayName(const CtrlTarget *ctrl_target)
 {
     const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
-    char *display_name;
+    const char *display_name;
 
-    if (h == NULL || h->dpy == NULL) {
+    if (h == NULL) {
         return NULL;
     }
 
-    display_name = DisplayString(h->dpy);
+    if (h->dpy) {
+        display_name = DisplayString(h->dpy);
+    } else {
+        /* Replayed systems have no connection, but recorded its name */
+        display_name = NvCtrlTraceGetDisplayString(h->system);
+    }
+
+    if (display_name == NULL) {
+        return NULL;
+    }
 
     if (h->target_type != X_SCREEN_TARGET) {
         /* Return the display name and # without a screen number */
@@ -591,9 +635,9 @@ int NvCtrlGetScreenPlanes(const CtrlTarget *ctrl_target)
 
 
 
-ReturnStatus NvCtrlQueryTargetCount(const CtrlTarget *ctrl_target,
-                                    CtrlTargetType target_type,
-                                    int *val)
+static ReturnStatus query_target_count(const CtrlTarget *ctrl_target,
+                                       CtrlTargetType target_type,
+                                       int *val)
 {
     const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
     ReturnStatus ret = NvCtrlMissingExtension;
@@ -607,9 +651,12 @@ ReturnStatus NvCtrlQueryTargetCount(const CtrlTarget *ctrl_target,
         case THERMAL_SENSOR_TARGET:
         case COOLER_TARGET:
             {
-                ret = NvCtrlNvmlQueryTargetCount(ctrl_target,
-                                                 target_type,
-                                                 val);
+                NV_CTRL_STATS_CALL(ret, NV_CTRL_BACKEND_NVML,
+                                   NV_CTRL_STATS_TARGET_COUNT, target_type,
+                                   NvCtrlNvmlQueryTargetCount(ctrl_target,
+                                                              target_type,
+                                                              val),
+                                   sizeof(*val));
                 if ((ret != NvCtrlMissingExtension) &&
                     (ret != NvCtrlBadHandle) &&
                     (ret != NvCtrlNotSupported)) {
@@ -629,10 +676,35 @@ ReturnStatus NvCtrlQueryTargetCount(const CtrlTarget *ctrl_target,
                  */
                 return ret;
             }
-            return NvCtrlNvControlQueryTargetCount(h, target_type, val);
+            NV_CTRL_STATS_CALL(ret, NV_CTRL_BACKEND_NV_CONTROL,
+                               NV_CTRL_STATS_TARGET_COUNT, target_type,
+                               NvCtrlNvControlQueryTargetCount(h, target_type,
+                                                               val),
+                               sizeof(*val));
+            return ret;
         default:
             return NvCtrlBadHandle;
     }
+} /* query_target_count() */
+
+
+ReturnStatus NvCtrlQueryTargetCount(const CtrlTarget *ctrl_target,
+                                    CtrlTargetType target_type,
+                                    int *val)
+{
+    const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
+    ReturnStatus ret;
+
+    if (NV_CTRL_TRACE_REPLAYING()) {
+        return NvCtrlTraceReplayValue(h, NV_CTRL_TRACE_TARGET_COUNT, 0,
+                                      target_type, val, sizeof(*val));
+    }
+
+    NV_CTRL_TRACE_CALL(ret, h, NV_CTRL_TRACE_TARGET_COUNT, 0, target_type,
+                       query_target_count(ctrl_target, target_type, val),
+                       val, sizeof(*val));
+    return ret;
+
 } /* NvCtrlQueryTargetCount() */
 
 ReturnStatus NvCtrlGetAttribute(const CtrlTarget *ctrl_target,
@@ -659,200 +731,896 @@ ReturnStatus NvCtrlGetAttribute64(const CtrlTarget *ctrl_target,
 } /* NvCtrlGetAttribute64() */
 
 
-ReturnStatus NvCtrlGetVoidAttribute(const CtrlTarget *ctrl_target,
-                                    int attr, void **ptr)
-{
-    return NvCtrlGetVoidDisplayAttribute(ctrl_target, 0, attr, ptr);
-    
-} /* NvCtrlGetVoidAttribute() */
-
-
-ReturnStatus NvCtrlGetValidAttributeValues(const CtrlTarget *ctrl_target,
-                                           int attr,
-                                           CtrlAttributeValidValues *val)
-{
-    return NvCtrlGetValidDisplayAttributeValues(ctrl_target, 0, attr, val);
-    
-} /* NvCtrlGetValidAttributeValues() */
-
-
-ReturnStatus NvCtrlGetAttributePerms(const CtrlTarget *ctrl_target,
-                                     CtrlAttributeType attr_type,
-                                     int attr,
-                                     CtrlAttributePerms *perms)
+ReturnStatus NvCtrlGetAttributesBatch(const CtrlTarget *ctrl_target,
+                                      int count, const int *attrs,
+                                      int64_t *vals, ReturnStatus *statuses)
 {
     const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
-    ReturnStatus ret = NvCtrlError;
+    CtrlAttributeQuery *queries;
+    int *queryAttr;
+    int i, n = 0;
 
     if (h == NULL) {
         return NvCtrlBadHandle;
     }
 
-    if (perms == NULL) {
+    if ((count < 0) || (count > 0 && (!attrs || !vals || !statuses))) {
         return NvCtrlBadArgument;
     }
 
-    switch (attr_type) {
-        case CTRL_ATTRIBUTE_TYPE_INTEGER:
-        case CTRL_ATTRIBUTE_TYPE_STRING:
-        case CTRL_ATTRIBUTE_TYPE_BINARY_DATA:
-        case CTRL_ATTRIBUTE_TYPE_STRING_OPERATION:
+    if (count == 0) {
+        return NvCtrlSuccess;
+    }
 
-            ret = NvCtrlNvmlGetAttributePerms(h, attr_type, attr, perms);
+    for (i = 0; i < count; i++) {
+        statuses[i] = NvCtrlNotSupported;
+    }
 
-            if (ret == NvCtrlSuccess || h->dpy == NULL) {
-                return ret;
+    /*
+     * Let NVML answer what it can in bulk; it only ever marks attributes it
+     * did answer, so the rest goes through the batched NV-CONTROL path
+     * (including NVML attributes that have no field value equivalent).
+     */
+    if (TARGET_TYPE_IS_NVML_COMPATIBLE(h->target_type) &&
+        !NV_CTRL_TRACE_REPLAYING()) {
+        unsigned long long start = NvCtrlStatsBegin();
+        unsigned long long trace_start = NvCtrlTraceBegin();
+
+        NvCtrlNvmlGetAttributesBatch(ctrl_target, count, attrs, vals,
+                                     statuses);
+        NvCtrlStatsEnd(start, NV_CTRL_BACKEND_NVML, NV_CTRL_STATS_GET_BATCH,
+                       -1, NvCtrlSuccess, count * sizeof(int64_t));
+
+        if (trace_start) {
+            unsigned long long us = NvCtrlTraceElapsed(trace_start) / count;
+
+            for (i = 0; i < count; i++) {
+                if (statuses[i] == NvCtrlSuccess) {
+                    NvCtrlTraceRecord(h, NV_CTRL_TRACE_GET, 0, attrs[i],
+                                      NvCtrlSuccess, &vals[i],
+                                      sizeof(vals[i]), us);
+                }
             }
-            return NvCtrlNvControlGetAttributePerms(h, attr_type, attr, perms);
-
-        case CTRL_ATTRIBUTE_TYPE_COLOR:
-            /*
-             * Allow non NV-CONTROL attributes to be read/written on X screen
-             * targets
-             */
-            perms->read = NV_TRUE;
-            perms->write = NV_TRUE;
-            perms->valid_targets = CTRL_TARGET_PERM_BIT(X_SCREEN_TARGET);
-            return NvCtrlSuccess;
-
-        default:
-            return NvCtrlBadArgument;
+        }
     }
-}
 
+    queries = nvalloc(count * sizeof(CtrlAttributeQuery));
+    queryAttr = nvalloc(count * sizeof(int));
 
+    for (i = 0; i < count; i++) {
+        if (statuses[i] == NvCtrlSuccess) {
+            NvCtrlAttributeCacheStore(ctrl_target, 0, attrs[i], vals[i]);
+        } else {
+            queries[n].target = ctrl_target;
+            queries[n].attr = attrs[i];
+            queryAttr[n] = i;
+            n++;
+        }
+    }
 
-ReturnStatus NvCtrlGetStringAttribute(const CtrlTarget *ctrl_target,
-                                      int attr, char **ptr)
-{
-    return NvCtrlGetStringDisplayAttribute(ctrl_target, 0, attr, ptr);
+    NvCtrlGetDisplayAttributesBatch(queries, n);
 
-} /* NvCtrlGetStringAttribute() */
+    for (i = 0; i < n; i++) {
+        statuses[queryAttr[i]] = queries[i].status;
+        if (queries[i].status == NvCtrlSuccess) {
+            vals[queryAttr[i]] = queries[i].val;
+        }
+    }
 
+    nvfree(queryAttr);
+    nvfree(queries);
 
-ReturnStatus NvCtrlSetStringAttribute(CtrlTarget *ctrl_target,
-                                      int attr, const char *ptr)
-{
-    return NvCtrlSetStringDisplayAttribute(ctrl_target, 0, attr, ptr);
+    return NvCtrlSuccess;
 
-} /* NvCtrlSetStringAttribute() */
+} /* NvCtrlGetAttributesBatch() */
 
 
-ReturnStatus NvCtrlGetDisplayAttribute64(const CtrlTarget *ctrl_target,
-                                         unsigned int display_mask,
-                                         int attr, int64_t *val)
+ReturnStatus NvCtrlGetDisplayAttributesBatch(CtrlAttributeQuery *queries,
+                                             int count)
 {
-    const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
+    Bool *pending, *sent;
+    unsigned long long start, trace_start, trace_us = 0;
+    int i, n = 0;
 
-    if (h == NULL) {
-        return NvCtrlBadHandle;
+    if ((count < 0) || (count > 0 && !queries)) {
+        return NvCtrlBadArgument;
     }
 
-    if ((attr >= NV_CTRL_ATTR_EXT_BASE) &&
-        (attr <= NV_CTRL_ATTR_EXT_LAST_ATTRIBUTE)) {
-        switch (attr) {
-          case NV_CTRL_ATTR_EXT_NV_PRESENT:
-            *val = (h->nv) ? True : False; break;
-          case NV_CTRL_ATTR_EXT_VM_PRESENT:
-            *val = (h->vm) ? True : False; break;
-          case NV_CTRL_ATTR_EXT_XV_OVERLAY_PRESENT:
-            *val = h->xv && h->xv->overlay; break;
-          case NV_CTRL_ATTR_EXT_XV_TEXTURE_PRESENT:
-            *val = h->xv && h->xv->texture; break;
-          case NV_CTRL_ATTR_EXT_XV_BLITTER_PRESENT:
-            *val = h->xv && h->xv->blitter; break;
-          default:
-            return NvCtrlNoAttribute;
-        }
+    if (count == 0) {
         return NvCtrlSuccess;
     }
 
-    if (attr >= NV_CTRL_ATTR_RANDR_BASE &&
-        attr <= NV_CTRL_ATTR_RANDR_LAST_ATTRIBUTE) {
-        return NvCtrlXrandrGetAttribute(h, display_mask, attr, val);
+    /*
+     * Replays answer each query as it was recorded: by the batch, or by the
+     * per-attribute path it fell back to.
+     */
+    if (NV_CTRL_TRACE_REPLAYING()) {
+        for (i = 0; i < count; i++) {
+            CtrlAttributeQuery *query = &queries[i];
+
+            query->status = NvCtrlGetDisplayAttribute64(query->target,
+                                                        query->display_mask,
+                                                        query->attr,
+                                                        &query->val);
+        }
+        return NvCtrlSuccess;
     }
 
-    if (((attr >= 0) && (attr <= NV_CTRL_LAST_ATTRIBUTE)) ||
-        ((attr >= NV_CTRL_ATTR_NV_BASE) &&
-         (attr <= NV_CTRL_ATTR_NV_LAST_ATTRIBUTE))) {
-        ReturnStatus ret = NvCtrlMissingExtension;
+    pending = nvalloc(count * sizeof(Bool));
+    sent = nvalloc(count * sizeof(Bool));
 
-        switch (h->target_type) {
-            case GPU_TARGET:
-            case THERMAL_SENSOR_TARGET:
-            case COOLER_TARGET:
-                {
-                    ret = NvCtrlNvmlGetAttribute(ctrl_target,
-                                                 attr,
-                                                 val);
-                    if (ret == NvCtrlSuccess) {
-                        return ret;
-                    }
-                }
-                /* Fall through */
-            case DISPLAY_TARGET:
-            case X_SCREEN_TARGET:
-            case FRAMELOCK_TARGET:
-            case NVIDIA_3D_VISION_PRO_TRANSCEIVER_TARGET:
-            case MUX_TARGET:
-                if (!h->nv) {
-                    /*
-                     * If there is no connection to the X Driver, return the
-                     * non-success value from the NVML query, if available.
-                     */
-                    return ret;
-                }
-                return NvCtrlNvControlGetAttribute(h, display_mask, attr, val);
-            default:
-                return NvCtrlBadHandle;
+    /*
+     * Queries answered by the cache, or by NVML on NVML targets, are not
+     * pipelined; the rest are sent to NV-CONTROL together.
+     */
+    for (i = 0; i < count; i++) {
+        CtrlAttributeQuery *query = &queries[i];
+        const NvCtrlAttributePrivateHandle *h =
+            getPrivateHandleConst(query->target);
+
+        query->status = NvCtrlNotSupported;
+
+        if (h == NULL) {
+            query->status = NvCtrlBadHandle;
+            continue;
+        }
+
+        if (NvCtrlAttributeCacheLookup(query->target, query->display_mask,
+                                       query->attr, &query->val)) {
+            query->status = NvCtrlSuccess;
+            NvCtrlTraceRecord(h, NV_CTRL_TRACE_GET, query->display_mask,
+                              query->attr, NvCtrlSuccess, &query->val,
+                              sizeof(query->val), 0);
+            continue;
         }
+
+        pending[i] = !TARGET_TYPE_IS_NVML_COMPATIBLE(h->target_type) ||
+                     !NvCtrlNvmlRoutesAttribute(h, CTRL_ATTRIBUTE_TYPE_INTEGER,
+                                                query->attr);
+        sent[i] = pending[i];
+        n += pending[i] ? 1 : 0;
     }
 
-    return NvCtrlNoAttribute;
-    
-} /* NvCtrlGetDisplayAttribute64() */
+    start = NvCtrlStatsBegin();
+    trace_start = NvCtrlTraceBegin();
+    NvCtrlNvControlGetAttributesBatch(queries, count, pending);
+    NvCtrlStatsEnd(start, NV_CTRL_BACKEND_NV_CONTROL, NV_CTRL_STATS_GET_BATCH,
+                   -1, NvCtrlSuccess, n * sizeof(int64_t));
+    if (n > 0) {
+        trace_us = NvCtrlTraceElapsed(trace_start) / n;
+    }
 
-ReturnStatus NvCtrlGetDisplayAttribute(const CtrlTarget *ctrl_target,
-                                       unsigned int display_mask,
-                                       int attr, int *val)
-{
-    ReturnStatus status;
-    int64_t value_64;
+    /*
+     * Whatever NV-CONTROL did not answer, including the attributes routed
+     * to NVML, goes through the regular per-attribute path.
+     */
+    for (i = 0; i < count; i++) {
+        CtrlAttributeQuery *query = &queries[i];
 
-    status = NvCtrlGetDisplayAttribute64(ctrl_target, display_mask, attr,
-                                         &value_64);
-    if (status == NvCtrlSuccess) {
-        *val = value_64;
+        if (sent[i] && !pending[i]) {
+            if (query->status == NvCtrlSuccess) {
+                NvCtrlAttributeCacheStore(query->target, query->display_mask,
+                                          query->attr, query->val);
+            }
+            NvCtrlTraceRecord(getPrivateHandleConst(query->target),
+                              NV_CTRL_TRACE_GET, query->display_mask,
+                              query->attr, query->status, &query->val,
+                              (query->status == NvCtrlSuccess) ?
+                                  sizeof(query->val) : 0,
+                              trace_us);
+        } else if (query->status == NvCtrlNotSupported) {
+            query->status = NvCtrlGetDisplayAttribute64(query->target,
+                                                        query->display_mask,
+                                                        query->attr,
+                                                        &query->val);
+        }
     }
 
-    return status;
+    nvfree(sent);
+    nvfree(pending);
 
-} /* NvCtrlGetDisplayAttribute() */
+    return NvCtrlSuccess;
 
+} /* NvCtrlGetDisplayAttributesBatch() */
 
-ReturnStatus NvCtrlSetDisplayAttribute(CtrlTarget *ctrl_target,
-                                       unsigned int display_mask,
-                                       int attr, int val)
+
+/*
+ * Returns whether the status returned by NVML for a query is final, or if
+ * NV-CONTROL should be asked instead.
+ */
+
+static Bool nvml_status_is_final(ReturnStatus status)
 {
-    NvCtrlAttributePrivateHandle *h = getPrivateHandle(ctrl_target);
-    ReturnStatus ret = NvCtrlMissingExtension;
+    return (status != NvCtrlMissingExtension) &&
+           (status != NvCtrlBadHandle) &&
+           (status != NvCtrlNotSupported);
+}
 
-    if (h == NULL) {
-        return NvCtrlBadHandle;
+
+ReturnStatus NvCtrlGetStringAttributesBatch(CtrlStringAttributeQuery *queries,
+                                            int count)
+{
+    Bool *pending, *sent;
+    unsigned long long start, trace_start, trace_us = 0;
+    size_t bytes = 0;
+    int i, n = 0;
+
+    if ((count < 0) || (count > 0 && !queries)) {
+        return NvCtrlBadArgument;
     }
 
-    if ((attr >= 0) && (attr <= NV_CTRL_LAST_ATTRIBUTE)) {
-        switch (h->target_type) {
-            case GPU_TARGET:
-            case THERMAL_SENSOR_TARGET:
-            case COOLER_TARGET:
-                {
-                    ret = NvCtrlNvmlSetAttribute(ctrl_target,
-                                                 attr,
-                                                 display_mask,
-                                                 val);
-                    if ((ret != NvCtrlMissingExtension) &&
-                        (ret != NvCtrlBadHandle) &&
+    if (count == 0) {
+        return NvCtrlSuccess;
+    }
+
+    /* See NvCtrlGetDisplayAttributesBatch() */
+    if (NV_CTRL_TRACE_REPLAYING()) {
+        for (i = 0; i < count; i++) {
+            CtrlStringAttributeQuery *query = &queries[i];
+
+            query->str = NULL;
+            query->status =
+                NvCtrlGetStringDisplayAttribute(query->target,
+                                                query->display_mask,
+                                                query->attr, &query->str);
+        }
+        return NvCtrlSuccess;
+    }
+
+    pending = nvalloc(count * sizeof(Bool));
+    sent = nvalloc(count * sizeof(Bool));
+
+    /*
+     * Attributes routed to NVML are answered by NVML first, as
+     * NvCtrlGetStringDisplayAttribute() does; the NV-CONTROL attributes are
+     * sent together, and anything else goes through the regular path.
+     */
+    for (i = 0; i < count; i++) {
+        CtrlStringAttributeQuery *query = &queries[i];
+        const NvCtrlAttributePrivateHandle *h =
+            getPrivateHandleConst(query->target);
+
+        query->str = NULL;
+        query->status = NvCtrlNotSupported;
+
+        if (h == NULL) {
+            query->status = NvCtrlBadHandle;
+            continue;
+        }
+
+        if (TARGET_TYPE_IS_NVML_COMPATIBLE(h->target_type) &&
+            NvCtrlNvmlRoutesAttribute(h, CTRL_ATTRIBUTE_TYPE_STRING,
+                                      query->attr)) {
+            trace_start = NvCtrlTraceBegin();
+            NV_CTRL_STATS_CALL(query->status, NV_CTRL_BACKEND_NVML,
+                               NV_CTRL_STATS_GET_STRING, query->attr,
+                               NvCtrlNvmlGetStringAttribute(query->target,
+                                                            query->attr,
+                                                            &query->str),
+                               string_size(query->status, query->str));
+            if (nvml_status_is_final(query->status)) {
+                NvCtrlTraceRecord(h, NV_CTRL_TRACE_GET_STRING,
+                                  query->display_mask, query->attr,
+                                  query->status, query->str,
+                                  string_size(query->status, query->str),
+                                  NvCtrlTraceElapsed(trace_start));
+                continue;
+            }
+            query->status = NvCtrlNotSupported;
+        }
+
+        pending[i] = h->nv && NvCtrlIsTargetTypeValid(h->target_type) &&
+                     (query->attr >= 0) &&
+                     (query->attr <= NV_CTRL_STRING_LAST_ATTRIBUTE);
+        sent[i] = pending[i];
+        n += pending[i] ? 1 : 0;
+    }
+
+    start = NvCtrlStatsBegin();
+    trace_start = NvCtrlTraceBegin();
+    NvCtrlNvControlGetStringAttributesBatch(queries, count, pending);
+
+    for (i = 0; i < count; i++) {
+        if (sent[i] && !pending[i]) {
+            bytes += string_size(queries[i].status, queries[i].str);
+        }
+    }
+    NvCtrlStatsEnd(start, NV_CTRL_BACKEND_NV_CONTROL, NV_CTRL_STATS_GET_BATCH,
+                   -1, NvCtrlSuccess, bytes);
+    if (n > 0) {
+        trace_us = NvCtrlTraceElapsed(trace_start) / n;
+    }
+
+    for (i = 0; i < count; i++) {
+        CtrlStringAttributeQuery *query = &queries[i];
+
+        if (sent[i] && !pending[i]) {
+            NvCtrlTraceRecord(getPrivateHandleConst(query->target),
+                              NV_CTRL_TRACE_GET_STRING, query->display_mask,
+                              query->attr, query->status, query->str,
+                              string_size(query->status, query->str),
+                              trace_us);
+            continue;
+        }
+
+        if (query->status != NvCtrlNotSupported) {
+            continue;
+        }
+
+        query->status = NvCtrlGetStringDisplayAttribute(query->target,
+                                                        query->display_mask,
+                                                        query->attr,
+                                                        &query->str);
+    }
+
+    nvfree(sent);
+    nvfree(pending);
+
+    return NvCtrlSuccess;
+
+} /* NvCtrlGetStringAttributesBatch() */
+
+
+ReturnStatus NvCtrlGetBinaryAttributesBatch(CtrlBinaryAttributeQuery *queries,
+                                            int count)
+{
+    Bool *pending, *sent;
+    unsigned long long start, trace_start, trace_us;
+    size_t bytes = 0;
+    int i;
+
+    if ((count < 0) || (count > 0 && !queries)) {
+        return NvCtrlBadArgument;
+    }
+
+    if (count == 0) {
+        return NvCtrlSuccess;
+    }
+
+    /* See NvCtrlGetDisplayAttributesBatch() */
+    if (NV_CTRL_TRACE_REPLAYING()) {
+        for (i = 0; i < count; i++) {
+            CtrlBinaryAttributeQuery *query = &queries[i];
+
+            query->data = NULL;
+            query->len = 0;
+            query->status = NvCtrlGetBinaryAttribute(query->target,
+                                                     query->display_mask,
+                                                     query->attr,
+                                                     &query->data,
+                                                     &query->len);
+        }
+        return NvCtrlSuccess;
+    }
+
+    pending = nvalloc(count * sizeof(Bool));
+    sent = nvalloc(count * sizeof(Bool));
+    trace_start = NvCtrlTraceBegin();
+
+    /* Route the queries as NvCtrlGetBinaryAttribute() does */
+    for (i = 0; i < count; i++) {
+        CtrlBinaryAttributeQuery *query = &queries[i];
+        const NvCtrlAttributePrivateHandle *h =
+            getPrivateHandleConst(query->target);
+
+        query->data = NULL;
+        query->len = 0;
+        query->status = NvCtrlMissingExtension;
+
+        if (h == NULL) {
+            query->status = NvCtrlBadHandle;
+            continue;
+        }
+
+        switch (h->target_type) {
+            case GPU_TARGET:
+            case THERMAL_SENSOR_TARGET:
+            case COOLER_TARGET:
+                NV_CTRL_STATS_CALL(query->status, NV_CTRL_BACKEND_NVML,
+                                   NV_CTRL_STATS_GET_BINARY, query->attr,
+                                   NvCtrlNvmlGetBinaryAttribute(query->target,
+                                                                query->attr,
+                                                                &query->data,
+                                                                &query->len,
+                                                                NULL),
+                                   (query->status == NvCtrlSuccess) ?
+                                       query->len : 0);
+                if (nvml_status_is_final(query->status)) {
+                    break;
+                }
+                /* Fall through */
+            case DISPLAY_TARGET:
+            case X_SCREEN_TARGET:
+            case FRAMELOCK_TARGET:
+            case NVIDIA_3D_VISION_PRO_TRANSCEIVER_TARGET:
+                /*
+                 * Without NV-CONTROL, the status from NVML, if any, is
+                 * reported.
+                 */
+                pending[i] = (h->nv != NULL);
+                break;
+            default:
+                query->status = NvCtrlBadHandle;
+                break;
+        }
+
+        sent[i] = pending[i];
+    }
+
+    start = NvCtrlStatsBegin();
+    NvCtrlNvControlGetBinaryAttributesBatch(queries, count, pending);
+
+    for (i = 0; i < count; i++) {
+        if (sent[i] && !pending[i] && (queries[i].status == NvCtrlSuccess)) {
+            bytes += queries[i].len;
+        }
+    }
+    NvCtrlStatsEnd(start, NV_CTRL_BACKEND_NV_CONTROL, NV_CTRL_STATS_GET_BATCH,
+                   -1, NvCtrlSuccess, bytes);
+
+    /* Queries NV-CONTROL could not pipeline are sent individually */
+    for (i = 0; i < count; i++) {
+        CtrlBinaryAttributeQuery *query = &queries[i];
+        const NvCtrlAttributePrivateHandle *h;
+
+        if (!pending[i]) {
+            continue;
+        }
+
+        h = getPrivateHandleConst(query->target);
+
+        NV_CTRL_STATS_CALL(query->status, NV_CTRL_BACKEND_NV_CONTROL,
+                           NV_CTRL_STATS_GET_BINARY, query->attr,
+                           NvCtrlNvControlGetBinaryAttribute(h,
+                                                             query->display_mask,
+                                                             query->attr,
+                                                             &query->data,
+                                                             &query->len,
+                                                             NULL),
+                           (query->status == NvCtrlSuccess) ? query->len : 0);
+    }
+
+    /* Every query was answered by the batch, which they share the time of */
+    trace_us = NvCtrlTraceElapsed(trace_start) / count;
+
+    for (i = 0; i < count; i++) {
+        CtrlBinaryAttributeQuery *query = &queries[i];
+
+        NvCtrlTraceRecord(getPrivateHandleConst(query->target),
+                          NV_CTRL_TRACE_GET_BINARY, query->display_mask,
+                          query->attr, query->status, query->data,
+                          (query->status == NvCtrlSuccess) ? query->len : 0,
+                          trace_us);
+    }
+
+    nvfree(sent);
+    nvfree(pending);
+
+    return NvCtrlSuccess;
+
+} /* NvCtrlGetBinaryAttributesBatch() */
+
+
+ReturnStatus NvCtrlQueryTargetCountsBatch(CtrlTargetCountQuery *queries,
+                                          int count)
+{
+    Bool *pending, *sent;
+    unsigned long long start, trace_start, trace_us;
+    int i, n = 0;
+
+    if ((count < 0) || (count > 0 && !queries)) {
+        return NvCtrlBadArgument;
+    }
+
+    if (count == 0) {
+        return NvCtrlSuccess;
+    }
+
+    /* See NvCtrlGetDisplayAttributesBatch() */
+    if (NV_CTRL_TRACE_REPLAYING()) {
+        for (i = 0; i < count; i++) {
+            CtrlTargetCountQuery *query = &queries[i];
+
+            query->val = 0;
+            query->status = NvCtrlQueryTargetCount(query->target,
+                                                   query->target_type,
+                                                   &query->val);
+        }
+        return NvCtrlSuccess;
+    }
+
+    pending = nvalloc(count * sizeof(Bool));
+    sent = nvalloc(count * sizeof(Bool));
+    trace_start = NvCtrlTraceBegin();
+
+    /* Route the queries as NvCtrlQueryTargetCount() does */
+    for (i = 0; i < count; i++) {
+        CtrlTargetCountQuery *query = &queries[i];
+        const NvCtrlAttributePrivateHandle *h =
+            getPrivateHandleConst(query->target);
+
+        query->val = 0;
+        query->status = NvCtrlMissingExtension;
+
+        if (h == NULL) {
+            query->status = NvCtrlBadHandle;
+            continue;
+        }
+
+        switch (query->target_type) {
+            case GPU_TARGET:
+            case THERMAL_SENSOR_TARGET:
+            case COOLER_TARGET:
+                NV_CTRL_STATS_CALL(query->status, NV_CTRL_BACKEND_NVML,
+                                   NV_CTRL_STATS_TARGET_COUNT,
+                                   query->target_type,
+                                   NvCtrlNvmlQueryTargetCount(query->target,
+                                                              query->target_type,
+                                                              &query->val),
+                                   sizeof(query->val));
+                if (nvml_status_is_final(query->status)) {
+                    break;
+                }
+                /* Fall through */
+            case DISPLAY_TARGET:
+            case X_SCREEN_TARGET:
+            case FRAMELOCK_TARGET:
+            case NVIDIA_3D_VISION_PRO_TRANSCEIVER_TARGET:
+            case MUX_TARGET:
+                pending[i] = (h->nv != NULL);
+                break;
+            default:
+                query->status = NvCtrlBadHandle;
+                break;
+        }
+
+        sent[i] = pending[i];
+        n += pending[i] ? 1 : 0;
+    }
+
+    start = NvCtrlStatsBegin();
+    NvCtrlNvControlQueryTargetCountsBatch(queries, count, pending);
+    NvCtrlStatsEnd(start, NV_CTRL_BACKEND_NV_CONTROL, NV_CTRL_STATS_GET_BATCH,
+                   -1, NvCtrlSuccess, n * sizeof(int));
+
+    for (i = 0; i < count; i++) {
+        CtrlTargetCountQuery *query = &queries[i];
+        const NvCtrlAttributePrivateHandle *h;
+
+        if (!pending[i]) {
+            continue;
+        }
+
+        h = getPrivateHandleConst(query->target);
+
+        NV_CTRL_STATS_CALL(query->status, NV_CTRL_BACKEND_NV_CONTROL,
+                           NV_CTRL_STATS_TARGET_COUNT, query->target_type,
+                           NvCtrlNvControlQueryTargetCount(h,
+                                                           query->target_type,
+                                                           &query->val),
+                           sizeof(query->val));
+    }
+
+    /* See NvCtrlGetBinaryAttributesBatch() */
+    trace_us = NvCtrlTraceElapsed(trace_start) / count;
+
+    for (i = 0; i < count; i++) {
+        CtrlTargetCountQuery *query = &queries[i];
+
+        NvCtrlTraceRecord(getPrivateHandleConst(query->target),
+                          NV_CTRL_TRACE_TARGET_COUNT, 0, query->target_type,
+                          query->status, &query->val, sizeof(query->val),
+                          trace_us);
+    }
+
+    nvfree(sent);
+    nvfree(pending);
+
+    return NvCtrlSuccess;
+
+} /* NvCtrlQueryTargetCountsBatch() */
+
+
+ReturnStatus NvCtrlGetVoidAttribute(const CtrlTarget *ctrl_target,
+                                    int attr, void **ptr)
+{
+    return NvCtrlGetVoidDisplayAttribute(ctrl_target, 0, attr, ptr);
+    
+} /* NvCtrlGetVoidAttribute() */
+
+
+ReturnStatus NvCtrlGetValidAttributeValues(const CtrlTarget *ctrl_target,
+                                           int attr,
+                                           CtrlAttributeValidValues *val)
+{
+    return NvCtrlGetValidDisplayAttributeValues(ctrl_target, 0, attr, val);
+    
+} /* NvCtrlGetValidAttributeValues() */
+
+
+static ReturnStatus get_attribute_perms(const CtrlTarget *ctrl_target,
+                                        CtrlAttributeType attr_type,
+                                        int attr,
+                                        CtrlAttributePerms *perms)
+{
+    const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
+    ReturnStatus ret = NvCtrlError;
+
+    if (h == NULL) {
+        return NvCtrlBadHandle;
+    }
+
+    if (perms == NULL) {
+        return NvCtrlBadArgument;
+    }
+
+    switch (attr_type) {
+        case CTRL_ATTRIBUTE_TYPE_INTEGER:
+        case CTRL_ATTRIBUTE_TYPE_STRING:
+        case CTRL_ATTRIBUTE_TYPE_BINARY_DATA:
+        case CTRL_ATTRIBUTE_TYPE_STRING_OPERATION:
+
+            NV_CTRL_STATS_CALL(ret, NV_CTRL_BACKEND_NVML,
+                               NV_CTRL_STATS_GET_PERMS, attr,
+                               NvCtrlNvmlGetAttributePerms(h, attr_type, attr,
+                                                           perms),
+                               sizeof(*perms));
+
+            if (ret == NvCtrlSuccess || h->dpy == NULL) {
+                return ret;
+            }
+            NV_CTRL_STATS_CALL(ret, NV_CTRL_BACKEND_NV_CONTROL,
+                               NV_CTRL_STATS_GET_PERMS, attr,
+                               NvCtrlNvControlGetAttributePerms(h, attr_type,
+                                                                attr, perms),
+                               sizeof(*perms));
+            return ret;
+
+        case CTRL_ATTRIBUTE_TYPE_COLOR:
+            /*
+             * Allow non NV-CONTROL attributes to be read/written on X screen
+             * targets
+             */
+            perms->read = NV_TRUE;
+            perms->write = NV_TRUE;
+            perms->valid_targets = CTRL_TARGET_PERM_BIT(X_SCREEN_TARGET);
+            return NvCtrlSuccess;
+
+        default:
+            return NvCtrlBadArgument;
+    }
+}
+
+ReturnStatus NvCtrlGetAttributePerms(const CtrlTarget *ctrl_target,
+                                     CtrlAttributeType attr_type,
+                                     int attr,
+                                     CtrlAttributePerms *perms)
+{
+    const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
+    unsigned long long start = NvCtrlTraceBegin();
+    ReturnStatus ret;
+
+    if (perms == NULL) {
+        return NvCtrlBadArgument;
+    }
+
+    if (NV_CTRL_TRACE_REPLAYING()) {
+        return NvCtrlTraceReplayValue(h, NV_CTRL_TRACE_GET_PERMS, attr_type,
+                                      attr, perms, sizeof(*perms));
+    }
+
+    if (!NvCtrlAttributeCacheLookupPerms(ctrl_target, attr_type, attr, perms,
+                                         &ret)) {
+        ret = get_attribute_perms(ctrl_target, attr_type, attr, perms);
+
+        NvCtrlAttributeCacheStorePerms(ctrl_target, attr_type, attr, perms,
+                                       ret);
+    }
+
+    NvCtrlTraceRecord(h, NV_CTRL_TRACE_GET_PERMS, attr_type, attr, ret,
+                      (ret == NvCtrlSuccess) ? perms : NULL, sizeof(*perms),
+                      NvCtrlTraceElapsed(start));
+
+    return ret;
+}
+
+
+
+ReturnStatus NvCtrlGetStringAttribute(const CtrlTarget *ctrl_target,
+                                      int attr, char **ptr)
+{
+    return NvCtrlGetStringDisplayAttribute(ctrl_target, 0, attr, ptr);
+
+} /* NvCtrlGetStringAttribute() */
+
+
+ReturnStatus NvCtrlSetStringAttribute(CtrlTarget *ctrl_target,
+                                      int attr, const char *ptr)
+{
+    return NvCtrlSetStringDisplayAttribute(ctrl_target, 0, attr, ptr);
+
+} /* NvCtrlSetStringAttribute() */
+
+
+static ReturnStatus get_display_attribute64(const CtrlTarget *ctrl_target,
+                                            unsigned int display_mask,
+                                            int attr, int64_t *val)
+{
+    const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
+    ReturnStatus ret;
+
+    if (h == NULL) {
+        return NvCtrlBadHandle;
+    }
+
+    if ((attr >= NV_CTRL_ATTR_EXT_BASE) &&
+        (attr <= NV_CTRL_ATTR_EXT_LAST_ATTRIBUTE)) {
+        switch (attr) {
+          case NV_CTRL_ATTR_EXT_NV_PRESENT:
+            *val = (h->nv) ? True : False; break;
+          case NV_CTRL_ATTR_EXT_VM_PRESENT:
+            NvCtrlLoadSubsystems(h, NV_CTRL_ATTRIBUTES_XF86VIDMODE_SUBSYSTEM);
+            *val = (h->vm) ? True : False; break;
+          case NV_CTRL_ATTR_EXT_XV_OVERLAY_PRESENT:
+            NvCtrlLoadSubsystems(h, NV_CTRL_ATTRIBUTES_XVIDEO_SUBSYSTEM);
+            *val = h->xv && h->xv->overlay; break;
+          case NV_CTRL_ATTR_EXT_XV_TEXTURE_PRESENT:
+            NvCtrlLoadSubsystems(h, NV_CTRL_ATTRIBUTES_XVIDEO_SUBSYSTEM);
+            *val = h->xv && h->xv->texture; break;
+          case NV_CTRL_ATTR_EXT_XV_BLITTER_PRESENT:
+            NvCtrlLoadSubsystems(h, NV_CTRL_ATTRIBUTES_XVIDEO_SUBSYSTEM);
+            *val = h->xv && h->xv->blitter; break;
+          default:
+            return NvCtrlNoAttribute;
+        }
+        return NvCtrlSuccess;
+    }
+
+    if (attr >= NV_CTRL_ATTR_RANDR_BASE &&
+        attr <= NV_CTRL_ATTR_RANDR_LAST_ATTRIBUTE) {
+        NvCtrlLoadSubsystems(h, NV_CTRL_ATTRIBUTES_XRANDR_SUBSYSTEM);
+        NV_CTRL_STATS_CALL(ret, NV_CTRL_BACKEND_XRANDR,
+                           NV_CTRL_STATS_GET, attr,
+                           NvCtrlXrandrGetAttribute(h, display_mask, attr, val),
+                           sizeof(*val));
+        return ret;
+    }
+
+    if (((attr >= 0) && (attr <= NV_CTRL_LAST_ATTRIBUTE)) ||
+        ((attr >= NV_CTRL_ATTR_NV_BASE) &&
+         (attr <= NV_CTRL_ATTR_NV_LAST_ATTRIBUTE))) {
+        unsigned long long start = NvCtrlStatsBegin();
+
+        if (NvCtrlAttributeCacheLookup(ctrl_target, display_mask, attr, val)) {
+            NvCtrlStatsEnd(start, NV_CTRL_BACKEND_CACHE, NV_CTRL_STATS_GET,
+                           attr, NvCtrlSuccess, sizeof(*val));
+            return NvCtrlSuccess;
+        }
+
+        ret = NvCtrlMissingExtension;
+
+        switch (h->target_type) {
+            case GPU_TARGET:
+            case THERMAL_SENSOR_TARGET:
+            case COOLER_TARGET:
+                if (NvCtrlNvmlRoutesAttribute(h, CTRL_ATTRIBUTE_TYPE_INTEGER,
+                                              attr)) {
+                    NV_CTRL_STATS_CALL(ret, NV_CTRL_BACKEND_NVML,
+                                       NV_CTRL_STATS_GET, attr,
+                                       NvCtrlNvmlGetAttribute(ctrl_target,
+                                                              attr,
+                                                              val),
+                                       sizeof(*val));
+                    if (ret == NvCtrlSuccess) {
+                        break;
+                    }
+                }
+                /* Fall through */
+            case DISPLAY_TARGET:
+            case X_SCREEN_TARGET:
+            case FRAMELOCK_TARGET:
+            case NVIDIA_3D_VISION_PRO_TRANSCEIVER_TARGET:
+            case MUX_TARGET:
+                /*
+                 * If there is no connection to the X Driver, return the
+                 * non-success value from the NVML query, if available.
+                 */
+                if (h->nv) {
+                    NV_CTRL_STATS_CALL(ret, NV_CTRL_BACKEND_NV_CONTROL,
+                                       NV_CTRL_STATS_GET, attr,
+                                       NvCtrlNvControlGetAttribute(h, display_mask, attr,
+                                                                   val),
+                                       sizeof(*val));
+                }
+                break;
+            default:
+                return NvCtrlBadHandle;
+        }
+
+        if (ret == NvCtrlSuccess) {
+            NvCtrlAttributeCacheStore(ctrl_target, display_mask, attr, *val);
+        }
+
+        return ret;
+    }
+
+    return NvCtrlNoAttribute;
+    
+} /* get_display_attribute64() */
+
+
+ReturnStatus NvCtrlGetDisplayAttribute64(const CtrlTarget *ctrl_target,
+                                         unsigned int display_mask,
+                                         int attr, int64_t *val)
+{
+    const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
+    ReturnStatus ret;
+
+    if (NV_CTRL_TRACE_REPLAYING()) {
+        return NvCtrlTraceReplayValue(h, NV_CTRL_TRACE_GET, display_mask,
+                                      attr, val, sizeof(*val));
+    }
+
+    NV_CTRL_TRACE_CALL(ret, h, NV_CTRL_TRACE_GET, display_mask, attr,
+                       get_display_attribute64(ctrl_target, display_mask,
+                                               attr, val),
+                       val, sizeof(*val));
+    return ret;
+
+} /* NvCtrlGetDisplayAttribute64() */
+
+ReturnStatus NvCtrlGetDisplayAttribute(const CtrlTarget *ctrl_target,
+                                       unsigned int display_mask,
+                                       int attr, int *val)
+{
+    ReturnStatus status;
+    int64_t value_64;
+
+    status = NvCtrlGetDisplayAttribute64(ctrl_target, display_mask, attr,
+                                         &value_64);
+    if (status == NvCtrlSuccess) {
+        *val = value_64;
+    }
+
+    return status;
+
+} /* NvCtrlGetDisplayAttribute() */
+
+
+static ReturnStatus set_display_attribute(CtrlTarget *ctrl_target,
+                                          unsigned int display_mask,
+                                          int attr, int val)
+{
+    NvCtrlAttributePrivateHandle *h = getPrivateHandle(ctrl_target);
+    ReturnStatus ret = NvCtrlMissingExtension;
+
+    if (h == NULL) {
+        return NvCtrlBadHandle;
+    }
+
+    /*
+     * Writing an attribute may change others (e.g. the cooler levels and
+     * their permissions when switching to manual fan control), so forget
+     * the values cached for the target and the system's attribute info.
+     */
+    NvCtrlAttributeCacheFlush(ctrl_target);
+    NvCtrlAttributeCacheFlushInfo(h->system);
+
+    if ((attr >= 0) && (attr <= NV_CTRL_LAST_ATTRIBUTE)) {
+        switch (h->target_type) {
+            case GPU_TARGET:
+            case THERMAL_SENSOR_TARGET:
+            case COOLER_TARGET:
+                {
+                    NV_CTRL_STATS_CALL(ret, NV_CTRL_BACKEND_NVML,
+                                       NV_CTRL_STATS_SET, attr,
+                                       NvCtrlNvmlSetAttribute(ctrl_target,
+                                                              attr,
+                                                              display_mask,
+                                                              val),
+                                       sizeof(val));
+                    if ((ret != NvCtrlMissingExtension) &&
+                        (ret != NvCtrlBadHandle) &&
                         (ret != NvCtrlNotSupported)) {
                         return ret;
                     }
@@ -870,7 +1638,12 @@ ReturnStatus NvCtrlSetDisplayAttribute(CtrlTarget *ctrl_target,
                      */
                     return ret;
                 }
-                return NvCtrlNvControlSetAttribute(h, display_mask, attr, val);
+                NV_CTRL_STATS_CALL(ret, NV_CTRL_BACKEND_NV_CONTROL,
+                                   NV_CTRL_STATS_SET, attr,
+                                   NvCtrlNvControlSetAttribute(h, display_mask,
+                                                               attr, val),
+                                   sizeof(val));
+                return ret;
             default:
                 return NvCtrlBadHandle;
         }
@@ -880,11 +1653,33 @@ ReturnStatus NvCtrlSetDisplayAttribute(CtrlTarget *ctrl_target,
 }
 
 
-ReturnStatus NvCtrlGetVoidDisplayAttribute(const CtrlTarget *ctrl_target,
-                                           unsigned int display_mask,
-                                           int attr, void **ptr)
+ReturnStatus NvCtrlSetDisplayAttribute(CtrlTarget *ctrl_target,
+                                       unsigned int display_mask,
+                                       int attr, int val)
+{
+    const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
+    ReturnStatus ret;
+
+    if (NV_CTRL_TRACE_REPLAYING()) {
+        return NvCtrlTraceReplay(h, NV_CTRL_TRACE_SET, display_mask, attr,
+                                 NULL, NULL);
+    }
+
+    NV_CTRL_TRACE_CALL(ret, h, NV_CTRL_TRACE_SET, display_mask, attr,
+                       set_display_attribute(ctrl_target, display_mask, attr,
+                                             val),
+                       &val, sizeof(val));
+    return ret;
+
+} /* NvCtrlSetDisplayAttribute() */
+
+
+static ReturnStatus get_void_display_attribute(const CtrlTarget *ctrl_target,
+                                               unsigned int display_mask,
+                                               int attr, void **ptr)
 {
     const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
+    ReturnStatus ret;
 
     if (h == NULL) {
         return NvCtrlBadHandle;
@@ -892,27 +1687,81 @@ ReturnStatus NvCtrlGetVoidDisplayAttribute(const CtrlTarget *ctrl_target,
 
     if ( attr >= NV_CTRL_ATTR_GLX_BASE &&
          attr <= NV_CTRL_ATTR_GLX_LAST_ATTRIBUTE ) {
+        NvCtrlLoadSubsystems(h, NV_CTRL_ATTRIBUTES_GLX_SUBSYSTEM);
         if ( !(h->glx) ) return NvCtrlMissingExtension;
-        return NvCtrlGlxGetVoidAttribute(h, display_mask, attr, ptr);
+        NV_CTRL_STATS_CALL(ret, NV_CTRL_BACKEND_GLX,
+                           NV_CTRL_STATS_GET_VOID, attr,
+                           NvCtrlGlxGetVoidAttribute(h, display_mask, attr,
+                                                     ptr),
+                           0);
+        return ret;
     }
 
     if ( attr >= NV_CTRL_ATTR_EGL_BASE &&
          attr <= NV_CTRL_ATTR_EGL_LAST_ATTRIBUTE ) {
+        NvCtrlLoadSubsystems(h, NV_CTRL_ATTRIBUTES_EGL_SUBSYSTEM);
         if (!(h->egl)) {
             return NvCtrlMissingExtension;
         }
-        return NvCtrlEglGetVoidAttribute(h, display_mask, attr, ptr);
+        NV_CTRL_STATS_CALL(ret, NV_CTRL_BACKEND_EGL,
+                           NV_CTRL_STATS_GET_VOID, attr,
+                           NvCtrlEglGetVoidAttribute(h, display_mask, attr,
+                                                     ptr),
+                           0);
+        return ret;
     }
 
     return NvCtrlNoAttribute;
 
+} /* get_void_display_attribute() */
+
+
+/*
+ * Returns the size of the array of GLXFBConfigAttr or EGLConfigAttr returned
+ * for a void attribute, up to and including the entry with a config ID of 0
+ * that terminates it.
+ */
+
+static int void_attribute_size(int attr, const void *ptr)
+{
+    size_t size = (attr == NV_CTRL_ATTR_GLX_FBCONFIG_ATTRIBS) ?
+                  sizeof(GLXFBConfigAttr) : sizeof(EGLConfigAttr);
+    const char *entry = ptr;
+
+    /* Both start with their config ID */
+    while (*(const int *) entry != 0) {
+        entry += size;
+    }
+
+    return entry + size - (const char *) ptr;
+}
+
+
+ReturnStatus NvCtrlGetVoidDisplayAttribute(const CtrlTarget *ctrl_target,
+                                           unsigned int display_mask,
+                                           int attr, void **ptr)
+{
+    const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
+    ReturnStatus ret;
+
+    if (NV_CTRL_TRACE_REPLAYING()) {
+        return NvCtrlTraceReplayData(h, NV_CTRL_TRACE_GET_VOID, display_mask,
+                                     attr, ptr, NULL);
+    }
+
+    NV_CTRL_TRACE_CALL(ret, h, NV_CTRL_TRACE_GET_VOID, display_mask, attr,
+                       get_void_display_attribute(ctrl_target, display_mask,
+                                                  attr, ptr),
+                       *ptr, void_attribute_size(attr, *ptr));
+    return ret;
+
 } /* NvCtrlGetVoidDisplayAttribute() */
 
 
-ReturnStatus
-NvCtrlGetValidDisplayAttributeValues(const CtrlTarget *ctrl_target,
-                                     unsigned int display_mask, int attr,
-                                     CtrlAttributeValidValues *val)
+static ReturnStatus
+get_valid_display_attribute_values(const CtrlTarget *ctrl_target,
+                                   unsigned int display_mask, int attr,
+                                   CtrlAttributeValidValues *val)
 {
     const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
     ReturnStatus ret = NvCtrlMissingExtension;
@@ -926,10 +1775,14 @@ NvCtrlGetValidDisplayAttributeValues(const CtrlTarget *ctrl_target,
             case GPU_TARGET:
             case THERMAL_SENSOR_TARGET:
             case COOLER_TARGET:
-                {
-                    ret = NvCtrlNvmlGetValidAttributeValues(ctrl_target,
-                                                            attr,
-                                                            val);
+                if (NvCtrlNvmlRoutesAttribute(h, CTRL_ATTRIBUTE_TYPE_INTEGER,
+                                              attr)) {
+                    NV_CTRL_STATS_CALL(ret, NV_CTRL_BACKEND_NVML,
+                                       NV_CTRL_STATS_GET_VALID, attr,
+                                       NvCtrlNvmlGetValidAttributeValues(ctrl_target,
+                                                                         attr,
+                                                                         val),
+                                       sizeof(*val));
                     if (ret == NvCtrlSuccess) {
                         return ret;
                     }
@@ -947,8 +1800,12 @@ NvCtrlGetValidDisplayAttributeValues(const CtrlTarget *ctrl_target,
                      */
                     return ret;
                 }
-                return NvCtrlNvControlGetValidAttributeValues(h, display_mask,
-                                                              attr, val);
+                NV_CTRL_STATS_CALL(ret, NV_CTRL_BACKEND_NV_CONTROL,
+                                   NV_CTRL_STATS_GET_VALID, attr,
+                                   NvCtrlNvControlGetValidAttributeValues(h, display_mask,
+                                                                          attr, val),
+                                   sizeof(*val));
+                return ret;
             default:
                 return NvCtrlBadHandle;
         }
@@ -956,6 +1813,41 @@ NvCtrlGetValidDisplayAttributeValues(const CtrlTarget *ctrl_target,
 
     return NvCtrlNoAttribute;
     
+} /* get_valid_display_attribute_values() */
+
+
+ReturnStatus
+NvCtrlGetValidDisplayAttributeValues(const CtrlTarget *ctrl_target,
+                                     unsigned int display_mask, int attr,
+                                     CtrlAttributeValidValues *val)
+{
+    const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
+    unsigned long long start = NvCtrlTraceBegin();
+    ReturnStatus ret;
+
+    if (NV_CTRL_TRACE_REPLAYING()) {
+        return NvCtrlTraceReplayValue(h, NV_CTRL_TRACE_GET_VALID,
+                                      display_mask, attr, val, sizeof(*val));
+    }
+
+    if (!NvCtrlAttributeCacheLookupValidValues(ctrl_target,
+                                               CTRL_ATTRIBUTE_TYPE_INTEGER,
+                                               display_mask, attr, val,
+                                               &ret)) {
+        ret = get_valid_display_attribute_values(ctrl_target, display_mask,
+                                                 attr, val);
+
+        NvCtrlAttributeCacheStoreValidValues(ctrl_target,
+                                             CTRL_ATTRIBUTE_TYPE_INTEGER,
+                                             display_mask, attr, val, ret);
+    }
+
+    NvCtrlTraceRecord(h, NV_CTRL_TRACE_GET_VALID, display_mask, attr, ret,
+                      (ret == NvCtrlSuccess) ? val : NULL, sizeof(*val),
+                      NvCtrlTraceElapsed(start));
+
+    return ret;
+
 } /* NvCtrlGetValidDisplayAttributeValues() */
 
 
@@ -981,14 +1873,14 @@ GetValidStringDisplayAttributeValuesExtraAttr(CtrlAttributeValidValues *val)
 
 
 /*
- * NvCtrlGetValidStringDisplayAttributeValues() -fill the
+ * get_valid_string_display_attribute_values() -fill the
  * CtrlAttributeValidValues structure for String attributes
  */
 
-ReturnStatus
-NvCtrlGetValidStringDisplayAttributeValues(const CtrlTarget *ctrl_target,
-                                           unsigned int display_mask, int attr,
-                                           CtrlAttributeValidValues *val)
+static ReturnStatus
+get_valid_string_display_attribute_values(const CtrlTarget *ctrl_target,
+                                          unsigned int display_mask, int attr,
+                                          CtrlAttributeValidValues *val)
 {
     const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
     ReturnStatus ret = NvCtrlMissingExtension;
@@ -1002,10 +1894,14 @@ NvCtrlGetValidStringDisplayAttributeValues(const CtrlTarget *ctrl_target,
             case GPU_TARGET:
             case THERMAL_SENSOR_TARGET:
             case COOLER_TARGET:
-                {
-                    ret = NvCtrlNvmlGetValidStringAttributeValues(ctrl_target,
-                                                                  attr,
-                                                                  val);
+                if (NvCtrlNvmlRoutesAttribute(h, CTRL_ATTRIBUTE_TYPE_STRING,
+                                              attr)) {
+                    NV_CTRL_STATS_CALL(ret, NV_CTRL_BACKEND_NVML,
+                                       NV_CTRL_STATS_GET_VALID, attr,
+                                       NvCtrlNvmlGetValidStringAttributeValues(ctrl_target,
+                                                                               attr,
+                                                                               val),
+                                       sizeof(*val));
                     if (ret == NvCtrlSuccess) {
                         return ret;
                     }
@@ -1023,8 +1919,12 @@ NvCtrlGetValidStringDisplayAttributeValues(const CtrlTarget *ctrl_target,
                      */
                     return ret;
                 }
-                return NvCtrlNvControlGetValidStringDisplayAttributeValues(
-                           h, display_mask, attr, val);
+                NV_CTRL_STATS_CALL(ret, NV_CTRL_BACKEND_NV_CONTROL,
+                                   NV_CTRL_STATS_GET_VALID, attr,
+                                   NvCtrlNvControlGetValidStringDisplayAttributeValues(
+                                       h, display_mask, attr, val),
+                                   sizeof(*val));
+                return ret;
             default:
                 return NvCtrlBadHandle;
         }
@@ -1047,38 +1947,79 @@ NvCtrlGetValidStringDisplayAttributeValues(const CtrlTarget *ctrl_target,
 
     if ((attr >= NV_CTRL_STRING_GLX_BASE) &&
         (attr <= NV_CTRL_STRING_GLX_LAST_ATTRIBUTE)) {
+        NvCtrlLoadSubsystems(h, NV_CTRL_ATTRIBUTES_GLX_SUBSYSTEM);
         if (!h->glx) return NvCtrlMissingExtension;
         return GetValidStringDisplayAttributeValuesExtraAttr(val);
     }
 
     if ((attr >= NV_CTRL_STRING_XRANDR_BASE) &&
         (attr <= NV_CTRL_STRING_XRANDR_LAST_ATTRIBUTE)) {
+        NvCtrlLoadSubsystems(h, NV_CTRL_ATTRIBUTES_XRANDR_SUBSYSTEM);
         if (!h->xrandr) return NvCtrlMissingExtension;
         return GetValidStringDisplayAttributeValuesExtraAttr(val);
     }
 
     if ((attr >= NV_CTRL_STRING_XF86VIDMODE_BASE) &&
         (attr <= NV_CTRL_STRING_XF86VIDMODE_LAST_ATTRIBUTE)) {
+        NvCtrlLoadSubsystems(h, NV_CTRL_ATTRIBUTES_XF86VIDMODE_SUBSYSTEM);
         if (!h->vm) return NvCtrlMissingExtension;
         return GetValidStringDisplayAttributeValuesExtraAttr(val);
     }
 
     if ((attr >= NV_CTRL_STRING_XV_BASE) &&
         (attr <= NV_CTRL_STRING_XV_LAST_ATTRIBUTE)) {
+        NvCtrlLoadSubsystems(h, NV_CTRL_ATTRIBUTES_XVIDEO_SUBSYSTEM);
         if (!h->xv) return NvCtrlMissingExtension;
         return GetValidStringDisplayAttributeValuesExtraAttr(val);
     }
 
     return NvCtrlNoAttribute;
 
+} /* get_valid_string_display_attribute_values() */
+
+
+ReturnStatus
+NvCtrlGetValidStringDisplayAttributeValues(const CtrlTarget *ctrl_target,
+                                           unsigned int display_mask, int attr,
+                                           CtrlAttributeValidValues *val)
+{
+    const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
+    unsigned long long start = NvCtrlTraceBegin();
+    ReturnStatus ret;
+
+    if (NV_CTRL_TRACE_REPLAYING()) {
+        return NvCtrlTraceReplayValue(h, NV_CTRL_TRACE_GET_VALID_STRING,
+                                      display_mask, attr, val, sizeof(*val));
+    }
+
+    if (!NvCtrlAttributeCacheLookupValidValues(ctrl_target,
+                                               CTRL_ATTRIBUTE_TYPE_STRING,
+                                               display_mask, attr, val,
+                                               &ret)) {
+        ret = get_valid_string_display_attribute_values(ctrl_target,
+                                                        display_mask,
+                                                        attr, val);
+
+        NvCtrlAttributeCacheStoreValidValues(ctrl_target,
+                                             CTRL_ATTRIBUTE_TYPE_STRING,
+                                             display_mask, attr, val, ret);
+    }
+
+    NvCtrlTraceRecord(h, NV_CTRL_TRACE_GET_VALID_STRING, display_mask, attr,
+                      ret, (ret == NvCtrlSuccess) ? val : NULL, sizeof(*val),
+                      NvCtrlTraceElapsed(start));
+
+    return ret;
+
 } /* NvCtrlGetValidStringDisplayAttributeValues() */
 
 
-ReturnStatus NvCtrlGetStringDisplayAttribute(const CtrlTarget *ctrl_target,
-                                             unsigned int display_mask,
-                                             int attr, char **ptr)
+static ReturnStatus get_string_display_attribute(const CtrlTarget *ctrl_target,
+                                                 unsigned int display_mask,
+                                                 int attr, char **ptr)
 {
     const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
+    ReturnStatus ret;
 
     if (h == NULL) {
         return NvCtrlBadHandle;
@@ -1088,10 +2029,14 @@ ReturnStatus NvCtrlGetStringDisplayAttribute(const CtrlTarget *ctrl_target,
         case GPU_TARGET:
         case THERMAL_SENSOR_TARGET:
         case COOLER_TARGET:
-            {
-                ReturnStatus ret = NvCtrlNvmlGetStringAttribute(ctrl_target,
+            if (NvCtrlNvmlRoutesAttribute(h, CTRL_ATTRIBUTE_TYPE_STRING,
+                                          attr)) {
+                NV_CTRL_STATS_CALL(ret, NV_CTRL_BACKEND_NVML,
+                                   NV_CTRL_STATS_GET_STRING, attr,
+                                   NvCtrlNvmlGetStringAttribute(ctrl_target,
                                                                 attr,
-                                                                ptr);
+                                                                ptr),
+                                   string_size(ret, *ptr));
                 if ((ret != NvCtrlMissingExtension) &&
                     (ret != NvCtrlBadHandle) &&
                     (ret != NvCtrlNotSupported)) {
@@ -1106,43 +2051,87 @@ ReturnStatus NvCtrlGetStringDisplayAttribute(const CtrlTarget *ctrl_target,
         case MUX_TARGET:
             if ((attr >= 0) && (attr <= NV_CTRL_STRING_LAST_ATTRIBUTE)) {
                 if (!h->nv) return NvCtrlMissingExtension;
-                return NvCtrlNvControlGetStringAttribute(h, display_mask, attr, ptr);
+                NV_CTRL_STATS_CALL(ret, NV_CTRL_BACKEND_NV_CONTROL,
+                                   NV_CTRL_STATS_GET_STRING, attr,
+                                   NvCtrlNvControlGetStringAttribute(h,
+                                                                     display_mask,
+                                                                     attr, ptr),
+                                   string_size(ret, *ptr));
+                return ret;
             }
 
             if ((attr >= NV_CTRL_STRING_NV_CONTROL_BASE) &&
                 (attr <= NV_CTRL_STRING_NV_CONTROL_LAST_ATTRIBUTE)) {
                 if (!h->nv) return NvCtrlMissingExtension;
-                return NvCtrlNvControlGetStringAttribute(h, display_mask, attr, ptr);
+                NV_CTRL_STATS_CALL(ret, NV_CTRL_BACKEND_NV_CONTROL,
+                                   NV_CTRL_STATS_GET_STRING, attr,
+                                   NvCtrlNvControlGetStringAttribute(h,
+                                                                     display_mask,
+                                                                     attr, ptr),
+                                   string_size(ret, *ptr));
+                return ret;
             }
 
             if ((attr >= NV_CTRL_STRING_GLX_BASE) &&
                 (attr <= NV_CTRL_STRING_GLX_LAST_ATTRIBUTE)) {
+                NvCtrlLoadSubsystems(h, NV_CTRL_ATTRIBUTES_GLX_SUBSYSTEM);
                 if (!h->glx) return NvCtrlMissingExtension;
-                return NvCtrlGlxGetStringAttribute(h, display_mask, attr, ptr);
+                NV_CTRL_STATS_CALL(ret, NV_CTRL_BACKEND_GLX,
+                                   NV_CTRL_STATS_GET_STRING, attr,
+                                   NvCtrlGlxGetStringAttribute(h, display_mask,
+                                                               attr, ptr),
+                                   string_size(ret, *ptr));
+                return ret;
             }
 
             if ((attr >= NV_CTRL_STRING_EGL_BASE) &&
                 (attr <= NV_CTRL_STRING_EGL_LAST_ATTRIBUTE)) {
+                NvCtrlLoadSubsystems(h, NV_CTRL_ATTRIBUTES_EGL_SUBSYSTEM);
                 if (!h->egl) return NvCtrlMissingExtension;
-                return NvCtrlEglGetStringAttribute(h, display_mask, attr, ptr);
+                NV_CTRL_STATS_CALL(ret, NV_CTRL_BACKEND_EGL,
+                                   NV_CTRL_STATS_GET_STRING, attr,
+                                   NvCtrlEglGetStringAttribute(h, display_mask,
+                                                               attr, ptr),
+                                   string_size(ret, *ptr));
+                return ret;
             }
 
             if ((attr >= NV_CTRL_STRING_XRANDR_BASE) &&
                 (attr <= NV_CTRL_STRING_XRANDR_LAST_ATTRIBUTE)) {
+                NvCtrlLoadSubsystems(h, NV_CTRL_ATTRIBUTES_XRANDR_SUBSYSTEM);
                 if (!h->xrandr) return NvCtrlMissingExtension;
-                return NvCtrlXrandrGetStringAttribute(h, display_mask, attr, ptr);
+                NV_CTRL_STATS_CALL(ret, NV_CTRL_BACKEND_XRANDR,
+                                   NV_CTRL_STATS_GET_STRING, attr,
+                                   NvCtrlXrandrGetStringAttribute(h,
+                                                                  display_mask,
+                                                                  attr, ptr),
+                                   string_size(ret, *ptr));
+                return ret;
             }
 
             if ((attr >= NV_CTRL_STRING_XF86VIDMODE_BASE) &&
                 (attr <= NV_CTRL_STRING_XF86VIDMODE_LAST_ATTRIBUTE)) {
+                NvCtrlLoadSubsystems(h, NV_CTRL_ATTRIBUTES_XF86VIDMODE_SUBSYSTEM);
                 if (!h->vm) return NvCtrlMissingExtension;
-                return NvCtrlVidModeGetStringAttribute(h, display_mask, attr, ptr);
+                NV_CTRL_STATS_CALL(ret, NV_CTRL_BACKEND_VIDMODE,
+                                   NV_CTRL_STATS_GET_STRING, attr,
+                                   NvCtrlVidModeGetStringAttribute(h,
+                                                                   display_mask,
+                                                                   attr, ptr),
+                                   string_size(ret, *ptr));
+                return ret;
             }
 
             if ((attr >= NV_CTRL_STRING_XV_BASE) &&
                 (attr <= NV_CTRL_STRING_XV_LAST_ATTRIBUTE)) {
+                NvCtrlLoadSubsystems(h, NV_CTRL_ATTRIBUTES_XVIDEO_SUBSYSTEM);
                 if (!h->xv) return NvCtrlMissingExtension;
-                return NvCtrlXvGetStringAttribute(h, display_mask, attr, ptr);
+                NV_CTRL_STATS_CALL(ret, NV_CTRL_BACKEND_XV,
+                                   NV_CTRL_STATS_GET_STRING, attr,
+                                   NvCtrlXvGetStringAttribute(h, display_mask,
+                                                              attr, ptr),
+                                   string_size(ret, *ptr));
+                return ret;
             }
 
             return NvCtrlNoAttribute;
@@ -1151,28 +2140,57 @@ ReturnStatus NvCtrlGetStringDisplayAttribute(const CtrlTarget *ctrl_target,
             return NvCtrlBadHandle;
     }
 
-} /* NvCtrlGetStringDisplayAttribute() */
+} /* get_string_display_attribute() */
 
 
-ReturnStatus NvCtrlSetStringDisplayAttribute(CtrlTarget *ctrl_target,
+ReturnStatus NvCtrlGetStringDisplayAttribute(const CtrlTarget *ctrl_target,
                                              unsigned int display_mask,
-                                             int attr, const char *ptr)
+                                             int attr, char **ptr)
+{
+    const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
+    ReturnStatus ret;
+
+    if (NV_CTRL_TRACE_REPLAYING()) {
+        return NvCtrlTraceReplayData(h, NV_CTRL_TRACE_GET_STRING,
+                                     display_mask, attr, (void **) ptr,
+                                     NULL);
+    }
+
+    NV_CTRL_TRACE_CALL(ret, h, NV_CTRL_TRACE_GET_STRING, display_mask, attr,
+                       get_string_display_attribute(ctrl_target, display_mask,
+                                                    attr, ptr),
+                       *ptr, string_size(ret, *ptr));
+    return ret;
+
+} /* NvCtrlGetStringDisplayAttribute() */
+
+
+static ReturnStatus set_string_display_attribute(CtrlTarget *ctrl_target,
+                                                 unsigned int display_mask,
+                                                 int attr, const char *ptr)
 {
     NvCtrlAttributePrivateHandle *h = getPrivateHandle(ctrl_target);
+    ReturnStatus ret;
 
     if (h == NULL) {
         return NvCtrlBadHandle;
     }
 
+    /* String attributes (e.g. MetaModes) may affect any target */
+    NvCtrlAttributeCacheFlushSystem(h->system);
+
     if ((attr >= 0) && (attr <= NV_CTRL_STRING_LAST_ATTRIBUTE)) {
         switch (h->target_type) {
             case GPU_TARGET:
             case THERMAL_SENSOR_TARGET:
             case COOLER_TARGET:
                 {
-                    ReturnStatus ret = NvCtrlNvmlSetStringAttribute(ctrl_target,
+                    NV_CTRL_STATS_CALL(ret, NV_CTRL_BACKEND_NVML,
+                                       NV_CTRL_STATS_SET_STRING, attr,
+                                       NvCtrlNvmlSetStringAttribute(ctrl_target,
                                                                     attr,
-                                                                    ptr);
+                                                                    ptr),
+                                       string_size(NvCtrlSuccess, ptr));
                     if ((ret != NvCtrlMissingExtension) &&
                         (ret != NvCtrlBadHandle) &&
                         (ret != NvCtrlNotSupported)) {
@@ -1186,8 +2204,12 @@ ReturnStatus NvCtrlSetStringDisplayAttribute(CtrlTarget *ctrl_target,
             case NVIDIA_3D_VISION_PRO_TRANSCEIVER_TARGET:
             case MUX_TARGET:
                 if (!h->nv) return NvCtrlMissingExtension;
-                return NvCtrlNvControlSetStringAttribute(h, display_mask, attr,
-                                                         ptr);
+                NV_CTRL_STATS_CALL(ret, NV_CTRL_BACKEND_NV_CONTROL,
+                                   NV_CTRL_STATS_SET_STRING, attr,
+                                   NvCtrlNvControlSetStringAttribute(h, display_mask, attr,
+                                                                     ptr),
+                                   string_size(NvCtrlSuccess, ptr));
+                return ret;
             default:
                 return NvCtrlBadHandle;
         }
@@ -1197,9 +2219,59 @@ ReturnStatus NvCtrlSetStringDisplayAttribute(CtrlTarget *ctrl_target,
 }
 
 
-ReturnStatus NvCtrlGetBinaryAttribute(const CtrlTarget *ctrl_target,
-                                      unsigned int display_mask, int attr,
-                                      unsigned char **data, int *len)
+ReturnStatus NvCtrlSetStringDisplayAttribute(CtrlTarget *ctrl_target,
+                                             unsigned int display_mask,
+                                             int attr, const char *ptr)
+{
+    const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
+    ReturnStatus ret;
+
+    if (NV_CTRL_TRACE_REPLAYING()) {
+        return NvCtrlTraceReplay(h, NV_CTRL_TRACE_SET_STRING, display_mask,
+                                 attr, NULL, NULL);
+    }
+
+    NV_CTRL_TRACE_CALL(ret, h, NV_CTRL_TRACE_SET_STRING, display_mask, attr,
+                       set_string_display_attribute(ctrl_target, display_mask,
+                                                    attr, ptr),
+                       ptr, string_size(NvCtrlSuccess, ptr));
+    return ret;
+
+} /* NvCtrlSetStringDisplayAttribute() */
+
+
+/*
+ * NvCtrlAllocBinaryData() - returns a block of len bytes, zeroed, for the data
+ * of a binary attribute: the scratch buffer, grown if needed, if one is given,
+ * or else a newly allocated block that the caller must free.
+ */
+
+unsigned char *NvCtrlAllocBinaryData(NvCtrlBinaryScratch *scratch, int len)
+{
+    if (scratch == NULL) {
+        return nvalloc(len);
+    }
+
+    if ((scratch->data == NULL) || (len > scratch->size)) {
+        scratch->data = nvrealloc(scratch->data, len);
+        scratch->size = len;
+    }
+
+    memset(scratch->data, 0, len);
+
+    return scratch->data;
+}
+
+
+/*
+ * Asks the backends for a binary attribute of the target; see
+ * get_binary_attribute().
+ */
+
+static ReturnStatus query_binary_attribute(const CtrlTarget *ctrl_target,
+                                           unsigned int display_mask, int attr,
+                                           unsigned char **data, int *len,
+                                           NvCtrlBinaryScratch *scratch)
 {
     const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
     ReturnStatus ret = NvCtrlMissingExtension;
@@ -1213,10 +2285,14 @@ ReturnStatus NvCtrlGetBinaryAttribute(const CtrlTarget *ctrl_target,
         case THERMAL_SENSOR_TARGET:
         case COOLER_TARGET:
             {
-                ret = NvCtrlNvmlGetBinaryAttribute(ctrl_target,
-                                                   attr,
-                                                   data,
-                                                   len);
+                NV_CTRL_STATS_CALL(ret, NV_CTRL_BACKEND_NVML,
+                                   NV_CTRL_STATS_GET_BINARY, attr,
+                                   NvCtrlNvmlGetBinaryAttribute(ctrl_target,
+                                                                attr,
+                                                                data,
+                                                                len,
+                                                                scratch),
+                                   (ret == NvCtrlSuccess) ? *len : 0);
                 if ((ret != NvCtrlMissingExtension) &&
                     (ret != NvCtrlBadHandle) &&
                     (ret != NvCtrlNotSupported)) {
@@ -1235,34 +2311,234 @@ ReturnStatus NvCtrlGetBinaryAttribute(const CtrlTarget *ctrl_target,
                  */
                 return ret;
             }
-            return NvCtrlNvControlGetBinaryAttribute(h, display_mask, attr, data, len);
+            NV_CTRL_STATS_CALL(ret, NV_CTRL_BACKEND_NV_CONTROL,
+                               NV_CTRL_STATS_GET_BINARY, attr,
+                               NvCtrlNvControlGetBinaryAttribute(h,
+                                                                 display_mask,
+                                                                 attr, data,
+                                                                 len, scratch),
+                               (ret == NvCtrlSuccess) ? *len : 0);
+            return ret;
         default:
             return NvCtrlBadHandle;
     }
+}
+
+
+/*
+ * Queries a binary attribute of the target, storing its data in the scratch
+ * buffer if one is given, or else in a newly allocated block.
+ */
+
+static ReturnStatus get_binary_attribute(const CtrlTarget *ctrl_target,
+                                         unsigned int display_mask, int attr,
+                                         unsigned char **data, int *len,
+                                         NvCtrlBinaryScratch *scratch)
+{
+    const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
+    ReturnStatus ret;
+
+    if (NV_CTRL_TRACE_REPLAYING()) {
+        const void *trace_data;
+        int trace_len;
+
+        ret = NvCtrlTraceReplay(h, NV_CTRL_TRACE_GET_BINARY, display_mask,
+                                attr, &trace_data, &trace_len);
+        if (ret == NvCtrlSuccess) {
+            *data = NvCtrlAllocBinaryData(scratch, trace_len);
+            memcpy(*data, trace_data, trace_len);
+            *len = trace_len;
+        }
+        return ret;
+    }
+
+    NV_CTRL_TRACE_CALL(ret, h, NV_CTRL_TRACE_GET_BINARY, display_mask, attr,
+                       query_binary_attribute(ctrl_target, display_mask, attr,
+                                              data, len, scratch),
+                       *data, *len);
+    return ret;
+}
+
+
+ReturnStatus NvCtrlGetBinaryAttribute(const CtrlTarget *ctrl_target,
+                                      unsigned int display_mask, int attr,
+                                      unsigned char **data, int *len)
+{
+    return get_binary_attribute(ctrl_target, display_mask, attr, data, len,
+                                NULL);
+
+} /* NvCtrlGetBinaryAttribute() */
+
+
+ReturnStatus NvCtrlGetBinaryAttributeScratch(CtrlTarget *ctrl_target,
+                                             unsigned int display_mask,
+                                             int attr,
+                                             const unsigned char **data,
+                                             int *len)
+{
+    NvCtrlAttributePrivateHandle *h = getPrivateHandle(ctrl_target);
+    unsigned char *tmp = NULL;
+    ReturnStatus ret;
+
+    if (h == NULL) {
+        return NvCtrlBadHandle;
+    }
+
+    ret = get_binary_attribute(ctrl_target, display_mask, attr, &tmp, len,
+                               &h->binary_scratch);
+    if (ret == NvCtrlSuccess) {
+        *data = tmp;
+    }
+
+    return ret;
+
+} /* NvCtrlGetBinaryAttributeScratch() */
+
+
+static ReturnStatus get_gpu_telemetry(const CtrlTarget *ctrl_target,
+                                      CtrlGpuTelemetry *telemetry)
+{
+    const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
+    ReturnStatus ret;
+
+    if (h == NULL) {
+        return NvCtrlBadHandle;
+    }
+
+    if (telemetry == NULL) {
+        return NvCtrlBadArgument;
+    }
+
+    if (!TARGET_TYPE_IS_NVML_COMPATIBLE(h->target_type)) {
+        return NvCtrlBadHandle;
+    }
+
+    /* There is no NV-CONTROL equivalent; callers fall back to attributes */
+    NV_CTRL_STATS_CALL(ret, NV_CTRL_BACKEND_NVML,
+                       NV_CTRL_STATS_TELEMETRY, -1,
+                       NvCtrlNvmlGetTelemetry(ctrl_target, telemetry),
+                       sizeof(*telemetry));
+    return ret;
+
+} /* get_gpu_telemetry() */
+
+
+ReturnStatus NvCtrlGetGpuTelemetry(const CtrlTarget *ctrl_target,
+                                   CtrlGpuTelemetry *telemetry)
+{
+    const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
+    ReturnStatus ret;
+
+    if (NV_CTRL_TRACE_REPLAYING()) {
+        return NvCtrlTraceReplayValue(h, NV_CTRL_TRACE_TELEMETRY, 0, -1,
+                                      telemetry, sizeof(*telemetry));
+    }
+
+    NV_CTRL_TRACE_CALL(ret, h, NV_CTRL_TRACE_TELEMETRY, 0, -1,
+                       get_gpu_telemetry(ctrl_target, telemetry),
+                       telemetry, sizeof(*telemetry));
+    return ret;
+
+} /* NvCtrlGetGpuTelemetry() */
+
+
+static ReturnStatus get_nvml_event_types(const CtrlTarget *ctrl_target,
+                                         unsigned long long *event_types)
+{
+    const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
+
+    if (h == NULL) {
+        return NvCtrlBadHandle;
+    }
+
+    if (event_types == NULL) {
+        return NvCtrlBadArgument;
+    }
+
+    if (!TARGET_TYPE_IS_NVML_COMPATIBLE(h->target_type)) {
+        return NvCtrlBadHandle;
+    }
 
-} /* NvCtrlGetBinaryAttribute() */
+    return NvCtrlNvmlGetEventTypes(ctrl_target, event_types);
 
+} /* get_nvml_event_types() */
 
-ReturnStatus NvCtrlStringOperation(CtrlTarget *ctrl_target,
-                                   unsigned int display_mask, int attr,
-                                   const char *ptrIn, char **ptrOut)
+
+ReturnStatus NvCtrlGetNvmlEventTypes(const CtrlTarget *ctrl_target,
+                                     unsigned long long *event_types)
+{
+    const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
+    ReturnStatus ret;
+
+    if (NV_CTRL_TRACE_REPLAYING()) {
+        return NvCtrlTraceReplayValue(h, NV_CTRL_TRACE_EVENT_TYPES, 0, -1,
+                                      event_types, sizeof(*event_types));
+    }
+
+    NV_CTRL_TRACE_CALL(ret, h, NV_CTRL_TRACE_EVENT_TYPES, 0, -1,
+                       get_nvml_event_types(ctrl_target, event_types),
+                       event_types, sizeof(*event_types));
+    return ret;
+
+} /* NvCtrlGetNvmlEventTypes() */
+
+
+static ReturnStatus string_operation(CtrlTarget *ctrl_target,
+                                     unsigned int display_mask, int attr,
+                                     const char *ptrIn, char **ptrOut)
 {
     NvCtrlAttributePrivateHandle *h = getPrivateHandle(ctrl_target);
+    ReturnStatus ret;
 
     if (h == NULL) {
         return NvCtrlBadHandle;
     }
 
+    NvCtrlAttributeCacheFlushSystem(h->system);
+
     if ((attr >= 0) && (attr <= NV_CTRL_STRING_OPERATION_LAST_ATTRIBUTE)) {
         if (!h->nv) return NvCtrlMissingExtension;
-        return NvCtrlNvControlStringOperation(h, display_mask, attr, ptrIn,
-                                              ptrOut);
+        NV_CTRL_STATS_CALL(ret, NV_CTRL_BACKEND_NV_CONTROL,
+                           NV_CTRL_STATS_STRING_OP, attr,
+                           NvCtrlNvControlStringOperation(h, display_mask, attr, ptrIn,
+                                                          ptrOut),
+                           string_size(ret, *ptrOut));
+        return ret;
     }
 
     return NvCtrlNoAttribute;
 }
 
 
+ReturnStatus NvCtrlStringOperation(CtrlTarget *ctrl_target,
+                                   unsigned int display_mask, int attr,
+                                   const char *ptrIn, char **ptrOut)
+{
+    const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
+    ReturnStatus ret;
+
+    /* Replayed in order, whatever their input */
+    if (NV_CTRL_TRACE_REPLAYING()) {
+        const void *data;
+        int len;
+
+        ret = NvCtrlTraceReplay(h, NV_CTRL_TRACE_STRING_OP, display_mask,
+                                attr, &data, &len);
+        if (ret == NvCtrlSuccess) {
+            *ptrOut = len ? nvstrndup(data, len) : NULL;
+        }
+        return ret;
+    }
+
+    NV_CTRL_TRACE_CALL(ret, h, NV_CTRL_TRACE_STRING_OP, display_mask, attr,
+                       string_operation(ctrl_target, display_mask, attr,
+                                        ptrIn, ptrOut),
+                       *ptrOut, string_size(ret, *ptrOut));
+    return ret;
+
+} /* NvCtrlStringOperation() */
+
+
 char *NvCtrlAttributesStrError(ReturnStatus status)
 {
     switch (status) {
@@ -1320,6 +2596,7 @@ void NvCtrlAttributeClose(NvCtrlAttributeHandle *handle)
         NvCtrlNvmlAttributesClose(h);
     }
 
+    free(h->binary_scratch.data);
     free(h);
 } /* NvCtrlAttributeClose() */
 
@@ -1410,42 +2687,90 @@ const char *NvCtrlGetStereoModeName(int stereo_mode)
 }
 
 
-ReturnStatus NvCtrlGetColorAttributes(const CtrlTarget *ctrl_target,
-                                      float contrast[3],
-                                      float brightness[3],
-                                      float gamma[3])
+static ReturnStatus get_color_attributes(const CtrlTarget *ctrl_target,
+                                         float contrast[3],
+                                         float brightness[3],
+                                         float gamma[3])
 {
     const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
+    ReturnStatus ret;
 
     if (h == NULL) {
         return NvCtrlBadHandle;
     }
 
+    NvCtrlLoadSubsystems(h, NV_CTRL_ATTRIBUTES_XF86VIDMODE_SUBSYSTEM |
+                            NV_CTRL_ATTRIBUTES_XRANDR_SUBSYSTEM);
+
     switch (h->target_type) {
     case X_SCREEN_TARGET:
-        return NvCtrlVidModeGetColorAttributes(h, contrast, brightness, gamma);
+        NV_CTRL_STATS_CALL(ret, NV_CTRL_BACKEND_VIDMODE,
+                           NV_CTRL_STATS_COLOR, -1,
+                           NvCtrlVidModeGetColorAttributes(h, contrast,
+                                                           brightness, gamma),
+                           0);
+        return ret;
     case DISPLAY_TARGET:
-        return NvCtrlXrandrGetColorAttributes(h, contrast, brightness, gamma);
+        NV_CTRL_STATS_CALL(ret, NV_CTRL_BACKEND_XRANDR,
+                           NV_CTRL_STATS_COLOR, -1,
+                           NvCtrlXrandrGetColorAttributes(h, contrast,
+                                                          brightness, gamma),
+                           0);
+        return ret;
     default:
         return NvCtrlBadHandle;
     }
 }
 
-ReturnStatus NvCtrlSetColorAttributes(CtrlTarget *ctrl_target,
-                                      float c[3],
-                                      float b[3],
-                                      float g[3],
-                                      unsigned int bitmask)
+
+ReturnStatus NvCtrlGetColorAttributes(const CtrlTarget *ctrl_target,
+                                      float contrast[3],
+                                      float brightness[3],
+                                      float gamma[3])
+{
+    const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
+    float values[9];
+    ReturnStatus ret;
+
+    if (NV_CTRL_TRACE_REPLAYING()) {
+        ret = NvCtrlTraceReplayValue(h, NV_CTRL_TRACE_GET_COLOR, 0, -1,
+                                     values, sizeof(values));
+    } else {
+        NV_CTRL_TRACE_CALL(ret, h, NV_CTRL_TRACE_GET_COLOR, 0, -1,
+                           get_color_attributes(ctrl_target, values,
+                                                values + 3, values + 6),
+                           values, sizeof(values));
+    }
+
+    if (ret == NvCtrlSuccess) {
+        memcpy(contrast, values, 3 * sizeof(float));
+        memcpy(brightness, values + 3, 3 * sizeof(float));
+        memcpy(gamma, values + 6, 3 * sizeof(float));
+    }
+
+    return ret;
+
+} /* NvCtrlGetColorAttributes() */
+
+static ReturnStatus set_color_attributes(CtrlTarget *ctrl_target,
+                                         float c[3],
+                                         float b[3],
+                                         float g[3],
+                                         unsigned int bitmask)
 {
     ReturnStatus status;
     int val = 0;
 
     NvCtrlAttributePrivateHandle *h = getPrivateHandle(ctrl_target);
+    ReturnStatus ret;
 
     if (h == NULL) {
         return NvCtrlBadHandle;
     }
 
+    NvCtrlLoadSubsystems(h, NV_CTRL_ATTRIBUTES_XF86VIDMODE_SUBSYSTEM |
+                            NV_CTRL_ATTRIBUTES_XRANDR_SUBSYSTEM);
+
     status = NvCtrlGetAttribute(ctrl_target,
                                 NV_CTRL_ATTR_RANDR_GAMMA_AVAILABLE,
                                 &val);
@@ -1453,62 +2778,170 @@ ReturnStatus NvCtrlSetColorAttributes(CtrlTarget *ctrl_target,
     if (status == NvCtrlSuccess && val) {
         switch (h->target_type) {
         case X_SCREEN_TARGET:
-            return NvCtrlVidModeSetColorAttributes(h, c, b, g, bitmask);
+            NV_CTRL_STATS_CALL(ret, NV_CTRL_BACKEND_VIDMODE,
+                               NV_CTRL_STATS_COLOR, -1,
+                               NvCtrlVidModeSetColorAttributes(h, c, b, g,
+                                                               bitmask),
+                               0);
+            return ret;
         case DISPLAY_TARGET:
-            return NvCtrlXrandrSetColorAttributes(h, c, b, g, bitmask);
+            NV_CTRL_STATS_CALL(ret, NV_CTRL_BACKEND_XRANDR,
+                               NV_CTRL_STATS_COLOR, -1,
+                               NvCtrlXrandrSetColorAttributes(h, c, b, g,
+                                                              bitmask),
+                               0);
+            return ret;
         default:
             return NvCtrlBadHandle;
         }
     } else if ((status != NvCtrlSuccess || !val) &&
                h->target_type == NV_CTRL_TARGET_TYPE_X_SCREEN) {
-        return NvCtrlVidModeSetColorAttributes(h, c, b, g, bitmask);
+        NV_CTRL_STATS_CALL(ret, NV_CTRL_BACKEND_VIDMODE,
+                           NV_CTRL_STATS_COLOR, -1,
+                           NvCtrlVidModeSetColorAttributes(h, c, b, g, bitmask),
+                           0);
+        return ret;
     }
 
     return NvCtrlError;
 }
 
 
-ReturnStatus NvCtrlGetColorRamp(const CtrlTarget *ctrl_target,
-                                unsigned int channel,
-                                uint16_t **lut,
-                                int *n)
+ReturnStatus NvCtrlSetColorAttributes(CtrlTarget *ctrl_target,
+                                      float c[3],
+                                      float b[3],
+                                      float g[3],
+                                      unsigned int bitmask)
 {
     const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
+    ReturnStatus ret;
+
+    if (NV_CTRL_TRACE_REPLAYING()) {
+        return NvCtrlTraceReplay(h, NV_CTRL_TRACE_SET_COLOR, 0, bitmask,
+                                 NULL, NULL);
+    }
+
+    NV_CTRL_TRACE_CALL(ret, h, NV_CTRL_TRACE_SET_COLOR, 0, bitmask,
+                       set_color_attributes(ctrl_target, c, b, g, bitmask),
+                       NULL, 0);
+    return ret;
+
+} /* NvCtrlSetColorAttributes() */
+
+
+static ReturnStatus get_color_ramp(const CtrlTarget *ctrl_target,
+                                   unsigned int channel,
+                                   uint16_t **lut,
+                                   int *n)
+{
+    const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
+    ReturnStatus ret;
 
     if (h == NULL) {
         return NvCtrlBadHandle;
     }
 
+    NvCtrlLoadSubsystems(h, NV_CTRL_ATTRIBUTES_XF86VIDMODE_SUBSYSTEM |
+                            NV_CTRL_ATTRIBUTES_XRANDR_SUBSYSTEM);
+
     switch (h->target_type) {
     case X_SCREEN_TARGET:
-        return NvCtrlVidModeGetColorRamp(h, channel, lut, n);
+        NV_CTRL_STATS_CALL(ret, NV_CTRL_BACKEND_VIDMODE,
+                           NV_CTRL_STATS_COLOR, -1,
+                           NvCtrlVidModeGetColorRamp(h, channel, lut, n),
+                           0);
+        return ret;
     case DISPLAY_TARGET:
-        return NvCtrlXrandrGetColorRamp(h, channel, lut, n);
+        NV_CTRL_STATS_CALL(ret, NV_CTRL_BACKEND_XRANDR,
+                           NV_CTRL_STATS_COLOR, -1,
+                           NvCtrlXrandrGetColorRamp(h, channel, lut, n),
+                           0);
+        return ret;
     default:
         return NvCtrlBadHandle;
     }
 }
 
 
-ReturnStatus NvCtrlReloadColorRamp(CtrlTarget *ctrl_target)
+ReturnStatus NvCtrlGetColorRamp(const CtrlTarget *ctrl_target,
+                                unsigned int channel,
+                                uint16_t **lut,
+                                int *n)
+{
+    const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
+    ReturnStatus ret;
+
+    /* The ramp belongs to the backend, or to the trace when replayed */
+    if (NV_CTRL_TRACE_REPLAYING()) {
+        const void *data;
+        int len;
+
+        ret = NvCtrlTraceReplay(h, NV_CTRL_TRACE_GET_COLOR_RAMP, 0, channel,
+                                &data, &len);
+        if (ret == NvCtrlSuccess) {
+            *lut = (uint16_t *) data;
+            *n = len / sizeof(uint16_t);
+        }
+        return ret;
+    }
+
+    NV_CTRL_TRACE_CALL(ret, h, NV_CTRL_TRACE_GET_COLOR_RAMP, 0, channel,
+                       get_color_ramp(ctrl_target, channel, lut, n),
+                       *lut, *n * sizeof(uint16_t));
+    return ret;
+
+} /* NvCtrlGetColorRamp() */
+
+
+static ReturnStatus reload_color_ramp(CtrlTarget *ctrl_target)
 {
     NvCtrlAttributePrivateHandle *h = getPrivateHandle(ctrl_target);
+    ReturnStatus ret;
 
     if (h == NULL) {
         return NvCtrlBadHandle;
     }
 
+    NvCtrlLoadSubsystems(h, NV_CTRL_ATTRIBUTES_XF86VIDMODE_SUBSYSTEM |
+                            NV_CTRL_ATTRIBUTES_XRANDR_SUBSYSTEM);
+
     switch (h->target_type) {
     case X_SCREEN_TARGET:
-        return NvCtrlVidModeReloadColorRamp(h);
+        NV_CTRL_STATS_CALL(ret, NV_CTRL_BACKEND_VIDMODE,
+                           NV_CTRL_STATS_COLOR, -1,
+                           NvCtrlVidModeReloadColorRamp(h),
+                           0);
+        return ret;
     case DISPLAY_TARGET:
-        return NvCtrlXrandrReloadColorRamp(h);
+        NV_CTRL_STATS_CALL(ret, NV_CTRL_BACKEND_XRANDR,
+                           NV_CTRL_STATS_COLOR, -1,
+                           NvCtrlXrandrReloadColorRamp(h),
+                           0);
+        return ret;
     default:
         return NvCtrlBadHandle;
     }
 }
 
 
+ReturnStatus NvCtrlReloadColorRamp(CtrlTarget *ctrl_target)
+{
+    const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
+    ReturnStatus ret;
+
+    if (NV_CTRL_TRACE_REPLAYING()) {
+        return NvCtrlTraceReplay(h, NV_CTRL_TRACE_RELOAD_COLOR_RAMP, 0, -1,
+                                 NULL, NULL);
+    }
+
+    NV_CTRL_TRACE_CALL(ret, h, NV_CTRL_TRACE_RELOAD_COLOR_RAMP, 0, -1,
+                       reload_color_ramp(ctrl_target),
+                       NULL, 0);
+    return ret;
+
+} /* NvCtrlReloadColorRamp() */
+
+
 /* helper functions private to the libXNVCtrlAttributes backend */
 
 void NvCtrlInitGammaInputStruct(NvCtrlGammaInput *pGammaInput)
@@ -1673,10 +3106,7 @@ NvCtrlEventHandle *NvCtrlGetEventHandle(const CtrlTarget *ctrl_target)
         return NULL;
     }
 
-    if (!h->dpy && !h->nv && h->nvml) {
-        /* We are running with NVML lib only. Events not yet supported.*/
-        return NULL;
-    }
+    pthread_mutex_lock(&__event_handles_lock);
 
     /* Look for the event handle */
     evt_h = NULL;
@@ -1692,9 +3122,19 @@ NvCtrlEventHandle *NvCtrlGetEventHandle(const CtrlTarget *ctrl_target)
 
     /* If not found, create a new one */
     if (!evt_h) {
+        int nvml_fd = NvCtrlNvmlStartEvents(h->system);
+
+        if (!h->dpy && nvml_fd == -1) {
+            /* We are running with NVML lib only, without NVML events */
+            pthread_mutex_unlock(&__event_handles_lock);
+            return NULL;
+        }
+
         evt_h = nvalloc(sizeof(*evt_h));
+        evt_h->system = h->system;
         evt_h->dpy = h->dpy;
-        evt_h->fd = ConnectionNumber(h->dpy);
+        evt_h->fd = (h->dpy) ? ConnectionNumber(h->dpy) : -1;
+        evt_h->nvml_fd = nvml_fd;
         evt_h->nvctrl_event_base = (h->nv) ? h->nv->event_base : -1;
         evt_h->xrandr_event_base = (h->xrandr) ? h->xrandr->event_base : -1;
 
@@ -1705,6 +3145,14 @@ NvCtrlEventHandle *NvCtrlGetEventHandle(const CtrlTarget *ctrl_target)
         __event_handles = evt_hnode;
     }
 
+    /*
+     * X screens select XRandR events when their XRandR subsystem is
+     * initialized, so do that now that their events are wanted.
+     */
+    if (h->target_type == X_SCREEN_TARGET) {
+        NvCtrlLoadSubsystems(h, NV_CTRL_ATTRIBUTES_XRANDR_SUBSYSTEM);
+    }
+
     /*
      * This next bit of code is to make sure that the xrandr_event_base
      * for this event handle is valid in the case where a NON X Screen
@@ -1720,6 +3168,8 @@ NvCtrlEventHandle *NvCtrlGetEventHandle(const CtrlTarget *ctrl_target)
         evt_h->xrandr_event_base = h->xrandr->event_base;
     }
 
+    pthread_mutex_unlock(&__event_handles_lock);
+
     return (NvCtrlEventHandle *)evt_h;
 }
 
@@ -1732,6 +3182,8 @@ NvCtrlCloseEventHandle(NvCtrlEventHandle *handle)
         return NvCtrlBadArgument;
     }
 
+    pthread_mutex_lock(&__event_handles_lock);
+
     /* Look for the event handle */
     if (__event_handles) {
         NvCtrlEventPrivateHandleNode *prev;
@@ -1756,9 +3208,14 @@ NvCtrlCloseEventHandle(NvCtrlEventHandle *handle)
         }
     }
 
+    pthread_mutex_unlock(&__event_handles_lock);
+
     return NvCtrlBadHandle;
 
 free_handle:
+    pthread_mutex_unlock(&__event_handles_lock);
+
+    free(((NvCtrlEventPrivateHandle *)handle)->coalesced);
     free(handle);
     free(evt_hnode);
 
@@ -1776,11 +3233,63 @@ NvCtrlEventHandleGetFD(NvCtrlEventHandle *handle, int *fd)
 
     evt_h = (NvCtrlEventPrivateHandle*)handle;
 
+    if (evt_h->fd == -1) {
+        return NvCtrlNotSupported;
+    }
+
     *fd = evt_h->fd;
 
     return NvCtrlSuccess;
 }
 
+ReturnStatus
+NvCtrlEventHandleGetNvmlFD(NvCtrlEventHandle *handle, int *fd)
+{
+    NvCtrlEventPrivateHandle *evt_h;
+
+    if (!handle) {
+        return NvCtrlBadArgument;
+    }
+
+    evt_h = (NvCtrlEventPrivateHandle*)handle;
+
+    if (evt_h->nvml_fd == -1) {
+        return NvCtrlNotSupported;
+    }
+
+    *fd = evt_h->nvml_fd;
+
+    return NvCtrlSuccess;
+}
+
+static Bool nvml_event_pending(NvCtrlEventPrivateHandle *evt_h)
+{
+    struct pollfd pfd;
+
+    if (evt_h->nvml_fd == -1) {
+        return FALSE;
+    }
+
+    pfd.fd = evt_h->nvml_fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    if (poll(&pfd, 1, 0) <= 0) {
+        return FALSE;
+    }
+
+    /*
+     * The NVML event thread gave up: stop polling the pipe, so that
+     * NvCtrlEventHandleGetNvmlFD() tells callers to go back to polling.
+     */
+    if ((pfd.revents & POLLHUP) && !(pfd.revents & POLLIN)) {
+        evt_h->nvml_fd = -1;
+        return FALSE;
+    }
+
+    return (pfd.revents & POLLIN) != 0;
+}
+
 ReturnStatus
 NvCtrlEventHandlePending(NvCtrlEventHandle *handle, Bool *pending)
 {
@@ -1792,7 +3301,14 @@ NvCtrlEventHandlePending(NvCtrlEventHandle *handle, Bool *pending)
 
     evt_h = (NvCtrlEventPrivateHandle*)handle;
 
-    if (XPending(evt_h->dpy)) {
+    /*
+     * XPending() also reads the replies to asynchronous queries, so check
+     * for answered queries last.
+     */
+    if ((evt_h->next_coalesced < evt_h->num_coalesced) ||
+        nvml_event_pending(evt_h) ||
+        (evt_h->dpy && XPending(evt_h->dpy)) ||
+        NvCtrlAsyncRepliesPending(evt_h->system)) {
         *pending = TRUE;
     } else {
         *pending = FALSE;
@@ -1818,26 +3334,39 @@ static int get_screen_of_root(Display *dpy, Window root)
     return screen;
 }
 
-ReturnStatus
-NvCtrlEventHandleNextEvent(NvCtrlEventHandle *handle, CtrlEvent *event)
+static ReturnStatus get_next_event(NvCtrlEventPrivateHandle *evt_h,
+                                   CtrlEvent *event)
 {
-    NvCtrlEventPrivateHandle *evt_h;
     XEvent xevent;
 
-    if (!handle) {
-        return NvCtrlBadArgument;
-    }
+    memset(event, 0, sizeof(CtrlEvent));
 
-    evt_h = (NvCtrlEventPrivateHandle*)handle;
 
-    memset(event, 0, sizeof(CtrlEvent));
+    /*
+     * NVML events are forwarded already translated by the NVML event thread
+     */
+    if (nvml_event_pending(evt_h)) {
+        if (read(evt_h->nvml_fd, event, sizeof(CtrlEvent)) !=
+            sizeof(CtrlEvent)) {
+            memset(event, 0, sizeof(CtrlEvent));
+        }
+        return NvCtrlSuccess;
+    }
+
+    if (!evt_h->dpy) {
+        return NvCtrlSuccess;
+    }
 
 
     /*
      * if NvCtrlEventHandleNextEvent() is called, then
-     * NvCtrlEventHandlePending() returned TRUE, so we
-     * know there is an event pending
+     * NvCtrlEventHandlePending() returned TRUE, but that may have been
+     * for answered asynchronous queries only
      */
+    if (!XEventsQueued(evt_h->dpy, QueuedAlready)) {
+        return NvCtrlSuccess;
+    }
+
     XNextEvent(evt_h->dpy, &xevent);
 
 
@@ -1981,3 +3510,168 @@ NvCtrlEventHandleNextEvent(NvCtrlEventHandle *handle, CtrlEvent *event)
     return NvCtrlSuccess;
 }
 
+/*
+ * Maximum number of events read by one call to coalesce_events(), so that a
+ * flood of events cannot keep the caller from processing them.
+ */
+
+#define MAX_COALESCED_EVENTS_READ 1024
+
+/*
+ * Returns whether the event 'b' reports a change of the same attribute or
+ * screen as 'a', so that 'a' no longer needs to be delivered.  XID errors are
+ * all delivered.
+ */
+
+static Bool event_supersedes(const CtrlEvent *a, const CtrlEvent *b)
+{
+    if ((a->type != b->type) ||
+        (a->target_type != b->target_type) ||
+        (a->target_id != b->target_id)) {
+        return FALSE;
+    }
+
+    switch (a->type) {
+        case CTRL_EVENT_TYPE_INTEGER_ATTRIBUTE:
+            return (a->int_attr.attribute == b->int_attr.attribute) &&
+                   (a->int_attr.is_availability_changed ==
+                    b->int_attr.is_availability_changed);
+        case CTRL_EVENT_TYPE_STRING_ATTRIBUTE:
+            return (a->str_attr.attribute == b->str_attr.attribute);
+        case CTRL_EVENT_TYPE_BINARY_ATTRIBUTE:
+            return (a->bin_attr.attribute == b->bin_attr.attribute);
+        case CTRL_EVENT_TYPE_SCREEN_CHANGE:
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+/*
+ * Reads all the events that are pending on the event handle, and queues them
+ * with only the latest event kept for each attribute or screen: a superseded
+ * event is removed, and counted as dropped, and the newer one queued last, so
+ * that events are delivered in the order of the latest changes.
+ */
+
+static void coalesce_events(NvCtrlEventPrivateHandle *evt_h)
+{
+    CtrlEvent event;
+    int i, n;
+
+    evt_h->num_coalesced = 0;
+    evt_h->next_coalesced = 0;
+
+    for (n = 0; n < MAX_COALESCED_EVENTS_READ; n++) {
+
+        if (!nvml_event_pending(evt_h) &&
+            !(evt_h->dpy && XEventsQueued(evt_h->dpy, QueuedAfterReading))) {
+            break;
+        }
+
+        if (get_next_event(evt_h, &event) != NvCtrlSuccess) {
+            break;
+        }
+
+        /* Drop the cached values the event makes stale */
+        NvCtrlAttributeCacheHandleEvent(evt_h->system, &event);
+
+        if (event.type == CTRL_EVENT_TYPE_UNKNOWN) {
+            continue;
+        }
+
+        /* At most one queued event can be superseded by the new one */
+        for (i = 0; i < evt_h->num_coalesced; i++) {
+            if (event_supersedes(&evt_h->coalesced[i], &event)) {
+                memmove(&evt_h->coalesced[i], &evt_h->coalesced[i + 1],
+                        (evt_h->num_coalesced - i - 1) * sizeof(CtrlEvent));
+                evt_h->num_coalesced--;
+                evt_h->dropped_events++;
+                break;
+            }
+        }
+
+        if (evt_h->num_coalesced == evt_h->max_coalesced) {
+            evt_h->max_coalesced = evt_h->max_coalesced ?
+                                   (evt_h->max_coalesced * 2) : 16;
+            evt_h->coalesced = nvrealloc(evt_h->coalesced,
+                                         evt_h->max_coalesced *
+                                         sizeof(CtrlEvent));
+        }
+
+        evt_h->coalesced[evt_h->num_coalesced++] = event;
+    }
+}
+
+ReturnStatus
+NvCtrlEventHandleSetCoalescing(NvCtrlEventHandle *handle, Bool enable)
+{
+    NvCtrlEventPrivateHandle *evt_h;
+
+    if (!handle) {
+        return NvCtrlBadArgument;
+    }
+
+    evt_h = (NvCtrlEventPrivateHandle*)handle;
+    evt_h->coalesce = enable;
+
+    return NvCtrlSuccess;
+}
+
+ReturnStatus
+NvCtrlEventHandleGetDroppedEvents(NvCtrlEventHandle *handle,
+                                  unsigned long *count)
+{
+    NvCtrlEventPrivateHandle *evt_h;
+
+    if (!handle) {
+        return NvCtrlBadArgument;
+    }
+
+    evt_h = (NvCtrlEventPrivateHandle*)handle;
+    *count = evt_h->dropped_events;
+
+    return NvCtrlSuccess;
+}
+
+ReturnStatus
+NvCtrlEventHandleNextEvent(NvCtrlEventHandle *handle, CtrlEvent *event)
+{
+    NvCtrlEventPrivateHandle *evt_h;
+    ReturnStatus status;
+
+    if (!handle) {
+        return NvCtrlBadArgument;
+    }
+
+    evt_h = (NvCtrlEventPrivateHandle*)handle;
+
+    /*
+     * Deliver the coalesced events first, even if coalescing was disabled
+     * since they were read
+     */
+    if (evt_h->coalesce &&
+        (evt_h->next_coalesced >= evt_h->num_coalesced)) {
+        coalesce_events(evt_h);
+    }
+
+    if (evt_h->next_coalesced < evt_h->num_coalesced) {
+        *event = evt_h->coalesced[evt_h->next_coalesced++];
+        return NvCtrlSuccess;
+    }
+
+    if (evt_h->coalesce) {
+        memset(event, 0, sizeof(CtrlEvent));
+        return NvCtrlSuccess;
+    }
+
+    status = get_next_event(evt_h, event);
+
+    /* Drop the cached values the event makes stale */
+    if (status == NvCtrlSuccess) {
+        NvCtrlAttributeCacheHandleEvent(evt_h->system, event);
+    }
+
+    return status;
+}
+
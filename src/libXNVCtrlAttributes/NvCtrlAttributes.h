@@ -102,6 +102,8 @@ typedef struct _CtrlTarget CtrlTarget;
 typedef struct _CtrlTargetNode CtrlTargetNode;
 typedef struct _CtrlSystem CtrlSystem;
 typedef struct _CtrlSystemList CtrlSystemList;
+typedef struct _CtrlAttributeCache CtrlAttributeCache;
+typedef struct _CtrlAsyncQuery CtrlAsyncQuery;
 
 struct _CtrlTarget {
     NvCtrlAttributeHandle *h; /* handle for this target */
@@ -120,6 +122,8 @@ struct _CtrlTarget {
     } display;
 
     struct _CtrlTargetNode *relations; /* List of associated targets */
+
+    CtrlAttributeCache *attr_cache; /* see NvCtrlEnableAttributeCache() */
 };
 
 /* Used to keep track of lists of targets */
@@ -140,6 +144,15 @@ struct _CtrlSystem {
     Display *dpy;   /* X display connection */
     Bool has_nv_control;
     Bool has_nvml;
+    Bool cache_attributes; /* integer attribute values are cached */
+    int nv_control_major;  /* NV-CONTROL version, 0 until queried */
+    int nv_control_minor;
+    int trace_id;          /* see NvCtrlStartTraceRecording() */
+
+    /* NVML state shared by all targets of this system */
+    struct __NvCtrlNvmlSystem *nvml;
+
+    CtrlAsyncQuery *async_queries; /* see NvCtrlGetAttributeAsync() */
 
     CtrlTargetNode *targets[MAX_TARGET_TYPES]; /* Shadows targetTypeTable */
     CtrlTargetNode *physical_screens;
@@ -438,6 +451,41 @@ typedef struct {
 } CtrlAttributeValidValues;
 
 
+/*
+ * Snapshot of the frequently polled state of one GPU, gathered through NVML
+ * in a single pass by NvCtrlGetGpuTelemetry().  A field is only meaningful
+ * if its CTRL_GPU_TELEMETRY_* bit is set in 'valid'; values use the units of
+ * the NV-CONTROL attribute noted next to them.
+ */
+#define CTRL_GPU_TELEMETRY_MAX_FANS          16
+
+#define CTRL_GPU_TELEMETRY_TEMPERATURE       0x00000001
+#define CTRL_GPU_TELEMETRY_UTILIZATION       0x00000002
+#define CTRL_GPU_TELEMETRY_MEMORY            0x00000004
+#define CTRL_GPU_TELEMETRY_FAN_SPEED         0x00000008
+#define CTRL_GPU_TELEMETRY_PCIE_LINK_WIDTH   0x00000010
+#define CTRL_GPU_TELEMETRY_POWER_SOURCE      0x00000020
+
+typedef struct {
+    unsigned long long timestamp; /* CLOCK_MONOTONIC, in microseconds */
+    unsigned int valid;
+
+    int temperature;        /* NV_CTRL_GPU_CORE_TEMPERATURE */
+    int gpu_utilization;    /* graphics utilization, in percent */
+    int memory_utilization; /* memory utilization, in percent */
+    int total_memory;       /* NV_CTRL_TOTAL_DEDICATED_GPU_MEMORY */
+    int used_memory;        /* NV_CTRL_USED_DEDICATED_GPU_MEMORY */
+    int pcie_link_width;    /* NV_CTRL_GPU_PCIE_CURRENT_LINK_WIDTH */
+    int power_source;       /* NV_CTRL_GPU_POWER_SOURCE */
+
+    int fan_count;
+    int fan_speed[CTRL_GPU_TELEMETRY_MAX_FANS]; /* NV_CTRL_THERMAL_COOLER_CURRENT_LEVEL */
+
+    /* Index in fan_speed[] of the queried COOLER_TARGET, -1 otherwise */
+    int fan_index;
+} CtrlGpuTelemetry;
+
+
 /*
  * Event handle and event structure used to provide an event mechanism to
  * communicate different backends with the frontend
@@ -449,7 +497,8 @@ typedef enum {
     CTRL_EVENT_TYPE_INTEGER_ATTRIBUTE,
     CTRL_EVENT_TYPE_STRING_ATTRIBUTE,
     CTRL_EVENT_TYPE_BINARY_ATTRIBUTE,
-    CTRL_EVENT_TYPE_SCREEN_CHANGE
+    CTRL_EVENT_TYPE_SCREEN_CHANGE,
+    CTRL_EVENT_TYPE_XID_ERROR
 } CtrlEventType;
 
 typedef struct {
@@ -474,6 +523,10 @@ typedef struct {
     int mheight;
 } CtrlEventScreenChange;
 
+typedef struct {
+    unsigned long long xid;
+} CtrlEventXidError;
+
 typedef struct {
     CtrlEventType  type;
     CtrlTargetType target_type;
@@ -484,6 +537,7 @@ typedef struct {
         CtrlEventStrAttribute str_attr;
         CtrlEventBinAttribute bin_attr;
         CtrlEventScreenChange screen_change;
+        CtrlEventXidError     xid_error;
     };
 
 } CtrlEvent;
@@ -605,10 +659,61 @@ typedef struct {
 
 
 
+/*
+ * Targets of different systems, and the targets of a system, may be used
+ * from several threads once NvCtrlInitThreads() was called; a single target
+ * must still only be used by one thread at a time.  NvCtrlInitThreads() must
+ * be called before any other Xlib call is made by the process.  The system
+ * list functions below are not thread safe.
+ */
+
+Bool NvCtrlInitThreads(void);
+
 CtrlSystem *NvCtrlConnectToSystem(const char *display, CtrlSystemList *systems);
+void        NvCtrlConnectToSystems(const char **displays, int count,
+                                   CtrlSystemList *systems);
 CtrlSystem *NvCtrlGetSystem      (const char *display, CtrlSystemList *systems);
 void        NvCtrlFreeAllSystems (CtrlSystemList *systems);
 
+ReturnStatus NvCtrlStartNvmlSampler(CtrlSystem *system,
+                                    unsigned int interval_ms);
+
+/*
+ * Caches the integer attribute values, and the attribute permissions and
+ * valid values, read from the targets of the system until events report them
+ * as changed.  Only enable this when the events of the system are processed
+ * through NvCtrlEventHandleNextEvent().
+ */
+
+void NvCtrlEnableAttributeCache(CtrlSystem *system);
+
+unsigned long NvCtrlGetMisroutesAvoided(const CtrlSystem *system);
+
+/*
+ * Call counts, payload bytes and latency histograms of the calls made into
+ * each backend, per backend and per attribute.
+ */
+
+typedef enum {
+    CTRL_STATS_FORMAT_TEXT = 0,
+    CTRL_STATS_FORMAT_JSON,
+} CtrlStatsFormat;
+
+void NvCtrlEnableStats(void);
+void NvCtrlPrintStats(FILE *stream, CtrlStatsFormat format);
+
+/*
+ * Records the calls made into the backends, their results and durations to
+ * a trace file, or answers them from such a trace instead of the backends,
+ * so that systems can be inspected without their GPUs or X server.  Either
+ * must be started before connecting to any system.
+ */
+
+Bool        NvCtrlStartTraceRecording(const char *filename);
+Bool        NvCtrlStartTraceReplay(const char *filename, Bool timing);
+void        NvCtrlStopTrace(void);
+const char *NvCtrlGetTraceDisplayName(void);
+
 
 int         NvCtrlGetTargetTypeCount    (const CtrlSystem *system,
                                          CtrlTargetType target_type);
@@ -714,6 +819,109 @@ ReturnStatus NvCtrlSetAttribute(CtrlTarget *ctrl_target, int attr, int val);
 ReturnStatus NvCtrlGetAttribute64(const CtrlTarget *ctrl_target,
                                   int attr, int64_t *val);
 
+/*
+ * NvCtrlGetAttributesBatch() - queries 'count' integer attributes of the
+ * target at once.  statuses[i] and vals[i] receive what
+ * NvCtrlGetAttribute64() would have returned for attrs[i]; attributes that
+ * NVML can report as field values are answered by a single NVML call, the
+ * others as by NvCtrlGetDisplayAttributesBatch().
+ */
+
+ReturnStatus NvCtrlGetAttributesBatch(const CtrlTarget *ctrl_target,
+                                      int count, const int *attrs,
+                                      int64_t *vals, ReturnStatus *statuses);
+
+/*
+ * NvCtrlGetDisplayAttributesBatch() - queries the integer attributes of
+ * 'count' (target, display_mask, attr) tuples, which may belong to
+ * different targets and systems.  Each query's val and status receive what
+ * NvCtrlGetDisplayAttribute64() would have returned.  The NV-CONTROL
+ * requests for all the queries of an X display are sent together, so that
+ * they cost a single round trip.
+ */
+
+typedef struct {
+    const CtrlTarget *target;
+    unsigned int display_mask;
+    int attr;
+    int64_t val;
+    ReturnStatus status;
+} CtrlAttributeQuery;
+
+ReturnStatus NvCtrlGetDisplayAttributesBatch(CtrlAttributeQuery *queries,
+                                             int count);
+
+/*
+ * NvCtrlGetStringAttributesBatch(), NvCtrlGetBinaryAttributesBatch() and
+ * NvCtrlQueryTargetCountsBatch() - the same as
+ * NvCtrlGetDisplayAttributesBatch(), for string attributes, binary data
+ * attributes and target counts: each query receives what
+ * NvCtrlGetStringDisplayAttribute(), NvCtrlGetBinaryAttribute() or
+ * NvCtrlQueryTargetCount() would have returned, and the NV-CONTROL requests
+ * of all the queries of an X display cost a single round trip.  The
+ * strings and data returned must be freed by the caller.  For target
+ * counts, 'target' is any target of the system to count the targets of.
+ */
+
+typedef struct {
+    const CtrlTarget *target;
+    unsigned int display_mask;
+    int attr;
+    char *str;
+    ReturnStatus status;
+} CtrlStringAttributeQuery;
+
+typedef struct {
+    const CtrlTarget *target;
+    unsigned int display_mask;
+    int attr;
+    unsigned char *data;
+    int len;
+    ReturnStatus status;
+} CtrlBinaryAttributeQuery;
+
+typedef struct {
+    const CtrlTarget *target;
+    CtrlTargetType target_type;
+    int val;
+    ReturnStatus status;
+} CtrlTargetCountQuery;
+
+ReturnStatus NvCtrlGetStringAttributesBatch(CtrlStringAttributeQuery *queries,
+                                            int count);
+ReturnStatus NvCtrlGetBinaryAttributesBatch(CtrlBinaryAttributeQuery *queries,
+                                            int count);
+ReturnStatus NvCtrlQueryTargetCountsBatch(CtrlTargetCountQuery *queries,
+                                          int count);
+
+/*
+ * NvCtrlGetAttributeAsync() and NvCtrlGetStringAttributeAsync() - query an
+ * attribute without waiting for the X server.  The callback receives what
+ * NvCtrlGetAttribute64() or NvCtrlGetStringAttribute() would have returned,
+ * and is only ever run from NvCtrlEventHandleDispatchReplies() on the event
+ * handle of the target's system.  A query that is still pending when it is
+ * asked for again (same target, attribute, callback and data) is not sent
+ * twice.  NvCtrlNotSupported is returned when the target has no X
+ * connection, in which case the attribute should be queried synchronously.
+ */
+
+typedef void (*CtrlAttributeCallback)(const CtrlTarget *ctrl_target,
+                                      int attr, ReturnStatus status,
+                                      int64_t val, void *data);
+
+typedef void (*CtrlStringAttributeCallback)(const CtrlTarget *ctrl_target,
+                                            int attr, ReturnStatus status,
+                                            const char *str, void *data);
+
+ReturnStatus NvCtrlGetAttributeAsync(const CtrlTarget *ctrl_target, int attr,
+                                     CtrlAttributeCallback callback,
+                                     void *data);
+
+ReturnStatus NvCtrlGetStringAttributeAsync(const CtrlTarget *ctrl_target,
+                                           int attr,
+                                           CtrlStringAttributeCallback callback,
+                                           void *data);
+
 
 /*
  * NvCtrlGetVoidAttribute() - this function works like the
@@ -805,6 +1013,40 @@ ReturnStatus NvCtrlGetBinaryAttribute(const CtrlTarget *ctrl_target,
                                       unsigned int display_mask, int attr,
                                       unsigned char **data, int *len);
 
+/*
+ * NvCtrlGetBinaryAttributeScratch() - Same as NvCtrlGetBinaryAttribute(), but
+ * the data is stored in a buffer owned by the target, which is reused by every
+ * call for that target rather than allocated for each query.  The data must
+ * not be freed, and is only valid until the next call for the same target;
+ * callers that poll binary attributes (e.g., on a timer) should use this.
+ * The target must not be queried this way from several threads at once.
+ */
+
+ReturnStatus NvCtrlGetBinaryAttributeScratch(CtrlTarget *ctrl_target,
+                                             unsigned int display_mask,
+                                             int attr,
+                                             const unsigned char **data,
+                                             int *len);
+
+/*
+ * NvCtrlGetGpuTelemetry() - Returns a snapshot of the dynamic state of the
+ * GPU backing the given GPU, thermal sensor or cooler target.  The snapshot
+ * is shared by every target of the same GPU, so pages refreshing at about
+ * the same time read the same values without additional NVML calls.
+ */
+
+ReturnStatus NvCtrlGetGpuTelemetry(const CtrlTarget *ctrl_target,
+                                   CtrlGpuTelemetry *telemetry);
+
+/*
+ * NvCtrlGetNvmlEventTypes() - Returns the NVML event types (nvmlEventType*
+ * bits) for which events are delivered through the event handle for the GPU
+ * of the given target, so that pages need not poll for those changes.
+ */
+
+ReturnStatus NvCtrlGetNvmlEventTypes(const CtrlTarget *ctrl_target,
+                                     unsigned long long *event_types);
+
 /*
  * NvCtrlStringOperation() - Performs the string operation associated
  * with the specified attribute, where valid values are the
@@ -846,6 +1088,15 @@ NvCtrlCloseEventHandle(NvCtrlEventHandle *handle);
 ReturnStatus
 NvCtrlEventHandleGetFD(NvCtrlEventHandle *handle, int *fd);
 
+/*
+ * NvCtrlEventHandleGetNvmlFD() - Get the file descriptor to poll for NVML
+ * events (ECC errors, clock changes and XID errors) delivered through the
+ * specified event handle, in addition to the one returned by
+ * NvCtrlEventHandleGetFD().
+ */
+ReturnStatus
+NvCtrlEventHandleGetNvmlFD(NvCtrlEventHandle *handle, int *fd);
+
 /*
  * NvCtrlEventHandlePending() - Check whether there are pending events or not in
  * the specified event handle.
@@ -860,6 +1111,34 @@ NvCtrlEventHandlePending(NvCtrlEventHandle *handle, Bool *pending);
 ReturnStatus
 NvCtrlEventHandleNextEvent(NvCtrlEventHandle *handle, CtrlEvent *event);
 
+/*
+ * NvCtrlEventHandleSetCoalescing() - Enable or disable event coalescing on the
+ * specified event handle.  When enabled, NvCtrlEventHandleNextEvent() reads
+ * all the pending events at once and only returns the latest event for each
+ * (target, attribute) and for each X screen change, so that a burst of updates
+ * is delivered as one event per distinct change.  XID errors are never
+ * coalesced.  Coalescing is disabled by default.
+ */
+ReturnStatus
+NvCtrlEventHandleSetCoalescing(NvCtrlEventHandle *handle, Bool enable);
+
+/*
+ * NvCtrlEventHandleGetDroppedEvents() - Get the number of events that event
+ * coalescing dropped from the specified event handle because a later event
+ * superseded them.
+ */
+ReturnStatus
+NvCtrlEventHandleGetDroppedEvents(NvCtrlEventHandle *handle,
+                                  unsigned long *count);
+
+/*
+ * NvCtrlEventHandleDispatchReplies() - Run the callbacks of the answered
+ * asynchronous queries of the system of the specified event handle.
+ * NvCtrlEventHandlePending() also reports answered queries as pending.
+ */
+ReturnStatus
+NvCtrlEventHandleDispatchReplies(NvCtrlEventHandle *handle);
+
 
 
 #endif /* __NVCTRL_ATTRIBUTES__ */
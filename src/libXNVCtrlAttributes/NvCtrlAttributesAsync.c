@@ -0,0 +1,437 @@
+/*
+ * nvidia-settings: A tool for configuring the NVIDIA X driver on Unix
+ * and Linux systems.
+ *
+ * Copyright (C) 2024 NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses>.
+ */
+
+/*
+ *  Asynchronous attribute queries
+ *
+ *  NvCtrlGetAttributeAsync() and NvCtrlGetStringAttributeAsync() send the
+ *  NV-CONTROL request of a query without waiting for its reply.  The reply
+ *  is picked up by libXNVCtrl whenever Xlib reads from the connection, which
+ *  the event source of the system does each time it checks for events, and
+ *  the callback of the query is then run from
+ *  NvCtrlEventHandleDispatchReplies().
+ *
+ *  Queries that do not need an X round trip (cached values, attributes
+ *  answered by NVML, ...) are answered right away, but their callbacks are
+ *  also only run from NvCtrlEventHandleDispatchReplies(), so that callers
+ *  never see a callback from within the call that queued it.
+ *
+ *  The queue of a system is not locked: asynchronous queries are meant to be
+ *  issued and dispatched from the thread running the event loop.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "NvCtrlAttributes.h"
+#include "NvCtrlAttributesPrivate.h"
+
+#include "NVCtrlLib.h"
+
+#include "common-utils.h"
+
+
+struct _CtrlAsyncQuery {
+    const CtrlTarget *ctrl_target;
+    int attr;
+    Bool string;
+    CtrlAttributeCallback callback;
+    CtrlStringAttributeCallback string_callback;
+    void *data;
+
+    XNVCTRLAsyncQueryRec *request; /* NULL once answered */
+    ReturnStatus status;
+    int64_t val;
+    char *str;
+
+    CtrlAsyncQuery *next;
+};
+
+
+
+/*
+ * Returns whether the given query is already queued on the system, in which
+ * case it is not sent again: a slow server then gets at most one request
+ * per query in flight, however often a timer asks for it.
+ */
+
+static Bool is_query_queued(const CtrlSystem *system,
+                            const CtrlAsyncQuery *query)
+{
+    const CtrlAsyncQuery *q;
+
+    for (q = system->async_queries; q; q = q->next) {
+        if ((q->ctrl_target == query->ctrl_target) &&
+            (q->attr == query->attr) &&
+            (q->string == query->string) &&
+            (q->callback == query->callback) &&
+            (q->string_callback == query->string_callback) &&
+            (q->data == query->data)) {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+
+
+static void queue_query(CtrlSystem *system, CtrlAsyncQuery *query)
+{
+    CtrlAsyncQuery **tail = &system->async_queries;
+
+    while (*tail) {
+        tail = &(*tail)->next;
+    }
+    *tail = query;
+}
+
+
+
+/*
+ * Returns whether the NV-CONTROL request for the given attribute can be sent
+ * asynchronously: this mirrors the routing of NvCtrlGetDisplayAttribute64()
+ * and NvCtrlGetStringDisplayAttribute().
+ */
+
+static Bool use_async_request(const NvCtrlAttributePrivateHandle *h,
+                              CtrlAttributeType attr_type, int attr)
+{
+    int last;
+
+    if (!h->nv) {
+        return FALSE;
+    }
+
+    if (attr_type == CTRL_ATTRIBUTE_TYPE_INTEGER) {
+        last = NV_CTRL_LAST_ATTRIBUTE;
+    } else {
+        last = NV_CTRL_STRING_LAST_ATTRIBUTE;
+
+        /* Answered locally, see NvCtrlNvControlGetStringAttribute() */
+        if (attr == NV_CTRL_STRING_NV_CONTROL_VERSION) {
+            return FALSE;
+        }
+    }
+
+    if ((attr < 0) || (attr > last)) {
+        return FALSE;
+    }
+
+    if (TARGET_TYPE_IS_NVML_COMPATIBLE(h->target_type) &&
+        NvCtrlNvmlRoutesAttribute(h, attr_type, attr)) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+
+
+static ReturnStatus get_attribute_async(const CtrlTarget *ctrl_target,
+                                        int attr, Bool string,
+                                        CtrlAttributeCallback callback,
+                                        CtrlStringAttributeCallback
+                                            string_callback,
+                                        void *data)
+{
+    const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
+    CtrlAttributeType attr_type;
+    const CtrlTargetTypeInfo *targetTypeInfo;
+    CtrlAsyncQuery *query;
+
+    if (h == NULL) {
+        return NvCtrlBadHandle;
+    }
+
+    if (!h->system || !h->dpy) {
+        /* Nothing would dispatch the replies */
+        return NvCtrlNotSupported;
+    }
+
+    query = nvalloc(sizeof(CtrlAsyncQuery));
+    query->ctrl_target = ctrl_target;
+    query->attr = attr;
+    query->string = string;
+    query->callback = callback;
+    query->string_callback = string_callback;
+    query->data = data;
+
+    if (is_query_queued(h->system, query)) {
+        nvfree(query);
+        return NvCtrlSuccess;
+    }
+
+    attr_type = string ? CTRL_ATTRIBUTE_TYPE_STRING :
+                         CTRL_ATTRIBUTE_TYPE_INTEGER;
+    targetTypeInfo = NvCtrlGetTargetTypeInfo(h->target_type);
+
+    if (!string && NvCtrlAttributeCacheLookup(ctrl_target, 0, attr,
+                                              &query->val)) {
+        query->status = NvCtrlSuccess;
+        NvCtrlTraceRecord(h, NV_CTRL_TRACE_GET, 0, attr, NvCtrlSuccess,
+                          &query->val, sizeof(query->val), 0);
+        queue_query(h->system, query);
+        return NvCtrlSuccess;
+    }
+
+    if (targetTypeInfo && use_async_request(h, attr_type, attr)) {
+        if (string) {
+            query->request =
+                XNVCTRLQueryTargetStringAttributeAsync(h->dpy,
+                                                       targetTypeInfo->nvctrl,
+                                                       h->target_id, 0, attr);
+        } else {
+            query->request =
+                XNVCTRLQueryTargetAttribute64Async(h->dpy,
+                                                   targetTypeInfo->nvctrl,
+                                                   h->target_id, 0, attr);
+        }
+    }
+
+    if (query->request) {
+        XFlush(h->dpy);
+    } else if (string) {
+        query->status = NvCtrlGetStringAttribute(ctrl_target, attr,
+                                                 &query->str);
+    } else {
+        query->status = NvCtrlGetAttribute64(ctrl_target, attr, &query->val);
+    }
+
+    queue_query(h->system, query);
+
+    return NvCtrlSuccess;
+}
+
+
+
+/*!
+ * Queries an integer attribute without waiting for the X server.
+ *
+ * \param[in]  ctrl_target  The target to query.
+ * \param[in]  attr         The NV-CONTROL attribute to query.
+ * \param[in]  callback     Called with what NvCtrlGetAttribute64() would have
+ *                          returned, from NvCtrlEventHandleDispatchReplies().
+ * \param[in]  data         Passed to the callback.
+ *
+ * \return  NvCtrlSuccess if the query was queued, or NvCtrlNotSupported if
+ *          the target has no X connection to deliver the reply through, in
+ *          which case the attribute should be queried synchronously.
+ */
+
+ReturnStatus NvCtrlGetAttributeAsync(const CtrlTarget *ctrl_target, int attr,
+                                     CtrlAttributeCallback callback,
+                                     void *data)
+{
+    if (!callback) {
+        return NvCtrlBadArgument;
+    }
+
+    return get_attribute_async(ctrl_target, attr, FALSE, callback, NULL, data);
+}
+
+
+
+/*!
+ * Queries a string attribute without waiting for the X server; see
+ * NvCtrlGetAttributeAsync().  The string given to the callback is freed
+ * once the callback returns.
+ */
+
+ReturnStatus NvCtrlGetStringAttributeAsync(const CtrlTarget *ctrl_target,
+                                           int attr,
+                                           CtrlStringAttributeCallback callback,
+                                           void *data)
+{
+    if (!callback) {
+        return NvCtrlBadArgument;
+    }
+
+    return get_attribute_async(ctrl_target, attr, TRUE, NULL, callback, data);
+}
+
+
+
+/*
+ * Collects the reply of the given query, if it has arrived.  Returns whether
+ * the query is answered.
+ */
+
+static Bool complete_query(const CtrlSystem *system, CtrlAsyncQuery *query)
+{
+    if (!query->request) {
+        return TRUE;
+    }
+
+    if (!XNVCTRLAsyncQueryDone(system->dpy, query->request)) {
+        return FALSE;
+    }
+
+    if (query->string) {
+        char *tmp;
+
+        if (XNVCTRLAsyncQueryStringAttribute(query->request, &tmp)) {
+            query->str = strdup(tmp);
+            XFree(tmp);
+            query->status = NvCtrlSuccess;
+        } else {
+            query->status = NvCtrlAttributeNotAvailable;
+        }
+    } else {
+        if (XNVCTRLAsyncQueryAttribute64(query->request, &query->val)) {
+            query->status = NvCtrlSuccess;
+            NvCtrlAttributeCacheStore(query->ctrl_target, 0, query->attr,
+                                      query->val);
+        } else {
+            query->status = NvCtrlAttributeNotAvailable;
+        }
+    }
+
+    /*
+     * Traced as the synchronous query replays will make instead; the round
+     * trip overlapped other work, so it took no time of its own.
+     */
+    if (query->string) {
+        NvCtrlTraceRecord(getPrivateHandleConst(query->ctrl_target),
+                          NV_CTRL_TRACE_GET_STRING, 0, query->attr,
+                          query->status, query->str,
+                          query->str ? strlen(query->str) + 1 : 0, 0);
+    } else {
+        NvCtrlTraceRecord(getPrivateHandleConst(query->ctrl_target),
+                          NV_CTRL_TRACE_GET, 0, query->attr, query->status,
+                          &query->val, sizeof(query->val), 0);
+    }
+
+    XNVCTRLFreeAsyncQuery(system->dpy, query->request);
+    query->request = NULL;
+
+    return TRUE;
+}
+
+
+
+static void free_query(const CtrlSystem *system, CtrlAsyncQuery *query)
+{
+    if (query->request) {
+        XNVCTRLFreeAsyncQuery(system->dpy, query->request);
+    }
+    free(query->str);
+    nvfree(query);
+}
+
+
+
+/*
+ * Returns whether any query of the system is answered and waiting for
+ * its callback to be run.
+ */
+
+Bool NvCtrlAsyncRepliesPending(const CtrlSystem *system)
+{
+    CtrlAsyncQuery *query;
+
+    if (!system) {
+        return FALSE;
+    }
+
+    for (query = system->async_queries; query; query = query->next) {
+        if (complete_query(system, query)) {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+
+
+/*!
+ * Runs the callbacks of the asynchronous queries of the event handle's
+ * system that are answered.
+ *
+ * \param[in]  handle  The event handle of the system.
+ *
+ * \return  NvCtrlSuccess, or NvCtrlBadArgument if the handle is invalid.
+ */
+
+ReturnStatus NvCtrlEventHandleDispatchReplies(NvCtrlEventHandle *handle)
+{
+    NvCtrlEventPrivateHandle *evt_h = (NvCtrlEventPrivateHandle *) handle;
+    CtrlSystem *system;
+    CtrlAsyncQuery *answered = NULL, **tail = &answered;
+    CtrlAsyncQuery **prev, *query;
+
+    if (!evt_h) {
+        return NvCtrlBadArgument;
+    }
+
+    system = evt_h->system;
+    if (!system) {
+        return NvCtrlSuccess;
+    }
+
+    /*
+     * Unlink the answered queries first: the callbacks may queue new ones,
+     * including the same query again.
+     */
+    prev = &system->async_queries;
+    while ((query = *prev)) {
+        if (complete_query(system, query)) {
+            *prev = query->next;
+            query->next = NULL;
+            *tail = query;
+            tail = &query->next;
+        } else {
+            prev = &query->next;
+        }
+    }
+
+    while ((query = answered)) {
+        answered = query->next;
+
+        if (query->string) {
+            query->string_callback(query->ctrl_target, query->attr,
+                                   query->status, query->str, query->data);
+        } else {
+            query->callback(query->ctrl_target, query->attr,
+                            query->status, query->val, query->data);
+        }
+
+        free_query(system, query);
+    }
+
+    return NvCtrlSuccess;
+}
+
+
+
+/*
+ * Drops the pending queries of the system without running their callbacks.
+ * This must be done before the X connection of the system is closed.
+ */
+
+void NvCtrlFreeAsyncQueries(CtrlSystem *system)
+{
+    while (system->async_queries) {
+        CtrlAsyncQuery *query = system->async_queries;
+
+        system->async_queries = query->next;
+        free_query(system, query);
+    }
+}
@@ -0,0 +1,759 @@
+/*
+ * nvidia-settings: A tool for configuring the NVIDIA X driver on Unix
+ * and Linux systems.
+ *
+ * Copyright (C) 2024 NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses>.
+ */
+
+/*
+ *  Integer attribute value cache
+ *
+ *  Once enabled for a system with NvCtrlEnableAttributeCache(), the integer
+ *  attribute values read through NvCtrlGetDisplayAttribute64() are kept per
+ *  target, keyed by (attribute, display mask), so that repeated reads of the
+ *  same attribute do not each cost an X or NVML round trip.
+ *
+ *  Cached values stay valid until the attribute is reported as changed by an
+ *  event (see NvCtrlEventHandleNextEvent()) or the target is written to
+ *  through this library.  Telemetry-like attributes that change without
+ *  events are only cached for a short time, or not at all; see
+ *  attributeTTLs[] below, which must list every attribute polled by
+ *  the GUI.  Callers enabling the cache are expected to process the events
+ *  of the system, as the GUI does.
+ *
+ *  The permissions and valid values of attributes (their "info") are kept
+ *  alongside, including negative answers, as they only change on mode sets,
+ *  availability changes and a few specific attribute changes.
+ *
+ *  Each cache has its own lock, so that targets can be queried from several
+ *  threads; it is never held across a call into a backend.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "NvCtrlAttributes.h"
+#include "NvCtrlAttributesPrivate.h"
+
+#include "common-utils.h"
+
+
+/* Lifetime, in milliseconds, of attributes that are not covered by events */
+
+#define TTL_NEVER     0
+#define TTL_VOLATILE  250
+
+static const struct {
+    int attr;
+    unsigned int ttl_ms;
+} attributeTTLs[] = {
+
+    /* Reading these has side effects, or they are polled for status */
+    { NV_CTRL_PROBE_DISPLAYS,                       TTL_NEVER },
+    { NV_CTRL_FRAMELOCK_PORT0_STATUS,               TTL_NEVER },
+    { NV_CTRL_FRAMELOCK_PORT1_STATUS,               TTL_NEVER },
+    { NV_CTRL_FRAMELOCK_HOUSE_STATUS,               TTL_NEVER },
+    { NV_CTRL_FRAMELOCK_SYNC_READY,                 TTL_NEVER },
+    { NV_CTRL_FRAMELOCK_ETHERNET_DETECTED,          TTL_NEVER },
+    { NV_CTRL_FRAMELOCK_SYNC_RATE,                  TTL_NEVER },
+    { NV_CTRL_FRAMELOCK_SYNC_RATE_4,                TTL_NEVER },
+    { NV_CTRL_FRAMELOCK_TIMING,                     TTL_NEVER },
+    { NV_CTRL_FRAMELOCK_INCOMING_HOUSE_SYNC_RATE,   TTL_NEVER },
+
+    /*
+     * Polled by the GUI on timers, as they may be changed without an event
+     * being sent, e.g. by non NV-CONTROL clients
+     */
+    { NV_CTRL_GPU_ECC_CONFIGURATION,                TTL_NEVER },
+    { NV_CTRL_FRAMELOCK_STEREO_SYNC,                TTL_NEVER },
+    { NV_CTRL_STEREO,                               TTL_NEVER },
+    { NV_CTRL_FRAMELOCK_SYNC_DELAY,                 TTL_NEVER },
+    { NV_CTRL_FRAMELOCK_SYNC_INTERVAL,              TTL_NEVER },
+    { NV_CTRL_FRAMELOCK_POLARITY,                   TTL_NEVER },
+    { NV_CTRL_FRAMELOCK_VIDEO_MODE,                 TTL_NEVER },
+    { NV_CTRL_USE_HOUSE_SYNC,                       TTL_NEVER },
+    { NV_CTRL_GPU_POWER_MIZER_MODE,                 TTL_NEVER },
+    { NV_CTRL_GPU_POWER_MIZER_DEFAULT_MODE,         TTL_NEVER },
+    { NV_CTRL_THERMAL_COOLER_CONTROL_TYPE,          TTL_NEVER },
+    { NV_CTRL_THERMAL_COOLER_TARGET,                TTL_NEVER },
+    { NV_CTRL_THERMAL_COOLER_LEVEL,                 TTL_NEVER },
+
+    /* Telemetry */
+    { NV_CTRL_GPU_CORE_TEMPERATURE,                 TTL_VOLATILE },
+    { NV_CTRL_AMBIENT_TEMPERATURE,                  TTL_VOLATILE },
+    { NV_CTRL_THERMAL_SENSOR_READING,               TTL_VOLATILE },
+    { NV_CTRL_GPU_CURRENT_CLOCK_FREQS,              TTL_VOLATILE },
+    { NV_CTRL_GPU_CURRENT_PROCESSOR_CLOCK_FREQS,    TTL_VOLATILE },
+    { NV_CTRL_GPU_CURRENT_PERFORMANCE_LEVEL,        TTL_VOLATILE },
+    { NV_CTRL_GPU_ADAPTIVE_CLOCK_STATE,             TTL_VOLATILE },
+    { NV_CTRL_GPU_CURRENT_CORE_VOLTAGE,             TTL_VOLATILE },
+    { NV_CTRL_GPU_PCIE_CURRENT_LINK_WIDTH,          TTL_VOLATILE },
+    { NV_CTRL_GPU_PCIE_CURRENT_LINK_SPEED,          TTL_VOLATILE },
+    { NV_CTRL_GPU_POWER_SOURCE,                     TTL_VOLATILE },
+    { NV_CTRL_PLATFORM_CURRENT_POWER_MODE,          TTL_VOLATILE },
+    { NV_CTRL_USED_DEDICATED_GPU_MEMORY,            TTL_VOLATILE },
+    { NV_CTRL_VIDEO_ENCODER_UTILIZATION,            TTL_VOLATILE },
+    { NV_CTRL_VIDEO_DECODER_UTILIZATION,            TTL_VOLATILE },
+    { NV_CTRL_THERMAL_COOLER_SPEED,                 TTL_VOLATILE },
+    { NV_CTRL_THERMAL_COOLER_CURRENT_LEVEL,         TTL_VOLATILE },
+    { NV_CTRL_NUM_GPU_ERRORS_RECOVERED,             TTL_VOLATILE },
+    { NV_CTRL_GPU_ECC_SINGLE_BIT_ERRORS,            TTL_VOLATILE },
+    { NV_CTRL_GPU_ECC_DOUBLE_BIT_ERRORS,            TTL_VOLATILE },
+    { NV_CTRL_GPU_ECC_AGGREGATE_SINGLE_BIT_ERRORS,  TTL_VOLATILE },
+    { NV_CTRL_GPU_ECC_AGGREGATE_DOUBLE_BIT_ERRORS,  TTL_VOLATILE },
+    { NV_CTRL_3D_VISION_PRO_GLASSES_BATTERY_LEVEL,  TTL_VOLATILE },
+};
+
+typedef struct {
+    int attr;
+    unsigned int display_mask;
+    int64_t value;
+    Bool expires;
+    uint64_t expires_ms;           /* CLOCK_MONOTONIC */
+} CtrlAttributeCacheEntry;
+
+/*
+ * Attributes whose changes may alter the permissions or valid values of
+ * other attributes, possibly on other targets.
+ */
+
+static const int infoChangingAttributes[] = {
+    NV_CTRL_GPU_COOLER_MANUAL_CONTROL,
+};
+
+typedef enum {
+    CACHE_INFO_PERMS,
+    CACHE_INFO_VALID_VALUES,
+} CtrlAttributeInfoKind;
+
+typedef struct {
+    CtrlAttributeInfoKind kind;
+    CtrlAttributeType attr_type;
+    int attr;
+    unsigned int display_mask;
+    ReturnStatus status;
+    union {
+        CtrlAttributePerms perms;
+        CtrlAttributeValidValues valid;
+    };
+} CtrlAttributeInfoEntry;
+
+struct _CtrlAttributeCache {
+    pthread_mutex_t lock;
+
+    int count;
+    int size;
+    CtrlAttributeCacheEntry *entries;
+
+    int infoCount;
+    int infoSize;
+    CtrlAttributeInfoEntry *info;
+};
+
+
+
+static uint64_t get_time_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t)ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+}
+
+
+
+/*
+ * Returns whether 'attr' may be cached at all and, in 'ttl_ms', for how long
+ * (0 meaning until invalidated).
+ */
+
+static Bool get_attribute_ttl(int attr, unsigned int *ttl_ms)
+{
+    int i;
+
+    for (i = 0; i < ARRAY_LEN(attributeTTLs); i++) {
+        if (attributeTTLs[i].attr == attr) {
+            *ttl_ms = attributeTTLs[i].ttl_ms;
+            return (*ttl_ms != TTL_NEVER);
+        }
+    }
+
+    *ttl_ms = 0;
+    return TRUE;
+}
+
+
+
+static CtrlAttributeCacheEntry *find_entry(const CtrlAttributeCache *cache,
+                                           unsigned int display_mask, int attr)
+{
+    int i;
+
+    for (i = 0; i < cache->count; i++) {
+        if ((cache->entries[i].attr == attr) &&
+            (cache->entries[i].display_mask == display_mask)) {
+            return &cache->entries[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+
+static void remove_entry(CtrlAttributeCache *cache,
+                         CtrlAttributeCacheEntry *entry)
+{
+    /* Order does not matter; move the last entry into the hole */
+    *entry = cache->entries[cache->count - 1];
+    cache->count--;
+}
+
+
+
+CtrlAttributeCache *NvCtrlAttributeCacheNew(void)
+{
+    CtrlAttributeCache *cache = nvalloc(sizeof(CtrlAttributeCache));
+
+    pthread_mutex_init(&cache->lock, NULL);
+
+    return cache;
+}
+
+
+
+void NvCtrlAttributeCacheFree(CtrlAttributeCache *cache)
+{
+    if (cache == NULL) {
+        return;
+    }
+
+    pthread_mutex_destroy(&cache->lock);
+    nvfree(cache->entries);
+    nvfree(cache->info);
+    nvfree(cache);
+}
+
+
+
+/*
+ * Looks up the cached value of 'attr' for the given target.  Returns TRUE
+ * and sets 'val' on a hit; expired entries are dropped.
+ */
+
+Bool NvCtrlAttributeCacheLookup(const CtrlTarget *ctrl_target,
+                                unsigned int display_mask, int attr,
+                                int64_t *val)
+{
+    CtrlAttributeCache *cache;
+    CtrlAttributeCacheEntry *entry;
+    Bool hit = FALSE;
+
+    if ((ctrl_target == NULL) || (ctrl_target->attr_cache == NULL)) {
+        return FALSE;
+    }
+
+    cache = ctrl_target->attr_cache;
+
+    pthread_mutex_lock(&cache->lock);
+
+    entry = find_entry(cache, display_mask, attr);
+    if (entry != NULL) {
+        if (entry->expires && (get_time_ms() >= entry->expires_ms)) {
+            remove_entry(cache, entry);
+        } else {
+            *val = entry->value;
+            hit = TRUE;
+        }
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+
+    return hit;
+}
+
+
+
+/*
+ * Records the value of 'attr' that was just read for the given target.
+ */
+
+void NvCtrlAttributeCacheStore(const CtrlTarget *ctrl_target,
+                               unsigned int display_mask, int attr,
+                               int64_t val)
+{
+    CtrlAttributeCache *cache;
+    CtrlAttributeCacheEntry *entry;
+    unsigned int ttl_ms;
+
+    if ((ctrl_target == NULL) || (ctrl_target->attr_cache == NULL)) {
+        return;
+    }
+
+    if (!get_attribute_ttl(attr, &ttl_ms)) {
+        return;
+    }
+
+    cache = ctrl_target->attr_cache;
+
+    pthread_mutex_lock(&cache->lock);
+
+    entry = find_entry(cache, display_mask, attr);
+    if (entry == NULL) {
+        if (cache->count == cache->size) {
+            cache->size = (cache->size == 0) ? 32 : (cache->size * 2);
+            cache->entries = nvrealloc(cache->entries,
+                                       cache->size * sizeof(*cache->entries));
+        }
+        entry = &cache->entries[cache->count++];
+        entry->attr = attr;
+        entry->display_mask = display_mask;
+    }
+
+    entry->value = val;
+    entry->expires = (ttl_ms != 0);
+    entry->expires_ms = entry->expires ? (get_time_ms() + ttl_ms) : 0;
+
+    pthread_mutex_unlock(&cache->lock);
+}
+
+
+
+static CtrlAttributeInfoEntry *find_info(const CtrlAttributeCache *cache,
+                                         CtrlAttributeInfoKind kind,
+                                         CtrlAttributeType attr_type,
+                                         unsigned int display_mask, int attr)
+{
+    int i;
+
+    for (i = 0; i < cache->infoCount; i++) {
+        const CtrlAttributeInfoEntry *info = &cache->info[i];
+
+        if ((info->attr == attr) && (info->kind == kind) &&
+            (info->attr_type == attr_type) &&
+            (info->display_mask == display_mask)) {
+            return &cache->info[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+
+/*
+ * Only answers that depend on the attribute itself are worth keeping; any
+ * other failure is reported again the next time.
+ */
+
+static Bool is_info_status_cacheable(ReturnStatus status)
+{
+    switch (status) {
+        case NvCtrlSuccess:
+        case NvCtrlNoAttribute:
+        case NvCtrlNotSupported:
+        case NvCtrlAttributeNotAvailable:
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+
+
+/*
+ * Returns the info entry to fill in for the given query, or NULL if its
+ * answer is not to be cached.  Must be called with the cache locked.
+ */
+
+static CtrlAttributeInfoEntry *store_info(const CtrlTarget *ctrl_target,
+                                          CtrlAttributeInfoKind kind,
+                                          CtrlAttributeType attr_type,
+                                          unsigned int display_mask, int attr,
+                                          ReturnStatus status)
+{
+    CtrlAttributeCache *cache;
+    CtrlAttributeInfoEntry *info;
+
+    if (!is_info_status_cacheable(status)) {
+        return NULL;
+    }
+
+    cache = ctrl_target->attr_cache;
+
+    info = find_info(cache, kind, attr_type, display_mask, attr);
+    if (info == NULL) {
+        if (cache->infoCount == cache->infoSize) {
+            cache->infoSize = (cache->infoSize == 0) ? 64 :
+                              (cache->infoSize * 2);
+            cache->info = nvrealloc(cache->info,
+                                    cache->infoSize * sizeof(*cache->info));
+        }
+        info = &cache->info[cache->infoCount++];
+        memset(info, 0, sizeof(*info));
+        info->kind = kind;
+        info->attr_type = attr_type;
+        info->attr = attr;
+        info->display_mask = display_mask;
+    }
+
+    info->status = status;
+
+    return info;
+}
+
+
+
+/*
+ * Looks up the cached permissions of 'attr'.  Returns TRUE on a hit, with
+ * the status of the original query in 'status' and, if that was a success,
+ * the permissions in 'perms'.
+ */
+
+Bool NvCtrlAttributeCacheLookupPerms(const CtrlTarget *ctrl_target,
+                                     CtrlAttributeType attr_type, int attr,
+                                     CtrlAttributePerms *perms,
+                                     ReturnStatus *status)
+{
+    CtrlAttributeCache *cache;
+    const CtrlAttributeInfoEntry *info;
+
+    if ((ctrl_target == NULL) || (ctrl_target->attr_cache == NULL)) {
+        return FALSE;
+    }
+
+    cache = ctrl_target->attr_cache;
+
+    pthread_mutex_lock(&cache->lock);
+
+    info = find_info(cache, CACHE_INFO_PERMS, attr_type, 0, attr);
+    if (info != NULL) {
+        *status = info->status;
+        if (info->status == NvCtrlSuccess) {
+            *perms = info->perms;
+        }
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+
+    return (info != NULL);
+}
+
+
+
+void NvCtrlAttributeCacheStorePerms(const CtrlTarget *ctrl_target,
+                                    CtrlAttributeType attr_type, int attr,
+                                    const CtrlAttributePerms *perms,
+                                    ReturnStatus status)
+{
+    CtrlAttributeInfoEntry *info;
+
+    if ((ctrl_target == NULL) || (ctrl_target->attr_cache == NULL)) {
+        return;
+    }
+
+    pthread_mutex_lock(&ctrl_target->attr_cache->lock);
+
+    info = store_info(ctrl_target, CACHE_INFO_PERMS, attr_type, 0, attr,
+                      status);
+    if ((info != NULL) && (status == NvCtrlSuccess)) {
+        info->perms = *perms;
+    }
+
+    pthread_mutex_unlock(&ctrl_target->attr_cache->lock);
+}
+
+
+
+/*
+ * Same as NvCtrlAttributeCacheLookupPerms(), for the valid values of integer
+ * ('attr_type' CTRL_ATTRIBUTE_TYPE_INTEGER) or string attributes.
+ */
+
+Bool NvCtrlAttributeCacheLookupValidValues(const CtrlTarget *ctrl_target,
+                                           CtrlAttributeType attr_type,
+                                           unsigned int display_mask,
+                                           int attr,
+                                           CtrlAttributeValidValues *val,
+                                           ReturnStatus *status)
+{
+    CtrlAttributeCache *cache;
+    const CtrlAttributeInfoEntry *info;
+
+    if ((ctrl_target == NULL) || (ctrl_target->attr_cache == NULL)) {
+        return FALSE;
+    }
+
+    cache = ctrl_target->attr_cache;
+
+    pthread_mutex_lock(&cache->lock);
+
+    info = find_info(cache, CACHE_INFO_VALID_VALUES, attr_type, display_mask,
+                     attr);
+    if (info != NULL) {
+        *status = info->status;
+        if (info->status == NvCtrlSuccess) {
+            *val = info->valid;
+        }
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+
+    return (info != NULL);
+}
+
+
+
+void NvCtrlAttributeCacheStoreValidValues(const CtrlTarget *ctrl_target,
+                                          CtrlAttributeType attr_type,
+                                          unsigned int display_mask, int attr,
+                                          const CtrlAttributeValidValues *val,
+                                          ReturnStatus status)
+{
+    CtrlAttributeInfoEntry *info;
+
+    if ((ctrl_target == NULL) || (ctrl_target->attr_cache == NULL)) {
+        return;
+    }
+
+    pthread_mutex_lock(&ctrl_target->attr_cache->lock);
+
+    info = store_info(ctrl_target, CACHE_INFO_VALID_VALUES, attr_type,
+                      display_mask, attr, status);
+    if ((info != NULL) && (status == NvCtrlSuccess)) {
+        info->valid = *val;
+    }
+
+    pthread_mutex_unlock(&ctrl_target->attr_cache->lock);
+}
+
+
+
+/*
+ * Drops the cached permissions and valid values of the given target.
+ */
+
+static void flush_info(const CtrlTarget *ctrl_target)
+{
+    if ((ctrl_target == NULL) || (ctrl_target->attr_cache == NULL)) {
+        return;
+    }
+
+    pthread_mutex_lock(&ctrl_target->attr_cache->lock);
+    ctrl_target->attr_cache->infoCount = 0;
+    pthread_mutex_unlock(&ctrl_target->attr_cache->lock);
+}
+
+
+
+/*
+ * Drops the cached permissions and valid values of every target of the given
+ * system.
+ */
+
+void NvCtrlAttributeCacheFlushInfo(const CtrlSystem *system)
+{
+    CtrlTargetNode *node;
+    int i;
+
+    if (system == NULL) {
+        return;
+    }
+
+    for (i = 0; i < MAX_TARGET_TYPES; i++) {
+        for (node = system->targets[i]; node; node = node->next) {
+            flush_info(node->t);
+        }
+    }
+}
+
+
+
+static Bool is_info_changing_attribute(int attr)
+{
+    int i;
+
+    if ((attr >= NV_CTRL_ATTR_NV_BASE) &&
+        (attr <= NV_CTRL_ATTR_NV_LAST_ATTRIBUTE)) {
+        return TRUE;
+    }
+
+    for (i = 0; i < ARRAY_LEN(infoChangingAttributes); i++) {
+        if (infoChangingAttributes[i] == attr) {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+
+
+/*
+ * Drops the cached values and integer attribute info of 'attr' (for any
+ * display mask) of the given target.
+ */
+
+void NvCtrlAttributeCacheInvalidate(const CtrlTarget *ctrl_target, int attr)
+{
+    CtrlAttributeCache *cache;
+    int i;
+
+    if ((ctrl_target == NULL) || (ctrl_target->attr_cache == NULL)) {
+        return;
+    }
+
+    cache = ctrl_target->attr_cache;
+
+    pthread_mutex_lock(&cache->lock);
+
+    for (i = cache->count - 1; i >= 0; i--) {
+        if (cache->entries[i].attr == attr) {
+            remove_entry(cache, &cache->entries[i]);
+        }
+    }
+
+    for (i = cache->infoCount - 1; i >= 0; i--) {
+        if ((cache->info[i].attr == attr) &&
+            (cache->info[i].attr_type == CTRL_ATTRIBUTE_TYPE_INTEGER)) {
+            cache->info[i] = cache->info[cache->infoCount - 1];
+            cache->infoCount--;
+        }
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+}
+
+
+
+/*
+ * Drops all the cached values of the given target.
+ */
+
+void NvCtrlAttributeCacheFlush(const CtrlTarget *ctrl_target)
+{
+    if ((ctrl_target == NULL) || (ctrl_target->attr_cache == NULL)) {
+        return;
+    }
+
+    pthread_mutex_lock(&ctrl_target->attr_cache->lock);
+    ctrl_target->attr_cache->count = 0;
+    pthread_mutex_unlock(&ctrl_target->attr_cache->lock);
+}
+
+
+
+/*
+ * Drops all the cached values, permissions and valid values of every target
+ * of the given system.
+ */
+
+void NvCtrlAttributeCacheFlushSystem(const CtrlSystem *system)
+{
+    CtrlTargetNode *node;
+    int i;
+
+    if (system == NULL) {
+        return;
+    }
+
+    for (i = 0; i < MAX_TARGET_TYPES; i++) {
+        for (node = system->targets[i]; node; node = node->next) {
+            NvCtrlAttributeCacheFlush(node->t);
+            flush_info(node->t);
+        }
+    }
+}
+
+
+
+/*
+ * Keeps the cache of the system coherent with the event that was just
+ * received on it.
+ */
+
+void NvCtrlAttributeCacheHandleEvent(const CtrlSystem *system,
+                                     const CtrlEvent *event)
+{
+    const CtrlTarget *ctrl_target;
+
+    if ((system == NULL) || !system->cache_attributes) {
+        return;
+    }
+
+    switch (event->type) {
+        case CTRL_EVENT_TYPE_INTEGER_ATTRIBUTE:
+            ctrl_target = NvCtrlGetTarget(system, event->target_type,
+                                          event->target_id);
+            if (event->int_attr.is_availability_changed) {
+                NvCtrlAttributeCacheFlush(ctrl_target);
+                flush_info(ctrl_target);
+            } else {
+                NvCtrlAttributeCacheInvalidate(ctrl_target,
+                                               event->int_attr.attribute);
+            }
+            if (is_info_changing_attribute(event->int_attr.attribute)) {
+                NvCtrlAttributeCacheFlushInfo(system);
+            }
+            break;
+
+        case CTRL_EVENT_TYPE_STRING_ATTRIBUTE:
+        case CTRL_EVENT_TYPE_BINARY_ATTRIBUTE:
+            /*
+             * String and binary attributes are not cached, but changing them
+             * may change integer attributes of the same target.
+             */
+            ctrl_target = NvCtrlGetTarget(system, event->target_type,
+                                          event->target_id);
+            NvCtrlAttributeCacheFlush(ctrl_target);
+            break;
+
+        case CTRL_EVENT_TYPE_SCREEN_CHANGE:
+            /* Mode sets affect the displays and screens of every GPU */
+            NvCtrlAttributeCacheFlushSystem(system);
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+
+/*
+ * Enables the attribute value and info cache for all the targets of the
+ * system, including targets added later on.
+ */
+
+void NvCtrlEnableAttributeCache(CtrlSystem *system)
+{
+    CtrlTargetNode *node;
+    int i;
+
+    if ((system == NULL) || system->cache_attributes) {
+        return;
+    }
+
+    system->cache_attributes = TRUE;
+
+    for (i = 0; i < MAX_TARGET_TYPES; i++) {
+        for (node = system->targets[i]; node; node = node->next) {
+            node->t->attr_cache = NvCtrlAttributeCacheNew();
+        }
+    }
+}
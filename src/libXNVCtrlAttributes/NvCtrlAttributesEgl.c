@@ -62,6 +62,9 @@ typedef struct __libEGLInfoRec {
 
 static __libEGLInfo *__libEGL = NULL;
 
+/* protects the library table and its reference count */
+static pthread_mutex_t __libEGLLock = PTHREAD_MUTEX_INITIALIZER;
+
 
 
 /****
@@ -97,6 +100,8 @@ static Bool open_libegl(void)
     const char *error_str = NULL;
 
 
+    pthread_mutex_lock(&__libEGLLock);
+
     /* Initialize bookkeeping structure */
     if ( !__libEGL ) {
         __libEGL = nvalloc(sizeof(__libEGLInfo));
@@ -106,6 +111,7 @@ static Bool open_libegl(void)
     /* Library was already opened */
     if ( __libEGL->handle ) {
         __libEGL->ref_count++;
+        pthread_mutex_unlock(&__libEGLLock);
         return True;
     }
 
@@ -147,6 +153,8 @@ static Bool open_libegl(void)
     /* Up the ref count */
     __libEGL->ref_count++;
 
+    pthread_mutex_unlock(&__libEGLLock);
+
     return True;
 
 
@@ -163,6 +171,7 @@ static Bool open_libegl(void)
         free(__libEGL);
         __libEGL = NULL;
     }
+    pthread_mutex_unlock(&__libEGLLock);
     return False;
 
 } /* open_libegl() */
@@ -177,6 +186,8 @@ static Bool open_libegl(void)
 
 static void close_libegl(void)
 {
+    pthread_mutex_lock(&__libEGLLock);
+
     if ( __libEGL && __libEGL->handle && __libEGL->ref_count ) {
         __libEGL->ref_count--;
         if ( __libEGL->ref_count == 0 ) {
@@ -186,6 +197,8 @@ static void close_libegl(void)
             __libEGL = NULL;
         }
     }
+
+    pthread_mutex_unlock(&__libEGLLock);
 } /* close_libegl() */
 
 
@@ -73,6 +73,9 @@ typedef struct __libGLInfoRec {
 
 static __libGLInfo *__libGL = NULL;
 
+/* protects the library table and its reference count */
+static pthread_mutex_t __libGLLock = PTHREAD_MUTEX_INITIALIZER;
+
 
 
 /****
@@ -129,6 +132,8 @@ static Bool open_libgl(void)
     const char *error_str = NULL;
 
 
+    pthread_mutex_lock(&__libGLLock);
+
     /* Initialize bookkeeping structure */
     if ( !__libGL ) {
         __libGL = nvalloc(sizeof(__libGLInfo));
@@ -138,6 +143,7 @@ static Bool open_libgl(void)
     /* Library was already opened */
     if ( __libGL->handle ) {
         __libGL->ref_count++;
+        pthread_mutex_unlock(&__libGLLock);
         return True;
     }
 
@@ -209,6 +215,8 @@ static Bool open_libgl(void)
     /* Up the ref count */
     __libGL->ref_count++;
 
+    pthread_mutex_unlock(&__libGLLock);
+
     return True;
 
 
@@ -225,6 +233,7 @@ static Bool open_libgl(void)
         free(__libGL);
         __libGL = NULL;
     }
+    pthread_mutex_unlock(&__libGLLock);
     return False;
     
 } /* open_libgL() */
@@ -239,6 +248,8 @@ static Bool open_libgl(void)
 
 static void close_libgl(void)
 {
+    pthread_mutex_lock(&__libGLLock);
+
     if ( __libGL && __libGL->handle && __libGL->ref_count ) {
         __libGL->ref_count--;
         if ( __libGL->ref_count == 0 ) {
@@ -248,6 +259,8 @@ static void close_libgl(void)
             __libGL = NULL;
         }
     }
+
+    pthread_mutex_unlock(&__libGLLock);
 } /* close_libgl() */
 
 
@@ -264,7 +277,7 @@ static void close_libgl(void)
  *
  ****/
 
-Bool
+NvCtrlGlxAttributes *
 NvCtrlInitGlxAttributes (NvCtrlAttributePrivateHandle *h)
 {
     int event_base;
@@ -273,13 +286,13 @@ NvCtrlInitGlxAttributes (NvCtrlAttributePrivateHandle *h)
 
     /* Check parameters */
     if ( !h || !h->dpy || h->target_type != X_SCREEN_TARGET ) {
-        return False;
+        return NULL;
     }
 
 
     /* Open libGL.so.1 */
     if ( !open_libgl() ) {
-        return False;
+        return NULL;
     }
 
 
@@ -287,10 +300,11 @@ NvCtrlInitGlxAttributes (NvCtrlAttributePrivateHandle *h)
     if ( !__libGL->glXQueryExtension(h->dpy,
                                      &(error_base),
                                      &(event_base)) ) {
-        return False;
+        close_libgl();
+        return NULL;
     }
 
-    return True;
+    return nvalloc(sizeof(NvCtrlGlxAttributes));
 
 } /* NvCtrlInitGlxAttributes() */
 
@@ -308,13 +322,21 @@ NvCtrlInitGlxAttributes (NvCtrlAttributePrivateHandle *h)
 void
 NvCtrlGlxAttributesClose (NvCtrlAttributePrivateHandle *h)
 {
+    int i;
+
     if ( !h || !h->glx ) {
         return;
     }
- 
+
+    for ( i = 0; i < ARRAY_LEN(h->glx->strings); i++ ) {
+        free(h->glx->strings[i]);
+    }
+    free(h->glx->fbconfig_attribs);
+    free(h->glx);
+
     close_libgl();
 
-    h->glx = False;
+    h->glx = NULL;
 
 } /* NvCtrlGlxAttributesClose() */
 
@@ -338,7 +360,7 @@ NvCtrlGlxAttributesClose (NvCtrlAttributePrivateHandle *h)
 #ifdef GLX_VERSION_1_3
 
 static GLXFBConfigAttr *
-get_fbconfig_attribs(const NvCtrlAttributePrivateHandle *h)
+get_fbconfig_attribs(const NvCtrlAttributePrivateHandle *h, int *count)
 {
     XVisualInfo     * visinfo;
 
@@ -536,6 +558,7 @@ get_fbconfig_attribs(const NvCtrlAttributePrivateHandle *h)
 
 
     XFree(fbconfigs);
+    *count = nfbconfigs;
     return fbcas;
 
 
@@ -555,6 +578,124 @@ get_fbconfig_attribs(const NvCtrlAttributePrivateHandle *h)
 
 
 
+/******************************************************************************
+ *
+ * probe_glx()
+ *
+ * Collects every GLX string and the fbconfigs of the X screen, and caches
+ * them on the handle.  The OpenGL strings and the direct rendering state
+ * need a current context: a single one is created for all of them, and torn
+ * down along with its window and colormap once the strings are copied.
+ *
+ ****/
+
+static void set_string(NvCtrlGlxAttributes *glx, int attr, const char *str)
+{
+    if ( str ) {
+        glx->strings[attr - NV_CTRL_STRING_GLX_BASE] = strdup(str);
+    }
+}
+
+static void probe_glx(const NvCtrlAttributePrivateHandle *h)
+{
+    NvCtrlGlxAttributes *glx = h->glx;
+
+    /* These variables are required for getting some OpenGL/GLX Information */
+    Window win = None;
+    Window root;
+    Colormap cmap = None;
+    GLXContext ctx = NULL;
+    XVisualInfo *visinfo;
+    XSetWindowAttributes win_attr;       /* Used for creating a gc */
+    unsigned long mask;
+    int width = 100;
+    int height = 100;
+
+    static int attribListSgl[] = { GLX_RGBA,
+                                   GLX_RED_SIZE, 1,
+                                   GLX_GREEN_SIZE, 1,
+                                   GLX_BLUE_SIZE, 1,
+                                   None };
+
+    if ( glx->probed ) {
+        return;
+    }
+    glx->probed = True;
+
+
+    /* Strings that do not need a context */
+    set_string(glx, NV_CTRL_STRING_GLX_GLX_EXTENSIONS,
+               __libGL->glXQueryExtensionsString(h->dpy, h->target_id));
+    set_string(glx, NV_CTRL_STRING_GLX_SERVER_VENDOR,
+               __libGL->glXQueryServerString(h->dpy, h->target_id,
+                                             GLX_VENDOR));
+    set_string(glx, NV_CTRL_STRING_GLX_SERVER_VERSION,
+               __libGL->glXQueryServerString(h->dpy, h->target_id,
+                                             GLX_VERSION));
+    set_string(glx, NV_CTRL_STRING_GLX_SERVER_EXTENSIONS,
+               __libGL->glXQueryServerString(h->dpy, h->target_id,
+                                             GLX_EXTENSIONS));
+    set_string(glx, NV_CTRL_STRING_GLX_CLIENT_VENDOR,
+               __libGL->glXGetClientString(h->dpy, GLX_VENDOR));
+    set_string(glx, NV_CTRL_STRING_GLX_CLIENT_VERSION,
+               __libGL->glXGetClientString(h->dpy, GLX_VERSION));
+    set_string(glx, NV_CTRL_STRING_GLX_CLIENT_EXTENSIONS,
+               __libGL->glXGetClientString(h->dpy, GLX_EXTENSIONS));
+
+#ifdef GLX_VERSION_1_3
+    glx->fbconfig_attribs = get_fbconfig_attribs(h, &glx->fbconfig_count);
+#endif
+
+
+    /* Strings that need a current context */
+    root    = RootWindow(h->dpy, h->target_id);
+    visinfo = __libGL->glXChooseVisual(h->dpy, h->target_id,
+                                       &(attribListSgl[0]));
+    if (!visinfo) {
+        return;
+    }
+    cmap = XCreateColormap(h->dpy, root, visinfo->visual, AllocNone);
+    win_attr.background_pixel = 0;
+    win_attr.border_pixel     = 0;
+    win_attr.colormap         = cmap;
+    win_attr.event_mask       = 0;
+    mask                      = CWBackPixel | CWBorderPixel | CWColormap |
+                                CWEventMask;
+    win  = XCreateWindow(h->dpy, root, 0, 0, width, height,
+                         0, visinfo->depth, InputOutput,
+                         visinfo->visual, mask, &win_attr);
+    ctx  = __libGL->glXCreateContext(h->dpy, visinfo, NULL, True );
+
+    if ( ctx && __libGL->glXMakeCurrent(h->dpy, win, ctx) ) {
+        set_string(glx, NV_CTRL_STRING_GLX_DIRECT_RENDERING,
+                   __libGL->glXIsDirect(h->dpy, ctx) ? "Yes" : "No");
+        set_string(glx, NV_CTRL_STRING_GLX_OPENGL_VENDOR,
+                   (const char *) __libGL->glGetString(GL_VENDOR));
+        set_string(glx, NV_CTRL_STRING_GLX_OPENGL_RENDERER,
+                   (const char *) __libGL->glGetString(GL_RENDERER));
+        set_string(glx, NV_CTRL_STRING_GLX_OPENGL_VERSION,
+                   (const char *) __libGL->glGetString(GL_VERSION));
+        set_string(glx, NV_CTRL_STRING_GLX_OPENGL_EXTENSIONS,
+                   (const char *) __libGL->glGetString(GL_EXTENSIONS));
+
+        __libGL->glXMakeCurrent(h->dpy, None, NULL);
+    }
+
+    XFree(visinfo);
+    if (ctx) {
+        __libGL->glXDestroyContext(h->dpy, ctx);
+    }
+    if (win) {
+        XDestroyWindow(h->dpy, win);
+    }
+    if (cmap) {
+        XFreeColormap(h->dpy, cmap);
+    }
+
+} /* probe_glx() */
+
+
+
 /******************************************************************************
  *
  * NvCtrlGlxGetVoidAttribute()
@@ -567,7 +708,7 @@ ReturnStatus NvCtrlGlxGetVoidAttribute(const NvCtrlAttributePrivateHandle *h,
                                        unsigned int display_mask,
                                        int attr, void **ptr) 
 {
-    GLXFBConfigAttr * fbconfig_attribs = NULL;
+    size_t size;
 
 
     /* Validate */
@@ -585,12 +726,17 @@ ReturnStatus NvCtrlGlxGetVoidAttribute(const NvCtrlAttributePrivateHandle *h,
     /* Fetch the right attribute */
     switch ( attr ) {
 
-#ifdef GLX_VERSION_1_3
     case NV_CTRL_ATTR_GLX_FBCONFIG_ATTRIBS:
-        fbconfig_attribs = get_fbconfig_attribs(h);
-        *ptr = fbconfig_attribs;
+        probe_glx(h);
+        if ( !h->glx->fbconfig_attribs ) {
+            return NvCtrlError;
+        }
+
+        /* The caller owns what is returned; hand out a copy */
+        size = (h->glx->fbconfig_count + 1) * sizeof(GLXFBConfigAttr);
+        *ptr = nvalloc(size);
+        memcpy(*ptr, h->glx->fbconfig_attribs, size);
         break;
-#endif
 
     default:
         return NvCtrlNoAttribute;
@@ -598,9 +744,6 @@ ReturnStatus NvCtrlGlxGetVoidAttribute(const NvCtrlAttributePrivateHandle *h,
     } /* Done fetching attribute */
 
 
-    if ( *ptr == NULL ) {
-        return NvCtrlError;
-    }
     return NvCtrlSuccess;
 
 } /* NvCtrlGlxGetAttribute */
@@ -613,13 +756,7 @@ ReturnStatus NvCtrlGlxGetVoidAttribute(const NvCtrlAttributePrivateHandle *h,
  * NvCtrlGlxGetStringAttribute()
  *
  *
- * Retrieves a particular GLX information string by calling the appropriate
- * OpenGL/GLX function.
- *
- *
- * But first, the following helper function may be used to set up a rendering
- * context such that valid information may be retrieved. (Having a context is
- * required for getting OpenGL and 'Direct rendering' information.)
+ * Retrieves a particular GLX information string, collected by probe_glx().
  *
  * NOTE: A separate display connection is used to avoid the dependence on
  *       libGL when an XCloseDisplay is issued.   If we did not, calling
@@ -628,77 +765,11 @@ ReturnStatus NvCtrlGlxGetVoidAttribute(const NvCtrlAttributePrivateHandle *h,
  *
  ****/
 
-/*
- * Helper function for NvCtrlGlxGetStringAttribute for queries that require a
- * current context.  If getDirect is true, then check if we can create a direct
- * GLX context and return "Yes" or "No".  Otherwise, create a context and query
- * the GLX implementation for the string specified in prop.
- */
-static const char *getString(const NvCtrlAttributePrivateHandle *h,
-                             Bool getDirect, GLenum prop)
-{
-    const char *str = NULL;
-
-    /* These variables are required for getting some OpenGL/GLX Information */
-    Window win;
-    Window root;
-    GLXContext ctx;
-    XVisualInfo *visinfo;
-    XSetWindowAttributes win_attr;       /* Used for creating a gc */
-    unsigned long mask;
-    int width = 100;
-    int height = 100;
-
-    static int attribListSgl[] = { GLX_RGBA,
-                                   GLX_RED_SIZE, 1,
-                                   GLX_GREEN_SIZE, 1,
-                                   GLX_BLUE_SIZE, 1,
-                                   None };
-    root    = RootWindow(h->dpy, h->target_id);
-    visinfo = __libGL->glXChooseVisual(h->dpy, h->target_id,
-                                       &(attribListSgl[0]));
-    if (!visinfo) {
-        return NULL;
-    }
-    win_attr.background_pixel = 0;
-    win_attr.border_pixel     = 0;
-    win_attr.colormap         = XCreateColormap(h->dpy, root,
-                                                visinfo->visual, AllocNone);
-    win_attr.event_mask       = 0;
-    mask                      = CWBackPixel | CWBorderPixel | CWColormap |
-                                CWEventMask;
-    win  = XCreateWindow(h->dpy, root, 0, 0, width, height,
-                         0, visinfo->depth, InputOutput,
-                         visinfo->visual, mask, &win_attr);
-    ctx  = __libGL->glXCreateContext(h->dpy, visinfo, NULL, True );
-    if ( ctx ) {
-        __libGL->glXMakeCurrent(h->dpy, win, ctx);
-    }
-
-    if (getDirect) {
-        str = ((*(__libGL->glXIsDirect))(h->dpy, ctx)) ? "Yes" : "No";
-    } else {
-        str = (const char *) (* (__libGL->glGetString))(prop);
-    }
-
-    if (visinfo) {
-        XFree(visinfo);
-    }
-    if (ctx) {
-        __libGL->glXDestroyContext(h->dpy, ctx);
-    }
-    if (win) {
-        XDestroyWindow(h->dpy, win);
-    }
-
-    return str;
-}
-
 ReturnStatus NvCtrlGlxGetStringAttribute(const NvCtrlAttributePrivateHandle *h,
                                          unsigned int display_mask,
                                          int attr, char **ptr)
 {
-    const char *str = NULL;
+    const char *str;
 
     /* Validate */
     if ( !h || !h->dpy || h->target_type != X_SCREEN_TARGET ) {
@@ -710,55 +781,15 @@ ReturnStatus NvCtrlGlxGetStringAttribute(const NvCtrlAttributePrivateHandle *h,
     if ( !ptr ) {
         return NvCtrlBadArgument;
     }
+    if ( attr < NV_CTRL_STRING_GLX_BASE ||
+         attr > NV_CTRL_STRING_GLX_LAST_ATTRIBUTE ) {
+        return NvCtrlNoAttribute;
+    }
 
 
     /* Get the right string */
-    switch (attr) {
-        
-    case NV_CTRL_STRING_GLX_DIRECT_RENDERING:
-        str = getString(h, True, 0);
-        break;
-    case NV_CTRL_STRING_GLX_GLX_EXTENSIONS:
-        str = (* (__libGL->glXQueryExtensionsString))(h->dpy, h->target_id);
-        break;
-    case NV_CTRL_STRING_GLX_SERVER_VENDOR:
-        str = (* (__libGL->glXQueryServerString))(h->dpy, h->target_id,
-                                                  GLX_VENDOR);
-        break;
-    case NV_CTRL_STRING_GLX_SERVER_VERSION:
-        str = (* (__libGL->glXQueryServerString))(h->dpy, h->target_id,
-                                                  GLX_VERSION);
-        break;
-    case NV_CTRL_STRING_GLX_SERVER_EXTENSIONS:
-        str = (* (__libGL->glXQueryServerString))(h->dpy, h->target_id,
-                                                  GLX_EXTENSIONS);
-        break;
-    case NV_CTRL_STRING_GLX_CLIENT_VENDOR:
-        str = (* (__libGL->glXGetClientString))(h->dpy, GLX_VENDOR);
-        break;
-    case NV_CTRL_STRING_GLX_CLIENT_VERSION:
-        str = (* (__libGL->glXGetClientString))(h->dpy, GLX_VERSION);
-        break;
-    case NV_CTRL_STRING_GLX_CLIENT_EXTENSIONS:
-        str = (* (__libGL->glXGetClientString))(h->dpy, GLX_EXTENSIONS);
-        break;
-    case NV_CTRL_STRING_GLX_OPENGL_VENDOR:
-        str = getString(h, False, GL_VENDOR);
-        break;
-    case NV_CTRL_STRING_GLX_OPENGL_RENDERER:
-        str = getString(h, False, GL_RENDERER);
-        break;
-    case NV_CTRL_STRING_GLX_OPENGL_VERSION:
-        str = getString(h, False, GL_VERSION);
-        break;
-    case NV_CTRL_STRING_GLX_OPENGL_EXTENSIONS:
-        str = getString(h, False, GL_EXTENSIONS);
-        break;
-        
-    default:
-        return NvCtrlNoAttribute;
-        break;
-    } /* Done - Fetching corresponding string attribute */
+    probe_glx(h);
+    str = h->glx->strings[attr - NV_CTRL_STRING_GLX_BASE];
 
 
     /* Copy the string and return it */
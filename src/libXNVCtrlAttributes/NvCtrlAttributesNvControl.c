@@ -22,6 +22,11 @@
 
 #include "NVCtrlLib.h"
 
+#if defined(NV_USE_XCB)
+#include <X11/Xlib-xcb.h>
+#include "NVCtrlXcbLib.h"
+#endif
+
 #include "common-utils.h"
 #include "msg.h"
 
@@ -53,10 +58,21 @@ NvCtrlInitNvControlAttributes (NvCtrlAttributePrivateHandle *h)
         return NULL;
     }
     
-    ret = XNVCTRLQueryVersion (h->dpy, &major, &minor);
-    if (ret != True) {
-        nv_error_msg("Failed to query NV-CONTROL extension version.");
-        return NULL;
+    /* All targets of a system share the version of its X server */
+
+    if (h->system && h->system->nv_control_major) {
+        major = h->system->nv_control_major;
+        minor = h->system->nv_control_minor;
+    } else {
+        ret = XNVCTRLQueryVersion (h->dpy, &major, &minor);
+        if (ret != True) {
+            nv_error_msg("Failed to query NV-CONTROL extension version.");
+            return NULL;
+        }
+        if (h->system) {
+            h->system->nv_control_major = major;
+            h->system->nv_control_minor = minor;
+        }
     }
 
     if (NV_VERSION2(major, minor) < NV_VERSION2(NV_MINMAJOR, NV_MINMINOR)) {
@@ -148,6 +164,10 @@ NvCtrlInitNvControlAttributes (NvCtrlAttributePrivateHandle *h)
     nv->major_version = major;
     nv->minor_version = minor;
 
+#if defined(NV_USE_XCB)
+    nv->xcb = XGetXCBConnection(h->dpy);
+#endif
+
     return (nv);
 
 } /* NvCtrlInitNvControlAttributes() */
@@ -239,6 +259,686 @@ ReturnStatus NvCtrlNvControlGetAttribute(const NvCtrlAttributePrivateHandle *h,
 } /* NvCtrlNvControlGetAttribute() */
 
 
+
+#if defined(NV_USE_XCB)
+
+/*
+ * The *_xcb() functions below are used by the batch queries when the
+ * NV-CONTROL client is built with xcb: they send the requests of the
+ * queries flagged in 'pending' through the xcb connection of their
+ * Display, all of them before waiting on any reply, and clear the queries
+ * they answered from 'pending'.  Queries left pending go through the Xlib
+ * code path.
+ */
+
+static xcb_connection_t *get_xcb_connection(const CtrlTarget *ctrl_target,
+                                            const CtrlTargetTypeInfo **info)
+{
+    const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
+
+    if (!h || !h->nv || !h->nv->xcb) {
+        return NULL;
+    }
+
+    *info = NvCtrlGetTargetTypeInfo(h->target_type);
+
+    return *info ? h->nv->xcb : NULL;
+}
+
+
+
+static void get_attributes_batch_xcb(CtrlAttributeQuery *queries, int count,
+                                     Bool *pending)
+{
+    xcb_nvctrl_cookie_t *cookies;
+    xcb_connection_t **conns;
+    int i;
+
+    cookies = nvalloc(count * sizeof(xcb_nvctrl_cookie_t));
+    conns = nvalloc(count * sizeof(xcb_connection_t *));
+
+    for (i = 0; i < count; i++) {
+        const NvCtrlAttributePrivateHandle *h;
+        const CtrlTargetTypeInfo *info;
+        xcb_connection_t *c;
+
+        if (!pending[i] ||
+            (queries[i].attr < 0) ||
+            (queries[i].attr > NV_CTRL_LAST_ATTRIBUTE)) {
+            continue;
+        }
+
+        c = get_xcb_connection(queries[i].target, &info);
+        h = getPrivateHandleConst(queries[i].target);
+
+        /* 64-bit attributes were added in NV-CONTROL 1.21 */
+        if (!c || (NV_VERSION2(h->nv->major_version, h->nv->minor_version) <=
+                   NV_VERSION2(1, 20))) {
+            continue;
+        }
+
+        cookies[i] = xcb_nvctrl_query_target_attribute64(c, info->nvctrl,
+                                                         h->target_id,
+                                                         queries[i].display_mask,
+                                                         queries[i].attr);
+        if (cookies[i].sequence) {
+            conns[i] = c;
+        }
+    }
+
+    for (i = 0; i < count; i++) {
+        if (!conns[i]) {
+            continue;
+        }
+
+        if (xcb_nvctrl_query_target_attribute64_reply(conns[i], cookies[i],
+                                                      &queries[i].val)) {
+            queries[i].status = NvCtrlSuccess;
+        } else {
+            queries[i].status = NvCtrlAttributeNotAvailable;
+        }
+        pending[i] = FALSE;
+    }
+
+    nvfree(conns);
+    nvfree(cookies);
+}
+
+
+
+static void get_string_attributes_batch_xcb(CtrlStringAttributeQuery *queries,
+                                            int count, Bool *pending)
+{
+    xcb_nvctrl_cookie_t *cookies;
+    xcb_connection_t **conns;
+    int i;
+
+    cookies = nvalloc(count * sizeof(xcb_nvctrl_cookie_t));
+    conns = nvalloc(count * sizeof(xcb_connection_t *));
+
+    for (i = 0; i < count; i++) {
+        const CtrlTargetTypeInfo *info;
+        xcb_connection_t *c;
+
+        /* NV_CTRL_STRING_NV_CONTROL_VERSION is answered locally */
+        if (!pending[i] ||
+            (queries[i].attr < 0) ||
+            (queries[i].attr > NV_CTRL_STRING_LAST_ATTRIBUTE) ||
+            (queries[i].attr == NV_CTRL_STRING_NV_CONTROL_VERSION)) {
+            continue;
+        }
+
+        c = get_xcb_connection(queries[i].target, &info);
+        if (!c) {
+            continue;
+        }
+
+        cookies[i] =
+            xcb_nvctrl_query_target_string_attribute(c, info->nvctrl,
+                                                     NvCtrlGetTargetId(queries[i].target),
+                                                     queries[i].display_mask,
+                                                     queries[i].attr);
+        if (cookies[i].sequence) {
+            conns[i] = c;
+        }
+    }
+
+    for (i = 0; i < count; i++) {
+        if (!conns[i]) {
+            continue;
+        }
+
+        if (xcb_nvctrl_query_target_string_attribute_reply(conns[i],
+                                                           cookies[i],
+                                                           &queries[i].str)) {
+            queries[i].status = NvCtrlSuccess;
+        } else {
+            queries[i].status = NvCtrlAttributeNotAvailable;
+        }
+        pending[i] = FALSE;
+    }
+
+    nvfree(conns);
+    nvfree(cookies);
+}
+
+
+
+static void get_binary_attributes_batch_xcb(CtrlBinaryAttributeQuery *queries,
+                                            int count, Bool *pending)
+{
+    xcb_nvctrl_cookie_t *cookies;
+    xcb_connection_t **conns;
+    int i;
+
+    cookies = nvalloc(count * sizeof(xcb_nvctrl_cookie_t));
+    conns = nvalloc(count * sizeof(xcb_connection_t *));
+
+    for (i = 0; i < count; i++) {
+        const NvCtrlAttributePrivateHandle *h;
+        const CtrlTargetTypeInfo *info;
+        xcb_connection_t *c;
+
+        if (!pending[i]) {
+            continue;
+        }
+
+        c = get_xcb_connection(queries[i].target, &info);
+        if (!c) {
+            continue;
+        }
+
+        /* the X_nvCtrlQueryBinaryData opcode was added in 1.7 */
+        h = getPrivateHandleConst(queries[i].target);
+        if (NV_VERSION2(h->nv->major_version, h->nv->minor_version) <
+            NV_VERSION2(1, 7)) {
+            queries[i].status = NvCtrlNoAttribute;
+            pending[i] = FALSE;
+            continue;
+        }
+
+        cookies[i] =
+            xcb_nvctrl_query_target_binary_data(c, info->nvctrl,
+                                                NvCtrlGetTargetId(queries[i].target),
+                                                queries[i].display_mask,
+                                                queries[i].attr);
+        if (cookies[i].sequence) {
+            conns[i] = c;
+        }
+    }
+
+    /* Match NvCtrlNvControlGetBinaryAttribute() */
+    for (i = 0; i < count; i++) {
+        if (!conns[i]) {
+            continue;
+        }
+
+        if (xcb_nvctrl_query_target_binary_data_reply(conns[i], cookies[i],
+                                                      &queries[i].data,
+                                                      &queries[i].len)) {
+            queries[i].status = NvCtrlSuccess;
+        } else {
+            queries[i].status = NvCtrlError;
+        }
+        pending[i] = FALSE;
+    }
+
+    nvfree(conns);
+    nvfree(cookies);
+}
+
+
+
+static void query_target_counts_batch_xcb(CtrlTargetCountQuery *queries,
+                                          int count, Bool *pending)
+{
+    xcb_nvctrl_cookie_t *cookies;
+    xcb_connection_t **conns;
+    int i;
+
+    cookies = nvalloc(count * sizeof(xcb_nvctrl_cookie_t));
+    conns = nvalloc(count * sizeof(xcb_connection_t *));
+
+    for (i = 0; i < count; i++) {
+        const CtrlTargetTypeInfo *info, *countedInfo;
+        xcb_connection_t *c;
+
+        if (!pending[i]) {
+            continue;
+        }
+
+        c = get_xcb_connection(queries[i].target, &info);
+        countedInfo = NvCtrlGetTargetTypeInfo(queries[i].target_type);
+        if (!c || (countedInfo == NULL)) {
+            continue;
+        }
+
+        cookies[i] = xcb_nvctrl_query_target_count(c, countedInfo->nvctrl);
+        if (cookies[i].sequence) {
+            conns[i] = c;
+        }
+    }
+
+    for (i = 0; i < count; i++) {
+        if (!conns[i]) {
+            continue;
+        }
+
+        if (xcb_nvctrl_query_target_count_reply(conns[i], cookies[i],
+                                                &queries[i].val)) {
+            queries[i].status = NvCtrlSuccess;
+        } else {
+            queries[i].status = NvCtrlError;
+        }
+        pending[i] = FALSE;
+    }
+
+    nvfree(conns);
+    nvfree(cookies);
+}
+
+#endif /* NV_USE_XCB */
+
+
+
+/*
+ * NvCtrlNvControlGetAttributesBatch() - query the integer attributes of the
+ * queries flagged in 'pending' with one round trip per X display, by
+ * pipelining their requests.  The queries answered this way are given the
+ * status NvCtrlNvControlGetAttribute() would have returned, and are
+ * cleared from 'pending'; the others (pseudo attributes, unknown target
+ * types, ...) are left for the caller to query individually.  NV-CONTROL
+ * versions without 64-bit attributes are sent 32-bit queries.
+ */
+
+void NvCtrlNvControlGetAttributesBatch(CtrlAttributeQuery *queries,
+                                       int count, Bool *pending)
+{
+    NVCTRLAttributeQueryRec *recs;
+    int *recQuery;
+    Bool *visited;
+    int first, i, n;
+
+    if (count <= 0) {
+        return;
+    }
+
+#if defined(NV_USE_XCB)
+    get_attributes_batch_xcb(queries, count, pending);
+#endif
+
+    recs = nvalloc(count * sizeof(NVCTRLAttributeQueryRec));
+    recQuery = nvalloc(count * sizeof(int));
+    visited = nvalloc(count * sizeof(Bool));
+
+    for (first = 0; first < count; first++) {
+        const NvCtrlNvControlAttributes *nv = NULL;
+        Display *dpy = NULL;
+        Bool ok;
+
+        if (visited[first]) {
+            continue;
+        }
+
+        /* Gather the pending queries sharing the display of the first one */
+        n = 0;
+        for (i = first; i < count; i++) {
+            const NvCtrlAttributePrivateHandle *h;
+            const CtrlTargetTypeInfo *targetTypeInfo;
+
+            if (visited[i]) {
+                continue;
+            }
+
+            h = getPrivateHandleConst(queries[i].target);
+
+            if (!pending[i] || !h || !h->nv ||
+                (queries[i].attr < 0) ||
+                (queries[i].attr > NV_CTRL_LAST_ATTRIBUTE)) {
+                visited[i] = TRUE;
+                continue;
+            }
+
+            targetTypeInfo = NvCtrlGetTargetTypeInfo(h->target_type);
+            if (targetTypeInfo == NULL) {
+                visited[i] = TRUE;
+                continue;
+            }
+
+            if (dpy == NULL) {
+                dpy = h->dpy;
+                nv = h->nv;
+            } else if (h->dpy != dpy) {
+                continue;
+            }
+
+            visited[i] = TRUE;
+
+            recs[n].target_type = targetTypeInfo->nvctrl;
+            recs[n].target_id = h->target_id;
+            recs[n].display_mask = queries[i].display_mask;
+            recs[n].attribute = queries[i].attr;
+            recQuery[n] = i;
+            n++;
+        }
+
+        if (n == 0) {
+            continue;
+        }
+
+        /* 64-bit attributes were added in NV-CONTROL 1.21 */
+        if (NV_VERSION2(nv->major_version, nv->minor_version) >
+            NV_VERSION2(1, 20)) {
+            ok = XNVCTRLQueryTargetAttributes64(dpy, recs, n);
+        } else {
+            ok = XNVCTRLQueryTargetAttributesMulti(dpy, recs, n);
+        }
+
+        if (!ok) {
+            continue;
+        }
+
+        for (i = 0; i < n; i++) {
+            CtrlAttributeQuery *query = &queries[recQuery[i]];
+
+            if (recs[i].exists) {
+                query->val = recs[i].value;
+                query->status = NvCtrlSuccess;
+            } else {
+                query->status = NvCtrlAttributeNotAvailable;
+            }
+            pending[recQuery[i]] = FALSE;
+        }
+    }
+
+    nvfree(visited);
+    nvfree(recQuery);
+    nvfree(recs);
+
+} /* NvCtrlNvControlGetAttributesBatch() */
+
+
+
+/*
+ * wait_for_async_replies() - wait for the replies to the asynchronous
+ * requests sent on the given displays (NULL entries are skipped): a single
+ * round trip per display reads all of them.
+ */
+
+static void wait_for_async_replies(Display **dpys, int count)
+{
+    int i, j;
+
+    for (i = 0; i < count; i++) {
+        if (dpys[i] == NULL) {
+            continue;
+        }
+        for (j = 0; j < i; j++) {
+            if (dpys[j] == dpys[i]) {
+                break;
+            }
+        }
+        if (j == i) {
+            XFlush(dpys[i]);
+        }
+    }
+
+    for (i = 0; i < count; i++) {
+        if (dpys[i] == NULL) {
+            continue;
+        }
+        for (j = 0; j < i; j++) {
+            if (dpys[j] == dpys[i]) {
+                break;
+            }
+        }
+        if (j == i) {
+            XSync(dpys[i], False);
+        }
+    }
+}
+
+
+
+/*
+ * NvCtrlNvControlGetStringAttributesBatch() - query the string attributes of
+ * the queries flagged in 'pending' with one round trip per X display, as
+ * NvCtrlNvControlGetAttributesBatch() does for integer attributes.
+ */
+
+void NvCtrlNvControlGetStringAttributesBatch(CtrlStringAttributeQuery *queries,
+                                             int count, Bool *pending)
+{
+    XNVCTRLAsyncQueryRec **recs;
+    Display **dpys;
+    int i;
+
+    if (count <= 0) {
+        return;
+    }
+
+#if defined(NV_USE_XCB)
+    get_string_attributes_batch_xcb(queries, count, pending);
+#endif
+
+    recs = nvalloc(count * sizeof(XNVCTRLAsyncQueryRec *));
+    dpys = nvalloc(count * sizeof(Display *));
+
+    for (i = 0; i < count; i++) {
+        const NvCtrlAttributePrivateHandle *h;
+        const CtrlTargetTypeInfo *targetTypeInfo;
+
+        if (!pending[i]) {
+            continue;
+        }
+
+        h = getPrivateHandleConst(queries[i].target);
+
+        /* NV_CTRL_STRING_NV_CONTROL_VERSION is answered locally */
+        if (!h || !h->nv || !h->dpy ||
+            (queries[i].attr < 0) ||
+            (queries[i].attr > NV_CTRL_STRING_LAST_ATTRIBUTE) ||
+            (queries[i].attr == NV_CTRL_STRING_NV_CONTROL_VERSION)) {
+            continue;
+        }
+
+        targetTypeInfo = NvCtrlGetTargetTypeInfo(h->target_type);
+        if (targetTypeInfo == NULL) {
+            continue;
+        }
+
+        recs[i] = XNVCTRLQueryTargetStringAttributeAsync(h->dpy,
+                                                         targetTypeInfo->nvctrl,
+                                                         h->target_id,
+                                                         queries[i].display_mask,
+                                                         queries[i].attr);
+        if (recs[i]) {
+            dpys[i] = h->dpy;
+        }
+    }
+
+    wait_for_async_replies(dpys, count);
+
+    for (i = 0; i < count; i++) {
+        CtrlStringAttributeQuery *query = &queries[i];
+        char *tmp;
+
+        if (!recs[i]) {
+            continue;
+        }
+
+        if (!XNVCTRLAsyncQueryDone(dpys[i], recs[i])) {
+            XNVCTRLFreeAsyncQuery(dpys[i], recs[i]);
+            continue;
+        }
+
+        if (XNVCTRLAsyncQueryStringAttribute(recs[i], &tmp)) {
+            query->str = strdup(tmp);
+            XFree(tmp);
+            query->status = NvCtrlSuccess;
+        } else {
+            query->status = NvCtrlAttributeNotAvailable;
+        }
+        pending[i] = FALSE;
+
+        XNVCTRLFreeAsyncQuery(dpys[i], recs[i]);
+    }
+
+    nvfree(dpys);
+    nvfree(recs);
+
+} /* NvCtrlNvControlGetStringAttributesBatch() */
+
+
+
+/*
+ * NvCtrlNvControlGetBinaryAttributesBatch() - query the binary data
+ * attributes of the queries flagged in 'pending' with one round trip per X
+ * display.
+ */
+
+void NvCtrlNvControlGetBinaryAttributesBatch(CtrlBinaryAttributeQuery *queries,
+                                             int count, Bool *pending)
+{
+    XNVCTRLAsyncQueryRec **recs;
+    Display **dpys;
+    int i;
+
+    if (count <= 0) {
+        return;
+    }
+
+#if defined(NV_USE_XCB)
+    get_binary_attributes_batch_xcb(queries, count, pending);
+#endif
+
+    recs = nvalloc(count * sizeof(XNVCTRLAsyncQueryRec *));
+    dpys = nvalloc(count * sizeof(Display *));
+
+    for (i = 0; i < count; i++) {
+        const NvCtrlAttributePrivateHandle *h;
+        const CtrlTargetTypeInfo *targetTypeInfo;
+
+        if (!pending[i]) {
+            continue;
+        }
+
+        h = getPrivateHandleConst(queries[i].target);
+
+        /* the X_nvCtrlQueryBinaryData opcode was added in 1.7 */
+        if (!h || !h->nv || !h->dpy ||
+            (NV_VERSION2(h->nv->major_version, h->nv->minor_version) <
+             NV_VERSION2(1, 7))) {
+            continue;
+        }
+
+        targetTypeInfo = NvCtrlGetTargetTypeInfo(h->target_type);
+        if (targetTypeInfo == NULL) {
+            continue;
+        }
+
+        recs[i] = XNVCTRLQueryTargetBinaryDataAsync(h->dpy,
+                                                    targetTypeInfo->nvctrl,
+                                                    h->target_id,
+                                                    queries[i].display_mask,
+                                                    queries[i].attr);
+        if (recs[i]) {
+            dpys[i] = h->dpy;
+        }
+    }
+
+    wait_for_async_replies(dpys, count);
+
+    for (i = 0; i < count; i++) {
+        CtrlBinaryAttributeQuery *query = &queries[i];
+        unsigned char *tmp;
+        int len;
+
+        if (!recs[i]) {
+            continue;
+        }
+
+        if (!XNVCTRLAsyncQueryDone(dpys[i], recs[i])) {
+            XNVCTRLFreeAsyncQuery(dpys[i], recs[i]);
+            continue;
+        }
+
+        /* Match NvCtrlNvControlGetBinaryAttribute() */
+        if (XNVCTRLAsyncQueryBinaryData(recs[i], &tmp, &len)) {
+            query->data = malloc(len);
+            if (query->data) {
+                memcpy(query->data, tmp, len);
+                query->len = len;
+                query->status = NvCtrlSuccess;
+            } else {
+                query->status = NvCtrlError;
+            }
+            XFree(tmp);
+        } else {
+            query->status = NvCtrlError;
+        }
+        pending[i] = FALSE;
+
+        XNVCTRLFreeAsyncQuery(dpys[i], recs[i]);
+    }
+
+    nvfree(dpys);
+    nvfree(recs);
+
+} /* NvCtrlNvControlGetBinaryAttributesBatch() */
+
+
+
+/*
+ * NvCtrlNvControlQueryTargetCountsBatch() - query the target counts of the
+ * queries flagged in 'pending' with one round trip per X display.
+ */
+
+void NvCtrlNvControlQueryTargetCountsBatch(CtrlTargetCountQuery *queries,
+                                           int count, Bool *pending)
+{
+    XNVCTRLAsyncQueryRec **recs;
+    Display **dpys;
+    int i;
+
+    if (count <= 0) {
+        return;
+    }
+
+#if defined(NV_USE_XCB)
+    query_target_counts_batch_xcb(queries, count, pending);
+#endif
+
+    recs = nvalloc(count * sizeof(XNVCTRLAsyncQueryRec *));
+    dpys = nvalloc(count * sizeof(Display *));
+
+    for (i = 0; i < count; i++) {
+        const NvCtrlAttributePrivateHandle *h;
+        const CtrlTargetTypeInfo *targetTypeInfo;
+
+        if (!pending[i]) {
+            continue;
+        }
+
+        h = getPrivateHandleConst(queries[i].target);
+        targetTypeInfo = NvCtrlGetTargetTypeInfo(queries[i].target_type);
+
+        if (!h || !h->nv || !h->dpy || (targetTypeInfo == NULL)) {
+            continue;
+        }
+
+        recs[i] = XNVCTRLQueryTargetCountAsync(h->dpy, targetTypeInfo->nvctrl);
+        if (recs[i]) {
+            dpys[i] = h->dpy;
+        }
+    }
+
+    wait_for_async_replies(dpys, count);
+
+    for (i = 0; i < count; i++) {
+        CtrlTargetCountQuery *query = &queries[i];
+
+        if (!recs[i]) {
+            continue;
+        }
+
+        if (XNVCTRLAsyncQueryDone(dpys[i], recs[i]) &&
+            XNVCTRLAsyncQueryTargetCount(recs[i], &query->val)) {
+            query->status = NvCtrlSuccess;
+        } else {
+            query->status = NvCtrlError;
+        }
+        pending[i] = FALSE;
+
+        XNVCTRLFreeAsyncQuery(dpys[i], recs[i]);
+    }
+
+    nvfree(dpys);
+    nvfree(recs);
+
+} /* NvCtrlNvControlQueryTargetCountsBatch() */
+
+
 ReturnStatus NvCtrlNvControlSetAttribute (NvCtrlAttributePrivateHandle *h,
                                           unsigned int display_mask,
                                           int attr, int val)
@@ -579,7 +1279,8 @@ NvCtrlNvControlSetStringAttribute (NvCtrlAttributePrivateHandle *h,
 ReturnStatus
 NvCtrlNvControlGetBinaryAttribute(const NvCtrlAttributePrivateHandle *h,
                                   unsigned int display_mask, int attr,
-                                  unsigned char **data, int *len)
+                                  unsigned char **data, int *len,
+                                  NvCtrlBinaryScratch *scratch)
 {
     unsigned char *tmp;
     Bool ret;
@@ -604,6 +1305,21 @@ NvCtrlNvControlGetBinaryAttribute(const NvCtrlAttributePrivateHandle *h,
         return NvCtrlBadHandle;
     }
 
+    if (scratch != NULL) {
+        ret = XNVCTRLQueryTargetBinaryDataToBuffer(h->dpy,
+                                                   targetTypeInfo->nvctrl,
+                                                   h->target_id,
+                                                   display_mask, attr,
+                                                   &scratch->data,
+                                                   &scratch->size, len);
+        if (!ret) {
+            return NvCtrlError;
+        }
+
+        *data = scratch->data;
+        return NvCtrlSuccess;
+    }
+
     ret = XNVCTRLQueryTargetBinaryData(h->dpy,
                                        targetTypeInfo->nvctrl,
                                        h->target_id,
@@ -25,6 +25,9 @@
 #include <string.h>
 #include <assert.h>
 #include <dlfcn.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
 
 #include "NvCtrlAttributes.h"
 #include "NvCtrlAttributesPrivate.h"
@@ -39,8 +42,14 @@
 
 #define MAX_NVML_STR_LEN 64
 
-static inline const NvCtrlNvmlAttributes *
-getNvmlHandleConst(const NvCtrlAttributePrivateHandle *h)
+/*
+ * Telemetry snapshots younger than this are handed out again instead of
+ * querying NVML, so pages refreshing on separate timers share one sample.
+ */
+#define TELEMETRY_MAX_AGE_USEC 500000
+
+static inline NvCtrlNvmlAttributes *
+getNvmlHandle(const NvCtrlAttributePrivateHandle *h)
 {
     if ((h == NULL) || (h->nvml == NULL)) {
         return NULL;
@@ -149,48 +158,68 @@ static Bool NvmlMissing(const CtrlTarget *ctrl_target)
 }
 
 
+/*
+ * The NVML library instance shared by every user in this process.
+ */
+static NvCtrlNvmlLibrary *__libNvml = NULL;
+
+/* protects the library table and its reference count */
+static pthread_mutex_t __libNvmlLock = PTHREAD_MUTEX_INITIALIZER;
+
+
+
 /*
  * Unload the NVML library if it was successfully loaded.
  */
-static void UnloadNvml(NvCtrlNvmlAttributes *nvml)
+static void UnloadNvml(NvCtrlNvmlLibrary *lib)
 {
-    if (nvml == NULL) {
+    if (lib == NULL) {
         return;
     }
 
-    if (nvml->lib.handle == NULL) {
+    if (lib->handle == NULL) {
         return;
     }
 
-    if (nvml->lib.shutdown != NULL) {
-        nvmlReturn_t ret = nvml->lib.shutdown();
+    if (lib->shutdown != NULL) {
+        nvmlReturn_t ret = lib->shutdown();
         if (ret != NVML_SUCCESS) {
             printNvmlError(ret);
         }
     }
 
-    dlclose(nvml->lib.handle);
+    dlclose(lib->handle);
 
-    memset(&nvml->lib, 0, sizeof(nvml->lib));
+    memset(lib, 0, sizeof(*lib));
 }
 
 /*
- * Load and initializes the NVML library.
+ * Load and initializes the NVML library.  If the NVML_LIBRARY_ENV
+ * environment variable is set, it names the library to load instead of the
+ * driver's one (e.g. the stub library built by `make nvml-stub`).
  */
-static Bool LoadNvml(NvCtrlNvmlAttributes *nvml)
+
+#define NVML_LIBRARY_ENV "NVIDIA_SETTINGS_NVML_LIBRARY"
+
+static Bool LoadNvml(NvCtrlNvmlLibrary *lib)
 {
     nvmlReturn_t ret;
+    const char *name = getenv(NVML_LIBRARY_ENV);
 
-    nvml->lib.handle = dlopen("libnvidia-ml.so.1", RTLD_LAZY);
+    if (name == NULL || name[0] == '\0') {
+        name = "libnvidia-ml.so.1";
+    }
+
+    lib->handle = dlopen(name, RTLD_LAZY);
 
-    if (nvml->lib.handle == NULL) {
+    if (lib->handle == NULL) {
         goto fail;
     }
 
-#define GET_SYMBOL_REQUIRED(_proc, _name)             \
-    nvml->lib._proc = dlsym(nvml->lib.handle, _name); \
-    if (nvml->lib._proc == NULL) {                    \
-        goto fail;                                    \
+#define GET_SYMBOL_REQUIRED(_proc, _name)   \
+    lib->_proc = dlsym(lib->handle, _name); \
+    if (lib->_proc == NULL) {               \
+        goto fail;                          \
     }
 
     GET_SYMBOL_REQUIRED(init,                           "nvmlInit");
@@ -225,14 +254,21 @@ static Bool LoadNvml(NvCtrlNvmlAttributes *nvml)
 #undef GET_SYMBOL_REQUIRED
     
 /* Do not fail with older drivers */
-#define GET_SYMBOL_OPTIONAL(_proc, _name)             \
-    nvml->lib._proc = dlsym(nvml->lib.handle, _name); 
+#define GET_SYMBOL_OPTIONAL(_proc, _name)   \
+    lib->_proc = dlsym(lib->handle, _name);
     
     GET_SYMBOL_OPTIONAL(deviceGetGridLicensableFeatures, "nvmlDeviceGetGridLicensableFeatures_v4");
     GET_SYMBOL_OPTIONAL(deviceGetMemoryInfo_v2,          "nvmlDeviceGetMemoryInfo_v2");
+    GET_SYMBOL_OPTIONAL(deviceGetHandleByUUID,           "nvmlDeviceGetHandleByUUID");
+    GET_SYMBOL_OPTIONAL(deviceGetFieldValues,            "nvmlDeviceGetFieldValues");
+    GET_SYMBOL_OPTIONAL(eventSetCreate,                  "nvmlEventSetCreate");
+    GET_SYMBOL_OPTIONAL(eventSetFree,                    "nvmlEventSetFree");
+    GET_SYMBOL_OPTIONAL(eventSetWait,                    "nvmlEventSetWait_v2");
+    GET_SYMBOL_OPTIONAL(deviceRegisterEvents,            "nvmlDeviceRegisterEvents");
+    GET_SYMBOL_OPTIONAL(deviceGetSupportedEventTypes,    "nvmlDeviceGetSupportedEventTypes");
 #undef GET_SYMBOL_OPTIONAL
 
-    ret = nvml->lib.init();
+    ret = lib->init();
 
     if (ret != NVML_SUCCESS) {
         printNvmlError(ret);
@@ -242,11 +278,78 @@ static Bool LoadNvml(NvCtrlNvmlAttributes *nvml)
     return True;
 
 fail:
-    UnloadNvml(nvml);
+    UnloadNvml(lib);
     return False;
 }
 
 
+
+/*
+ * Returns a reference to the process-wide NVML library instance, loading and
+ * initializing it on first use.  Every CtrlSystem holds a reference for its
+ * lifetime, so the targets it creates share a single dlopen() and nvmlInit()
+ * instead of paying for them once per target.
+ */
+
+static NvCtrlNvmlLibrary *NvCtrlNvmlOpenLibrary(void)
+{
+    pthread_mutex_lock(&__libNvmlLock);
+
+    /* Library was already opened */
+    if ((__libNvml != NULL) && (__libNvml->handle != NULL)) {
+        __libNvml->ref_count++;
+        pthread_mutex_unlock(&__libNvmlLock);
+        return __libNvml;
+    }
+
+    /* We are the first to open the library */
+    if (__libNvml == NULL) {
+        __libNvml = nvalloc(sizeof(NvCtrlNvmlLibrary));
+    }
+
+    if (!LoadNvml(__libNvml)) {
+        nvfree(__libNvml);
+        __libNvml = NULL;
+        pthread_mutex_unlock(&__libNvmlLock);
+        return NULL;
+    }
+
+    __libNvml->ref_count = 1;
+
+    pthread_mutex_unlock(&__libNvmlLock);
+
+    return __libNvml;
+}
+
+
+
+/*
+ * Drops a reference to the NVML library instance; the library is shut down
+ * and unloaded when the last user is gone.
+ */
+
+static void NvCtrlNvmlCloseLibrary(NvCtrlNvmlLibrary *lib)
+{
+    pthread_mutex_lock(&__libNvmlLock);
+
+    if ((lib == NULL) || (lib != __libNvml) || (lib->ref_count <= 0)) {
+        pthread_mutex_unlock(&__libNvmlLock);
+        return;
+    }
+
+    lib->ref_count--;
+
+    if (lib->ref_count == 0) {
+        UnloadNvml(lib);
+        nvfree(lib);
+        __libNvml = NULL;
+    }
+
+    pthread_mutex_unlock(&__libNvmlLock);
+}
+
+
+
 /*
  * Creates and fills an IDs dictionary so we can translate from NV-CONTROL IDs
  * to NVML indexes
@@ -254,20 +357,21 @@ fail:
  * XXX Needed while using NV-CONTROL as fallback during the migration process
  */
 
-static Bool matchNvCtrlWithNvmlIds(const NvCtrlNvmlAttributes *nvml,
-                                   const NvCtrlAttributePrivateHandle *h,
+static Bool matchNvCtrlWithNvmlIds(const NvCtrlNvmlLibrary *lib,
+                                   const CtrlSystem *system,
                                    int nvmlGpuCount,
                                    unsigned int **idsDictionary)
 {
-    char nvmlUUID[MAX_NVML_STR_LEN];
+    char (*nvmlUUIDs)[MAX_NVML_STR_LEN] = NULL;
     char *nvctrlUUID = NULL;
     nvmlDevice_t device;
     int i, j;
     int nvctrlGpuCount = 0;
 
     /* Get the gpu count returned by NV-CONTROL. */
-    if (h->nv && !XNVCTRLQueryTargetCount(h->dpy, NV_CTRL_TARGET_TYPE_GPU,
-                                          &nvctrlGpuCount)) {
+    if (system->has_nv_control &&
+        !XNVCTRLQueryTargetCount(system->dpy, NV_CTRL_TARGET_TYPE_GPU,
+                                 &nvctrlGpuCount)) {
         return FALSE;
     }
 
@@ -278,12 +382,28 @@ static Bool matchNvCtrlWithNvmlIds(const NvCtrlNvmlAttributes *nvml,
         (*idsDictionary)[i] = i;
     }
 
-    if (h->nv != NULL) {
+    if (system->has_nv_control) {
+
+        /*
+         * Get every NVML GPU UUID up front so that each one is only queried
+         * once, rather than once per NV-CONTROL GPU.  An empty string marks
+         * a device whose UUID could not be retrieved.
+         */
+        nvmlUUIDs = nvalloc(nvmlGpuCount * sizeof(*nvmlUUIDs));
+
+        for (j = 0; j < nvmlGpuCount; j++) {
+            if ((lib->deviceGetHandleByIndex(j, &device) != NVML_SUCCESS) ||
+                (lib->deviceGetUUID(device, nvmlUUIDs[j],
+                                    MAX_NVML_STR_LEN) != NVML_SUCCESS)) {
+                nvmlUUIDs[j][0] = '\0';
+            }
+        }
+
         for (i = 0; i < nvctrlGpuCount; i++) {
             Bool gpuUUIDMatchFound = FALSE;
 
             /* Get GPU UUID through NV-CONTROL */
-            if (!XNVCTRLQueryTargetStringAttribute(h->dpy,
+            if (!XNVCTRLQueryTargetStringAttribute(system->dpy,
                                                    NV_CTRL_TARGET_TYPE_GPU,
                                                    i, 0,
                                                    NV_CTRL_STRING_GPU_UUID,
@@ -297,19 +417,13 @@ static Bool matchNvCtrlWithNvmlIds(const NvCtrlNvmlAttributes *nvml,
 
             /* Look for the same UUID through NVML */
             for (j = 0; j < nvmlGpuCount; j++) {
-                if (NVML_SUCCESS != nvml->lib.deviceGetHandleByIndex(j, &device)) {
-                    continue;
-                }
-
-                if (NVML_SUCCESS != nvml->lib.deviceGetUUID(device, nvmlUUID,
-                                                            MAX_NVML_STR_LEN)) {
-                    continue;
-                }
-
-                if (strcmp(nvctrlUUID, nvmlUUID) == 0) {
+                if ((nvmlUUIDs[j][0] != '\0') &&
+                    (strcmp(nvctrlUUID, nvmlUUIDs[j]) == 0)) {
                     /* We got a match */
                     gpuUUIDMatchFound = TRUE;
-                    (*idsDictionary)[i] = j;
+                    if (i < nvmlGpuCount) {
+                        (*idsDictionary)[i] = j;
+                    }
                     break;
                 }
             }
@@ -323,421 +437,569 @@ static Bool matchNvCtrlWithNvmlIds(const NvCtrlNvmlAttributes *nvml,
                 goto fail;
             }
         }
+
+        nvfree(nvmlUUIDs);
     }
     return TRUE;
 
 fail:
+    nvfree(nvmlUUIDs);
     nvfree(*idsDictionary);
+    *idsDictionary = NULL;
     return FALSE;
 }
 
 
 
 /*
- * Initializes an NVML private handle to hold some information to be used later
- * on
+ * Free the sampler resources; the thread must not be running anymore
  */
 
-NvCtrlNvmlAttributes *NvCtrlInitNvmlAttributes(NvCtrlAttributePrivateHandle *h)
+static void freeSampler(NvCtrlNvmlSampler *sampler)
 {
-    NvCtrlNvmlAttributes *nvml = NULL;
-    unsigned int count;
-    unsigned int *nvctrlToNvmlId;
     int i;
-    int nvctrlCoolerCount;
-
-    /* Check parameters */
-    if (h == NULL || !TARGET_TYPE_IS_NVML_COMPATIBLE(h->target_type)) {
-        goto fail;
-    }
 
-    /* Create storage for NVML attributes */
-    nvml = nvalloc(sizeof(NvCtrlNvmlAttributes));
+    pthread_mutex_destroy(&sampler->lock);
+    pthread_cond_destroy(&sampler->cond);
 
-    if (!LoadNvml(nvml)) {
-        goto fail;
+    for (i = 0; i < NVML_SAMPLER_RING_SIZE; i++) {
+        nvfree(sampler->slots[i].telemetry);
     }
+    nvfree(sampler);
+}
 
-    /* Initialize NVML attributes */
-    if (nvml->lib.deviceGetCount(&count) != NVML_SUCCESS) {
-        goto fail;
-    }
-    nvml->deviceCount = count;
 
-    nvml->sensorCountPerGPU = nvalloc(count * sizeof(unsigned int));
-    nvml->sensorCount = 0;
-    nvml->coolerCountPerGPU = nvalloc(count * sizeof(unsigned int));
-    nvml->coolerCount = 0;
 
-    /* Fill the NV-CONTROL to NVML IDs dictionary */
-    if (!matchNvCtrlWithNvmlIds(nvml, h, count, &nvctrlToNvmlId)) {
-        goto fail;
-    }
+/*
+ * Stop the sampler thread, waiting for its current sampling pass to end
+ */
 
-    /*
-     * Fill 'sensorCountPerGPU', 'coolerCountPerGPU' and properly set
-     * 'deviceIdx'
-     */
-    nvml->deviceIdx = h->target_id; /* Fallback */
+static void stopSampler(NvCtrlNvmlSampler *sampler)
+{
+    pthread_mutex_lock(&sampler->lock);
+    sampler->stop = TRUE;
+    pthread_cond_signal(&sampler->cond);
+    pthread_mutex_unlock(&sampler->lock);
 
-    if (h->target_type == GPU_TARGET) {
-        nvml->deviceIdx = nvctrlToNvmlId[h->target_id];
-    }
+    pthread_join(sampler->thread, NULL);
 
-    for (i = 0; i < count; i++) {
-        int devIdx = nvctrlToNvmlId[i];
-        nvmlDevice_t device;
-        nvmlReturn_t ret = nvml->lib.deviceGetHandleByIndex(devIdx, &device);
-        if (ret == NVML_SUCCESS) {
-            unsigned int temp;
-            unsigned int fans;
+    freeSampler(sampler);
+}
 
-            /*
-             * XXX Currently, NVML only allows to get the GPU temperature so
-             *     check for nvmlDeviceGetTemperature() success to figure
-             *     out if that sensor is available.
-             */
-            ret = nvml->lib.deviceGetTemperature(device, NVML_TEMPERATURE_GPU,
-                                                 &temp);
-            if (ret == NVML_SUCCESS) {
-                if ((h->target_type == THERMAL_SENSOR_TARGET) &&
-                    (h->target_id == nvml->sensorCount)) {
 
-                    nvml->deviceIdx = devIdx;
-                }
 
-                nvml->sensorCountPerGPU[i] = 1;
-                nvml->sensorCount++;
-            }
+/*
+ * Free the event listener resources; the thread must not be running anymore
+ */
 
-            ret = nvml->lib.deviceGetNumFans(device, &fans);
-            if (ret == NVML_SUCCESS) {
-                if ((h->target_type == COOLER_TARGET) &&
-                    (h->target_id == nvml->coolerCount)) {
+static void freeEvents(NvCtrlNvmlEvents *events)
+{
+    if (events->set != NULL) {
+        events->lib->eventSetFree(events->set);
+    }
+    if (events->fds[0] != -1) {
+        close(events->fds[0]);
+    }
+    if (events->fds[1] != -1) {
+        close(events->fds[1]);
+    }
 
-                    nvml->deviceIdx = devIdx;
-                }
+    nvfree(events->devices);
+    nvfree(events->eventTypes);
+    nvfree(events->nvctrlIds);
+    nvfree(events);
+}
 
-                nvml->coolerCountPerGPU[i] = fans;
-                nvml->coolerCount += fans;
-            }
-        }
-    }
 
-    /*
-     * Consistency check between X/NV-CONTROL and NVML.
-     */
-    if (h->nv &&
-        (!XNVCTRLQueryTargetCount(h->dpy, NV_CTRL_TARGET_TYPE_COOLER,
-                                   &nvctrlCoolerCount) ||
-         (nvctrlCoolerCount != nvml->coolerCount))) {
-        nv_warning_msg("Inconsistent number of fans detected.");
-    }
 
-    nvfree(nvctrlToNvmlId);
+/*
+ * Stop the event listener thread.  It notices the request the next time its
+ * wait on the event set times out.
+ */
 
-    return nvml;
+static void stopEvents(NvCtrlNvmlEvents *events)
+{
+    __atomic_store_n(&events->stop, TRUE, __ATOMIC_RELEASE);
 
- fail:
-    UnloadNvml(nvml);
-    nvfree(nvml->sensorCountPerGPU);
-    nvfree(nvml->coolerCountPerGPU);
-    nvfree(nvml);
-    return NULL;
+    pthread_join(events->thread, NULL);
+
+    freeEvents(events);
 }
 
 
 
 /*
- * Frees any resource hold by the NVML private handle
+ * Attributes the NVML backend can answer, per target type.  These must be
+ * kept in sync with the NvCtrlNvmlGet*Attribute(), valid values and perms
+ * functions below: when NV-CONTROL is available, any other attribute of an
+ * NVML target is sent to it without asking NVML first.
+ *
+ * NV_CTRL_STRING_GPU_UTILIZATION is only read from NVML when there is no
+ * NV-CONTROL, so it is not listed.
  */
 
-void NvCtrlNvmlAttributesClose(NvCtrlAttributePrivateHandle *h)
+static const int nvmlGpuIntAttributes[] = {
+    NV_CTRL_TOTAL_DEDICATED_GPU_MEMORY,
+    NV_CTRL_USED_DEDICATED_GPU_MEMORY,
+    NV_CTRL_PCI_DOMAIN,
+    NV_CTRL_PCI_BUS,
+    NV_CTRL_PCI_DEVICE,
+    NV_CTRL_PCI_FUNCTION,
+    NV_CTRL_PCI_ID,
+    NV_CTRL_GPU_PCIE_GENERATION,
+    NV_CTRL_GPU_PCIE_CURRENT_LINK_WIDTH,
+    NV_CTRL_GPU_PCIE_MAX_LINK_WIDTH,
+    NV_CTRL_GPU_SLOWDOWN_THRESHOLD,
+    NV_CTRL_GPU_SHUTDOWN_THRESHOLD,
+    NV_CTRL_GPU_CORE_TEMPERATURE,
+    NV_CTRL_GPU_ECC_SUPPORTED,
+    NV_CTRL_GPU_ECC_CONFIGURATION_SUPPORTED,
+    NV_CTRL_GPU_ECC_STATUS,
+    NV_CTRL_GPU_ECC_CONFIGURATION,
+    NV_CTRL_GPU_ECC_SINGLE_BIT_ERRORS,
+    NV_CTRL_GPU_ECC_AGGREGATE_SINGLE_BIT_ERRORS,
+    NV_CTRL_GPU_ECC_DOUBLE_BIT_ERRORS,
+    NV_CTRL_GPU_ECC_AGGREGATE_DOUBLE_BIT_ERRORS,
+    NV_CTRL_GPU_ECC_RESET_ERROR_STATUS,
+    NV_CTRL_GPU_CORES,
+    NV_CTRL_GPU_MEMORY_BUS_WIDTH,
+    NV_CTRL_IRQ,
+    NV_CTRL_GPU_POWER_SOURCE,
+};
+
+static const int nvmlCoolerIntAttributes[] = {
+    NV_CTRL_THERMAL_COOLER_CURRENT_LEVEL,
+};
+
+static const int nvmlGpuStringAttributes[] = {
+    NV_CTRL_STRING_PRODUCT_NAME,
+    NV_CTRL_STRING_VBIOS_VERSION,
+    NV_CTRL_STRING_GPU_UUID,
+};
+
+/* Answered for any NVML target, see NvCtrlNvmlGetGeneralStringAttribute() */
+static const int nvmlGeneralStringAttributes[] = {
+    NV_CTRL_STRING_NVIDIA_DRIVER_VERSION,
+    NV_CTRL_STRING_NVML_VERSION,
+};
+
+static void buildRoutingTable(NvCtrlNvmlSystem *sys)
 {
-    /* Check parameters */
-    if (h == NULL || h->nvml == NULL) {
-        return;
+    static const CtrlTargetType targetTypes[] = {
+        GPU_TARGET, THERMAL_SENSOR_TARGET, COOLER_TARGET,
+    };
+    int i, j;
+
+#define ROUTE(table, target_type, attrs)                    \
+    for (i = 0; i < ARRAY_LEN(attrs); i++) {                \
+        sys->table[target_type][attrs[i]] = TRUE;           \
     }
 
-    UnloadNvml(h->nvml);
-    nvfree(h->nvml->sensorCountPerGPU);
-    nvfree(h->nvml->coolerCountPerGPU);
-    nvfree(h->nvml);
-    h->nvml = NULL;
+    ROUTE(intRoutes, GPU_TARGET, nvmlGpuIntAttributes);
+    ROUTE(intRoutes, COOLER_TARGET, nvmlCoolerIntAttributes);
+    ROUTE(stringRoutes, GPU_TARGET, nvmlGpuStringAttributes);
+
+    for (j = 0; j < ARRAY_LEN(targetTypes); j++) {
+        ROUTE(stringRoutes, targetTypes[j], nvmlGeneralStringAttributes);
+    }
+
+#undef ROUTE
 }
 
 
 
 /*
- * Get the number of 'target_type' targets according to NVML
+ * Loads the NVML library for the given system and builds the NV-CONTROL to
+ * NVML GPU IDs dictionary.  This is done once per system, when the system is
+ * loaded, and then shared by every NVML target created for it.
  */
 
-ReturnStatus NvCtrlNvmlQueryTargetCount(const CtrlTarget *ctrl_target,
-                                        int target_type, int *val)
+NvCtrlNvmlSystem *NvCtrlInitNvmlSystem(CtrlSystem *system)
 {
-    const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
+    NvCtrlNvmlSystem *sys;
+    unsigned int count;
 
-    if (NvmlMissing(ctrl_target)) {
-        return NvCtrlMissingExtension;
+    if (system == NULL) {
+        return NULL;
     }
 
-    /*
-     * This shouldn't be reached for target types that are not handled through
-     * NVML (Keep TARGET_TYPE_IS_NVML_COMPATIBLE in NvCtrlAttributesPrivate.h up
-     * to date).
-     */
-    assert(TARGET_TYPE_IS_NVML_COMPATIBLE(target_type));
+    sys = nvalloc(sizeof(NvCtrlNvmlSystem));
+    pthread_mutex_init(&sys->lock, NULL);
 
-    if ((h == NULL) || (h->nvml == NULL)) {
-        return NvCtrlBadHandle;
+    sys->lib = NvCtrlNvmlOpenLibrary();
+    if (sys->lib == NULL) {
+        goto fail;
     }
 
-    switch (target_type) {
-        case GPU_TARGET:
-            *val = (int)(h->nvml->deviceCount);
-            break;
-        case THERMAL_SENSOR_TARGET:
-            *val = (int)(h->nvml->sensorCount);
-            break;
-        case COOLER_TARGET:
-            *val = (int)(h->nvml->coolerCount);
-            break;
-        default:
-            return NvCtrlBadArgument;
+    if (sys->lib->deviceGetCount(&count) != NVML_SUCCESS) {
+        goto fail;
     }
+    sys->deviceCount = count;
+    sys->telemetry = nvalloc(count * sizeof(CtrlGpuTelemetry));
 
-    return NvCtrlSuccess;
+    /* Fill the NV-CONTROL to NVML IDs dictionary */
+    if (!matchNvCtrlWithNvmlIds(sys->lib, system, count,
+                                &sys->nvctrlToNvmlId)) {
+        goto fail;
+    }
+
+    buildRoutingTable(sys);
+
+    return sys;
+
+ fail:
+    NvCtrlNvmlCloseLibrary(sys->lib);
+    nvfree(sys->telemetry);
+    pthread_mutex_destroy(&sys->lock);
+    nvfree(sys);
+    return NULL;
 }
 
 
 
 /*
- * Get NVML String Attribute Values that do not require a control target.
+ * Returns whether an attribute query on the given NVML target should be
+ * sent to NVML.  Attributes NVML does not know about are routed straight to
+ * NV-CONTROL when it is available; without it, NVML is still asked so that
+ * its answer is reported.
  */
 
-static ReturnStatus NvCtrlNvmlGetGeneralStringAttribute(const CtrlTarget *ctrl_target,
-                                                        int attr, char **ptr)
+Bool NvCtrlNvmlRoutesAttribute(const NvCtrlAttributePrivateHandle *h,
+                               CtrlAttributeType attr_type, int attr)
 {
-    char res[MAX_NVML_STR_LEN];
-    const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
-    nvmlReturn_t ret;
-    *ptr = NULL;
+    NvCtrlNvmlSystem *sys;
+    Bool routed;
 
-    if ((h == NULL) || (h->nvml == NULL)) {
-        return NvCtrlBadHandle;
+    if ((h->nvml == NULL) || (h->nv == NULL) ||
+        (h->system == NULL) || (h->system->nvml == NULL)) {
+        return TRUE;
     }
 
-    switch (attr) {
-        case NV_CTRL_STRING_NVIDIA_DRIVER_VERSION:
-            ret = h->nvml->lib.systemGetDriverVersion(res, MAX_NVML_STR_LEN);
-            break;
+    sys = h->system->nvml;
 
-        case NV_CTRL_STRING_NVML_VERSION:
-            ret = h->nvml->lib.systemGetNVMLVersion(res, MAX_NVML_STR_LEN);
+    switch (attr_type) {
+        case CTRL_ATTRIBUTE_TYPE_INTEGER:
+            routed = (attr >= 0) && (attr <= NV_CTRL_LAST_ATTRIBUTE) &&
+                     sys->intRoutes[h->target_type][attr];
+            break;
+        case CTRL_ATTRIBUTE_TYPE_STRING:
+            routed = (attr >= 0) && (attr <= NV_CTRL_STRING_LAST_ATTRIBUTE) &&
+                     sys->stringRoutes[h->target_type][attr];
             break;
-
         default:
-            /* This is expected to fall through silently. */
-            return NvCtrlNotSupported;
+            return TRUE;
     }
 
-    if (ret == NVML_SUCCESS) {
-        *ptr = strdup(res);
-        return NvCtrlSuccess;
+    if (!routed) {
+        __sync_fetch_and_add(&sys->misroutesAvoided, 1);
     }
 
-    /* An NVML error occurred */
-    printNvmlError(ret);
-    return NvCtrlNotSupported;
+    return routed;
 }
 
 
 
 /*
- * Get NVML String Attribute Values
+ * Frees the NVML state of the given system
  */
 
-static ReturnStatus NvCtrlNvmlGetGPUStringAttribute(const CtrlTarget *ctrl_target,
-                                                    int attr, char **ptr)
+void NvCtrlNvmlSystemClose(CtrlSystem *system)
 {
-    char res[MAX_NVML_STR_LEN];
-    const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
-    const NvCtrlNvmlAttributes *nvml;
-    nvmlDevice_t device;
-    nvmlReturn_t ret;
-    *ptr = NULL;
+    if (system == NULL || system->nvml == NULL) {
+        return;
+    }
 
-    nvml = getNvmlHandleConst(h);
-    if (nvml == NULL) {
-        return NvCtrlBadHandle;
+    if (system->nvml->sampler != NULL) {
+        stopSampler(system->nvml->sampler);
     }
 
-    ret = nvml->lib.deviceGetHandleByIndex(nvml->deviceIdx, &device);
-    if (ret == NVML_SUCCESS) {
-        switch (attr) {
-            case NV_CTRL_STRING_PRODUCT_NAME:
-                ret = nvml->lib.deviceGetName(device, res, MAX_NVML_STR_LEN);
-                break;
+    if (system->nvml->events != NULL) {
+        stopEvents(system->nvml->events);
+    }
 
-            case NV_CTRL_STRING_VBIOS_VERSION:
-                ret = nvml->lib.deviceGetVbiosVersion(device, res, MAX_NVML_STR_LEN);
-                break;
+    NvCtrlNvmlCloseLibrary(system->nvml->lib);
+    nvfree(system->nvml->nvctrlToNvmlId);
+    nvfree(system->nvml->telemetry);
+    nvfree(system->nvml->sensorCountPerGPU);
+    nvfree(system->nvml->coolerCountPerGPU);
+    pthread_mutex_destroy(&system->nvml->lock);
+    nvfree(system->nvml);
+    system->nvml = NULL;
+}
 
-            case NV_CTRL_STRING_GPU_UUID:
-                ret = nvml->lib.deviceGetUUID(device, res, MAX_NVML_STR_LEN);
-                break;
 
-            case NV_CTRL_STRING_GPU_UTILIZATION:
-            {
-                nvmlUtilization_t util;
 
-                if (ctrl_target->system->has_nv_control) {
-                    /*
-                     * Not all utilization types are currently available via
-                     * NVML so, if accessible, get the rates from X.
-                     */
-                    return NvCtrlNotSupported;
-                }
+/*
+ * Returns the NVML state of the given system, with the thermal sensor and
+ * cooler topology filled in.  Probing the topology costs two driver calls per
+ * GPU, so it is done once per system and only when a thermal sensor or cooler
+ * is actually needed rather than for every target.
+ */
 
-                ret = nvml->lib.deviceGetUtilizationRates(device, &util);
+static const NvCtrlNvmlSystem *getNvmlTopology(CtrlSystem *system)
+{
+    NvCtrlNvmlSystem *sys;
+    int i;
+    int nvctrlCoolerCount;
 
-                if (ret != NVML_SUCCESS) {
-                    break;
-                }
+    if (system == NULL || system->nvml == NULL) {
+        return NULL;
+    }
 
-                snprintf(res, sizeof(res),
-                         "graphics=%d, memory=%d",
-                         util.gpu, util.memory);
+    sys = system->nvml;
 
-                break;
-            }
-            case NV_CTRL_STRING_SLI_MODE:
-            case NV_CTRL_STRING_PERFORMANCE_MODES:
-            case NV_CTRL_STRING_GPU_CURRENT_CLOCK_FREQS:
-            case NV_CTRL_STRING_MULTIGPU_MODE:
-                /*
-                 * XXX We'll eventually need to add support for this attributes
-                 *     through NVML
-                 */
-                return NvCtrlNotSupported;
+    pthread_mutex_lock(&sys->lock);
 
-            default:
-                /* Did we forget to handle a GPU string attribute? */
-                nv_warning_msg("Unhandled string attribute %s (%d) of GPU (%d)",
-                               STR_ATTRIBUTE_NAME(attr), attr,
-                               NvCtrlGetTargetId(ctrl_target));
-                return NvCtrlNotSupported;
-        }
+    if (sys->topologyLoaded) {
+        pthread_mutex_unlock(&sys->lock);
+        return sys;
+    }
 
+    sys->sensorCountPerGPU = nvalloc(sys->deviceCount * sizeof(unsigned int));
+    sys->sensorCount = 0;
+    sys->coolerCountPerGPU = nvalloc(sys->deviceCount * sizeof(unsigned int));
+    sys->coolerCount = 0;
+
+    for (i = 0; i < sys->deviceCount; i++) {
+        nvmlDevice_t device;
+        nvmlReturn_t ret =
+            sys->lib->deviceGetHandleByIndex(sys->nvctrlToNvmlId[i], &device);
         if (ret == NVML_SUCCESS) {
-            *ptr = strdup(res);
-            return NvCtrlSuccess;
+            unsigned int temp;
+            unsigned int fans;
+
+            /*
+             * XXX Currently, NVML only allows to get the GPU temperature so
+             *     check for nvmlDeviceGetTemperature() success to figure
+             *     out if that sensor is available.
+             */
+            ret = sys->lib->deviceGetTemperature(device, NVML_TEMPERATURE_GPU,
+                                                 &temp);
+            if (ret == NVML_SUCCESS) {
+                sys->sensorCountPerGPU[i] = 1;
+                sys->sensorCount++;
+            }
+
+            ret = sys->lib->deviceGetNumFans(device, &fans);
+            if (ret == NVML_SUCCESS) {
+                sys->coolerCountPerGPU[i] = fans;
+                sys->coolerCount += fans;
+            }
         }
     }
 
-    /* An NVML error occurred */
-    printNvmlError(ret);
-    return NvCtrlNotSupported;
+    sys->topologyLoaded = TRUE;
+
+    /*
+     * Consistency check between X/NV-CONTROL and NVML.
+     */
+    if (system->has_nv_control &&
+        (!XNVCTRLQueryTargetCount(system->dpy, NV_CTRL_TARGET_TYPE_COOLER,
+                                   &nvctrlCoolerCount) ||
+         (nvctrlCoolerCount != sys->coolerCount))) {
+        nv_warning_msg("Inconsistent number of fans detected.");
+    }
+
+    pthread_mutex_unlock(&sys->lock);
+
+    return sys;
 }
 
 
 
-ReturnStatus NvCtrlNvmlGetStringAttribute(const CtrlTarget *ctrl_target,
-                                          int attr, char **ptr)
+/*
+ * Returns the NVML device index backing the given thermal sensor or cooler
+ * target, or -1 if the target id is out of range.
+ */
+
+static int getThermalCoolerDeviceIdx(const NvCtrlNvmlSystem *sys,
+                                     int target_id,
+                                     const unsigned int *countPerGPU)
 {
-    ReturnStatus ret;
+    unsigned int count = 0;
+    int i;
 
-    if (NvmlMissing(ctrl_target)) {
-        return NvCtrlMissingExtension;
+    for (i = 0; i < sys->deviceCount; i++) {
+        count += countPerGPU[i];
+        if (target_id < count) {
+            return sys->nvctrlToNvmlId[i];
+        }
+    }
+
+    return -1;
+}
+
+
+
+/*
+ * Initializes an NVML private handle to hold some information to be used later
+ * on
+ */
+
+NvCtrlNvmlAttributes *NvCtrlInitNvmlAttributes(NvCtrlAttributePrivateHandle *h)
+{
+    NvCtrlNvmlAttributes *nvml = NULL;
+    const NvCtrlNvmlSystem *sys;
+    int devIdx;
+
+    /* Check parameters */
+    if (h == NULL || !TARGET_TYPE_IS_NVML_COMPATIBLE(h->target_type)) {
+        goto fail;
+    }
+
+    /* The library and IDs dictionary are set up once for the whole system */
+    sys = h->system->nvml;
+    if (sys == NULL) {
+        goto fail;
+    }
+
+    /* Create storage for NVML attributes */
+    nvml = nvalloc(sizeof(NvCtrlNvmlAttributes));
+
+    /* Share the library instance already loaded by the system */
+    nvml->lib = NvCtrlNvmlOpenLibrary();
+    if (nvml->lib == NULL) {
+        goto fail;
     }
 
+    /* Initialize NVML attributes */
+    nvml->deviceCount = sys->deviceCount;
+
     /*
-     * Check for attributes that don't require a target, else continue to
-     * supported target types.
+     * Properly set 'deviceIdx'.  Thermal sensors and coolers need the
+     * system's topology to be mapped to their GPU.
      */
-    ret = NvCtrlNvmlGetGeneralStringAttribute(ctrl_target, attr, ptr);
+    nvml->deviceIdx = h->target_id; /* Fallback */
 
-    if (ret == NvCtrlSuccess) {
-        return NvCtrlSuccess;
+    switch (h->target_type) {
+        case GPU_TARGET:
+            nvml->deviceIdx = sys->nvctrlToNvmlId[h->target_id];
+            break;
+        case THERMAL_SENSOR_TARGET:
+            sys = getNvmlTopology(h->system);
+            devIdx = getThermalCoolerDeviceIdx(sys, h->target_id,
+                                               sys->sensorCountPerGPU);
+            if (devIdx != -1) {
+                nvml->deviceIdx = devIdx;
+            }
+            break;
+        case COOLER_TARGET:
+            sys = getNvmlTopology(h->system);
+            devIdx = getThermalCoolerDeviceIdx(sys, h->target_id,
+                                               sys->coolerCountPerGPU);
+            if (devIdx != -1) {
+                nvml->deviceIdx = devIdx;
+            }
+            break;
+        default:
+            break;
     }
 
-    switch (NvCtrlGetTargetType(ctrl_target)) {
-        case GPU_TARGET:
-            return NvCtrlNvmlGetGPUStringAttribute(ctrl_target, attr, ptr);
+    /*
+     * Resolve the device handle once; the UUID lets getNvmlDevice() find
+     * the same GPU again if the handle goes stale.
+     */
+    if (nvml->lib->deviceGetHandleByIndex(nvml->deviceIdx,
+                                          &nvml->device) == NVML_SUCCESS) {
+        nvml->deviceValid = TRUE;
 
-        case THERMAL_SENSOR_TARGET:
-            /* Did we forget to handle a sensor string attribute? */
-            nv_warning_msg("Unhandled string attribute %s (%d) of Thermal "
-                           "sensor (%d)", STR_ATTRIBUTE_NAME(attr), attr,
-                           NvCtrlGetTargetId(ctrl_target));
-            return NvCtrlNotSupported;
+        if (nvml->lib->deviceGetUUID(nvml->device, nvml->deviceUUID,
+                                     sizeof(nvml->deviceUUID)) != NVML_SUCCESS) {
+            nvml->deviceUUID[0] = '\0';
+        }
+    }
 
-        case COOLER_TARGET:
-            /* Did we forget to handle a cooler string attribute? */
-            nv_warning_msg("Unhandled string attribute %s (%d) of Fan (%d)",
-                           STR_ATTRIBUTE_NAME(attr), attr,
-                           NvCtrlGetTargetId(ctrl_target));
-            return NvCtrlNotSupported;
+    return nvml;
 
-        default:
-            return NvCtrlBadHandle;
+ fail:
+    if (nvml != NULL) {
+        NvCtrlNvmlCloseLibrary(nvml->lib);
+        nvfree(nvml);
     }
+    return NULL;
 }
 
 
 
 /*
- * Set NVML String Attribute Values
+ * Frees any resource hold by the NVML private handle
  */
 
+void NvCtrlNvmlAttributesClose(NvCtrlAttributePrivateHandle *h)
+{
+    /* Check parameters */
+    if (h == NULL || h->nvml == NULL) {
+        return;
+    }
+
+    NvCtrlNvmlCloseLibrary(h->nvml->lib);
+    nvfree(h->nvml);
+    h->nvml = NULL;
+}
 
 
-static ReturnStatus NvCtrlNvmlSetGPUStringAttribute(CtrlTarget *ctrl_target,
-                                                    int attr, const char *ptr)
-{
-    const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
-    const NvCtrlNvmlAttributes *nvml;
-    nvmlDevice_t device;
-    nvmlReturn_t ret;
 
-    nvml = getNvmlHandleConst(h);
-    if (nvml == NULL) {
-        return NvCtrlBadHandle;
-    }
+/*
+ * Returns the NVML device handle of the target, resolving it again if it was
+ * invalidated by checkNvmlDevice().  After a GPU reset or hot-unplug the
+ * device index may point to a different GPU, so the handle is looked up by
+ * UUID when possible.
+ */
 
-    ret = nvml->lib.deviceGetHandleByIndex(nvml->deviceIdx, &device);
-    if (ret == NVML_SUCCESS) {
-        switch (attr) {
-            case NV_CTRL_STRING_GPU_CURRENT_CLOCK_FREQS:
-                /*
-                 * XXX We'll eventually need to add support for this attributes
-                 *     through NVML
-                 */
-                return NvCtrlNotSupported;
+static nvmlReturn_t getNvmlDevice(NvCtrlNvmlAttributes *nvml,
+                                  nvmlDevice_t *device)
+{
+    nvmlReturn_t ret;
 
-            default:
-                /* Did we forget to handle a GPU string attribute? */
-                nv_warning_msg("Unhandled string attribute %s (%d) of GPU (%d) "
-                               "(set to '%s')", STR_ATTRIBUTE_NAME(attr), attr,
-                               NvCtrlGetTargetId(ctrl_target), (ptr ? ptr : ""));
-                return NvCtrlNotSupported;
+    if (!nvml->deviceValid) {
+        if ((nvml->deviceUUID[0] != '\0') &&
+            (nvml->lib->deviceGetHandleByUUID != NULL)) {
+            ret = nvml->lib->deviceGetHandleByUUID(nvml->deviceUUID,
+                                                   &nvml->device);
+        } else {
+            ret = nvml->lib->deviceGetHandleByIndex(nvml->deviceIdx,
+                                                    &nvml->device);
         }
 
-        if (ret == NVML_SUCCESS) {
-            return NvCtrlSuccess;
+        if (ret != NVML_SUCCESS) {
+            return ret;
         }
+
+        nvml->deviceValid = TRUE;
     }
 
-    /* An NVML error occurred */
-    printNvmlError(ret);
-    return NvCtrlNotSupported;
+    *device = nvml->device;
+    return NVML_SUCCESS;
 }
 
 
 
-ReturnStatus NvCtrlNvmlSetStringAttribute(CtrlTarget *ctrl_target,
-                                          int attr, const char *ptr)
+/*
+ * Drops the cached device handle if 'ret' indicates that the GPU has fallen
+ * off the bus or has otherwise become inaccessible, so the next query does
+ * not keep using a stale handle.
+ */
+
+static void checkNvmlDevice(NvCtrlNvmlAttributes *nvml, nvmlReturn_t ret)
+{
+    if ((ret == NVML_ERROR_GPU_IS_LOST) ||
+        (ret == NVML_ERROR_UNINITIALIZED)) {
+        nvml->deviceValid = FALSE;
+    }
+}
+
+
+
+/*
+ * Get the number of 'target_type' targets according to NVML
+ */
+
+ReturnStatus NvCtrlNvmlQueryTargetCount(const CtrlTarget *ctrl_target,
+                                        int target_type, int *val)
 {
+    const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
+    const NvCtrlNvmlSystem *sys;
+
     if (NvmlMissing(ctrl_target)) {
         return NvCtrlMissingExtension;
     }
@@ -747,98 +1009,380 @@ ReturnStatus NvCtrlNvmlSetStringAttribute(CtrlTarget *ctrl_target,
      * NVML (Keep TARGET_TYPE_IS_NVML_COMPATIBLE in NvCtrlAttributesPrivate.h up
      * to date).
      */
-    assert(TARGET_TYPE_IS_NVML_COMPATIBLE(NvCtrlGetTargetType(ctrl_target)));
+    assert(TARGET_TYPE_IS_NVML_COMPATIBLE(target_type));
 
-    switch (NvCtrlGetTargetType(ctrl_target)) {
-        case GPU_TARGET:
-            return NvCtrlNvmlSetGPUStringAttribute(ctrl_target, attr, ptr);
+    if ((h == NULL) || (h->nvml == NULL)) {
+        return NvCtrlBadHandle;
+    }
 
+    switch (target_type) {
+        case GPU_TARGET:
+            *val = (int)(h->nvml->deviceCount);
+            break;
         case THERMAL_SENSOR_TARGET:
-            /* Did we forget to handle a sensor string attribute? */
-            nv_warning_msg("Unhandled string attribute %s (%d) of Thermal "
-                           "sensor (%d) (set to '%s')",
-                           STR_ATTRIBUTE_NAME(attr), attr,
-                           NvCtrlGetTargetId(ctrl_target), (ptr ? ptr : ""));
-            return NvCtrlNotSupported;
-
+            sys = getNvmlTopology(h->system);
+            *val = (sys != NULL) ? (int)(sys->sensorCount) : 0;
+            break;
         case COOLER_TARGET:
-            /* Did we forget to handle a cooler string attribute? */
-            nv_warning_msg("Unhandled string attribute %s (%d) of Fan (%d) "
-                           "(set to '%s')", STR_ATTRIBUTE_NAME(attr), attr,
-                           NvCtrlGetTargetId(ctrl_target), (ptr ? ptr : ""));
-            return NvCtrlNotSupported;
-
+            sys = getNvmlTopology(h->system);
+            *val = (sys != NULL) ? (int)(sys->coolerCount) : 0;
+            break;
         default:
-            return NvCtrlBadHandle;
+            return NvCtrlBadArgument;
     }
+
+    return NvCtrlSuccess;
 }
 
 
 
 /*
- * Get NVML Attribute Values
+ * Get NVML String Attribute Values that do not require a control target.
  */
 
-static ReturnStatus NvCtrlNvmlGetGPUAttribute(const CtrlTarget *ctrl_target,
-                                              int attr, int64_t *val)
+static ReturnStatus NvCtrlNvmlGetGeneralStringAttribute(const CtrlTarget *ctrl_target,
+                                                        int attr, char **ptr)
 {
-    unsigned int res = 0;
+    char res[MAX_NVML_STR_LEN];
     const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
-    const NvCtrlNvmlAttributes *nvml;
-    nvmlDevice_t device;
     nvmlReturn_t ret;
+    *ptr = NULL;
 
-    nvml = getNvmlHandleConst(h);
-    if (nvml == NULL) {
+    if ((h == NULL) || (h->nvml == NULL)) {
         return NvCtrlBadHandle;
     }
 
-    ret = nvml->lib.deviceGetHandleByIndex(nvml->deviceIdx, &device);
-    if (ret == NVML_SUCCESS) {
-        switch (attr) {
-            case NV_CTRL_TOTAL_DEDICATED_GPU_MEMORY:
-            case NV_CTRL_USED_DEDICATED_GPU_MEMORY:
-                {
-                    if (nvml->lib.deviceGetMemoryInfo_v2) {
-                        nvmlMemory_v2_t memory;
-                        memory.version = nvmlMemory_v2;
-                        ret = nvml->lib.deviceGetMemoryInfo_v2(device, &memory);
-                        if (ret == NVML_SUCCESS) {
-                            switch (attr) {
-                                case NV_CTRL_TOTAL_DEDICATED_GPU_MEMORY:
-                                    res = memory.total >> 20; // bytes --> MB
-                                    break;
-                                case NV_CTRL_USED_DEDICATED_GPU_MEMORY:
-                                    res = memory.used >> 20; // bytes --> MB
-                                    break;
-                            }
-                        }
-                    } else {
-                        nvmlMemory_t memory;
-                        ret = nvml->lib.deviceGetMemoryInfo(device, &memory);
-                        if (ret == NVML_SUCCESS) {
-                            switch (attr) {
-                                case NV_CTRL_TOTAL_DEDICATED_GPU_MEMORY:
-                                    res = memory.total >> 20; // bytes --> MB
-                                    break;
-                                case NV_CTRL_USED_DEDICATED_GPU_MEMORY:
-                                    res = memory.used >> 20; // bytes --> MB
-                                    break;
-                            }
-                        }
-                    }
-                }
-                break;
+    switch (attr) {
+        case NV_CTRL_STRING_NVIDIA_DRIVER_VERSION:
+            ret = h->nvml->lib->systemGetDriverVersion(res, MAX_NVML_STR_LEN);
+            break;
 
-            case NV_CTRL_PCI_DOMAIN:
-            case NV_CTRL_PCI_BUS:
-            case NV_CTRL_PCI_DEVICE:
-            case NV_CTRL_PCI_FUNCTION:
-            case NV_CTRL_PCI_ID:
-                {
-                    nvmlPciInfo_t pci;
-                    ret = nvml->lib.deviceGetPciInfo(device, &pci);
-                    if (ret == NVML_SUCCESS) {
+        case NV_CTRL_STRING_NVML_VERSION:
+            ret = h->nvml->lib->systemGetNVMLVersion(res, MAX_NVML_STR_LEN);
+            break;
+
+        default:
+            /* This is expected to fall through silently. */
+            return NvCtrlNotSupported;
+    }
+
+    if (ret == NVML_SUCCESS) {
+        *ptr = strdup(res);
+        return NvCtrlSuccess;
+    }
+
+    /* An NVML error occurred */
+    printNvmlError(ret);
+    return NvCtrlNotSupported;
+}
+
+
+
+/*
+ * Get NVML String Attribute Values
+ */
+
+static ReturnStatus NvCtrlNvmlGetGPUStringAttribute(const CtrlTarget *ctrl_target,
+                                                    int attr, char **ptr)
+{
+    char res[MAX_NVML_STR_LEN];
+    const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
+    NvCtrlNvmlAttributes *nvml;
+    nvmlDevice_t device;
+    nvmlReturn_t ret;
+    *ptr = NULL;
+
+    nvml = getNvmlHandle(h);
+    if (nvml == NULL) {
+        return NvCtrlBadHandle;
+    }
+
+    ret = getNvmlDevice(nvml, &device);
+    if (ret == NVML_SUCCESS) {
+        switch (attr) {
+            case NV_CTRL_STRING_PRODUCT_NAME:
+                ret = nvml->lib->deviceGetName(device, res, MAX_NVML_STR_LEN);
+                break;
+
+            case NV_CTRL_STRING_VBIOS_VERSION:
+                ret = nvml->lib->deviceGetVbiosVersion(device, res, MAX_NVML_STR_LEN);
+                break;
+
+            case NV_CTRL_STRING_GPU_UUID:
+                ret = nvml->lib->deviceGetUUID(device, res, MAX_NVML_STR_LEN);
+                break;
+
+            case NV_CTRL_STRING_GPU_UTILIZATION:
+            {
+                nvmlUtilization_t util;
+
+                if (ctrl_target->system->has_nv_control) {
+                    /*
+                     * Not all utilization types are currently available via
+                     * NVML so, if accessible, get the rates from X.
+                     */
+                    return NvCtrlNotSupported;
+                }
+
+                ret = nvml->lib->deviceGetUtilizationRates(device, &util);
+
+                if (ret != NVML_SUCCESS) {
+                    break;
+                }
+
+                snprintf(res, sizeof(res),
+                         "graphics=%d, memory=%d",
+                         util.gpu, util.memory);
+
+                break;
+            }
+            case NV_CTRL_STRING_SLI_MODE:
+            case NV_CTRL_STRING_PERFORMANCE_MODES:
+            case NV_CTRL_STRING_GPU_CURRENT_CLOCK_FREQS:
+            case NV_CTRL_STRING_MULTIGPU_MODE:
+                /*
+                 * XXX We'll eventually need to add support for this attributes
+                 *     through NVML
+                 */
+                return NvCtrlNotSupported;
+
+            default:
+                /* Did we forget to handle a GPU string attribute? */
+                nv_warning_msg("Unhandled string attribute %s (%d) of GPU (%d)",
+                               STR_ATTRIBUTE_NAME(attr), attr,
+                               NvCtrlGetTargetId(ctrl_target));
+                return NvCtrlNotSupported;
+        }
+
+        if (ret == NVML_SUCCESS) {
+            *ptr = strdup(res);
+            return NvCtrlSuccess;
+        }
+    }
+
+    /* An NVML error occurred */
+    checkNvmlDevice(nvml, ret);
+    printNvmlError(ret);
+    return NvCtrlNotSupported;
+}
+
+
+
+ReturnStatus NvCtrlNvmlGetStringAttribute(const CtrlTarget *ctrl_target,
+                                          int attr, char **ptr)
+{
+    ReturnStatus ret;
+
+    if (NvmlMissing(ctrl_target)) {
+        return NvCtrlMissingExtension;
+    }
+
+    /*
+     * Check for attributes that don't require a target, else continue to
+     * supported target types.
+     */
+    ret = NvCtrlNvmlGetGeneralStringAttribute(ctrl_target, attr, ptr);
+
+    if (ret == NvCtrlSuccess) {
+        return NvCtrlSuccess;
+    }
+
+    switch (NvCtrlGetTargetType(ctrl_target)) {
+        case GPU_TARGET:
+            return NvCtrlNvmlGetGPUStringAttribute(ctrl_target, attr, ptr);
+
+        case THERMAL_SENSOR_TARGET:
+            /* Did we forget to handle a sensor string attribute? */
+            nv_warning_msg("Unhandled string attribute %s (%d) of Thermal "
+                           "sensor (%d)", STR_ATTRIBUTE_NAME(attr), attr,
+                           NvCtrlGetTargetId(ctrl_target));
+            return NvCtrlNotSupported;
+
+        case COOLER_TARGET:
+            /* Did we forget to handle a cooler string attribute? */
+            nv_warning_msg("Unhandled string attribute %s (%d) of Fan (%d)",
+                           STR_ATTRIBUTE_NAME(attr), attr,
+                           NvCtrlGetTargetId(ctrl_target));
+            return NvCtrlNotSupported;
+
+        default:
+            return NvCtrlBadHandle;
+    }
+}
+
+
+
+/*
+ * Set NVML String Attribute Values
+ */
+
+
+
+static ReturnStatus NvCtrlNvmlSetGPUStringAttribute(CtrlTarget *ctrl_target,
+                                                    int attr, const char *ptr)
+{
+    const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
+    NvCtrlNvmlAttributes *nvml;
+    nvmlDevice_t device;
+    nvmlReturn_t ret;
+
+    nvml = getNvmlHandle(h);
+    if (nvml == NULL) {
+        return NvCtrlBadHandle;
+    }
+
+    ret = getNvmlDevice(nvml, &device);
+    if (ret == NVML_SUCCESS) {
+        switch (attr) {
+            case NV_CTRL_STRING_GPU_CURRENT_CLOCK_FREQS:
+                /*
+                 * XXX We'll eventually need to add support for this attributes
+                 *     through NVML
+                 */
+                return NvCtrlNotSupported;
+
+            default:
+                /* Did we forget to handle a GPU string attribute? */
+                nv_warning_msg("Unhandled string attribute %s (%d) of GPU (%d) "
+                               "(set to '%s')", STR_ATTRIBUTE_NAME(attr), attr,
+                               NvCtrlGetTargetId(ctrl_target), (ptr ? ptr : ""));
+                return NvCtrlNotSupported;
+        }
+
+        if (ret == NVML_SUCCESS) {
+            return NvCtrlSuccess;
+        }
+    }
+
+    /* An NVML error occurred */
+    checkNvmlDevice(nvml, ret);
+    printNvmlError(ret);
+    return NvCtrlNotSupported;
+}
+
+
+
+ReturnStatus NvCtrlNvmlSetStringAttribute(CtrlTarget *ctrl_target,
+                                          int attr, const char *ptr)
+{
+    if (NvmlMissing(ctrl_target)) {
+        return NvCtrlMissingExtension;
+    }
+
+    /*
+     * This shouldn't be reached for target types that are not handled through
+     * NVML (Keep TARGET_TYPE_IS_NVML_COMPATIBLE in NvCtrlAttributesPrivate.h up
+     * to date).
+     */
+    assert(TARGET_TYPE_IS_NVML_COMPATIBLE(NvCtrlGetTargetType(ctrl_target)));
+
+    switch (NvCtrlGetTargetType(ctrl_target)) {
+        case GPU_TARGET:
+            return NvCtrlNvmlSetGPUStringAttribute(ctrl_target, attr, ptr);
+
+        case THERMAL_SENSOR_TARGET:
+            /* Did we forget to handle a sensor string attribute? */
+            nv_warning_msg("Unhandled string attribute %s (%d) of Thermal "
+                           "sensor (%d) (set to '%s')",
+                           STR_ATTRIBUTE_NAME(attr), attr,
+                           NvCtrlGetTargetId(ctrl_target), (ptr ? ptr : ""));
+            return NvCtrlNotSupported;
+
+        case COOLER_TARGET:
+            /* Did we forget to handle a cooler string attribute? */
+            nv_warning_msg("Unhandled string attribute %s (%d) of Fan (%d) "
+                           "(set to '%s')", STR_ATTRIBUTE_NAME(attr), attr,
+                           NvCtrlGetTargetId(ctrl_target), (ptr ? ptr : ""));
+            return NvCtrlNotSupported;
+
+        default:
+            return NvCtrlBadHandle;
+    }
+}
+
+
+
+/*
+ * Get the total and used dedicated memory of the device, in MB
+ */
+
+static nvmlReturn_t getDeviceMemoryInfo(const NvCtrlNvmlLibrary *lib,
+                                        nvmlDevice_t device,
+                                        unsigned int *total,
+                                        unsigned int *used)
+{
+    nvmlReturn_t ret;
+
+    if (lib->deviceGetMemoryInfo_v2) {
+        nvmlMemory_v2_t memory;
+        memory.version = nvmlMemory_v2;
+        ret = lib->deviceGetMemoryInfo_v2(device, &memory);
+        if (ret == NVML_SUCCESS) {
+            *total = memory.total >> 20; // bytes --> MB
+            *used = memory.used >> 20; // bytes --> MB
+        }
+    } else {
+        nvmlMemory_t memory;
+        ret = lib->deviceGetMemoryInfo(device, &memory);
+        if (ret == NVML_SUCCESS) {
+            *total = memory.total >> 20; // bytes --> MB
+            *used = memory.used >> 20; // bytes --> MB
+        }
+    }
+
+    return ret;
+}
+
+
+
+/*
+ * Get NVML Attribute Values
+ */
+
+static ReturnStatus NvCtrlNvmlGetGPUAttribute(const CtrlTarget *ctrl_target,
+                                              int attr, int64_t *val)
+{
+    unsigned int res = 0;
+    const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
+    NvCtrlNvmlAttributes *nvml;
+    nvmlDevice_t device;
+    nvmlReturn_t ret;
+
+    nvml = getNvmlHandle(h);
+    if (nvml == NULL) {
+        return NvCtrlBadHandle;
+    }
+
+    ret = getNvmlDevice(nvml, &device);
+    if (ret == NVML_SUCCESS) {
+        switch (attr) {
+            case NV_CTRL_TOTAL_DEDICATED_GPU_MEMORY:
+            case NV_CTRL_USED_DEDICATED_GPU_MEMORY:
+                {
+                    unsigned int total, used;
+                    ret = getDeviceMemoryInfo(nvml->lib, device, &total, &used);
+                    if (ret == NVML_SUCCESS) {
+                        switch (attr) {
+                            case NV_CTRL_TOTAL_DEDICATED_GPU_MEMORY:
+                                res = total;
+                                break;
+                            case NV_CTRL_USED_DEDICATED_GPU_MEMORY:
+                                res = used;
+                                break;
+                        }
+                    }
+                }
+                break;
+
+            case NV_CTRL_PCI_DOMAIN:
+            case NV_CTRL_PCI_BUS:
+            case NV_CTRL_PCI_DEVICE:
+            case NV_CTRL_PCI_FUNCTION:
+            case NV_CTRL_PCI_ID:
+                {
+                    nvmlPciInfo_t pci;
+                    ret = nvml->lib->deviceGetPciInfo(device, &pci);
+                    if (ret == NVML_SUCCESS) {
                         switch (attr) {
                             case NV_CTRL_PCI_DOMAIN:
                                 res = pci.domain;
@@ -870,25 +1414,25 @@ static ReturnStatus NvCtrlNvmlGetGPUAttribute(const CtrlTarget *ctrl_target,
                 break;
 
             case NV_CTRL_GPU_PCIE_GENERATION:
-                ret = nvml->lib.deviceGetMaxPcieLinkGeneration(device, &res);
+                ret = nvml->lib->deviceGetMaxPcieLinkGeneration(device, &res);
                 break;
 
             case NV_CTRL_GPU_PCIE_CURRENT_LINK_WIDTH:
-                ret = nvml->lib.deviceGetCurrPcieLinkWidth(device, &res);
+                ret = nvml->lib->deviceGetCurrPcieLinkWidth(device, &res);
                 break;
             case NV_CTRL_GPU_PCIE_MAX_LINK_WIDTH:
-                ret = nvml->lib.deviceGetMaxPcieLinkWidth(device, &res);
+                ret = nvml->lib->deviceGetMaxPcieLinkWidth(device, &res);
                 break;
             case NV_CTRL_GPU_SLOWDOWN_THRESHOLD:
-                ret = nvml->lib.deviceGetTemperatureThreshold(device,
+                ret = nvml->lib->deviceGetTemperatureThreshold(device,
                           NVML_TEMPERATURE_THRESHOLD_SLOWDOWN ,&res);
                 break;
             case NV_CTRL_GPU_SHUTDOWN_THRESHOLD:
-                ret = nvml->lib.deviceGetTemperatureThreshold(device,
+                ret = nvml->lib->deviceGetTemperatureThreshold(device,
                           NVML_TEMPERATURE_THRESHOLD_SHUTDOWN ,&res);
                 break;
             case NV_CTRL_GPU_CORE_TEMPERATURE:
-                ret = nvml->lib.deviceGetTemperature(device,
+                ret = nvml->lib->deviceGetTemperature(device,
                                                      NVML_TEMPERATURE_GPU,
                                                      &res);
                 break;
@@ -897,7 +1441,7 @@ static ReturnStatus NvCtrlNvmlGetGPUAttribute(const CtrlTarget *ctrl_target,
             case NV_CTRL_GPU_ECC_SUPPORTED:
                 {
                     nvmlEnableState_t current, pending;
-                    ret = nvml->lib.deviceGetEccMode(device, &current, &pending);
+                    ret = nvml->lib->deviceGetEccMode(device, &current, &pending);
                     switch (attr) {
                         case NV_CTRL_GPU_ECC_CONFIGURATION_SUPPORTED:
                             res = (ret == NVML_SUCCESS) ?
@@ -922,7 +1466,7 @@ static ReturnStatus NvCtrlNvmlGetGPUAttribute(const CtrlTarget *ctrl_target,
             case NV_CTRL_GPU_ECC_STATUS:
                 {
                     nvmlEnableState_t current, pending;
-                    ret = nvml->lib.deviceGetEccMode(device, &current, &pending);
+                    ret = nvml->lib->deviceGetEccMode(device, &current, &pending);
                     if (ret == NVML_SUCCESS) {
                         switch (attr) {
                             case NV_CTRL_GPU_ECC_STATUS:
@@ -963,7 +1507,7 @@ static ReturnStatus NvCtrlNvmlGetGPUAttribute(const CtrlTarget *ctrl_target,
                             break;
                     }
 
-                    ret = nvml->lib.deviceGetTotalEccErrors(device, errorType,
+                    ret = nvml->lib->deviceGetTotalEccErrors(device, errorType,
                                                         counterType, &eccCounts);
                     if (ret == NVML_SUCCESS) {
                         if (val) {
@@ -975,18 +1519,18 @@ static ReturnStatus NvCtrlNvmlGetGPUAttribute(const CtrlTarget *ctrl_target,
                 break;
 
             case NV_CTRL_GPU_CORES:
-                ret = nvml->lib.deviceGetNumGpuCores(device, &res);
+                ret = nvml->lib->deviceGetNumGpuCores(device, &res);
                 break;
             case NV_CTRL_GPU_MEMORY_BUS_WIDTH:
-                ret = nvml->lib.deviceGetMemoryBusWidth(device, &res);
+                ret = nvml->lib->deviceGetMemoryBusWidth(device, &res);
                 break;
             case NV_CTRL_IRQ:
-                ret = nvml->lib.deviceGetIrqNum(device, &res);
+                ret = nvml->lib->deviceGetIrqNum(device, &res);
                 break;
             case NV_CTRL_GPU_POWER_SOURCE:
                 assert(NV_CTRL_GPU_POWER_SOURCE_AC == NVML_POWER_SOURCE_AC);
                 assert(NV_CTRL_GPU_POWER_SOURCE_BATTERY == NVML_POWER_SOURCE_BATTERY);
-                ret = nvml->lib.deviceGetPowerSource(device, &res);
+                ret = nvml->lib->deviceGetPowerSource(device, &res);
                 break;
 
             case NV_CTRL_GPU_ECC_DEFAULT_CONFIGURATION:
@@ -1038,261 +1582,772 @@ static ReturnStatus NvCtrlNvmlGetGPUAttribute(const CtrlTarget *ctrl_target,
                  */
                 return NvCtrlNotSupported;
 
-            case NV_CTRL_ATTR_NVML_GPU_VIRTUALIZATION_MODE:
-                {
-                    nvmlGpuVirtualizationMode_t mode;
-                    ret = nvml->lib.deviceGetVirtualizationMode(device, &mode);
-                    res = mode;
-                }
-                break;
-
-            case NV_CTRL_ATTR_NVML_GPU_GRID_LICENSE_SUPPORTED:
-                if (nvml->lib.deviceGetGridLicensableFeatures) {
-                    nvmlGridLicensableFeatures_t gridLicensableFeatures;
-                    ret = nvml->lib.deviceGetGridLicensableFeatures(device,
-                                                          &gridLicensableFeatures);
-                    res = !!(gridLicensableFeatures.isGridLicenseSupported);
-                } else {
-                    /* return NvCtrlNotSupported against older driver */
-                    ret = NVML_ERROR_FUNCTION_NOT_FOUND;
-                }
-
-                break;
-
+            case NV_CTRL_ATTR_NVML_GPU_VIRTUALIZATION_MODE:
+                {
+                    nvmlGpuVirtualizationMode_t mode;
+                    ret = nvml->lib->deviceGetVirtualizationMode(device, &mode);
+                    res = mode;
+                }
+                break;
+
+            case NV_CTRL_ATTR_NVML_GPU_GRID_LICENSE_SUPPORTED:
+                if (nvml->lib->deviceGetGridLicensableFeatures) {
+                    nvmlGridLicensableFeatures_t gridLicensableFeatures;
+                    ret = nvml->lib->deviceGetGridLicensableFeatures(device,
+                                                          &gridLicensableFeatures);
+                    res = !!(gridLicensableFeatures.isGridLicenseSupported);
+                } else {
+                    /* return NvCtrlNotSupported against older driver */
+                    ret = NVML_ERROR_FUNCTION_NOT_FOUND;
+                }
+
+                break;
+
+            default:
+                /* Did we forget to handle a GPU integer attribute? */
+                nv_info_msg("", "Unhandled integer attribute %s (%d) of GPU "
+                            "(%d)", INT_ATTRIBUTE_NAME(attr), attr,
+                            NvCtrlGetTargetId(ctrl_target));
+                return NvCtrlNotSupported;
+        }
+
+        if (ret == NVML_SUCCESS) {
+            if (val) {
+                *val = res;
+            }
+            return NvCtrlSuccess;
+        }
+    }
+
+    /* An NVML error occurred */
+    checkNvmlDevice(nvml, ret);
+    printNvmlError(ret);
+    return NvCtrlNotSupported;
+}
+
+static ReturnStatus NvCtrlNvmlGetGridLicensableFeatures(const CtrlTarget *ctrl_target,
+                                                    int attr, nvmlGridLicensableFeatures_t **val)
+{
+    const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
+    NvCtrlNvmlAttributes *nvml;
+    nvmlDevice_t device;
+    nvmlReturn_t ret;
+
+    nvml = getNvmlHandle(h);
+    if (nvml == NULL) {
+        return NvCtrlBadHandle;
+    }
+
+    ret = getNvmlDevice(nvml, &device);
+    if (ret == NVML_SUCCESS) {
+        switch (attr) {
+            case NV_CTRL_ATTR_NVML_GPU_GRID_LICENSABLE_FEATURES:
+                if (nvml->lib->deviceGetGridLicensableFeatures) {
+                    nvmlGridLicensableFeatures_t *gridLicensableFeatures;
+                    gridLicensableFeatures = (nvmlGridLicensableFeatures_t *)nvalloc(sizeof(nvmlGridLicensableFeatures_t));
+                    ret = nvml->lib->deviceGetGridLicensableFeatures(device,
+                                                                    gridLicensableFeatures);
+                    if (ret == NVML_SUCCESS) {
+                        *val = gridLicensableFeatures;
+                        return NvCtrlSuccess;
+                    }
+                } else {
+                    /* return NvCtrlNotSupported against older driver */
+                    ret = NVML_ERROR_FUNCTION_NOT_FOUND;
+                }
+
+                break;
+
+            default:
+                /* Did we forget to handle a GPU integer attribute? */
+                nv_warning_msg("Unhandled integer attribute %s (%d) of GPU "
+                               "(%d)", INT_ATTRIBUTE_NAME(attr), attr,
+                               NvCtrlGetTargetId(ctrl_target));
+                return NvCtrlNotSupported;
+        }
+    }
+
+    /* An NVML error occurred */
+    checkNvmlDevice(nvml, ret);
+    printNvmlError(ret);
+    return NvCtrlNotSupported;
+}
+
+
+
+static int getThermalCoolerId(const NvCtrlAttributePrivateHandle *h)
+{
+    const NvCtrlNvmlSystem *sys = getNvmlTopology(h->system);
+    unsigned int thermalCoolerCount;
+    const unsigned int *thermalCoolerCountPerGPU;
+    int i, count;
+
+    if (sys == NULL) {
+        return -1;
+    }
+
+    if (h->target_type == THERMAL_SENSOR_TARGET) {
+        thermalCoolerCount = sys->sensorCount;
+        thermalCoolerCountPerGPU = sys->sensorCountPerGPU;
+    } else {
+        thermalCoolerCount = sys->coolerCount;
+        thermalCoolerCountPerGPU = sys->coolerCountPerGPU;
+    }
+
+    if ((h->target_id < 0) || (h->target_id >= thermalCoolerCount)) {
+        return -1;
+    }
+
+    count = 0;
+    for (i = 0; i < h->nvml->deviceCount; i++) {
+        int tmp = count + thermalCoolerCountPerGPU[i];
+        if (h->target_id < tmp) {
+            return (h->target_id - count);
+        }
+        count = tmp;
+    }
+
+    return -1;
+}
+
+static ReturnStatus NvCtrlNvmlGetThermalAttribute(const CtrlTarget *ctrl_target,
+                                                  int attr, int64_t *val)
+{
+    unsigned int res;
+    const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
+    NvCtrlNvmlAttributes *nvml;
+    int sensorId;
+    nvmlDevice_t device;
+    nvmlReturn_t ret;
+
+    nvml = getNvmlHandle(h);
+    if (nvml == NULL) {
+        return NvCtrlBadHandle;
+    }
+
+    /* Get the proper device according to the sensor ID */
+    sensorId = getThermalCoolerId(h);
+    if (sensorId == -1) {
+        return NvCtrlBadHandle;
+    }
+
+
+    ret = getNvmlDevice(nvml, &device);
+    if (ret == NVML_SUCCESS) {
+        switch (attr) {
+            case NV_CTRL_THERMAL_SENSOR_READING:
+               
+            case NV_CTRL_THERMAL_SENSOR_PROVIDER:
+            case NV_CTRL_THERMAL_SENSOR_TARGET:
+                /*
+                 * XXX We'll eventually need to add support for this attributes
+                 *     through NVML
+                 */
+                return NvCtrlNotSupported;
+
             default:
-                /* Did we forget to handle a GPU integer attribute? */
-                nv_info_msg("", "Unhandled integer attribute %s (%d) of GPU "
-                            "(%d)", INT_ATTRIBUTE_NAME(attr), attr,
-                            NvCtrlGetTargetId(ctrl_target));
+                /* Did we forget to handle a sensor integer attribute? */
+                nv_info_msg("", "Unhandled integer attribute %s (%d) of "
+                            "Thermal sensor (%d)", INT_ATTRIBUTE_NAME(attr),
+                            attr, NvCtrlGetTargetId(ctrl_target));
                 return NvCtrlNotSupported;
         }
 
         if (ret == NVML_SUCCESS) {
-            if (val) {
-                *val = res;
-            }
+            *val = res;
             return NvCtrlSuccess;
         }
     }
 
     /* An NVML error occurred */
+    checkNvmlDevice(nvml, ret);
     printNvmlError(ret);
     return NvCtrlNotSupported;
 }
 
-static ReturnStatus NvCtrlNvmlGetGridLicensableFeatures(const CtrlTarget *ctrl_target,
-                                                    int attr, nvmlGridLicensableFeatures_t **val)
+static ReturnStatus NvCtrlNvmlGetCoolerAttribute(const CtrlTarget *ctrl_target,
+                                                 int attr, int64_t *val)
 {
+    unsigned int res;
     const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
-    const NvCtrlNvmlAttributes *nvml;
+    NvCtrlNvmlAttributes *nvml;
+    int coolerId;
     nvmlDevice_t device;
     nvmlReturn_t ret;
 
-    nvml = getNvmlHandleConst(h);
+    nvml = getNvmlHandle(h);
     if (nvml == NULL) {
         return NvCtrlBadHandle;
     }
 
-    ret = nvml->lib.deviceGetHandleByIndex(nvml->deviceIdx, &device);
-        if (ret == NVML_SUCCESS) {
-        switch (attr) {
-            case NV_CTRL_ATTR_NVML_GPU_GRID_LICENSABLE_FEATURES:
-                if (nvml->lib.deviceGetGridLicensableFeatures) {
-                    nvmlGridLicensableFeatures_t *gridLicensableFeatures;
-                    gridLicensableFeatures = (nvmlGridLicensableFeatures_t *)nvalloc(sizeof(nvmlGridLicensableFeatures_t));
-                    ret = nvml->lib.deviceGetGridLicensableFeatures(device,
-                                                                    gridLicensableFeatures);
-                    if (ret == NVML_SUCCESS) {
-                        *val = gridLicensableFeatures;
-                        return NvCtrlSuccess;
-                    }
-                } else {
-                    /* return NvCtrlNotSupported against older driver */
-                    ret = NVML_ERROR_FUNCTION_NOT_FOUND;
-                }
+    /* Get the proper device according to the cooler ID */
+    coolerId = getThermalCoolerId(h);
+    if (coolerId == -1) {
+        return NvCtrlBadHandle;
+    }
 
+    ret = getNvmlDevice(nvml, &device);
+    if (ret == NVML_SUCCESS) {
+        switch (attr) {
+            case NV_CTRL_THERMAL_COOLER_CURRENT_LEVEL:
+                ret = nvml->lib->deviceGetFanSpeed_v2(device, coolerId, &res);
                 break;
 
+            case NV_CTRL_THERMAL_COOLER_LEVEL:
+            case NV_CTRL_THERMAL_COOLER_SPEED:
+            case NV_CTRL_THERMAL_COOLER_CONTROL_TYPE:
+            case NV_CTRL_THERMAL_COOLER_TARGET:
+                /*
+                 * XXX We'll eventually need to add support for this attributes
+                 *     through NVML
+                 */
+                return NvCtrlNotSupported;
+
             default:
-                /* Did we forget to handle a GPU integer attribute? */
-                nv_warning_msg("Unhandled integer attribute %s (%d) of GPU "
-                               "(%d)", INT_ATTRIBUTE_NAME(attr), attr,
-                               NvCtrlGetTargetId(ctrl_target));
+                /* Did we forget to handle a cooler integer attribute? */
+                nv_info_msg("", "Unhandled integer attribute %s (%d) of Fan "
+                            "(%d)", INT_ATTRIBUTE_NAME(attr), attr,
+                            NvCtrlGetTargetId(ctrl_target));
                 return NvCtrlNotSupported;
         }
+
+        if (ret == NVML_SUCCESS) {
+            *val = res;
+            return NvCtrlSuccess;
+        }
     }
 
     /* An NVML error occurred */
+    checkNvmlDevice(nvml, ret);
     printNvmlError(ret);
     return NvCtrlNotSupported;
 }
 
 
 
-static int getThermalCoolerId(const NvCtrlAttributePrivateHandle *h,
-                              unsigned int thermalCoolerCount,
-                              const unsigned int *thermalCoolerCountPerGPU)
+ReturnStatus NvCtrlNvmlGetAttribute(const CtrlTarget *ctrl_target,
+                                    int attr, int64_t *val)
 {
-    int i, count;
+    if (NvmlMissing(ctrl_target)) {
+        return NvCtrlMissingExtension;
+    }
 
-    if ((h->target_id < 0) || (h->target_id >= thermalCoolerCount)) {
-        return -1;
+    /*
+     * This shouldn't be reached for target types that are not handled through
+     * NVML (Keep TARGET_TYPE_IS_NVML_COMPATIBLE in NvCtrlAttributesPrivate.h up
+     * to date).
+     */
+    assert(TARGET_TYPE_IS_NVML_COMPATIBLE(NvCtrlGetTargetType(ctrl_target)));
+
+    switch (NvCtrlGetTargetType(ctrl_target)) {
+        case GPU_TARGET:
+            return NvCtrlNvmlGetGPUAttribute(ctrl_target, attr, val);
+        case THERMAL_SENSOR_TARGET:
+            return NvCtrlNvmlGetThermalAttribute(ctrl_target, attr, val);
+        case COOLER_TARGET:
+            return NvCtrlNvmlGetCoolerAttribute(ctrl_target, attr, val);
+        default:
+            return NvCtrlNotSupported;
     }
+}
 
-    count = 0;
-    for (i = 0; i < h->nvml->deviceCount; i++) {
-        int tmp = count + thermalCoolerCountPerGPU[i];
-        if (h->target_id < tmp) {
-            return (h->target_id - count);
+
+/*
+ * GPU integer attributes whose value NvCtrlNvmlGetGPUAttribute() reads from
+ * the same driver state as the given NVML field.
+ */
+
+static const struct {
+    int attr;
+    unsigned int fieldId;
+} nvmlGpuFieldIds[] = {
+    { NV_CTRL_GPU_ECC_STATUS,                       NVML_FI_DEV_ECC_CURRENT       },
+    { NV_CTRL_GPU_ECC_CONFIGURATION,                NVML_FI_DEV_ECC_PENDING       },
+    { NV_CTRL_GPU_ECC_SINGLE_BIT_ERRORS,            NVML_FI_DEV_ECC_SBE_VOL_TOTAL },
+    { NV_CTRL_GPU_ECC_DOUBLE_BIT_ERRORS,            NVML_FI_DEV_ECC_DBE_VOL_TOTAL },
+    { NV_CTRL_GPU_ECC_AGGREGATE_SINGLE_BIT_ERRORS,  NVML_FI_DEV_ECC_SBE_AGG_TOTAL },
+    { NV_CTRL_GPU_ECC_AGGREGATE_DOUBLE_BIT_ERRORS,  NVML_FI_DEV_ECC_DBE_AGG_TOTAL },
+};
+
+static Bool getGpuFieldId(int attr, unsigned int *fieldId)
+{
+    int i;
+
+    for (i = 0; i < ARRAY_LEN(nvmlGpuFieldIds); i++) {
+        if (nvmlGpuFieldIds[i].attr == attr) {
+            *fieldId = nvmlGpuFieldIds[i].fieldId;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static Bool getFieldValue(const nvmlFieldValue_t *field, int64_t *val)
+{
+    if (field->nvmlReturn != NVML_SUCCESS) {
+        return FALSE;
+    }
+
+    switch (field->valueType) {
+        case NVML_VALUE_TYPE_UNSIGNED_INT:
+            *val = field->value.uiVal;
+            return TRUE;
+        case NVML_VALUE_TYPE_UNSIGNED_LONG:
+            *val = field->value.ulVal;
+            return TRUE;
+        case NVML_VALUE_TYPE_UNSIGNED_LONG_LONG:
+            *val = field->value.ullVal;
+            return TRUE;
+        case NVML_VALUE_TYPE_SIGNED_LONG_LONG:
+            *val = field->value.sllVal;
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+
+
+/*
+ * Answer the attributes of 'attrs' that map onto an NVML field value with a
+ * single nvmlDeviceGetFieldValues() call.  Only the statuses of attributes
+ * that were answered are set (to NvCtrlSuccess); the caller queries the
+ * others, and any field that failed, through the per-attribute path so the
+ * results and error reporting stay the same.
+ */
+
+ReturnStatus NvCtrlNvmlGetAttributesBatch(const CtrlTarget *ctrl_target,
+                                         int count, const int *attrs,
+                                         int64_t *vals,
+                                         ReturnStatus *statuses)
+{
+    const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
+    NvCtrlNvmlAttributes *nvml;
+    nvmlFieldValue_t *fields;
+    int *fieldAttrIdx;
+    int i, fieldCount;
+    unsigned int fieldId;
+    nvmlDevice_t device;
+    nvmlReturn_t ret;
+
+    if (NvmlMissing(ctrl_target)) {
+        return NvCtrlMissingExtension;
+    }
+
+    if ((NvCtrlGetTargetType(ctrl_target) != GPU_TARGET) || (count <= 0)) {
+        return NvCtrlNotSupported;
+    }
+
+    nvml = getNvmlHandle(h);
+    if (nvml == NULL) {
+        return NvCtrlBadHandle;
+    }
+
+    /* Field values are only available from newer NVML libraries */
+    if (nvml->lib->deviceGetFieldValues == NULL) {
+        return NvCtrlNotSupported;
+    }
+
+    fields = nvalloc(count * sizeof(nvmlFieldValue_t));
+    fieldAttrIdx = nvalloc(count * sizeof(int));
+
+    fieldCount = 0;
+    for (i = 0; i < count; i++) {
+        if (getGpuFieldId(attrs[i], &fieldId)) {
+            fields[fieldCount].fieldId = fieldId;
+            fieldAttrIdx[fieldCount] = i;
+            fieldCount++;
+        }
+    }
+
+    if (fieldCount == 0) {
+        ret = NVML_ERROR_NOT_SUPPORTED;
+        goto done;
+    }
+
+    ret = getNvmlDevice(nvml, &device);
+    if (ret != NVML_SUCCESS) {
+        goto done;
+    }
+
+    ret = nvml->lib->deviceGetFieldValues(device, fieldCount, fields);
+    checkNvmlDevice(nvml, ret);
+    if (ret != NVML_SUCCESS) {
+        goto done;
+    }
+
+    for (i = 0; i < fieldCount; i++) {
+        int idx = fieldAttrIdx[i];
+
+        if (getFieldValue(&fields[i], &vals[idx])) {
+            statuses[idx] = NvCtrlSuccess;
+        }
+    }
+
+ done:
+    nvfree(fields);
+    nvfree(fieldAttrIdx);
+
+    return (ret == NVML_SUCCESS) ? NvCtrlSuccess : NvCtrlNotSupported;
+}
+
+
+
+/*
+ * Query every telemetry value of the device in one pass.  Values NVML cannot
+ * provide are left out of 'telemetry->valid'.  This only uses the library
+ * so that it can also run on the sampler thread; the return value is
+ * NVML_SUCCESS, or the error that should invalidate the device handle (see
+ * checkNvmlDevice()).
+ */
+
+static nvmlReturn_t sampleTelemetry(const NvCtrlNvmlLibrary *lib,
+                                    nvmlDevice_t device,
+                                    CtrlGpuTelemetry *telemetry)
+{
+    nvmlReturn_t lost = NVML_SUCCESS;
+    struct timespec ts;
+    nvmlUtilization_t util;
+    unsigned int res, total, used, fans;
+    nvmlReturn_t ret;
+    int i;
+
+#define SAMPLE_CHECK(_ret)                          \
+    if (((_ret) == NVML_ERROR_GPU_IS_LOST) ||       \
+        ((_ret) == NVML_ERROR_UNINITIALIZED)) {     \
+        lost = (_ret);                              \
+    }
+
+    memset(telemetry, 0, sizeof(*telemetry));
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    telemetry->timestamp = (unsigned long long) ts.tv_sec * 1000000 +
+                           ts.tv_nsec / 1000;
+
+    ret = lib->deviceGetTemperature(device, NVML_TEMPERATURE_GPU, &res);
+    SAMPLE_CHECK(ret);
+    if (ret == NVML_SUCCESS) {
+        telemetry->temperature = res;
+        telemetry->valid |= CTRL_GPU_TELEMETRY_TEMPERATURE;
+    }
+
+    ret = lib->deviceGetUtilizationRates(device, &util);
+    SAMPLE_CHECK(ret);
+    if (ret == NVML_SUCCESS) {
+        telemetry->gpu_utilization = util.gpu;
+        telemetry->memory_utilization = util.memory;
+        telemetry->valid |= CTRL_GPU_TELEMETRY_UTILIZATION;
+    }
+
+    ret = getDeviceMemoryInfo(lib, device, &total, &used);
+    SAMPLE_CHECK(ret);
+    if (ret == NVML_SUCCESS) {
+        telemetry->total_memory = total;
+        telemetry->used_memory = used;
+        telemetry->valid |= CTRL_GPU_TELEMETRY_MEMORY;
+    }
+
+    ret = lib->deviceGetNumFans(device, &fans);
+    SAMPLE_CHECK(ret);
+    if (ret == NVML_SUCCESS) {
+        if (fans > CTRL_GPU_TELEMETRY_MAX_FANS) {
+            fans = CTRL_GPU_TELEMETRY_MAX_FANS;
+        }
+        for (i = 0; i < fans; i++) {
+            ret = lib->deviceGetFanSpeed_v2(device, i, &res);
+            SAMPLE_CHECK(ret);
+            if (ret != NVML_SUCCESS) {
+                break;
+            }
+            telemetry->fan_speed[i] = res;
+        }
+        if (i == fans) {
+            telemetry->fan_count = fans;
+            telemetry->valid |= CTRL_GPU_TELEMETRY_FAN_SPEED;
+        }
+    }
+
+    ret = lib->deviceGetCurrPcieLinkWidth(device, &res);
+    SAMPLE_CHECK(ret);
+    if (ret == NVML_SUCCESS) {
+        telemetry->pcie_link_width = res;
+        telemetry->valid |= CTRL_GPU_TELEMETRY_PCIE_LINK_WIDTH;
+    }
+
+    assert(NV_CTRL_GPU_POWER_SOURCE_AC == NVML_POWER_SOURCE_AC);
+    assert(NV_CTRL_GPU_POWER_SOURCE_BATTERY == NVML_POWER_SOURCE_BATTERY);
+    ret = lib->deviceGetPowerSource(device, &res);
+    SAMPLE_CHECK(ret);
+    if (ret == NVML_SUCCESS) {
+        telemetry->power_source = res;
+        telemetry->valid |= CTRL_GPU_TELEMETRY_POWER_SOURCE;
+    }
+
+#undef SAMPLE_CHECK
+
+    return lost;
+}
+
+
+
+/*
+ * Body of the sampler thread: sample every device into the next ring slot,
+ * publish it, then sleep for the sampling interval or until asked to stop.
+ */
+
+static void *samplerThread(void *arg)
+{
+    NvCtrlNvmlSampler *sampler = arg;
+    nvmlDevice_t *devices;
+    Bool *deviceValid;
+    unsigned int head, seq;
+    struct timespec deadline;
+    nvmlReturn_t ret;
+    Bool stop;
+    int i;
+
+    devices = nvalloc(sampler->deviceCount * sizeof(nvmlDevice_t));
+    deviceValid = nvalloc(sampler->deviceCount * sizeof(Bool));
+
+    do {
+        NvCtrlNvmlSamplerSlot *slot;
+
+        head = sampler->head;
+        slot = &sampler->slots[head % NVML_SAMPLER_RING_SIZE];
+
+        /* Mark the slot as being rewritten */
+        seq = slot->seq + 1;
+        __atomic_store_n(&slot->seq, seq, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+
+        for (i = 0; i < sampler->deviceCount; i++) {
+            if (!deviceValid[i]) {
+                ret = sampler->lib->deviceGetHandleByIndex(i, &devices[i]);
+                if (ret != NVML_SUCCESS) {
+                    memset(&slot->telemetry[i], 0, sizeof(CtrlGpuTelemetry));
+                    continue;
+                }
+                deviceValid[i] = TRUE;
+            }
+
+            ret = sampleTelemetry(sampler->lib, devices[i],
+                                  &slot->telemetry[i]);
+            if (ret != NVML_SUCCESS) {
+                deviceValid[i] = FALSE;
+            }
+        }
+
+        /* Publish the slot */
+        __atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELEASE);
+        __atomic_store_n(&sampler->head, head + 1, __ATOMIC_RELEASE);
+
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += sampler->intervalMs / 1000;
+        deadline.tv_nsec += (sampler->intervalMs % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+
+        pthread_mutex_lock(&sampler->lock);
+        while (!sampler->stop &&
+               pthread_cond_timedwait(&sampler->cond, &sampler->lock,
+                                      &deadline) == 0) {
+            /* spurious wakeup */
+        }
+        stop = sampler->stop;
+        pthread_mutex_unlock(&sampler->lock);
+
+    } while (!stop);
+
+    nvfree(devices);
+    nvfree(deviceValid);
+
+    return NULL;
+}
+
+
+
+/*
+ * Copy the telemetry of device 'deviceIdx' from the most recently published
+ * ring slot into 'telemetry'.  Returns FALSE, leaving 'telemetry' untouched,
+ * if nothing was published yet or no consistent copy could be made because
+ * the thread kept recycling the slot.
+ */
+
+static Bool readLatestSample(const NvCtrlNvmlSampler *sampler,
+                             unsigned int deviceIdx,
+                             CtrlGpuTelemetry *telemetry)
+{
+    const NvCtrlNvmlSamplerSlot *slot;
+    CtrlGpuTelemetry copy;
+    unsigned int head, seq;
+    int tries;
+
+    for (tries = 0; tries < NVML_SAMPLER_RING_SIZE; tries++) {
+
+        head = __atomic_load_n(&sampler->head, __ATOMIC_ACQUIRE);
+        if (head == 0) {
+            return FALSE;
+        }
+
+        slot = &sampler->slots[(head - 1) % NVML_SAMPLER_RING_SIZE];
+
+        seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1) {
+            continue;
+        }
+
+        copy = slot->telemetry[deviceIdx];
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq) {
+            *telemetry = copy;
+            return TRUE;
         }
-        count = tmp;
     }
 
-    return -1;
+    return FALSE;
 }
 
-static ReturnStatus NvCtrlNvmlGetThermalAttribute(const CtrlTarget *ctrl_target,
-                                                  int attr, int64_t *val)
+
+
+/*
+ * Start sampling the telemetry of every NVML device of the system on a
+ * separate thread, every 'interval_ms' milliseconds.  From then on,
+ * NvCtrlNvmlGetTelemetry() only reads the samples it publishes.
+ */
+
+ReturnStatus NvCtrlNvmlStartSampler(CtrlSystem *system,
+                                    unsigned int interval_ms)
 {
-    unsigned int res;
-    const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
-    const NvCtrlNvmlAttributes *nvml;
-    int sensorId;
-    nvmlDevice_t device;
-    nvmlReturn_t ret;
+    NvCtrlNvmlSystem *sys;
+    NvCtrlNvmlSampler *sampler;
+    int i;
 
-    nvml = getNvmlHandleConst(h);
-    if (nvml == NULL) {
-        return NvCtrlBadHandle;
+    if ((system == NULL) || (interval_ms == 0)) {
+        return NvCtrlBadArgument;
     }
 
-    /* Get the proper device according to the sensor ID */
-    sensorId = getThermalCoolerId(h, nvml->sensorCount,
-                                  nvml->sensorCountPerGPU);
-    if (sensorId == -1) {
-        return NvCtrlBadHandle;
+    sys = system->nvml;
+    if (sys == NULL) {
+        return NvCtrlMissingExtension;
     }
 
+    if (sys->sampler != NULL) {
+        return NvCtrlSuccess;
+    }
 
-    ret = nvml->lib.deviceGetHandleByIndex(nvml->deviceIdx, &device);
-    if (ret == NVML_SUCCESS) {
-        switch (attr) {
-            case NV_CTRL_THERMAL_SENSOR_READING:
-               
-            case NV_CTRL_THERMAL_SENSOR_PROVIDER:
-            case NV_CTRL_THERMAL_SENSOR_TARGET:
-                /*
-                 * XXX We'll eventually need to add support for this attributes
-                 *     through NVML
-                 */
-                return NvCtrlNotSupported;
+    sampler = nvalloc(sizeof(NvCtrlNvmlSampler));
+    sampler->lib = sys->lib;
+    sampler->deviceCount = sys->deviceCount;
+    sampler->intervalMs = interval_ms;
 
-            default:
-                /* Did we forget to handle a sensor integer attribute? */
-                nv_info_msg("", "Unhandled integer attribute %s (%d) of "
-                            "Thermal sensor (%d)", INT_ATTRIBUTE_NAME(attr),
-                            attr, NvCtrlGetTargetId(ctrl_target));
-                return NvCtrlNotSupported;
-        }
+    for (i = 0; i < NVML_SAMPLER_RING_SIZE; i++) {
+        sampler->slots[i].telemetry =
+            nvalloc(sys->deviceCount * sizeof(CtrlGpuTelemetry));
+    }
 
-        if (ret == NVML_SUCCESS) {
-            *val = res;
-            return NvCtrlSuccess;
-        }
+    pthread_mutex_init(&sampler->lock, NULL);
+    pthread_cond_init(&sampler->cond, NULL);
+
+    if (pthread_create(&sampler->thread, NULL, samplerThread, sampler) != 0) {
+        nv_warning_msg("Unable to start the NVML sampling thread.");
+        freeSampler(sampler);
+        return NvCtrlError;
     }
 
-    /* An NVML error occurred */
-    printNvmlError(ret);
-    return NvCtrlNotSupported;
+    sys->sampler = sampler;
+
+    return NvCtrlSuccess;
 }
 
-static ReturnStatus NvCtrlNvmlGetCoolerAttribute(const CtrlTarget *ctrl_target,
-                                                 int attr, int64_t *val)
+
+
+/*
+ * Get the telemetry snapshot of the device backing the target.  Snapshots
+ * are kept per device in the system's NVML state, so GPU, thermal sensor and
+ * cooler targets of the same GPU share them.
+ */
+
+ReturnStatus NvCtrlNvmlGetTelemetry(const CtrlTarget *ctrl_target,
+                                    CtrlGpuTelemetry *telemetry)
 {
-    unsigned int res;
     const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
-    const NvCtrlNvmlAttributes *nvml;
-    int coolerId;
+    NvCtrlNvmlAttributes *nvml;
+    NvCtrlNvmlSystem *sys;
+    CtrlGpuTelemetry *snapshot;
+    struct timespec ts;
+    unsigned long long now;
     nvmlDevice_t device;
     nvmlReturn_t ret;
+    int coolerId = -1;
 
-    nvml = getNvmlHandleConst(h);
-    if (nvml == NULL) {
-        return NvCtrlBadHandle;
+    if (NvmlMissing(ctrl_target)) {
+        return NvCtrlMissingExtension;
     }
 
-    /* Get the proper device according to the cooler ID */
-    coolerId = getThermalCoolerId(h, nvml->coolerCount,
-                                  nvml->coolerCountPerGPU);
-    if (coolerId == -1) {
+    nvml = getNvmlHandle(h);
+    sys = h->system->nvml;
+    if ((nvml == NULL) || (sys == NULL) ||
+        (nvml->deviceIdx >= sys->deviceCount)) {
         return NvCtrlBadHandle;
     }
 
-    ret = nvml->lib.deviceGetHandleByIndex(nvml->deviceIdx, &device);
-    if (ret == NVML_SUCCESS) {
-        switch (attr) {
-            case NV_CTRL_THERMAL_COOLER_CURRENT_LEVEL:
-                ret = nvml->lib.deviceGetFanSpeed_v2(device, coolerId, &res);
-                break;
+    if (h->target_type == COOLER_TARGET) {
+        coolerId = getThermalCoolerId(h);
+        if (coolerId == -1) {
+            return NvCtrlBadHandle;
+        }
+    }
 
-            case NV_CTRL_THERMAL_COOLER_LEVEL:
-            case NV_CTRL_THERMAL_COOLER_SPEED:
-            case NV_CTRL_THERMAL_COOLER_CONTROL_TYPE:
-            case NV_CTRL_THERMAL_COOLER_TARGET:
-                /*
-                 * XXX We'll eventually need to add support for this attributes
-                 *     through NVML
-                 */
-                return NvCtrlNotSupported;
+    pthread_mutex_lock(&sys->lock);
 
-            default:
-                /* Did we forget to handle a cooler integer attribute? */
-                nv_info_msg("", "Unhandled integer attribute %s (%d) of Fan "
-                            "(%d)", INT_ATTRIBUTE_NAME(attr), attr,
-                            NvCtrlGetTargetId(ctrl_target));
+    snapshot = &sys->telemetry[nvml->deviceIdx];
+
+    if (sys->sampler != NULL) {
+        /*
+         * Never call into the driver from here while the sampler runs; if
+         * no consistent sample can be read, keep the previous one.
+         */
+        readLatestSample(sys->sampler, nvml->deviceIdx, snapshot);
+
+    } else {
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        now = (unsigned long long) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+
+        if ((snapshot->timestamp == 0) ||
+            (now - snapshot->timestamp > TELEMETRY_MAX_AGE_USEC)) {
+
+            ret = getNvmlDevice(nvml, &device);
+            if (ret != NVML_SUCCESS) {
+                pthread_mutex_unlock(&sys->lock);
+                printNvmlError(ret);
                 return NvCtrlNotSupported;
-        }
+            }
 
-        if (ret == NVML_SUCCESS) {
-            *val = res;
-            return NvCtrlSuccess;
+            ret = sampleTelemetry(nvml->lib, device, snapshot);
+            checkNvmlDevice(nvml, ret);
         }
     }
 
-    /* An NVML error occurred */
-    printNvmlError(ret);
-    return NvCtrlNotSupported;
-}
-
+    if (snapshot->valid == 0) {
+        pthread_mutex_unlock(&sys->lock);
+        return NvCtrlNotSupported;
+    }
 
+    *telemetry = *snapshot;
 
-ReturnStatus NvCtrlNvmlGetAttribute(const CtrlTarget *ctrl_target,
-                                    int attr, int64_t *val)
-{
-    if (NvmlMissing(ctrl_target)) {
-        return NvCtrlMissingExtension;
-    }
+    pthread_mutex_unlock(&sys->lock);
 
-    /*
-     * This shouldn't be reached for target types that are not handled through
-     * NVML (Keep TARGET_TYPE_IS_NVML_COMPATIBLE in NvCtrlAttributesPrivate.h up
-     * to date).
-     */
-    assert(TARGET_TYPE_IS_NVML_COMPATIBLE(NvCtrlGetTargetType(ctrl_target)));
+    telemetry->fan_index = (coolerId < telemetry->fan_count) ? coolerId : -1;
 
-    switch (NvCtrlGetTargetType(ctrl_target)) {
-        case GPU_TARGET:
-            return NvCtrlNvmlGetGPUAttribute(ctrl_target, attr, val);
-        case THERMAL_SENSOR_TARGET:
-            return NvCtrlNvmlGetThermalAttribute(ctrl_target, attr, val);
-        case COOLER_TARGET:
-            return NvCtrlNvmlGetCoolerAttribute(ctrl_target, attr, val);
-        default:
-            return NvCtrlNotSupported;
-    }
+    return NvCtrlSuccess;
 }
 
 
+
 ReturnStatus NvCtrlNvmlGetGridLicenseAttributes(const CtrlTarget *ctrl_target,
                                                 int attr, nvmlGridLicensableFeatures_t **val)
 {
@@ -1326,20 +2381,20 @@ static ReturnStatus NvCtrlNvmlSetGPUAttribute(CtrlTarget *ctrl_target,
                                               int attr, int index, int val)
 {
     const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
-    const NvCtrlNvmlAttributes *nvml;
+    NvCtrlNvmlAttributes *nvml;
     nvmlDevice_t device;
     nvmlReturn_t ret;
 
-    nvml = getNvmlHandleConst(h);
+    nvml = getNvmlHandle(h);
     if (nvml == NULL) {
         return NvCtrlBadHandle;
     }
 
-    ret = nvml->lib.deviceGetHandleByIndex(nvml->deviceIdx, &device);
+    ret = getNvmlDevice(nvml, &device);
     if (ret == NVML_SUCCESS) {
         switch (attr) {
             case NV_CTRL_GPU_ECC_CONFIGURATION:
-                ret = nvml->lib.deviceSetEccMode(device, val);
+                ret = nvml->lib->deviceSetEccMode(device, val);
                 break;
 
             case NV_CTRL_GPU_ECC_RESET_ERROR_STATUS:
@@ -1353,7 +2408,7 @@ static ReturnStatus NvCtrlNvmlSetGPUAttribute(CtrlTarget *ctrl_target,
                             counterType = NVML_AGGREGATE_ECC;
                             break;
                     }
-                    ret = nvml->lib.deviceClearEccErrorCounts(device,
+                    ret = nvml->lib->deviceClearEccErrorCounts(device,
                                                               counterType);
                 }
                 break;
@@ -1388,6 +2443,7 @@ static ReturnStatus NvCtrlNvmlSetGPUAttribute(CtrlTarget *ctrl_target,
     }
 
     /* An NVML error occurred */
+    checkNvmlDevice(nvml, ret);
     printNvmlError(ret);
     return NvCtrlNotSupported;
 }
@@ -1396,24 +2452,23 @@ static ReturnStatus NvCtrlNvmlSetCoolerAttribute(CtrlTarget *ctrl_target,
                                                  int attr, int val)
 {
     NvCtrlAttributePrivateHandle *h = getPrivateHandle(ctrl_target);
-    const NvCtrlNvmlAttributes *nvml;
+    NvCtrlNvmlAttributes *nvml;
     int coolerId;
     nvmlDevice_t device;
     nvmlReturn_t ret;
 
-    nvml = getNvmlHandleConst(h);
+    nvml = getNvmlHandle(h);
     if (nvml == NULL) {
         return NvCtrlBadHandle;
     }
 
     /* Get the proper device according to the cooler ID */
-    coolerId = getThermalCoolerId(h, nvml->coolerCount,
-                                  nvml->coolerCountPerGPU);
+    coolerId = getThermalCoolerId(h);
     if (coolerId == -1) {
         return NvCtrlBadHandle;
     }
 
-    ret = nvml->lib.deviceGetHandleByIndex(nvml->deviceIdx, &device);
+    ret = getNvmlDevice(nvml, &device);
     if (ret == NVML_SUCCESS) {
         switch (attr) {
             case NV_CTRL_THERMAL_COOLER_LEVEL:
@@ -1438,6 +2493,7 @@ static ReturnStatus NvCtrlNvmlSetCoolerAttribute(CtrlTarget *ctrl_target,
     }
 
     /* An NVML error occurred */
+    checkNvmlDevice(nvml, ret);
     printNvmlError(ret);
     return NvCtrlNotSupported;
 }
@@ -1483,10 +2539,13 @@ static nvmlReturn_t getDeviceMemoryCounts(const CtrlTarget *ctrl_target,
                                           nvmlDevice_t device,
                                           nvmlMemoryErrorType_t errorType,
                                           nvmlEccCounterType_t counterType,
-                                          unsigned char **data, int *len)
+                                          unsigned char **data, int *len,
+                                          NvCtrlBinaryScratch *scratch)
 {
     unsigned long long count;
-    int *counts = (int *) nvalloc(sizeof(int) * NVML_MEMORY_LOCATION_COUNT);
+    int *counts = (int *)
+        NvCtrlAllocBinaryData(scratch,
+                              sizeof(int) * NVML_MEMORY_LOCATION_COUNT);
     nvmlReturn_t ret, anySuccess = NVML_ERROR_NOT_SUPPORTED;
     int i;
 
@@ -1494,7 +2553,7 @@ static nvmlReturn_t getDeviceMemoryCounts(const CtrlTarget *ctrl_target,
          i < NVML_MEMORY_LOCATION_COUNT;
          i++) {
 
-        ret = nvml->lib.deviceGetMemoryErrorCounter(device, errorType,
+        ret = nvml->lib->deviceGetMemoryErrorCounter(device, errorType,
                                                     counterType, i, &count);
         if (ret == NVML_SUCCESS) {
             anySuccess = NVML_SUCCESS;
@@ -1518,29 +2577,35 @@ static nvmlReturn_t getDeviceMemoryCounts(const CtrlTarget *ctrl_target,
 
 static ReturnStatus
 NvCtrlNvmlGetGPUBinaryAttribute(const CtrlTarget *ctrl_target,
-                                int attr, unsigned char **data, int *len)
+                                int attr, unsigned char **data, int *len,
+                                NvCtrlBinaryScratch *scratch)
 {
     const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
-    const NvCtrlNvmlAttributes *nvml;
+    NvCtrlNvmlAttributes *nvml;
     nvmlDevice_t device;
     nvmlReturn_t ret;
 
-    nvml = getNvmlHandleConst(h);
+    nvml = getNvmlHandle(h);
     if (nvml == NULL) {
         return NvCtrlBadHandle;
     }
 
-    ret = nvml->lib.deviceGetHandleByIndex(nvml->deviceIdx, &device);
+    ret = getNvmlDevice(nvml, &device);
     if (ret == NVML_SUCCESS) {
         switch (attr) {
             case NV_CTRL_BINARY_DATA_COOLERS_USED_BY_GPU:
             {
+                const NvCtrlNvmlSystem *sys = getNvmlTopology(h->system);
                 unsigned int *fan_data;
                 unsigned int count = 0;
                 int offset = 0;
                 int i = 0;
 
-                ret = nvml->lib.deviceGetNumFans(device, &count);
+                if (sys == NULL) {
+                    return NvCtrlBadHandle;
+                }
+
+                ret = nvml->lib->deviceGetNumFans(device, &count);
                 if (ret != NVML_SUCCESS) {
                     return NvCtrlNotSupported;
                 }
@@ -1553,13 +2618,14 @@ NvCtrlNvmlGetGPUBinaryAttribute(const CtrlTarget *ctrl_target,
                  */
 
                 *len = (count + 1) * sizeof(unsigned int);
-                fan_data = (unsigned int *) nvalloc(*len);
+                fan_data = (unsigned int *) NvCtrlAllocBinaryData(scratch,
+                                                                  *len);
                 memset(fan_data, 0, *len);
                 *data = (unsigned char *) fan_data;
 
                 /* Calculate global fan index offset for this GPU */
                 for (i = 0; i < nvml->deviceIdx; i++) {
-                    offset += nvml->coolerCountPerGPU[i];
+                    offset += sys->coolerCountPerGPU[i];
                 }
 
                 fan_data[0] = count;
@@ -1572,25 +2638,25 @@ NvCtrlNvmlGetGPUBinaryAttribute(const CtrlTarget *ctrl_target,
                 ret = getDeviceMemoryCounts(ctrl_target, nvml, device,
                                             NVML_MEMORY_ERROR_TYPE_CORRECTED,
                                             NVML_VOLATILE_ECC,
-                                            data, len);
+                                            data, len, scratch);
                 break;
             case NV_CTRL_BINARY_DATA_GPU_ECC_DETAILED_ERRORS_DOUBLE_BIT:
                 ret = getDeviceMemoryCounts(ctrl_target, nvml, device,
                                             NVML_MEMORY_ERROR_TYPE_UNCORRECTED,
                                             NVML_VOLATILE_ECC,
-                                            data, len);
+                                            data, len, scratch);
                 break;
             case NV_CTRL_BINARY_DATA_GPU_ECC_DETAILED_ERRORS_SINGLE_BIT_AGGREGATE:
                 ret = getDeviceMemoryCounts(ctrl_target, nvml, device,
                                             NVML_MEMORY_ERROR_TYPE_CORRECTED,
                                             NVML_AGGREGATE_ECC,
-                                            data, len);
+                                            data, len, scratch);
                 break;
             case NV_CTRL_BINARY_DATA_GPU_ECC_DETAILED_ERRORS_DOUBLE_BIT_AGGREGATE:
                 ret = getDeviceMemoryCounts(ctrl_target, nvml, device,
                                             NVML_MEMORY_ERROR_TYPE_UNCORRECTED,
                                             NVML_AGGREGATE_ECC,
-                                            data, len);
+                                            data, len, scratch);
                 break;
             case NV_CTRL_BINARY_DATA_FRAMELOCKS_USED_BY_GPU:
             case NV_CTRL_BINARY_DATA_THERMAL_SENSORS_USED_BY_GPU:
@@ -1618,6 +2684,7 @@ NvCtrlNvmlGetGPUBinaryAttribute(const CtrlTarget *ctrl_target,
     }
 
     /* An NVML error occurred */
+    checkNvmlDevice(nvml, ret);
     printNvmlError(ret);
     return NvCtrlNotSupported;
 }
@@ -1626,7 +2693,8 @@ NvCtrlNvmlGetGPUBinaryAttribute(const CtrlTarget *ctrl_target,
 
 ReturnStatus
 NvCtrlNvmlGetBinaryAttribute(const CtrlTarget *ctrl_target,
-                             int attr, unsigned char **data, int *len)
+                             int attr, unsigned char **data, int *len,
+                             NvCtrlBinaryScratch *scratch)
 {
     if (NvmlMissing(ctrl_target)) {
         return NvCtrlMissingExtension;
@@ -1644,7 +2712,8 @@ NvCtrlNvmlGetBinaryAttribute(const CtrlTarget *ctrl_target,
             return NvCtrlNvmlGetGPUBinaryAttribute(ctrl_target,
                                                    attr,
                                                    data,
-                                                   len);
+                                                   len,
+                                                   scratch);
 
         case THERMAL_SENSOR_TARGET:
             /* Did we forget to handle a sensor binary attribute? */
@@ -1796,18 +2865,18 @@ NvCtrlNvmlGetGPUValidAttributeValues(const CtrlTarget *ctrl_target, int attr,
                                      CtrlAttributeValidValues *val)
 {
     const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
-    const NvCtrlNvmlAttributes *nvml;
+    NvCtrlNvmlAttributes *nvml;
     nvmlDevice_t device;
     nvmlReturn_t ret;
 
-    nvml = getNvmlHandleConst(h);
+    nvml = getNvmlHandle(h);
     if (nvml == NULL) {
         return NvCtrlBadHandle;
     }
 
     val->permissions.write = NV_FALSE;
 
-    ret = nvml->lib.deviceGetHandleByIndex(nvml->deviceIdx, &device);
+    ret = getNvmlDevice(nvml, &device);
     if (ret == NVML_SUCCESS) {
         switch (attr) {
             case NV_CTRL_TOTAL_DEDICATED_GPU_MEMORY:
@@ -1908,6 +2977,7 @@ NvCtrlNvmlGetGPUValidAttributeValues(const CtrlTarget *ctrl_target, int attr,
     }
 
     /* An NVML error occurred */
+    checkNvmlDevice(nvml, ret);
     printNvmlError(ret);
     return NvCtrlNoAttribute;
 }
@@ -1918,25 +2988,24 @@ NvCtrlNvmlGetThermalValidAttributeValues(const CtrlTarget *ctrl_target,
                                          CtrlAttributeValidValues *val)
 {
     const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
-    const NvCtrlNvmlAttributes *nvml;
+    NvCtrlNvmlAttributes *nvml;
     int sensorId;
     nvmlDevice_t device;
     nvmlReturn_t ret;
 
-    nvml = getNvmlHandleConst(h);
+    nvml = getNvmlHandle(h);
     if (nvml == NULL) {
         return NvCtrlBadHandle;
     }
 
     /* Get the proper device and sensor ID according to the target ID */
-    sensorId = getThermalCoolerId(h, nvml->sensorCount,
-                                  nvml->sensorCountPerGPU);
+    sensorId = getThermalCoolerId(h);
     if (sensorId == -1) {
         return NvCtrlBadHandle;
     }
 
 
-    ret = nvml->lib.deviceGetHandleByIndex(nvml->deviceIdx, &device);
+    ret = getNvmlDevice(nvml, &device);
     if (ret == NVML_SUCCESS) {
         switch (attr) {
             case NV_CTRL_THERMAL_SENSOR_READING:
@@ -1959,6 +3028,7 @@ NvCtrlNvmlGetThermalValidAttributeValues(const CtrlTarget *ctrl_target,
     }
 
     /* An NVML error occurred */
+    checkNvmlDevice(nvml, ret);
     printNvmlError(ret);
     return NvCtrlNoAttribute;
 }
@@ -1969,25 +3039,24 @@ NvCtrlNvmlGetCoolerValidAttributeValues(const CtrlTarget *ctrl_target,
                                         CtrlAttributeValidValues *val)
 {
     const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
-    const NvCtrlNvmlAttributes *nvml;
+    NvCtrlNvmlAttributes *nvml;
     int coolerId;
     nvmlDevice_t device;
     nvmlReturn_t ret;
 
-    nvml = getNvmlHandleConst(h);
+    nvml = getNvmlHandle(h);
     if (nvml == NULL) {
         return NvCtrlBadHandle;
     }
 
     /* Get the proper device and cooler ID according to the target ID */
-    coolerId = getThermalCoolerId(h, nvml->coolerCount,
-                                  nvml->coolerCountPerGPU);
+    coolerId = getThermalCoolerId(h);
     if (coolerId == -1) {
         return NvCtrlBadHandle;
     }
 
 
-    ret = nvml->lib.deviceGetHandleByIndex(nvml->deviceIdx, &device);
+    ret = getNvmlDevice(nvml, &device);
     if (ret == NVML_SUCCESS) {
         switch (attr) {
             case NV_CTRL_THERMAL_COOLER_CURRENT_LEVEL:
@@ -2018,6 +3087,7 @@ NvCtrlNvmlGetCoolerValidAttributeValues(const CtrlTarget *ctrl_target,
     }
 
     /* An NVML error occurred */
+    checkNvmlDevice(nvml, ret);
     printNvmlError(ret);
     return NvCtrlNoAttribute;
 }
@@ -2200,3 +3270,263 @@ NvCtrlNvmlGetAttributePerms(const NvCtrlAttributePrivateHandle *h,
 
 }
 
+
+
+/*
+ * Body of the event listener thread: wait for NVML events and forward them
+ * as CtrlEvents through the pipe.  ECC errors are reported as changes of the
+ * corresponding error count attributes and clock changes as a change of the
+ * current clock frequencies string, so that pages can use the same handlers
+ * as for NV-CONTROL events.
+ *
+ * Failed waits are retried with an exponential backoff.  If they keep
+ * failing, the thread gives up and closes the write end of the pipe, so that
+ * readers see the end of file and can go back to polling.
+ */
+
+#define NVML_EVENT_WAIT_MSEC 250
+#define NVML_EVENT_RETRY_MAX_MSEC 8000
+#define NVML_EVENT_MAX_RETRIES 10
+
+/*
+ * Sleep for the given time, returning early (with FALSE) if the thread is
+ * asked to stop meanwhile.
+ */
+
+static Bool eventThreadSleep(NvCtrlNvmlEvents *events, int msec)
+{
+    struct timespec ts;
+    int slice;
+
+    while (msec > 0) {
+        if (__atomic_load_n(&events->stop, __ATOMIC_ACQUIRE)) {
+            return FALSE;
+        }
+
+        slice = NV_MIN(msec, NVML_EVENT_WAIT_MSEC);
+        ts.tv_sec = 0;
+        ts.tv_nsec = slice * 1000000L;
+        nanosleep(&ts, NULL);
+        msec -= slice;
+    }
+
+    return TRUE;
+}
+
+static void *eventThread(void *arg)
+{
+    NvCtrlNvmlEvents *events = arg;
+    nvmlEventData_t data;
+    nvmlReturn_t ret;
+    CtrlEvent event;
+    int retries = 0;
+    int backoff = NVML_EVENT_WAIT_MSEC;
+    int i;
+
+    while (!__atomic_load_n(&events->stop, __ATOMIC_ACQUIRE)) {
+
+        ret = events->lib->eventSetWait(events->set, &data,
+                                        NVML_EVENT_WAIT_MSEC);
+        if (ret == NVML_ERROR_TIMEOUT) {
+            retries = 0;
+            backoff = NVML_EVENT_WAIT_MSEC;
+            continue;
+        }
+        if (ret != NVML_SUCCESS) {
+            printNvmlError(ret);
+
+            /* e.g. the GPU fell off the bus: nothing more will be delivered */
+            if ((ret == NVML_ERROR_GPU_IS_LOST) ||
+                (ret == NVML_ERROR_UNINITIALIZED) ||
+                (++retries > NVML_EVENT_MAX_RETRIES)) {
+                nv_warning_msg("NVML events are no longer available.");
+                __atomic_store_n(&events->failed, TRUE, __ATOMIC_RELEASE);
+                close(events->fds[1]);
+                events->fds[1] = -1;
+                break;
+            }
+
+            if (!eventThreadSleep(events, backoff)) {
+                break;
+            }
+            backoff = NV_MIN(backoff * 2, NVML_EVENT_RETRY_MAX_MSEC);
+            continue;
+        }
+
+        retries = 0;
+        backoff = NVML_EVENT_WAIT_MSEC;
+
+        for (i = 0; i < events->deviceCount; i++) {
+            if (events->devices[i] == data.device) {
+                break;
+            }
+        }
+        if ((i == events->deviceCount) || (events->nvctrlIds[i] < 0)) {
+            continue;
+        }
+
+        memset(&event, 0, sizeof(CtrlEvent));
+        event.target_type = GPU_TARGET;
+        event.target_id   = events->nvctrlIds[i];
+
+        if (data.eventType & nvmlEventTypeSingleBitEccError) {
+            event.type = CTRL_EVENT_TYPE_INTEGER_ATTRIBUTE;
+            event.int_attr.attribute = NV_CTRL_GPU_ECC_SINGLE_BIT_ERRORS;
+        } else if (data.eventType & nvmlEventTypeDoubleBitEccError) {
+            event.type = CTRL_EVENT_TYPE_INTEGER_ATTRIBUTE;
+            event.int_attr.attribute = NV_CTRL_GPU_ECC_DOUBLE_BIT_ERRORS;
+        } else if (data.eventType & nvmlEventTypeClock) {
+            event.type = CTRL_EVENT_TYPE_STRING_ATTRIBUTE;
+            event.str_attr.attribute = NV_CTRL_STRING_GPU_CURRENT_CLOCK_FREQS;
+        } else if (data.eventType & nvmlEventTypeXidCriticalError) {
+            event.type = CTRL_EVENT_TYPE_XID_ERROR;
+            event.xid_error.xid = data.eventData;
+        } else {
+            continue;
+        }
+
+        /*
+         * The write end is non-blocking and events are smaller than
+         * PIPE_BUF, so this is atomic; if the GUI fell behind and the pipe
+         * is full, the event is dropped.
+         */
+        if (write(events->fds[1], &event, sizeof(event)) != sizeof(event)) {
+            continue;
+        }
+    }
+
+    return NULL;
+}
+
+
+
+/*
+ * Register every NVML device of the system for the ECC error, clock change
+ * and XID events it supports, and start the thread listening to them.
+ * Returns the file descriptor to poll for these events, or -1 if NVML
+ * events are not available.  Subsequent calls return the same descriptor.
+ */
+
+int NvCtrlNvmlStartEvents(CtrlSystem *system)
+{
+    NvCtrlNvmlSystem *sys;
+    NvCtrlNvmlEvents *events;
+    const NvCtrlNvmlLibrary *lib;
+    unsigned long long types;
+    int registered = 0;
+    int i;
+
+    if ((system == NULL) || (system->nvml == NULL)) {
+        return -1;
+    }
+
+    sys = system->nvml;
+    if (sys->events != NULL) {
+        return sys->events->fds[0];
+    }
+
+    lib = sys->lib;
+    if ((lib->eventSetCreate == NULL) ||
+        (lib->eventSetFree == NULL) ||
+        (lib->eventSetWait == NULL) ||
+        (lib->deviceRegisterEvents == NULL) ||
+        (lib->deviceGetSupportedEventTypes == NULL)) {
+        return -1;
+    }
+
+    events = nvalloc(sizeof(NvCtrlNvmlEvents));
+    events->lib = lib;
+    events->deviceCount = sys->deviceCount;
+    events->devices = nvalloc(sys->deviceCount * sizeof(nvmlDevice_t));
+    events->eventTypes = nvalloc(sys->deviceCount * sizeof(unsigned long long));
+    events->nvctrlIds = nvalloc(sys->deviceCount * sizeof(int));
+    events->fds[0] = events->fds[1] = -1;
+
+    if (lib->eventSetCreate(&events->set) != NVML_SUCCESS) {
+        events->set = NULL;
+        goto fail;
+    }
+
+    for (i = 0; i < sys->deviceCount; i++) {
+        events->nvctrlIds[i] = -1;
+    }
+    /* Walk backwards so that the lowest GPU target id wins on duplicates */
+    for (i = sys->deviceCount - 1; i >= 0; i--) {
+        events->nvctrlIds[sys->nvctrlToNvmlId[i]] = i;
+    }
+
+    for (i = 0; i < sys->deviceCount; i++) {
+        if ((lib->deviceGetHandleByIndex(i, &events->devices[i]) !=
+             NVML_SUCCESS) ||
+            (lib->deviceGetSupportedEventTypes(events->devices[i], &types) !=
+             NVML_SUCCESS)) {
+            continue;
+        }
+
+        types &= NVML_EVENT_TYPES;
+        if ((types != 0) &&
+            (lib->deviceRegisterEvents(events->devices[i], types,
+                                       events->set) == NVML_SUCCESS)) {
+            events->eventTypes[i] = types;
+            registered++;
+        }
+    }
+
+    if (registered == 0) {
+        goto fail;
+    }
+
+    if ((pipe(events->fds) != 0) ||
+        (fcntl(events->fds[0], F_SETFL, O_NONBLOCK) == -1) ||
+        (fcntl(events->fds[1], F_SETFL, O_NONBLOCK) == -1)) {
+        goto fail;
+    }
+
+    if (pthread_create(&events->thread, NULL, eventThread, events) != 0) {
+        nv_warning_msg("Unable to start the NVML event thread.");
+        goto fail;
+    }
+
+    sys->events = events;
+
+    return events->fds[0];
+
+ fail:
+    freeEvents(events);
+    return -1;
+}
+
+
+
+/*
+ * Get the NVML event types (nvmlEventType* bits) that are delivered for the
+ * GPU of the given target.
+ */
+
+ReturnStatus NvCtrlNvmlGetEventTypes(const CtrlTarget *ctrl_target,
+                                     unsigned long long *event_types)
+{
+    const NvCtrlAttributePrivateHandle *h = getPrivateHandleConst(ctrl_target);
+    const NvCtrlNvmlAttributes *nvml;
+    const NvCtrlNvmlSystem *sys;
+
+    if (NvmlMissing(ctrl_target)) {
+        return NvCtrlMissingExtension;
+    }
+
+    nvml = getNvmlHandle(h);
+    sys = h->system->nvml;
+    if ((nvml == NULL) || (sys == NULL) ||
+        (nvml->deviceIdx >= sys->deviceCount)) {
+        return NvCtrlBadHandle;
+    }
+
+    if ((sys->events == NULL) ||
+        __atomic_load_n(&sys->events->failed, __ATOMIC_ACQUIRE)) {
+        return NvCtrlNotSupported;
+    }
+
+    *event_types = sys->events->eventTypes[nvml->deviceIdx];
+
+    return NvCtrlSuccess;
+}
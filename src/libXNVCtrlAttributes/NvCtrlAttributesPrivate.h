@@ -26,6 +26,11 @@
 #include <EGL/egl.h>
 #include <X11/extensions/Xrandr.h> /* Xrandr */
 #include <nvml.h>
+#include <pthread.h>
+
+#if defined(NV_USE_XCB)
+#include <xcb/xcb.h>
+#endif
 
 /* Make sure we are compiling with XRandR version 1.2 or greater */
 #define MIN_RANDR_MAJOR 1
@@ -116,7 +121,12 @@ typedef struct __NvCtrlXvTextureAttributes NvCtrlXvTextureAttributes;
 typedef struct __NvCtrlXvBlitterAttributes NvCtrlXvBlitterAttributes;
 typedef struct __NvCtrlXvAttribute NvCtrlXvAttribute;
 typedef struct __NvCtrlXrandrAttributes NvCtrlXrandrAttributes;
+typedef struct __NvCtrlGlxAttributes NvCtrlGlxAttributes;
 typedef struct __NvCtrlNvmlAttributes NvCtrlNvmlAttributes;
+typedef struct __NvCtrlNvmlLibrary NvCtrlNvmlLibrary;
+typedef struct __NvCtrlNvmlSystem NvCtrlNvmlSystem;
+typedef struct __NvCtrlNvmlSampler NvCtrlNvmlSampler;
+typedef struct __NvCtrlNvmlEvents NvCtrlNvmlEvents;
 typedef struct __NvCtrlEventPrivateHandle NvCtrlEventPrivateHandle;
 typedef struct __NvCtrlEventPrivateHandleNode NvCtrlEventPrivateHandleNode;
 
@@ -131,6 +141,9 @@ struct __NvCtrlNvControlAttributes {
     int error_base;
     int major_version;
     int minor_version;
+#if defined(NV_USE_XCB)
+    xcb_connection_t *xcb; /* the Display's connection, for pipelining */
+#endif
 };
 
 struct __NvCtrlVidModeAttributes {
@@ -149,6 +162,20 @@ struct __NvCtrlXvAttributes {
     Bool blitter;
 };
 
+/*
+ * GLX strings and fbconfigs of an X screen.  They are all collected from a
+ * single probe context the first time one of them is queried, and kept for
+ * the lifetime of the handle.
+ */
+
+struct __NvCtrlGlxAttributes {
+    Bool probed;
+    char *strings[NV_CTRL_STRING_GLX_LAST_ATTRIBUTE -
+                  NV_CTRL_STRING_GLX_BASE + 1];
+    GLXFBConfigAttr *fbconfig_attribs; /* NULL if unavailable */
+    int fbconfig_count;
+};
+
 struct __NvCtrlXrandrAttributes {
     int event_base;
     int error_base;
@@ -160,53 +187,178 @@ struct __NvCtrlXrandrAttributes {
     XRRCrtcGamma *pGammaRamp;
 };
 
-struct __NvCtrlNvmlAttributes {
-    struct {
-        void *handle;
-
-        typeof(nvmlInit)                                (*init);
-        typeof(nvmlShutdown)                            (*shutdown);
-        typeof(nvmlDeviceGetHandleByIndex)              (*deviceGetHandleByIndex);
-        typeof(nvmlDeviceGetUUID)                       (*deviceGetUUID);
-        typeof(nvmlDeviceGetCount)                      (*deviceGetCount);
-        typeof(nvmlDeviceGetTemperature)                (*deviceGetTemperature);
-        typeof(nvmlDeviceGetName)                       (*deviceGetName);
-        typeof(nvmlDeviceGetVbiosVersion)               (*deviceGetVbiosVersion);
-        typeof(nvmlDeviceGetMemoryInfo)                 (*deviceGetMemoryInfo);
-        typeof(nvmlDeviceGetMemoryInfo_v2)              (*deviceGetMemoryInfo_v2);
-        typeof(nvmlDeviceGetPciInfo)                    (*deviceGetPciInfo);
-        typeof(nvmlDeviceGetCurrPcieLinkWidth)          (*deviceGetCurrPcieLinkWidth);
-        typeof(nvmlDeviceGetMaxPcieLinkGeneration)      (*deviceGetMaxPcieLinkGeneration);
-        typeof(nvmlDeviceGetMaxPcieLinkWidth)           (*deviceGetMaxPcieLinkWidth);
-        typeof(nvmlDeviceGetVirtualizationMode)         (*deviceGetVirtualizationMode);
-        typeof(nvmlDeviceGetGridLicensableFeatures_v4)  (*deviceGetGridLicensableFeatures);
-        typeof(nvmlDeviceGetUtilizationRates)           (*deviceGetUtilizationRates);
-        typeof(nvmlDeviceGetTemperatureThreshold)       (*deviceGetTemperatureThreshold);
-        typeof(nvmlDeviceGetFanSpeed_v2)                (*deviceGetFanSpeed_v2);
-        typeof(nvmlSystemGetDriverVersion)              (*systemGetDriverVersion);
-        typeof(nvmlDeviceGetEccMode)                    (*deviceGetEccMode);
-        typeof(nvmlDeviceSetEccMode)                    (*deviceSetEccMode);
-        typeof(nvmlDeviceGetTotalEccErrors)             (*deviceGetTotalEccErrors);
-        typeof(nvmlDeviceClearEccErrorCounts)           (*deviceClearEccErrorCounts);
-        typeof(nvmlDeviceGetMemoryErrorCounter)         (*deviceGetMemoryErrorCounter);
-        typeof(nvmlSystemGetNVMLVersion)                (*systemGetNVMLVersion);
-        typeof(nvmlDeviceGetNumGpuCores)                (*deviceGetNumGpuCores);
-        typeof(nvmlDeviceGetMemoryBusWidth)             (*deviceGetMemoryBusWidth);
-        typeof(nvmlDeviceGetIrqNum)                     (*deviceGetIrqNum);
-        typeof(nvmlDeviceGetPowerSource)                (*deviceGetPowerSource);
-        typeof(nvmlDeviceGetNumFans)                    (*deviceGetNumFans);
-
-    } lib;
+/*
+ * The NVML library is loaded and initialized once per process and shared by
+ * every CtrlSystem and NVML-capable target; see NvCtrlNvmlOpenLibrary().
+ */
 
-    unsigned int deviceIdx; /* XXX Needed while using NV-CONTROL as fallback */
+struct __NvCtrlNvmlLibrary {
+    void *handle;
+    int   ref_count; /* # users of the library */
+
+    typeof(nvmlInit)                                (*init);
+    typeof(nvmlShutdown)                            (*shutdown);
+    typeof(nvmlDeviceGetHandleByIndex)              (*deviceGetHandleByIndex);
+    typeof(nvmlDeviceGetUUID)                       (*deviceGetUUID);
+    typeof(nvmlDeviceGetCount)                      (*deviceGetCount);
+    typeof(nvmlDeviceGetTemperature)                (*deviceGetTemperature);
+    typeof(nvmlDeviceGetName)                       (*deviceGetName);
+    typeof(nvmlDeviceGetVbiosVersion)               (*deviceGetVbiosVersion);
+    typeof(nvmlDeviceGetMemoryInfo)                 (*deviceGetMemoryInfo);
+    typeof(nvmlDeviceGetMemoryInfo_v2)              (*deviceGetMemoryInfo_v2);
+    typeof(nvmlDeviceGetPciInfo)                    (*deviceGetPciInfo);
+    typeof(nvmlDeviceGetCurrPcieLinkWidth)          (*deviceGetCurrPcieLinkWidth);
+    typeof(nvmlDeviceGetMaxPcieLinkGeneration)      (*deviceGetMaxPcieLinkGeneration);
+    typeof(nvmlDeviceGetMaxPcieLinkWidth)           (*deviceGetMaxPcieLinkWidth);
+    typeof(nvmlDeviceGetVirtualizationMode)         (*deviceGetVirtualizationMode);
+    typeof(nvmlDeviceGetGridLicensableFeatures_v4)  (*deviceGetGridLicensableFeatures);
+    typeof(nvmlDeviceGetUtilizationRates)           (*deviceGetUtilizationRates);
+    typeof(nvmlDeviceGetTemperatureThreshold)       (*deviceGetTemperatureThreshold);
+    typeof(nvmlDeviceGetFanSpeed_v2)                (*deviceGetFanSpeed_v2);
+    typeof(nvmlSystemGetDriverVersion)              (*systemGetDriverVersion);
+    typeof(nvmlDeviceGetEccMode)                    (*deviceGetEccMode);
+    typeof(nvmlDeviceSetEccMode)                    (*deviceSetEccMode);
+    typeof(nvmlDeviceGetTotalEccErrors)             (*deviceGetTotalEccErrors);
+    typeof(nvmlDeviceClearEccErrorCounts)           (*deviceClearEccErrorCounts);
+    typeof(nvmlDeviceGetMemoryErrorCounter)         (*deviceGetMemoryErrorCounter);
+    typeof(nvmlSystemGetNVMLVersion)                (*systemGetNVMLVersion);
+    typeof(nvmlDeviceGetNumGpuCores)                (*deviceGetNumGpuCores);
+    typeof(nvmlDeviceGetMemoryBusWidth)             (*deviceGetMemoryBusWidth);
+    typeof(nvmlDeviceGetIrqNum)                     (*deviceGetIrqNum);
+    typeof(nvmlDeviceGetPowerSource)                (*deviceGetPowerSource);
+    typeof(nvmlDeviceGetNumFans)                    (*deviceGetNumFans);
+    typeof(nvmlDeviceGetHandleByUUID)               (*deviceGetHandleByUUID);
+    typeof(nvmlDeviceGetFieldValues)                (*deviceGetFieldValues);
+    typeof(nvmlEventSetCreate)                      (*eventSetCreate);
+    typeof(nvmlEventSetFree)                        (*eventSetFree);
+    typeof(nvmlEventSetWait)                        (*eventSetWait);
+    typeof(nvmlDeviceRegisterEvents)                (*deviceRegisterEvents);
+    typeof(nvmlDeviceGetSupportedEventTypes)        (*deviceGetSupportedEventTypes);
+};
+
+/*
+ * NVML state that does not depend on the target and is therefore computed
+ * once per CtrlSystem by NvCtrlInitNvmlSystem().
+ */
+
+struct __NvCtrlNvmlSystem {
+    NvCtrlNvmlLibrary *lib;        /* shared NVML library instance */
     unsigned int deviceCount;
+    unsigned int *nvctrlToNvmlId;  /* NV-CONTROL GPU id -> NVML device index */
+    CtrlGpuTelemetry *telemetry;   /* last snapshot, per NVML device index */
+    NvCtrlNvmlSampler *sampler;    /* background sampler, if started */
+    NvCtrlNvmlEvents *events;      /* NVML event listener, if started */
+
+    /*
+     * The targets of a system may be queried from several threads, so the
+     * state below that is filled in lazily, and 'telemetry', are only
+     * accessed with 'lock' held.
+     */
+    pthread_mutex_t lock;
+
+    /*
+     * Thermal sensor and cooler topology, indexed by NV-CONTROL GPU id.
+     * Only probed the first time a thermal sensor or cooler is needed; see
+     * getNvmlTopology().
+     */
+    Bool topologyLoaded;
     unsigned int sensorCount;
     unsigned int *sensorCountPerGPU;
     unsigned int coolerCount;
     unsigned int *coolerCountPerGPU;
+
+    /*
+     * Attributes answered by NVML, per target type; see
+     * NvCtrlNvmlRoutesAttribute().  Other attributes go straight to
+     * NV-CONTROL, and 'misroutesAvoided' counts the NVML lookups saved.
+     */
+    unsigned char intRoutes[MAX_TARGET_TYPES][NV_CTRL_LAST_ATTRIBUTE + 1];
+    unsigned char stringRoutes[MAX_TARGET_TYPES]
+                              [NV_CTRL_STRING_LAST_ATTRIBUTE + 1];
+    unsigned long misroutesAvoided;
+};
+
+/*
+ * Background telemetry sampler.  The sampler thread is the only writer of
+ * the ring; any number of readers pick the most recent slot without locking.
+ * A slot's 'seq' is odd while the thread rewrites it, so readers can detect
+ * (and retry on) a slot that was recycled under them.
+ */
+
+#define NVML_SAMPLER_RING_SIZE 4
+
+typedef struct {
+    unsigned int seq;
+    CtrlGpuTelemetry *telemetry;   /* one entry per NVML device */
+} NvCtrlNvmlSamplerSlot;
+
+struct __NvCtrlNvmlSampler {
+    const NvCtrlNvmlLibrary *lib;
+    unsigned int deviceCount;
+    unsigned int intervalMs;
+
+    pthread_t thread;
+    pthread_mutex_t lock;          /* protects 'stop' */
+    pthread_cond_t cond;
+    Bool stop;
+
+    unsigned int head;             /* # of samples published so far */
+    NvCtrlNvmlSamplerSlot slots[NVML_SAMPLER_RING_SIZE];
 };
 
+/*
+ * NVML event listener.  A thread waits on an NVML event set and forwards
+ * each event, already translated into a CtrlEvent, through a pipe whose
+ * read end is polled along with the X connection by the event handles.
+ */
+
+#define NVML_EVENT_TYPES (nvmlEventTypeSingleBitEccError | \
+                          nvmlEventTypeDoubleBitEccError | \
+                          nvmlEventTypeClock             | \
+                          nvmlEventTypeXidCriticalError)
+
+struct __NvCtrlNvmlEvents {
+    const NvCtrlNvmlLibrary *lib;
+    nvmlEventSet_t set;
+    unsigned int deviceCount;
+    nvmlDevice_t *devices;            /* per NVML device index */
+    unsigned long long *eventTypes;   /* registered types, per device */
+    int *nvctrlIds;                   /* NVML device index -> GPU target id */
+
+    pthread_t thread;
+    Bool stop;
+    Bool failed;                      /* the thread gave up, see eventThread */
+    int fds[2];                       /* pipe: [0] read end, [1] write end */
+};
+
+struct __NvCtrlNvmlAttributes {
+    NvCtrlNvmlLibrary *lib; /* shared NVML library instance */
+
+    unsigned int deviceIdx; /* XXX Needed while using NV-CONTROL as fallback */
+
+    /*
+     * Cached device handle, resolved in NvCtrlInitNvmlAttributes() and
+     * re-resolved by UUID after the GPU has been reset or lost.
+     */
+    nvmlDevice_t device;
+    Bool deviceValid;
+    char deviceUUID[NVML_DEVICE_UUID_V2_BUFFER_SIZE];
+
+    unsigned int deviceCount;
+};
+
+/*
+ * Growable buffer that binary attribute queries store their data in, rather
+ * than in a newly allocated block; see NvCtrlGetBinaryAttributeScratch().
+ */
+
+typedef struct {
+    unsigned char *data;
+    int size;
+} NvCtrlBinaryScratch;
+
 struct __NvCtrlAttributePrivateHandle {
+    CtrlSystem *system;             /* system this handle belongs to */
     Display *dpy;                   /* display connection */
     CtrlTargetType target_type;     /* Type of target this handle controls */
     int target_id;                  /* screen num, gpu num (etc) of target */
@@ -217,20 +369,36 @@ struct __NvCtrlAttributePrivateHandle {
     /* Screen-specific attributes */
     NvCtrlVidModeAttributes *vm;    /* XF86VidMode extension info */
     NvCtrlXvAttributes *xv;         /* XVideo info */
-    Bool glx;                       /* GLX extension available */
+    NvCtrlGlxAttributes *glx;       /* GLX extension info */
     Bool egl;                       /* EGL extension available */
     EGLDisplay egl_dpy;
     NvCtrlXrandrAttributes *xrandr; /* XRandR extension info */
 
     /* NVML-specific attributes */
     NvCtrlNvmlAttributes *nvml;
+
+    /* Subsystems not initialized yet; see NvCtrlLoadSubsystems() */
+    unsigned int lazy_subsystems;
+
+    /* Binary data of the last NvCtrlGetBinaryAttributeScratch() call */
+    NvCtrlBinaryScratch binary_scratch;
 };
 
 struct __NvCtrlEventPrivateHandle {
+    CtrlSystem *system;    /* system the events are received for */
     Display *dpy;          /* display connection */
     int fd;                /* file descriptor to poll for new events */
+    int nvml_fd;           /* NVML events pipe, or -1 */
     int nvctrl_event_base; /* NV-CONTROL base for indexing & identifying evts */
     int xrandr_event_base; /* RandR base for indexing & identifying evts */
+
+    /* Event coalescing; see NvCtrlEventHandleSetCoalescing() */
+    Bool coalesce;
+    CtrlEvent *coalesced;         /* collapsed events not delivered yet */
+    int num_coalesced;
+    int next_coalesced;           /* index of the next event to deliver */
+    int max_coalesced;            /* allocated size of 'coalesced' */
+    unsigned long dropped_events; /* events superseded by a later one */
 };
 
 struct __NvCtrlEventPrivateHandleNode {
@@ -290,7 +458,7 @@ ReturnStatus NvCtrlXvGetStringAttribute(const NvCtrlAttributePrivateHandle *,
 
 /* GLX extension attribute functions */
 
-Bool
+NvCtrlGlxAttributes *
 NvCtrlInitGlxAttributes (NvCtrlAttributePrivateHandle *);
 
 void
@@ -387,6 +555,17 @@ NvCtrlNvControlQueryTargetCount(const NvCtrlAttributePrivateHandle *, int,
 ReturnStatus NvCtrlNvControlGetAttribute(const NvCtrlAttributePrivateHandle *,
                                          unsigned int, int, int64_t *);
 
+void NvCtrlNvControlGetAttributesBatch(CtrlAttributeQuery *, int, Bool *);
+
+void NvCtrlNvControlGetStringAttributesBatch(CtrlStringAttributeQuery *, int,
+                                             Bool *);
+
+void NvCtrlNvControlGetBinaryAttributesBatch(CtrlBinaryAttributeQuery *, int,
+                                             Bool *);
+
+void NvCtrlNvControlQueryTargetCountsBatch(CtrlTargetCountQuery *, int,
+                                           Bool *);
+
 ReturnStatus
 NvCtrlNvControlSetAttribute (NvCtrlAttributePrivateHandle *, unsigned int,
                              int, int);
@@ -422,13 +601,178 @@ NvCtrlNvControlSetStringAttribute (NvCtrlAttributePrivateHandle *,
 ReturnStatus
 NvCtrlNvControlGetBinaryAttribute(const NvCtrlAttributePrivateHandle *h,
                                   unsigned int display_mask, int attr,
-                                  unsigned char **data, int *len);
+                                  unsigned char **data, int *len,
+                                  NvCtrlBinaryScratch *scratch);
 
 ReturnStatus
 NvCtrlNvControlStringOperation (NvCtrlAttributePrivateHandle *h,
                                 unsigned int display_mask, int attr,
                                 const char *ptrIn, char **ptrOut);
 
+/*
+ * Subsystems that are only initialized when an attribute needs them: most
+ * queries never touch them, but they cost library loads and X round trips.
+ */
+
+#define NV_CTRL_ATTRIBUTES_LAZY_SUBSYSTEMS   \
+ (NV_CTRL_ATTRIBUTES_XF86VIDMODE_SUBSYSTEM | \
+  NV_CTRL_ATTRIBUTES_XVIDEO_SUBSYSTEM      | \
+  NV_CTRL_ATTRIBUTES_GLX_SUBSYSTEM         | \
+  NV_CTRL_ATTRIBUTES_XRANDR_SUBSYSTEM      | \
+  NV_CTRL_ATTRIBUTES_EGL_SUBSYSTEM)
+
+void NvCtrlLoadSubsystems(const NvCtrlAttributePrivateHandle *h,
+                          unsigned int subsystems);
+
+unsigned char *NvCtrlAllocBinaryData(NvCtrlBinaryScratch *scratch, int len);
+
+/* backend call statistics; see NvCtrlAttributesStats.c */
+
+typedef enum {
+    NV_CTRL_BACKEND_CACHE = 0,
+    NV_CTRL_BACKEND_NV_CONTROL,
+    NV_CTRL_BACKEND_NVML,
+    NV_CTRL_BACKEND_GLX,
+    NV_CTRL_BACKEND_EGL,
+    NV_CTRL_BACKEND_XRANDR,
+    NV_CTRL_BACKEND_VIDMODE,
+    NV_CTRL_BACKEND_XV,
+    NV_CTRL_BACKEND_COUNT
+} NvCtrlBackend;
+
+typedef enum {
+    NV_CTRL_STATS_INIT = 0,
+    NV_CTRL_STATS_GET,
+    NV_CTRL_STATS_SET,
+    NV_CTRL_STATS_GET_BATCH,
+    NV_CTRL_STATS_GET_STRING,
+    NV_CTRL_STATS_SET_STRING,
+    NV_CTRL_STATS_GET_BINARY,
+    NV_CTRL_STATS_GET_VOID,
+    NV_CTRL_STATS_GET_VALID,
+    NV_CTRL_STATS_GET_PERMS,
+    NV_CTRL_STATS_STRING_OP,
+    NV_CTRL_STATS_TARGET_COUNT,
+    NV_CTRL_STATS_COLOR,
+    NV_CTRL_STATS_TELEMETRY,
+    NV_CTRL_STATS_OP_COUNT
+} NvCtrlStatsOp;
+
+unsigned long long NvCtrlStatsBegin(void);
+void NvCtrlStatsEnd(unsigned long long start, NvCtrlBackend backend,
+                    NvCtrlStatsOp op, int attr, ReturnStatus status,
+                    size_t bytes);
+
+/*
+ * Assigns the result of the backend call 'call' to 'ret', recording the
+ * call; 'bytes' is evaluated once the call has returned.
+ */
+
+#define NV_CTRL_STATS_CALL(ret, backend, op, attr, call, bytes)           \
+    do {                                                                  \
+        unsigned long long __stats_start = NvCtrlStatsBegin();            \
+        (ret) = (call);                                                   \
+        NvCtrlStatsEnd(__stats_start, (backend), (op), (attr), (ret),     \
+                       (bytes));                                          \
+    } while (0)
+
+/*
+ * Assigns the subsystem handle returned by 'init' to 'field', recording the
+ * initialization of the backend.
+ */
+
+#define NV_CTRL_STATS_INIT_BACKEND(backend, field, init)                  \
+    do {                                                                  \
+        unsigned long long __stats_start = NvCtrlStatsBegin();            \
+        (field) = (init);                                                 \
+        NvCtrlStatsEnd(__stats_start, (backend), NV_CTRL_STATS_INIT, -1,  \
+                       (field) ? NvCtrlSuccess : NvCtrlMissingExtension,  \
+                       0);                                                \
+    } while (0)
+
+/*
+ * backend call traces; see NvCtrlAttributesTrace.c.  Unless documented
+ * otherwise, 'attr' is the attribute of the call.
+ */
+
+typedef enum {
+    NV_CTRL_TRACE_OFF = 0,
+    NV_CTRL_TRACE_RECORD,
+    NV_CTRL_TRACE_REPLAY,
+} NvCtrlTraceMode;
+
+typedef enum {
+    NV_CTRL_TRACE_SYSTEM = 0,
+    NV_CTRL_TRACE_GET,
+    NV_CTRL_TRACE_SET,
+    NV_CTRL_TRACE_GET_STRING,
+    NV_CTRL_TRACE_SET_STRING,
+    NV_CTRL_TRACE_GET_BINARY,
+    NV_CTRL_TRACE_GET_VOID,
+    NV_CTRL_TRACE_GET_VALID,
+    NV_CTRL_TRACE_GET_VALID_STRING,
+    NV_CTRL_TRACE_GET_PERMS,        /* display_mask is the attribute type */
+    NV_CTRL_TRACE_STRING_OP,
+    NV_CTRL_TRACE_TARGET_COUNT,     /* attr is the target type counted */
+    NV_CTRL_TRACE_GET_COLOR,
+    NV_CTRL_TRACE_SET_COLOR,
+    NV_CTRL_TRACE_GET_COLOR_RAMP,   /* attr is the channel */
+    NV_CTRL_TRACE_RELOAD_COLOR_RAMP,
+    NV_CTRL_TRACE_TELEMETRY,
+    NV_CTRL_TRACE_EVENT_TYPES,
+} NvCtrlTraceOp;
+
+typedef struct {
+    int target_type;
+    int target_id;
+    Bool physical; /* a physical X screen; see CtrlSystem.physical_screens */
+} NvCtrlTraceTarget;
+
+NvCtrlTraceMode NvCtrlGetTraceMode(void);
+unsigned long long NvCtrlTraceBegin(void);
+unsigned long long NvCtrlTraceElapsed(unsigned long long start);
+void NvCtrlTraceRecord(const NvCtrlAttributePrivateHandle *h,
+                       NvCtrlTraceOp op, unsigned int display_mask, int attr,
+                       ReturnStatus status, const void *data, int len,
+                       unsigned long long us);
+ReturnStatus NvCtrlTraceReplay(const NvCtrlAttributePrivateHandle *h,
+                               NvCtrlTraceOp op, unsigned int display_mask,
+                               int attr, const void **data, int *len);
+ReturnStatus NvCtrlTraceReplayValue(const NvCtrlAttributePrivateHandle *h,
+                                    NvCtrlTraceOp op,
+                                    unsigned int display_mask, int attr,
+                                    void *val, int size);
+ReturnStatus NvCtrlTraceReplayData(const NvCtrlAttributePrivateHandle *h,
+                                   NvCtrlTraceOp op,
+                                   unsigned int display_mask, int attr,
+                                   void **ptr, int *len);
+int NvCtrlTraceAddSystem(const char *display);
+void NvCtrlTraceRecordSystem(const CtrlSystem *system);
+Bool NvCtrlTraceLoadSystem(CtrlSystem *system, NvCtrlTraceTarget **targets,
+                           int *count);
+const char *NvCtrlTraceGetDisplayString(const CtrlSystem *system);
+
+#define NV_CTRL_TRACE_REPLAYING() \
+    (NvCtrlGetTraceMode() == NV_CTRL_TRACE_REPLAY)
+
+/*
+ * Records the call made by evaluating 'call', which returns a ReturnStatus
+ * assigned to 'ret', and the 'len' bytes at 'data' it returned; 'data' and
+ * 'len' are evaluated once the call has returned.
+ */
+
+#define NV_CTRL_TRACE_CALL(ret, h, op, display_mask, attr, call, data, len) \
+    do {                                                                  \
+        unsigned long long __trace_start = NvCtrlTraceBegin();            \
+        (ret) = (call);                                                   \
+        if (__trace_start) {                                              \
+            NvCtrlTraceRecord((h), (op), (display_mask), (attr), (ret),   \
+                              ((ret) == NvCtrlSuccess) ? (data) : NULL,   \
+                              ((ret) == NvCtrlSuccess) ? (len) : 0,       \
+                              NvCtrlTraceElapsed(__trace_start));         \
+        }                                                                 \
+    } while (0)
+
 /* helper functions for XV86VidMode and RandR backends */
 
 void NvCtrlInitGammaInputStruct(NvCtrlGammaInput *pGammaInput);
@@ -446,6 +790,15 @@ void NvCtrlAssignGammaInput(NvCtrlGammaInput *pGammaInput,
 
 /* NVML backend functions */
 
+NvCtrlNvmlSystem     *NvCtrlInitNvmlSystem(CtrlSystem *system);
+void                  NvCtrlNvmlSystemClose(CtrlSystem *system);
+ReturnStatus          NvCtrlNvmlStartSampler(CtrlSystem *system,
+                                             unsigned int interval_ms);
+int                   NvCtrlNvmlStartEvents(CtrlSystem *system);
+Bool                  NvCtrlNvmlRoutesAttribute(const NvCtrlAttributePrivateHandle *h,
+                                                CtrlAttributeType attr_type,
+                                                int attr);
+
 NvCtrlNvmlAttributes *NvCtrlInitNvmlAttributes(NvCtrlAttributePrivateHandle *);
 void                  NvCtrlNvmlAttributesClose(NvCtrlAttributePrivateHandle *);
 
@@ -457,13 +810,22 @@ ReturnStatus NvCtrlNvmlSetStringAttribute(CtrlTarget *ctrl_target,
                                           int attr, const char *ptr);
 ReturnStatus NvCtrlNvmlGetAttribute(const CtrlTarget *ctrl_target,
                                     int attr, int64_t *val);
+ReturnStatus NvCtrlNvmlGetAttributesBatch(const CtrlTarget *ctrl_target,
+                                         int count, const int *attrs,
+                                         int64_t *vals,
+                                         ReturnStatus *statuses);
+ReturnStatus NvCtrlNvmlGetTelemetry(const CtrlTarget *ctrl_target,
+                                    CtrlGpuTelemetry *telemetry);
+ReturnStatus NvCtrlNvmlGetEventTypes(const CtrlTarget *ctrl_target,
+                                     unsigned long long *event_types);
 ReturnStatus NvCtrlNvmlGetGridLicenseAttributes(const CtrlTarget *ctrl_target,
                                                 int attr, nvmlGridLicensableFeatures_t **val);
 ReturnStatus NvCtrlNvmlSetAttribute(CtrlTarget *ctrl_target, int attr,
                                     int index, int val);
 ReturnStatus
 NvCtrlNvmlGetBinaryAttribute(const CtrlTarget *ctrl_target,
-                             int attr, unsigned char **data, int *len);
+                             int attr, unsigned char **data, int *len,
+                             NvCtrlBinaryScratch *scratch);
 ReturnStatus
 NvCtrlNvmlGetValidStringAttributeValues(const CtrlTarget *ctrl_target,
                                         int attr,
@@ -478,4 +840,46 @@ NvCtrlNvmlGetAttributePerms(const NvCtrlAttributePrivateHandle *,
                             CtrlAttributeType, int,
                             CtrlAttributePerms *);
 
+/* Attribute value cache functions */
+
+CtrlAttributeCache *NvCtrlAttributeCacheNew(void);
+void NvCtrlAttributeCacheFree(CtrlAttributeCache *cache);
+
+Bool NvCtrlAttributeCacheLookup(const CtrlTarget *ctrl_target,
+                                unsigned int display_mask, int attr,
+                                int64_t *val);
+void NvCtrlAttributeCacheStore(const CtrlTarget *ctrl_target,
+                               unsigned int display_mask, int attr,
+                               int64_t val);
+Bool NvCtrlAttributeCacheLookupPerms(const CtrlTarget *ctrl_target,
+                                     CtrlAttributeType attr_type, int attr,
+                                     CtrlAttributePerms *perms,
+                                     ReturnStatus *status);
+void NvCtrlAttributeCacheStorePerms(const CtrlTarget *ctrl_target,
+                                    CtrlAttributeType attr_type, int attr,
+                                    const CtrlAttributePerms *perms,
+                                    ReturnStatus status);
+Bool NvCtrlAttributeCacheLookupValidValues(const CtrlTarget *ctrl_target,
+                                           CtrlAttributeType attr_type,
+                                           unsigned int display_mask,
+                                           int attr,
+                                           CtrlAttributeValidValues *val,
+                                           ReturnStatus *status);
+void NvCtrlAttributeCacheStoreValidValues(const CtrlTarget *ctrl_target,
+                                          CtrlAttributeType attr_type,
+                                          unsigned int display_mask, int attr,
+                                          const CtrlAttributeValidValues *val,
+                                          ReturnStatus status);
+void NvCtrlAttributeCacheInvalidate(const CtrlTarget *ctrl_target, int attr);
+void NvCtrlAttributeCacheFlush(const CtrlTarget *ctrl_target);
+void NvCtrlAttributeCacheFlushInfo(const CtrlSystem *system);
+void NvCtrlAttributeCacheFlushSystem(const CtrlSystem *system);
+void NvCtrlAttributeCacheHandleEvent(const CtrlSystem *system,
+                                     const CtrlEvent *event);
+
+/* Asynchronous queries */
+
+Bool NvCtrlAsyncRepliesPending(const CtrlSystem *system);
+void NvCtrlFreeAsyncQueries(CtrlSystem *system);
+
 #endif /* __NVCTRL_ATTRIBUTES_PRIVATE__ */
@@ -0,0 +1,443 @@
+/*
+ * nvidia-settings: A tool for configuring the NVIDIA X driver on Unix
+ * and Linux systems.
+ *
+ * Copyright (C) 2024 NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses>.
+ */
+
+/*
+ *  Backend call statistics
+ *
+ *  Once enabled with NvCtrlEnableStats(), every call NvCtrlAttributes.c
+ *  makes into a backend (NV-CONTROL, NVML, GLX, ...) is recorded, per
+ *  backend and per (backend, operation, attribute): the number of calls,
+ *  how many of them failed, the payload bytes they returned or sent, and
+ *  their latencies in power-of-two microsecond buckets.  Subsystem
+ *  initializations, which include loading the backend libraries, are
+ *  recorded as the "init" operation of their backend.
+ *
+ *  The statistics are process-wide, as the library tables of the backends
+ *  are, and are only updated with 'statsLock' held.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "NvCtrlAttributes.h"
+#include "NvCtrlAttributesPrivate.h"
+
+#include "common-utils.h"
+#include "parse.h"
+
+
+/*
+ * Bucket 0 counts calls shorter than 2us, bucket i (0 < i < last) calls in
+ * [2^i, 2^(i+1)) us, and the last bucket everything longer.
+ */
+
+#define STATS_BUCKETS 24
+
+#define STATS_HASH_SIZE 256
+
+typedef struct {
+    unsigned long calls;
+    unsigned long errors;
+    unsigned long long bytes;
+    unsigned long long total_us;
+    unsigned long long max_us;
+    unsigned long buckets[STATS_BUCKETS];
+} StatsCounters;
+
+typedef struct _StatsAttribute {
+    NvCtrlBackend backend;
+    NvCtrlStatsOp op;
+    int attr;
+    StatsCounters counters;
+    struct _StatsAttribute *next;
+} StatsAttribute;
+
+static const char *backendNames[NV_CTRL_BACKEND_COUNT] = {
+    [NV_CTRL_BACKEND_CACHE]      = "cache",
+    [NV_CTRL_BACKEND_NV_CONTROL] = "NV-CONTROL",
+    [NV_CTRL_BACKEND_NVML]       = "NVML",
+    [NV_CTRL_BACKEND_GLX]        = "GLX",
+    [NV_CTRL_BACKEND_EGL]        = "EGL",
+    [NV_CTRL_BACKEND_XRANDR]     = "XRandR",
+    [NV_CTRL_BACKEND_VIDMODE]    = "XF86VidMode",
+    [NV_CTRL_BACKEND_XV]         = "XVideo",
+};
+
+static const struct {
+    const char *name;
+    CtrlAttributeType type; /* used to look up attribute names */
+} opInfo[NV_CTRL_STATS_OP_COUNT] = {
+    [NV_CTRL_STATS_INIT]         = { "init",         CTRL_ATTRIBUTE_TYPE_INTEGER },
+    [NV_CTRL_STATS_GET]          = { "get",          CTRL_ATTRIBUTE_TYPE_INTEGER },
+    [NV_CTRL_STATS_SET]          = { "set",          CTRL_ATTRIBUTE_TYPE_INTEGER },
+    [NV_CTRL_STATS_GET_BATCH]    = { "get-batch",    CTRL_ATTRIBUTE_TYPE_INTEGER },
+    [NV_CTRL_STATS_GET_STRING]   = { "get-string",   CTRL_ATTRIBUTE_TYPE_STRING },
+    [NV_CTRL_STATS_SET_STRING]   = { "set-string",   CTRL_ATTRIBUTE_TYPE_STRING },
+    [NV_CTRL_STATS_GET_BINARY]   = { "get-binary",   CTRL_ATTRIBUTE_TYPE_BINARY_DATA },
+    [NV_CTRL_STATS_GET_VOID]     = { "get-void",     CTRL_ATTRIBUTE_TYPE_INTEGER },
+    [NV_CTRL_STATS_GET_VALID]    = { "get-valid",    CTRL_ATTRIBUTE_TYPE_INTEGER },
+    [NV_CTRL_STATS_GET_PERMS]    = { "get-perms",    CTRL_ATTRIBUTE_TYPE_INTEGER },
+    [NV_CTRL_STATS_STRING_OP]    = { "string-op",    CTRL_ATTRIBUTE_TYPE_STRING_OPERATION },
+    [NV_CTRL_STATS_TARGET_COUNT] = { "target-count", CTRL_ATTRIBUTE_TYPE_INTEGER },
+    [NV_CTRL_STATS_COLOR]        = { "color",        CTRL_ATTRIBUTE_TYPE_COLOR },
+    [NV_CTRL_STATS_TELEMETRY]    = { "telemetry",    CTRL_ATTRIBUTE_TYPE_INTEGER },
+};
+
+static Bool statsEnabled = FALSE;
+static pthread_mutex_t statsLock = PTHREAD_MUTEX_INITIALIZER;
+static StatsCounters backendCounters[NV_CTRL_BACKEND_COUNT];
+static StatsAttribute *attributeHash[STATS_HASH_SIZE];
+static int attributeCount = 0;
+
+
+
+static unsigned long long now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+
+static int bucket_of(unsigned long long us)
+{
+    int bucket = 0;
+
+    while ((us >>= 1) && (bucket < STATS_BUCKETS - 1)) {
+        bucket++;
+    }
+
+    return bucket;
+}
+
+
+
+/*
+ * Returns the upper bound, in microseconds, of the given bucket; the last
+ * bucket has none and 0 is returned.
+ */
+
+static unsigned long long bucket_limit(int bucket)
+{
+    return (bucket < STATS_BUCKETS - 1) ? (2ULL << bucket) : 0;
+}
+
+
+
+static void count_call(StatsCounters *c, unsigned long long us,
+                       ReturnStatus status, size_t bytes)
+{
+    c->calls++;
+    if (status != NvCtrlSuccess) {
+        c->errors++;
+    }
+    c->bytes += bytes;
+    c->total_us += us;
+    if (us > c->max_us) {
+        c->max_us = us;
+    }
+    c->buckets[bucket_of(us)]++;
+}
+
+
+
+static StatsAttribute *get_attribute(NvCtrlBackend backend, NvCtrlStatsOp op,
+                                     int attr)
+{
+    unsigned int hash = ((unsigned int) attr * 31 + op * 7 + backend) %
+                        STATS_HASH_SIZE;
+    StatsAttribute *a;
+
+    for (a = attributeHash[hash]; a; a = a->next) {
+        if ((a->backend == backend) && (a->op == op) && (a->attr == attr)) {
+            return a;
+        }
+    }
+
+    a = nvalloc(sizeof(StatsAttribute));
+    a->backend = backend;
+    a->op = op;
+    a->attr = attr;
+    a->next = attributeHash[hash];
+    attributeHash[hash] = a;
+    attributeCount++;
+
+    return a;
+}
+
+
+
+/*!
+ * Starts recording the calls made into the backends.
+ */
+
+void NvCtrlEnableStats(void)
+{
+    statsEnabled = TRUE;
+}
+
+
+
+/*
+ * Returns the start time of a backend call, or 0 if statistics are not
+ * enabled; to be passed to NvCtrlStatsEnd() once the call returns.
+ */
+
+unsigned long long NvCtrlStatsBegin(void)
+{
+    return statsEnabled ? now_ns() : 0;
+}
+
+
+
+/*
+ * Records a backend call started at 'start'.  'attr' is the attribute, or
+ * any other identifier that makes sense for the operation, and 'bytes' the
+ * size of the payload returned or sent.
+ */
+
+void NvCtrlStatsEnd(unsigned long long start, NvCtrlBackend backend,
+                    NvCtrlStatsOp op, int attr, ReturnStatus status,
+                    size_t bytes)
+{
+    unsigned long long us;
+
+    if (start == 0) {
+        return;
+    }
+
+    us = (now_ns() - start) / 1000;
+
+    pthread_mutex_lock(&statsLock);
+
+    count_call(&backendCounters[backend], us, status, bytes);
+    count_call(&get_attribute(backend, op, attr)->counters, us, status,
+               bytes);
+
+    pthread_mutex_unlock(&statsLock);
+}
+
+
+
+/*
+ * Returns an upper bound of the given percentile of the latencies counted,
+ * from their histogram.
+ */
+
+static unsigned long long percentile(const StatsCounters *c, int pct)
+{
+    unsigned long long rank = (c->calls * pct + 99) / 100;
+    unsigned long long seen = 0;
+    int i;
+
+    for (i = 0; i < STATS_BUCKETS; i++) {
+        seen += c->buckets[i];
+        if (seen >= rank && seen > 0) {
+            return bucket_limit(i) ? bucket_limit(i) : c->max_us;
+        }
+    }
+
+    return c->max_us;
+}
+
+
+
+static const char *attribute_name(const StatsAttribute *a)
+{
+    const AttributeTableEntry *entry;
+
+    if ((a->op == NV_CTRL_STATS_INIT) ||
+        (a->op == NV_CTRL_STATS_TARGET_COUNT) ||
+        (a->op == NV_CTRL_STATS_COLOR) ||
+        (a->op == NV_CTRL_STATS_TELEMETRY)) {
+        return NULL;
+    }
+
+    entry = nv_get_attribute_entry(a->attr, opInfo[a->op].type);
+
+    return entry ? entry->name : NULL;
+}
+
+
+
+static int compare_attributes(const void *pa, const void *pb)
+{
+    const StatsAttribute *a = *(const StatsAttribute * const *) pa;
+    const StatsAttribute *b = *(const StatsAttribute * const *) pb;
+
+    if (a->backend != b->backend) {
+        return (int) a->backend - (int) b->backend;
+    }
+    if (a->op != b->op) {
+        return (int) a->op - (int) b->op;
+    }
+    return (a->attr > b->attr) - (a->attr < b->attr);
+}
+
+
+
+static void print_counters_text(FILE *stream, const StatsCounters *c)
+{
+    int i;
+
+    fprintf(stream, "%8lu %7lu %10llu %10llu %8llu %8llu %8llu %8llu\n",
+            c->calls, c->errors, c->bytes, c->total_us, c->max_us,
+            percentile(c, 50), percentile(c, 90), percentile(c, 99));
+
+    for (i = 0; i < STATS_BUCKETS; i++) {
+        if (c->buckets[i] == 0) {
+            continue;
+        }
+        if (bucket_limit(i)) {
+            fprintf(stream, "      < %8lluus: %lu\n", bucket_limit(i),
+                    c->buckets[i]);
+        } else {
+            fprintf(stream, "      >= %7lluus: %lu\n", bucket_limit(i - 1),
+                    c->buckets[i]);
+        }
+    }
+}
+
+
+
+static void print_counters_json(FILE *stream, const StatsCounters *c)
+{
+    int i;
+    Bool first = TRUE;
+
+    fprintf(stream, "\"calls\": %lu, \"errors\": %lu, \"bytes\": %llu, "
+            "\"total_us\": %llu, \"max_us\": %llu, \"p50_us\": %llu, "
+            "\"p90_us\": %llu, \"p99_us\": %llu, \"histogram_us\": [",
+            c->calls, c->errors, c->bytes, c->total_us, c->max_us,
+            percentile(c, 50), percentile(c, 90), percentile(c, 99));
+
+    for (i = 0; i < STATS_BUCKETS; i++) {
+        if (c->buckets[i] == 0) {
+            continue;
+        }
+        fprintf(stream, "%s{\"lt\": ", first ? "" : ", ");
+        if (bucket_limit(i)) {
+            fprintf(stream, "%llu", bucket_limit(i));
+        } else {
+            fprintf(stream, "null");
+        }
+        fprintf(stream, ", \"count\": %lu}", c->buckets[i]);
+        first = FALSE;
+    }
+
+    fprintf(stream, "]");
+}
+
+
+
+/*!
+ * Prints the statistics recorded since NvCtrlEnableStats() was called.
+ *
+ * \param[in]  stream  Where to print the statistics.
+ * \param[in]  format  CTRL_STATS_FORMAT_TEXT for a human readable table,
+ *                     or CTRL_STATS_FORMAT_JSON for a single JSON object.
+ */
+
+void NvCtrlPrintStats(FILE *stream, CtrlStatsFormat format)
+{
+    StatsAttribute **attributes;
+    int i, n = 0;
+    Bool first;
+
+    pthread_mutex_lock(&statsLock);
+
+    attributes = nvalloc((attributeCount + 1) * sizeof(StatsAttribute *));
+    for (i = 0; i < STATS_HASH_SIZE; i++) {
+        StatsAttribute *a;
+
+        for (a = attributeHash[i]; a; a = a->next) {
+            attributes[n++] = a;
+        }
+    }
+    qsort(attributes, n, sizeof(StatsAttribute *), compare_attributes);
+
+    if (format == CTRL_STATS_FORMAT_JSON) {
+        fprintf(stream, "{\"backends\": [");
+        first = TRUE;
+        for (i = 0; i < NV_CTRL_BACKEND_COUNT; i++) {
+            if (backendCounters[i].calls == 0) {
+                continue;
+            }
+            fprintf(stream, "%s\n  {\"backend\": \"%s\", ",
+                    first ? "" : ",", backendNames[i]);
+            print_counters_json(stream, &backendCounters[i]);
+            fprintf(stream, "}");
+            first = FALSE;
+        }
+
+        fprintf(stream, "],\n \"attributes\": [");
+        for (i = 0; i < n; i++) {
+            const StatsAttribute *a = attributes[i];
+            const char *name = attribute_name(a);
+
+            fprintf(stream, "%s\n  {\"backend\": \"%s\", "
+                    "\"operation\": \"%s\", \"id\": %d, ",
+                    (i == 0) ? "" : ",", backendNames[a->backend],
+                    opInfo[a->op].name, a->attr);
+            if (name) {
+                fprintf(stream, "\"attribute\": \"%s\", ", name);
+            }
+            print_counters_json(stream, &a->counters);
+            fprintf(stream, "}");
+        }
+        fprintf(stream, "]}\n");
+
+    } else {
+        static const char *header =
+            "   calls  errors      bytes   total-us   max-us   p50-us"
+            "   p90-us   p99-us\n";
+
+        fprintf(stream, "Backend statistics:\n\n");
+        for (i = 0; i < NV_CTRL_BACKEND_COUNT; i++) {
+            if (backendCounters[i].calls == 0) {
+                continue;
+            }
+            fprintf(stream, "  %s\n  %s  ", backendNames[i], header);
+            print_counters_text(stream, &backendCounters[i]);
+            fprintf(stream, "\n");
+        }
+
+        fprintf(stream, "Attribute statistics:\n\n");
+        for (i = 0; i < n; i++) {
+            const StatsAttribute *a = attributes[i];
+            const char *name = attribute_name(a);
+
+            fprintf(stream, "  %s %s %d%s%s%s\n  %s  ",
+                    backendNames[a->backend], opInfo[a->op].name, a->attr,
+                    name ? " (" : "", name ? name : "", name ? ")" : "",
+                    header);
+            print_counters_text(stream, &a->counters);
+            fprintf(stream, "\n");
+        }
+    }
+
+    pthread_mutex_unlock(&statsLock);
+
+    nvfree(attributes);
+}
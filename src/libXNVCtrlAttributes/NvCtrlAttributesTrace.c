@@ -0,0 +1,823 @@
+/*
+ * nvidia-settings: A tool for configuring the NVIDIA X driver on Unix
+ * and Linux systems.
+ *
+ * Copyright (C) 2024 NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses>.
+ */
+
+/*
+ *  Backend call traces
+ *
+ *  While recording (NvCtrlStartTraceRecording()), every call made through
+ *  the entry points of NvCtrlAttributes.c, whichever backend (NV-CONTROL,
+ *  NVML, GLX, EGL, XRandR, ...) answers it, is appended to a trace file
+ *  with its arguments, return status, returned data and duration; so is
+ *  the list of targets found on each system.
+ *
+ *  While replaying (NvCtrlStartTraceReplay()), no backend is initialized:
+ *  systems are rebuilt from the targets recorded for them and every call
+ *  is answered from the trace.  The calls recorded for the same target,
+ *  operation, display mask and attribute are returned in the order they
+ *  were recorded, the last one repeating once they are exhausted, so that
+ *  e.g. polled attributes replay their recorded evolution.  Optionally,
+ *  each call takes as long as it did when recorded.
+ *
+ *  A trace is a header followed by records, each a fixed size TraceRecord
+ *  followed by its payload padded to 8 bytes, in host byte order; the
+ *  header holds a byte order mark so that traces are only replayed on
+ *  hosts with the same byte order.  Both the file and the replay tables
+ *  are only accessed with 'traceLock' held.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "NvCtrlAttributes.h"
+#include "NvCtrlAttributesPrivate.h"
+
+#include "common-utils.h"
+#include "msg.h"
+
+
+#define TRACE_MAGIC "NVCTRACE"
+#define TRACE_VERSION 1
+#define TRACE_BYTE_ORDER 0x01020304
+
+#define TRACE_HASH_SIZE 1024
+
+/* More X servers than nvidia-settings is ever pointed at, at once */
+#define TRACE_MAX_SYSTEMS 256
+
+#define TRACE_PAD(len) (((len) + 7) & ~7)
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+} TraceHeader;
+
+typedef struct {
+    uint8_t op;            /* NvCtrlTraceOp */
+    uint8_t pad;
+    uint16_t system;       /* CtrlSystem.trace_id */
+    int32_t target_type;
+    int32_t target_id;
+    uint32_t display_mask;
+    int32_t attr;
+    int32_t status;        /* ReturnStatus */
+    uint32_t duration_us;
+    uint32_t len;          /* of the payload */
+} TraceRecord;
+
+/*
+ * The payload of NV_CTRL_TRACE_SYSTEM records: the DisplayString() of the
+ * system's connection and the display it was requested with, both NUL
+ * terminated and together padded to 8 bytes, and the TraceTarget array
+ * follow.
+ */
+
+typedef struct {
+    int32_t has_nv_control;
+    int32_t has_nvml;
+    int32_t nv_control_major;
+    int32_t nv_control_minor;
+    uint32_t display_len;  /* of both strings, including their NULs */
+    uint32_t target_count;
+} TraceSystem;
+
+typedef struct {
+    int32_t target_type;
+    int32_t target_id;
+    int32_t physical;
+    int32_t pad;
+} TraceTarget;
+
+/* The records of one replay key, in recording order */
+
+typedef struct _TraceEntry {
+    TraceRecord key;
+    const TraceRecord **records;
+    int count;
+    int next;
+    struct _TraceEntry *next_entry;
+} TraceEntry;
+
+typedef struct {
+    const char *display;        /* as passed to load_system_info() */
+    const char *display_string; /* DisplayString() of its connection */
+    const TraceSystem *info;
+    const TraceTarget *targets;
+    Bool claimed;
+} TraceSystemInfo;
+
+static NvCtrlTraceMode traceMode = NV_CTRL_TRACE_OFF;
+static pthread_mutex_t traceLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* recorded, or replayed, systems */
+static int traceSystemCount;
+
+/* recording */
+static FILE *traceFile;
+
+/* replay */
+static Bool traceTiming;
+static unsigned char *traceData;
+static TraceEntry *traceHash[TRACE_HASH_SIZE];
+static TraceSystemInfo *traceSystems;
+
+
+
+static unsigned long long now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (unsigned long long) ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+
+
+static unsigned int hash_key(const TraceRecord *r)
+{
+    return ((unsigned int) r->attr * 31 + r->display_mask * 17 +
+            r->target_id * 13 + r->target_type * 7 + r->op * 3 +
+            r->system) % TRACE_HASH_SIZE;
+}
+
+
+
+static Bool same_key(const TraceRecord *a, const TraceRecord *b)
+{
+    return (a->op == b->op) &&
+           (a->system == b->system) &&
+           (a->target_type == b->target_type) &&
+           (a->target_id == b->target_id) &&
+           (a->display_mask == b->display_mask) &&
+           (a->attr == b->attr);
+}
+
+
+
+static void make_key(TraceRecord *r, const NvCtrlAttributePrivateHandle *h,
+                     NvCtrlTraceOp op, unsigned int display_mask, int attr)
+{
+    memset(r, 0, sizeof(*r));
+
+    r->op = op;
+    r->system = h->system ? h->system->trace_id : 0;
+    r->target_type = h->target_type;
+    r->target_id = h->target_id;
+    r->display_mask = display_mask;
+    r->attr = attr;
+}
+
+
+
+static void write_record(const TraceRecord *r, const void *data)
+{
+    static const unsigned char zeros[8];
+    size_t padding = TRACE_PAD(r->len) - r->len;
+
+    if (fwrite(r, sizeof(*r), 1, traceFile) != 1 ||
+        (r->len && fwrite(data, r->len, 1, traceFile) != 1) ||
+        (padding && fwrite(zeros, padding, 1, traceFile) != 1)) {
+        nv_error_msg("Unable to write the trace: %s; recording stopped.",
+                     strerror(errno));
+        fclose(traceFile);
+        traceFile = NULL;
+        traceMode = NV_CTRL_TRACE_OFF;
+    }
+}
+
+
+
+/*!
+ * Starts recording the calls made into the backends to the given file,
+ * which is truncated.  Must be called before connecting to any system.
+ *
+ * \return  TRUE on success, FALSE if the file could not be created.
+ */
+
+Bool NvCtrlStartTraceRecording(const char *filename)
+{
+    TraceHeader header;
+
+    if (traceMode != NV_CTRL_TRACE_OFF) {
+        return FALSE;
+    }
+
+    traceFile = fopen(filename, "wb");
+    if (!traceFile) {
+        nv_error_msg("Unable to create the trace file '%s': %s.",
+                     filename, strerror(errno));
+        return FALSE;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.version = TRACE_VERSION;
+    header.byte_order = TRACE_BYTE_ORDER;
+
+    if (fwrite(&header, sizeof(header), 1, traceFile) != 1) {
+        nv_error_msg("Unable to write the trace file '%s': %s.",
+                     filename, strerror(errno));
+        fclose(traceFile);
+        traceFile = NULL;
+        return FALSE;
+    }
+
+    traceMode = NV_CTRL_TRACE_RECORD;
+
+    return TRUE;
+}
+
+
+
+static Bool load_trace(const char *filename, unsigned char *data, size_t size)
+{
+    const TraceHeader *header = (const TraceHeader *) data;
+    size_t offset = sizeof(TraceHeader);
+
+    if ((size < sizeof(TraceHeader)) ||
+        memcmp(header->magic, TRACE_MAGIC, sizeof(header->magic)) != 0) {
+        nv_error_msg("'%s' is not an nvidia-settings trace.", filename);
+        return FALSE;
+    }
+
+    if (header->byte_order != TRACE_BYTE_ORDER) {
+        nv_error_msg("The trace '%s' was recorded on a host with a different "
+                     "byte order.", filename);
+        return FALSE;
+    }
+
+    if (header->version != TRACE_VERSION) {
+        nv_error_msg("The trace '%s' has an unsupported version (%u).",
+                     filename, header->version);
+        return FALSE;
+    }
+
+    traceSystemCount = 0;
+
+    while (offset + sizeof(TraceRecord) <= size) {
+        const TraceRecord *r = (const TraceRecord *) (data + offset);
+        const unsigned char *payload = (const unsigned char *) (r + 1);
+        TraceEntry *entry;
+        unsigned int hash;
+
+        if (r->len > size - offset - sizeof(TraceRecord)) {
+            nv_warning_msg("The trace '%s' is truncated.", filename);
+            break;
+        }
+        offset += sizeof(TraceRecord) + TRACE_PAD(r->len);
+
+        if (r->op == NV_CTRL_TRACE_SYSTEM) {
+            const TraceSystem *info = (const TraceSystem *) payload;
+            const char *strings = (const char *) (info + 1);
+            const char *end;
+            TraceSystemInfo *system;
+            size_t targets_offset;
+
+            if ((r->len < sizeof(TraceSystem)) ||
+                (r->system >= TRACE_MAX_SYSTEMS) ||
+                (info->display_len == 0) ||
+                ((size_t) info->display_len > r->len - sizeof(TraceSystem))) {
+                nv_warning_msg("Ignoring an invalid system in the trace '%s'.",
+                               filename);
+                continue;
+            }
+
+            /* Both strings must be NUL terminated within display_len */
+            end = memchr(strings, '\0', info->display_len);
+            if (end) {
+                end = memchr(end + 1, '\0',
+                             info->display_len - (end + 1 - strings));
+            }
+
+            targets_offset = sizeof(TraceSystem) +
+                             TRACE_PAD((size_t) info->display_len);
+            if (!end ||
+                (targets_offset > r->len) ||
+                ((size_t) info->target_count >
+                 (r->len - targets_offset) / sizeof(TraceTarget))) {
+                nv_warning_msg("Ignoring an invalid system in the trace '%s'.",
+                               filename);
+                continue;
+            }
+
+            if (r->system >= traceSystemCount) {
+                traceSystems = nvrealloc(traceSystems, (r->system + 1) *
+                                         sizeof(TraceSystemInfo));
+                memset(traceSystems + traceSystemCount, 0,
+                       (r->system + 1 - traceSystemCount) *
+                       sizeof(TraceSystemInfo));
+                traceSystemCount = r->system + 1;
+            }
+
+            /* The requested display follows the display string */
+            system = &traceSystems[r->system];
+            system->info = info;
+            system->display_string = strings;
+            system->display = strings + strlen(strings) + 1;
+            system->targets =
+                (const TraceTarget *) (payload + targets_offset);
+            continue;
+        }
+
+        /* Look up, or add, the entry of the record's key */
+
+        hash = hash_key(r);
+        for (entry = traceHash[hash]; entry; entry = entry->next_entry) {
+            if (same_key(&entry->key, r)) {
+                break;
+            }
+        }
+
+        if (!entry) {
+            entry = nvalloc(sizeof(TraceEntry));
+            entry->key = *r;
+            entry->next_entry = traceHash[hash];
+            traceHash[hash] = entry;
+        }
+
+        entry->records = nvrealloc(entry->records, (entry->count + 1) *
+                                   sizeof(TraceRecord *));
+        entry->records[entry->count++] = r;
+    }
+
+    return TRUE;
+}
+
+
+
+/*!
+ * Starts answering the calls made into the backends from the given trace,
+ * recorded with NvCtrlStartTraceRecording().  Must be called before
+ * connecting to any system.
+ *
+ * \param[in]  filename  The trace to replay.
+ * \param[in]  timing    Whether each call should take as long as it did when
+ *                       recorded, rather than return immediately.
+ *
+ * \return  TRUE on success, FALSE if the trace could not be loaded.
+ */
+
+Bool NvCtrlStartTraceReplay(const char *filename, Bool timing)
+{
+    FILE *file;
+    long size;
+    unsigned char *data;
+
+    if (traceMode != NV_CTRL_TRACE_OFF) {
+        return FALSE;
+    }
+
+    file = fopen(filename, "rb");
+    if (!file) {
+        nv_error_msg("Unable to open the trace file '%s': %s.",
+                     filename, strerror(errno));
+        return FALSE;
+    }
+
+    if (fseek(file, 0, SEEK_END) != 0 || (size = ftell(file)) < 0 ||
+        fseek(file, 0, SEEK_SET) != 0) {
+        nv_error_msg("Unable to read the trace file '%s': %s.",
+                     filename, strerror(errno));
+        fclose(file);
+        return FALSE;
+    }
+
+    /* The payloads are used in place, so the data is kept until exit */
+    data = nvalloc(size + 1);
+    if (size && fread(data, size, 1, file) != 1) {
+        nv_error_msg("Unable to read the trace file '%s'.", filename);
+        fclose(file);
+        nvfree(data);
+        return FALSE;
+    }
+    fclose(file);
+
+    if (!load_trace(filename, data, size)) {
+        nvfree(data);
+        return FALSE;
+    }
+
+    traceData = data;
+    traceTiming = timing;
+    traceMode = NV_CTRL_TRACE_REPLAY;
+
+    return TRUE;
+}
+
+
+
+/*!
+ * Stops recording, flushing the trace.  Replayed traces stay loaded, as
+ * the data they returned may still be in use.
+ */
+
+void NvCtrlStopTrace(void)
+{
+    pthread_mutex_lock(&traceLock);
+
+    if (traceMode == NV_CTRL_TRACE_RECORD) {
+        if (traceFile) {
+            fclose(traceFile);
+            traceFile = NULL;
+        }
+        traceMode = NV_CTRL_TRACE_OFF;
+    }
+
+    pthread_mutex_unlock(&traceLock);
+}
+
+
+
+/*!
+ * Returns the display the first system of the replayed trace was connected
+ * with, or NULL if none is being replayed or it used the default display.
+ */
+
+const char *NvCtrlGetTraceDisplayName(void)
+{
+    int i;
+
+    if (traceMode != NV_CTRL_TRACE_REPLAY) {
+        return NULL;
+    }
+
+    for (i = 0; i < traceSystemCount; i++) {
+        if (traceSystems[i].info) {
+            return traceSystems[i].display[0] ? traceSystems[i].display :
+                                                NULL;
+        }
+    }
+
+    return NULL;
+}
+
+
+
+NvCtrlTraceMode NvCtrlGetTraceMode(void)
+{
+    return traceMode;
+}
+
+
+
+/*
+ * Returns the start time of a call, or 0 if no trace is being recorded; the
+ * duration of the call is NvCtrlTraceElapsed() of it.
+ */
+
+unsigned long long NvCtrlTraceBegin(void)
+{
+    return (traceMode == NV_CTRL_TRACE_RECORD) ? now_us() : 0;
+}
+
+unsigned long long NvCtrlTraceElapsed(unsigned long long start)
+{
+    return start ? now_us() - start : 0;
+}
+
+
+
+/*
+ * Records a call that took 'us' microseconds and returned 'status' and,
+ * on success, the 'len' bytes at 'data'.  'attr' is the attribute, or the
+ * other identifier documented for the operation.
+ */
+
+void NvCtrlTraceRecord(const NvCtrlAttributePrivateHandle *h,
+                       NvCtrlTraceOp op, unsigned int display_mask, int attr,
+                       ReturnStatus status, const void *data, int len,
+                       unsigned long long us)
+{
+    TraceRecord r;
+
+    if ((traceMode != NV_CTRL_TRACE_RECORD) || !h) {
+        return;
+    }
+
+    make_key(&r, h, op, display_mask, attr);
+    r.status = status;
+    r.duration_us = (us > UINT32_MAX) ? UINT32_MAX : us;
+    r.len = ((status == NvCtrlSuccess) && data && len > 0) ? len : 0;
+
+    pthread_mutex_lock(&traceLock);
+    if (traceFile) {
+        write_record(&r, data);
+    }
+    pthread_mutex_unlock(&traceLock);
+}
+
+
+
+/*
+ * Returns the status of the next recorded call with the given arguments,
+ * pointing 'data' to the data it returned, if any, and 'len' to its size;
+ * the data belongs to the trace.  Returns NvCtrlNotSupported if no such call
+ * was recorded.
+ */
+
+ReturnStatus NvCtrlTraceReplay(const NvCtrlAttributePrivateHandle *h,
+                               NvCtrlTraceOp op, unsigned int display_mask,
+                               int attr, const void **data, int *len)
+{
+    const TraceRecord *r = NULL;
+    TraceRecord key;
+    TraceEntry *entry;
+
+    if (!h) {
+        return NvCtrlBadHandle;
+    }
+
+    make_key(&key, h, op, display_mask, attr);
+
+    pthread_mutex_lock(&traceLock);
+
+    for (entry = traceHash[hash_key(&key)]; entry;
+         entry = entry->next_entry) {
+        if (same_key(&entry->key, &key)) {
+            r = entry->records[entry->next];
+            if (entry->next < entry->count - 1) {
+                entry->next++;
+            }
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&traceLock);
+
+    if (!r) {
+        return NvCtrlNotSupported;
+    }
+
+    if (traceTiming && r->duration_us) {
+        struct timespec ts;
+
+        ts.tv_sec = r->duration_us / 1000000;
+        ts.tv_nsec = (r->duration_us % 1000000) * 1000;
+        while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+            /* keep sleeping for the remaining time */
+        }
+    }
+
+    if (data) *data = r->len ? (const void *) (r + 1) : NULL;
+    if (len) *len = r->len;
+
+    return r->status;
+}
+
+
+
+/*
+ * Replays a call that returns a value of 'size' bytes, copying it to 'val'.
+ */
+
+ReturnStatus NvCtrlTraceReplayValue(const NvCtrlAttributePrivateHandle *h,
+                                    NvCtrlTraceOp op,
+                                    unsigned int display_mask, int attr,
+                                    void *val, int size)
+{
+    const void *data;
+    int len;
+    ReturnStatus ret;
+
+    ret = NvCtrlTraceReplay(h, op, display_mask, attr, &data, &len);
+
+    if (ret == NvCtrlSuccess) {
+        if (len != size) {
+            return NvCtrlError;
+        }
+        memcpy(val, data, size);
+    }
+
+    return ret;
+}
+
+
+
+/*
+ * Replays a call that returns an allocated block of data, such as a string,
+ * to be freed by the caller; the copy is NUL terminated.
+ */
+
+ReturnStatus NvCtrlTraceReplayData(const NvCtrlAttributePrivateHandle *h,
+                                   NvCtrlTraceOp op,
+                                   unsigned int display_mask, int attr,
+                                   void **ptr, int *len)
+{
+    const void *data;
+    int size;
+    ReturnStatus ret;
+
+    ret = NvCtrlTraceReplay(h, op, display_mask, attr, &data, &size);
+
+    if (ret == NvCtrlSuccess) {
+        unsigned char *copy = nvalloc(size + 1);
+
+        if (size) {
+            memcpy(copy, data, size);
+        }
+        *ptr = copy;
+        if (len) *len = size;
+    }
+
+    return ret;
+}
+
+
+
+/*
+ * Returns the trace id of a system being connected to the given display: a
+ * new one while recording; while replaying, the one of the first system
+ * recorded for that display that is not replayed yet, if any, or else the
+ * only system of the trace; -1 if there is none.
+ */
+
+int NvCtrlTraceAddSystem(const char *display)
+{
+    int i, id = -1;
+
+    pthread_mutex_lock(&traceLock);
+
+    if (traceMode == NV_CTRL_TRACE_RECORD) {
+        id = traceSystemCount++;
+    } else if (traceMode == NV_CTRL_TRACE_REPLAY) {
+        for (i = 0; i < traceSystemCount; i++) {
+            if (!traceSystems[i].info ||
+                strcmp(traceSystems[i].display, display ? display : "")) {
+                continue;
+            }
+            if ((id == -1) ||
+                (traceSystems[id].claimed && !traceSystems[i].claimed)) {
+                id = i;
+            }
+        }
+
+        if ((id == -1) && (traceSystemCount == 1) && traceSystems[0].info) {
+            id = 0;
+        }
+
+        if (id >= 0) {
+            traceSystems[id].claimed = TRUE;
+        }
+    }
+
+    pthread_mutex_unlock(&traceLock);
+
+    return id;
+}
+
+
+
+/*
+ * Records the targets found on a system, so that replays can recreate them.
+ */
+
+void NvCtrlTraceRecordSystem(const CtrlSystem *system)
+{
+    const char *display_string;
+    const char *display = system->display ? system->display : "";
+    TraceSystem *info;
+    TraceTarget *targets;
+    CtrlTargetNode *node;
+    unsigned char *payload;
+    TraceRecord r;
+    size_t size;
+    int i, n = 0, count = 0;
+
+    if (traceMode != NV_CTRL_TRACE_RECORD) {
+        return;
+    }
+
+    display_string = system->dpy ? DisplayString(system->dpy) : "";
+
+    for (i = 0; i < MAX_TARGET_TYPES; i++) {
+        count += NvCtrlGetTargetTypeCount(system, i);
+    }
+    for (node = system->physical_screens; node; node = node->next) {
+        count++;
+    }
+
+    /* The requested display follows the display string */
+    size = sizeof(TraceSystem) +
+           TRACE_PAD(strlen(display_string) + strlen(display) + 2) +
+           count * sizeof(TraceTarget);
+    payload = nvalloc(size);
+
+    info = (TraceSystem *) payload;
+    info->has_nv_control = system->has_nv_control;
+    info->has_nvml = system->has_nvml;
+    info->nv_control_major = system->nv_control_major;
+    info->nv_control_minor = system->nv_control_minor;
+    info->display_len = strlen(display_string) + strlen(display) + 2;
+    info->target_count = count;
+
+    strcpy((char *) (info + 1), display_string);
+    strcpy((char *) (info + 1) + strlen(display_string) + 1, display);
+
+    targets = (TraceTarget *) (payload + sizeof(TraceSystem) +
+                               TRACE_PAD(info->display_len));
+
+    for (i = 0; i < MAX_TARGET_TYPES; i++) {
+        for (node = system->targets[i]; node; node = node->next) {
+            targets[n].target_type = NvCtrlGetTargetType(node->t);
+            targets[n].target_id = NvCtrlGetTargetId(node->t);
+            n++;
+        }
+    }
+    for (node = system->physical_screens; node; node = node->next) {
+        targets[n].target_type = NvCtrlGetTargetType(node->t);
+        targets[n].target_id = NvCtrlGetTargetId(node->t);
+        targets[n].physical = TRUE;
+        n++;
+    }
+
+    memset(&r, 0, sizeof(r));
+    r.op = NV_CTRL_TRACE_SYSTEM;
+    r.system = system->trace_id;
+    r.status = NvCtrlSuccess;
+    r.len = size;
+
+    pthread_mutex_lock(&traceLock);
+    if (traceFile) {
+        write_record(&r, payload);
+    }
+    pthread_mutex_unlock(&traceLock);
+
+    nvfree(payload);
+}
+
+
+
+/*
+ * Loads the state recorded for the system with the trace id of the given
+ * system, and the targets that were found on it, into 'targets', allocated,
+ * and 'count'.
+ */
+
+Bool NvCtrlTraceLoadSystem(CtrlSystem *system, NvCtrlTraceTarget **targets,
+                           int *count)
+{
+    const TraceSystemInfo *trace;
+    int i;
+
+    if ((traceMode != NV_CTRL_TRACE_REPLAY) || (system->trace_id < 0)) {
+        return FALSE;
+    }
+
+    trace = &traceSystems[system->trace_id];
+
+    system->has_nv_control = trace->info->has_nv_control;
+    system->has_nvml = trace->info->has_nvml;
+    system->nv_control_major = trace->info->nv_control_major;
+    system->nv_control_minor = trace->info->nv_control_minor;
+
+    *count = trace->info->target_count;
+    *targets = nvalloc((*count + 1) * sizeof(NvCtrlTraceTarget));
+
+    for (i = 0; i < *count; i++) {
+        (*targets)[i].target_type = trace->targets[i].target_type;
+        (*targets)[i].target_id = trace->targets[i].target_id;
+        (*targets)[i].physical = trace->targets[i].physical;
+    }
+
+    return TRUE;
+}
+
+
+
+/*
+ * Returns the DisplayString() of the connection of the recorded system, for
+ * NvCtrlGetDisplayName() to use while replaying; NULL otherwise.
+ */
+
+const char *NvCtrlTraceGetDisplayString(const CtrlSystem *system)
+{
+    if ((traceMode != NV_CTRL_TRACE_REPLAY) || !system ||
+        (system->trace_id < 0) ||
+        (traceSystems[system->trace_id].display_string[0] == '\0')) {
+        return NULL;
+    }
+
+    return traceSystems[system->trace_id].display_string;
+}
@@ -38,33 +38,6 @@
 
 
 
-/*!
- * Queries the NV-CONTROL string attribute and returns the string as a simple
- * char *.  This is useful to avoid having to track how strings are allocated
- * so we can cleanup all strings via nvfree().
- *
- * \param[in]  t     The CtrlTarget to query the string on.
- * \param[in]  attr  The NV-CONTROL string to query.
- *
- * \return  Return a nvalloc()'ed copy of the NV-CONTROL string; else, returns
- *          NULL.
- */
-
-static char *query_x_name(const CtrlTarget *t, int attr)
-{
-    ReturnStatus status;
-    char *str = NULL;
-
-    status = NvCtrlGetStringAttribute(t, attr, &str);
-    if (status != NvCtrlSuccess) {
-        return NULL;
-    }
-
-    return str;
-}
-
-
-
 static void nv_free_ctrl_target(CtrlTarget *target)
 {
     int i;
@@ -87,6 +60,9 @@ static void nv_free_ctrl_target(CtrlTarget *target)
     NvCtrlTargetListFree(target->relations);
     target->relations = NULL;
 
+    NvCtrlAttributeCacheFree(target->attr_cache);
+    target->attr_cache = NULL;
+
     nvfree(target);
 }
 
@@ -100,6 +76,10 @@ static void nv_free_ctrl_system(CtrlSystem *system)
         return;
     }
 
+    /* drop the queries still waiting for the X server */
+
+    NvCtrlFreeAsyncQueries(system);
+
     /* close the X connection */
 
     if (system->dpy) {
@@ -141,6 +121,10 @@ static void nv_free_ctrl_system(CtrlSystem *system)
         nvfree(node);
     }
 
+    /* release the NVML library once no target is using it anymore */
+
+    NvCtrlNvmlSystemClose(system);
+
     /* cleanup everything else */
 
     free(system->display);
@@ -171,37 +155,73 @@ void NvCtrlFreeAllSystems(CtrlSystemList *systems)
 
 
 /*!
- * Retrieves and adds all the display device names for the given target.
+ * Starts sampling the NVML telemetry of all GPUs of the system on a
+ * background thread, so that NvCtrlGetGpuTelemetry() only reads the latest
+ * published sample instead of querying the driver.  The thread is stopped
+ * when the system is freed.
+ *
+ * \param[in]  system       The CtrlSystem whose GPUs to sample.
+ * \param[in]  interval_ms  Time between two samples, in milliseconds.
  *
- * \param[in/out]  t  The CtrlTarget to load names for.
+ * \return  NvCtrlSuccess if the sampler is running, or an error status if
+ *          NVML is unavailable or the thread could not be started.
  */
 
-static void load_display_target_proto_names(CtrlTarget *t)
+ReturnStatus NvCtrlStartNvmlSampler(CtrlSystem *system,
+                                    unsigned int interval_ms)
 {
-    t->protoNames[NV_DPY_PROTO_NAME_TYPE_BASENAME] =
-        query_x_name(t, NV_CTRL_STRING_DISPLAY_NAME_TYPE_BASENAME);
-
-    t->protoNames[NV_DPY_PROTO_NAME_TYPE_ID] =
-        query_x_name(t, NV_CTRL_STRING_DISPLAY_NAME_TYPE_ID);
+    return NvCtrlNvmlStartSampler(system, interval_ms);
+}
 
-    t->protoNames[NV_DPY_PROTO_NAME_DP_GUID] =
-        query_x_name(t, NV_CTRL_STRING_DISPLAY_NAME_DP_GUID);
 
-    t->protoNames[NV_DPY_PROTO_NAME_EDID_HASH] =
-        query_x_name(t, NV_CTRL_STRING_DISPLAY_NAME_EDID_HASH);
 
-    t->protoNames[NV_DPY_PROTO_NAME_TARGET_INDEX] =
-        query_x_name(t, NV_CTRL_STRING_DISPLAY_NAME_TARGET_INDEX);
+/*!
+ * Returns how many queries on NVML targets were sent directly to NV-CONTROL
+ * because the NVML routing table showed that NVML does not handle them.
+ *
+ * \param[in]  system  The CtrlSystem to report on.
+ *
+ * \return  The number of NVML lookups avoided, or 0 without NVML.
+ */
 
-    t->protoNames[NV_DPY_PROTO_NAME_RANDR] =
-        query_x_name(t, NV_CTRL_STRING_DISPLAY_NAME_RANDR);
+unsigned long NvCtrlGetMisroutesAvoided(const CtrlSystem *system)
+{
+    if (!system || !system->nvml) {
+        return 0;
+    }
 
-    t->protoNames[NV_DPY_PROTO_NAME_CONNECTOR] =
-        query_x_name(t, NV_CTRL_STRING_DISPLAY_NAME_CONNECTOR);
+    return system->nvml->misroutesAvoided;
 }
 
 
 
+/*
+ * Targets are discovered in phases (target counts, target handles, integer
+ * attributes, protocol names and relationships), each of which gathers the
+ * same information for all the targets of a system at once: the NV-CONTROL
+ * requests of a phase are sent together and their replies collected after,
+ * so that discovery costs a round trip per phase rather than several per
+ * target.
+ */
+
+
+/*
+ * The NV-CONTROL string attributes holding the names of display targets,
+ * indexed by NV_DPY_PROTO_NAME_*.
+ */
+
+static const int displayProtoNameAttrs[NV_DPY_PROTO_NAME_MAX] = {
+    NV_CTRL_STRING_DISPLAY_NAME_TYPE_BASENAME,
+    NV_CTRL_STRING_DISPLAY_NAME_TYPE_ID,
+    NV_CTRL_STRING_DISPLAY_NAME_DP_GUID,
+    NV_CTRL_STRING_DISPLAY_NAME_EDID_HASH,
+    NV_CTRL_STRING_DISPLAY_NAME_TARGET_INDEX,
+    NV_CTRL_STRING_DISPLAY_NAME_RANDR,
+    NV_CTRL_STRING_DISPLAY_NAME_CONNECTOR,
+};
+
+
+
 /*!
  * Adds the default name for the given target to the list of protocol names at
  * the given proto name index.
@@ -226,43 +246,67 @@ static void load_default_target_proto_name(CtrlTarget *t,
 
 
 /*!
- * Adds the GPU names to the given target to the list of protocol names.
+ * Adds all the appropriate names for the given targets to their lists of
+ * protocol names: the display device names of display targets, the default
+ * name and UUID of GPUs, and the default name of other targets.
  *
- * \param[in/out]  t  The CtrlTarget to load names for.
+ * \param[in/out]  targets  The CtrlTargets to load names for; NULL entries
+ *                          are skipped.
+ * \param[in]      count    The number of entries in targets.
  */
 
-static void load_gpu_target_proto_names(CtrlTarget *t)
+static void load_targets_proto_names(CtrlTarget **targets, int count)
 {
-    load_default_target_proto_name(t, NV_GPU_PROTO_NAME_TYPE_ID);
+    CtrlStringAttributeQuery *queries;
+    char ***names;
+    int i, j, n = 0;
 
-    t->protoNames[NV_GPU_PROTO_NAME_UUID] =
-        query_x_name(t, NV_CTRL_STRING_GPU_UUID);
-}
+    queries = nvalloc(count * NV_PROTO_NAME_MAX *
+                      sizeof(CtrlStringAttributeQuery));
+    names = nvalloc(count * NV_PROTO_NAME_MAX * sizeof(char **));
 
+    for (i = 0; i < count; i++) {
+        CtrlTarget *t = targets[i];
 
+        if (!t) {
+            continue;
+        }
 
-/*!
- * Adds the all the appropriate names for the given target to the list of
- * protocol names.
- *
- * \param[in/out]  t  The CtrlTarget to load names for.
- */
+        switch (NvCtrlGetTargetType(t)) {
+        case DISPLAY_TARGET:
+            for (j = 0; j < NV_DPY_PROTO_NAME_MAX; j++) {
+                queries[n].target = t;
+                queries[n].attr = displayProtoNameAttrs[j];
+                names[n++] = &t->protoNames[j];
+            }
+            break;
 
-static void load_target_proto_names(CtrlTarget *t)
-{
-    switch (NvCtrlGetTargetType(t)) {
-    case DISPLAY_TARGET:
-        load_display_target_proto_names(t);
-        break;
+        case GPU_TARGET:
+            load_default_target_proto_name(t, NV_GPU_PROTO_NAME_TYPE_ID);
 
-    case GPU_TARGET:
-        load_gpu_target_proto_names(t);
-        break;
+            queries[n].target = t;
+            queries[n].attr = NV_CTRL_STRING_GPU_UUID;
+            names[n++] = &t->protoNames[NV_GPU_PROTO_NAME_UUID];
+            break;
 
-    default:
-        load_default_target_proto_name(t, 0);
-        break;
+        default:
+            load_default_target_proto_name(t, 0);
+            break;
+        }
+    }
+
+    NvCtrlGetStringAttributesBatch(queries, n);
+
+    for (i = 0; i < n; i++) {
+        if (queries[i].status == NvCtrlSuccess) {
+            *names[i] = queries[i].str;
+        } else {
+            free(queries[i].str);
+        }
     }
+
+    nvfree(names);
+    nvfree(queries);
 }
 
 
@@ -467,180 +511,208 @@ void NvCtrlTargetListFree(CtrlTargetNode *head)
 
 
 
+/*
+ * A relationship between targets: the targets of type 'target_type' that are
+ * associated to a target are listed by the NV-CONTROL binary attribute
+ * 'attr'.  If implicit_reciprocal is set, the relationship is also added to
+ * the associated targets.
+ */
+
+typedef struct {
+    CtrlTargetType target_type;
+    int attr;
+    Bool implicit_reciprocal;
+} TargetRelationship;
+
+static const TargetRelationship screenRelationships[] = {
+    { GPU_TARGET,
+      NV_CTRL_BINARY_DATA_GPUS_USED_BY_LOGICAL_XSCREEN, NV_TRUE },
+    { DISPLAY_TARGET,
+      NV_CTRL_BINARY_DATA_DISPLAYS_ASSIGNED_TO_XSCREEN, NV_TRUE },
+};
+
+static const TargetRelationship gpuRelationships[] = {
+    { FRAMELOCK_TARGET,
+      NV_CTRL_BINARY_DATA_FRAMELOCKS_USED_BY_GPU, NV_FALSE },
+    { COOLER_TARGET,
+      NV_CTRL_BINARY_DATA_COOLERS_USED_BY_GPU, NV_TRUE },
+    { THERMAL_SENSOR_TARGET,
+      NV_CTRL_BINARY_DATA_THERMAL_SENSORS_USED_BY_GPU, NV_TRUE },
+    { DISPLAY_TARGET,
+      NV_CTRL_BINARY_DATA_DISPLAYS_CONNECTED_TO_GPU, NV_TRUE },
+    { DISPLAY_TARGET,
+      NV_CTRL_BINARY_DATA_DISPLAYS_ON_GPU, NV_TRUE },
+};
+
+static const TargetRelationship framelockRelationships[] = {
+    { GPU_TARGET,
+      NV_CTRL_BINARY_DATA_GPUS_USING_FRAMELOCK, NV_FALSE },
+};
+
+
+
 /*!
- * Adds all the targets of target type relating to 'target_type' that are
- * known to be associated to 'target' by querying the list of associated targets
- * for the given attribute association 'attr'.  If implicit_reciprocal is set,
- * the relatiopship is added to the relating target(s).
+ * Returns the relationships to query for targets of the given type.
  *
- * \param[in\out]  target               The target to which association(s) are
- *                                      being made.
- * \param[in]      target_type          The target type of the associated
- *                                      targets being considered (queried.)
- * \param[in]      attr                 The NV-CONTROL binary attribute that
- *                                      should be queried to retrieve the list
- *                                      of 'targetType' targets that are
- *                                      associated to the (CtrlTarget) target
- *                                      't'.
- * \param[in]      implicit_reciprocal  Whether or not to reciprocally add the
- *                                      reverse relationship to the matching
- *                                      targets.
+ * \param[in]   target_type  The target type.
+ * \param[out]  count        The number of relationships returned.
  */
 
-static void add_target_relationships(CtrlTarget *target,
-                                     CtrlTargetType target_type, int attr,
-                                     int implicit_reciprocal)
+static const TargetRelationship *get_target_relationships(
+    CtrlTargetType target_type, int *count)
 {
-    ReturnStatus status;
-    int *pData;
-    int len;
-    int i;
+    switch (target_type) {
+    case X_SCREEN_TARGET:
+        *count = ARRAY_LEN(screenRelationships);
+        return screenRelationships;
 
-    /* If no targets of this type exist in the system, don't bother querying
-     * the server about relationships. */
-    if (target->system->targets[target_type] == NULL) {
-        return;
-    }
+    case GPU_TARGET:
+        *count = ARRAY_LEN(gpuRelationships);
+        return gpuRelationships;
 
-    status = NvCtrlGetBinaryAttribute(target, 0, attr,
-                                      (unsigned char **)(&pData), &len);
-    if ((status != NvCtrlSuccess) || !pData) {
-        if (status != NvCtrlNotSupported) {
-            nv_error_msg("Error querying target relations");
-        }
-        return;
+    case FRAMELOCK_TARGET:
+        *count = ARRAY_LEN(framelockRelationships);
+        return framelockRelationships;
+
+    default:
+        *count = 0;
+        return NULL;
     }
+}
+
+
+
+/*!
+ * Adds all the targets listed in pData, of the target type of the given
+ * relationship, as associated to 'target'.
+ *
+ * \param[in\out]  target  The target to which association(s) are being made.
+ * \param[in]      rel     The relationship that was queried.
+ * \param[in]      pData   The list of associated target ids, as returned by
+ *                         the NV-CONTROL binary attribute of the
+ *                         relationship.
+ */
+
+static void add_target_relationships(CtrlTarget *target,
+                                     const TargetRelationship *rel,
+                                     const int *pData)
+{
+    int i;
 
     for (i = 0; i < pData[0]; i++) {
         int target_id = pData[i+1];
         CtrlTarget *other;
 
-        other = NvCtrlGetTarget(target->system, target_type, target_id);
+        other = NvCtrlGetTarget(target->system, rel->target_type, target_id);
         if (other) {
             NvCtrlTargetListAdd(&(target->relations), other, FALSE);
 
             /* Track connection state of display devices */
-            if (attr == NV_CTRL_BINARY_DATA_DISPLAYS_CONNECTED_TO_GPU) {
+            if (rel->attr == NV_CTRL_BINARY_DATA_DISPLAYS_CONNECTED_TO_GPU) {
                 other->display.connected = NV_TRUE;
             }
 
-            if (implicit_reciprocal == NV_TRUE) {
+            if (rel->implicit_reciprocal == NV_TRUE) {
                 NvCtrlTargetListAdd(&(other->relations), target, FALSE);
             }
         }
     }
-
-    free(pData);
 }
 
 
 
 /*!
- * Adds all associations to/from an X screen target.
+ * Adds all associations to/from the given targets.
  *
- * \param[in\out]  target  The X screen target to which association(s) are
- *                         being made.
+ * \param[in\out]  targets  The targets to which association(s) are being
+ *                          made; NULL entries are skipped.
+ * \param[in]      count    The number of entries in targets.
  */
 
-static void load_screen_target_relationships(CtrlTarget *target)
+static void load_targets_relationships(CtrlTarget **targets, int count)
 {
-    add_target_relationships(target, GPU_TARGET,
-                             NV_CTRL_BINARY_DATA_GPUS_USED_BY_LOGICAL_XSCREEN,
-                             NV_TRUE);
-    add_target_relationships(target, DISPLAY_TARGET,
-                             NV_CTRL_BINARY_DATA_DISPLAYS_ASSIGNED_TO_XSCREEN,
-                             NV_TRUE);
-}
-
-
-
-/*!
- * Adds all associations to/from a GPU target.
- *
- * \param[in\out]  target  The GPU target to which association(s) are being
- *                         made.
- */
-
-static void load_gpu_target_relationships(CtrlTarget *target)
-{
-    add_target_relationships(target, FRAMELOCK_TARGET,
-                             NV_CTRL_BINARY_DATA_FRAMELOCKS_USED_BY_GPU,
-                             NV_FALSE);
-    add_target_relationships(target, COOLER_TARGET,
-                             NV_CTRL_BINARY_DATA_COOLERS_USED_BY_GPU,
-                             NV_TRUE);
-    add_target_relationships(target, THERMAL_SENSOR_TARGET,
-                             NV_CTRL_BINARY_DATA_THERMAL_SENSORS_USED_BY_GPU,
-                             NV_TRUE);
-    add_target_relationships(target, DISPLAY_TARGET,
-                             NV_CTRL_BINARY_DATA_DISPLAYS_CONNECTED_TO_GPU,
-                             NV_TRUE);
-    add_target_relationships(target, DISPLAY_TARGET,
-                             NV_CTRL_BINARY_DATA_DISPLAYS_ON_GPU,
-                             NV_TRUE);
-}
+    CtrlBinaryAttributeQuery *queries;
+    const TargetRelationship **rels;
+    int i, j, n = 0, max = 0;
+
+    for (i = 0; i < count; i++) {
+        if (targets[i]) {
+            int num;
+            get_target_relationships(NvCtrlGetTargetType(targets[i]), &num);
+            max += num;
+        }
+    }
 
+    queries = nvalloc(max * sizeof(CtrlBinaryAttributeQuery));
+    rels = nvalloc(max * sizeof(TargetRelationship *));
 
+    for (i = 0; i < count; i++) {
+        CtrlTarget *target = targets[i];
+        const TargetRelationship *rel;
+        int num;
 
-/*!
- * Adds all associations to/from a FrameLock target.
- *
- * \param[in\out]  target  The FrameLock target to which association(s) are
- *                          being made.
- */
+        if (!target) {
+            continue;
+        }
 
-static void load_framelock_target_relationships(CtrlTarget *target)
-{
-    add_target_relationships(target, GPU_TARGET,
-                             NV_CTRL_BINARY_DATA_GPUS_USING_FRAMELOCK,
-                             NV_FALSE);
-}
+        rel = get_target_relationships(NvCtrlGetTargetType(target), &num);
 
+        for (j = 0; j < num; j++) {
+            /*
+             * If no targets of this type exist in the system, don't bother
+             * querying the server about relationships.
+             */
+            if (target->system->targets[rel[j].target_type] == NULL) {
+                continue;
+            }
 
+            queries[n].target = target;
+            queries[n].attr = rel[j].attr;
+            rels[n++] = &rel[j];
+        }
+    }
 
-/*!
- * Adds all associations to/from a target.
- *
- * \param[in\out]  target  The target to which association(s) are being made.
- */
+    NvCtrlGetBinaryAttributesBatch(queries, n);
 
-static void load_target_relationships(CtrlTarget *target)
-{
-    switch (NvCtrlGetTargetType(target)) {
-    case X_SCREEN_TARGET:
-        load_screen_target_relationships(target);
-        break;
+    /* Add the relationships in the order they were queried */
 
-    case GPU_TARGET:
-        load_gpu_target_relationships(target);
-        break;
+    for (i = 0; i < n; i++) {
+        const int *pData = (const int *) queries[i].data;
 
-    case FRAMELOCK_TARGET:
-        load_framelock_target_relationships(target);
-        break;
+        if ((queries[i].status != NvCtrlSuccess) || !pData) {
+            if (queries[i].status != NvCtrlNotSupported) {
+                nv_error_msg("Error querying target relations");
+            }
+            continue;
+        }
 
-    default:
-        break;
+        add_target_relationships((CtrlTarget *) queries[i].target, rels[i],
+                                 pData);
+        free(queries[i].data);
     }
+
+    nvfree(rels);
+    nvfree(queries);
 }
 
 
 
 /*
- * nv_alloc_ctrl_target() - Given the Display pointer, create an attribute
- * handle and initialize the handle target.
+ * new_ctrl_target() - Given the Display pointer, create an attribute
+ * handle and initialize the handle target.  The target is not fully
+ * initialized until load_targets_info() and load_targets_proto_names() are
+ * called on it.
  */
 
-static CtrlTarget *nv_alloc_ctrl_target(CtrlSystem *system,
-                                        CtrlTargetType target_type,
-                                        int targetId,
-                                        int subsystem)
+static CtrlTarget *new_ctrl_target(CtrlSystem *system,
+                                   CtrlTargetType target_type,
+                                   int targetId,
+                                   int subsystem)
 {
     CtrlTarget *t;
     NvCtrlAttributeHandle *handle;
-    ReturnStatus status;
     char *tmp;
-    int len, d, c;
+    int len;
     const CtrlTargetTypeInfo *targetTypeInfo;
 
 
@@ -668,23 +740,6 @@ static CtrlTarget *nv_alloc_ctrl_target(CtrlSystem *system,
     t->system = system;
     t->targetTypeInfo = targetTypeInfo;
 
-    /*
-     * detect if the given GPU is visible to the X server and silently fail if
-     * it is not; if there is a discrepancy between NVML and NV-CONTROL, such as
-     * an eGPU that is invisible to X due to Option "AllowExternalGpus" "true"
-     * not being specified in xorg.conf, it can cause errors down the line.
-     */
-
-    if (target_type == GPU_TARGET && t->system->has_nv_control) {
-        /* NV_CTRL_DEPTH_30_ALLOWED expected to succeed for any valid device */
-        status = NvCtrlGetAttribute(t, NV_CTRL_DEPTH_30_ALLOWED, &d);
-        if (status != NvCtrlSuccess) {
-            nvfree(t);
-            NvCtrlAttributeClose(handle);
-            return NULL;
-        }
-    }
-
     /*
      * get a name for this target; in the case of
      * X_SCREEN_TARGET targets, just use the string returned
@@ -714,62 +769,183 @@ static CtrlTarget *nv_alloc_ctrl_target(CtrlSystem *system,
         }
     }
 
-    load_target_proto_names(t);
     t->relations = NULL;
 
-    if (target_type == DISPLAY_TARGET) {
-        status = NvCtrlGetAttribute(t, NV_CTRL_DISPLAY_ENABLED, &d);
-        if (status != NvCtrlSuccess) {
-            nv_error_msg("Error querying enabled state of display %s %d (%s).",
-                         targetTypeInfo->name, targetId,
-                         NvCtrlAttributesStrError(status));
-            d = NV_CTRL_DISPLAY_ENABLED_FALSE;
+    return t;
+}
+
+
+
+/*
+ * load_targets_info() - query the integer attributes describing the given
+ * new targets: whether GPUs are visible to the X server, whether displays
+ * are enabled, and the enabled and connected display device masks.
+ *
+ * GPUs that are not visible to the X server are freed, and their entries
+ * in targets set to NULL; if there is a discrepancy between NVML and
+ * NV-CONTROL, such as an eGPU that is invisible to X due to Option
+ * "AllowExternalGpus" "true" not being specified in xorg.conf, it can cause
+ * errors down the line.
+ */
+
+static void load_targets_info(CtrlTarget **targets, int count)
+{
+    CtrlAttributeQuery *queries;
+    int *first;
+    int i, n = 0;
+
+    queries = nvalloc(count * 4 * sizeof(CtrlAttributeQuery));
+    first = nvalloc(count * sizeof(int));
+
+    for (i = 0; i < count; i++) {
+        CtrlTarget *t = targets[i];
+        CtrlTargetType target_type;
+
+        first[i] = n;
+
+        if (!t) {
+            continue;
+        }
+
+        target_type = NvCtrlGetTargetType(t);
+
+        /* NV_CTRL_DEPTH_30_ALLOWED expected to succeed for any valid device */
+        if (target_type == GPU_TARGET && t->system->has_nv_control) {
+            queries[n].target = t;
+            queries[n++].attr = NV_CTRL_DEPTH_30_ALLOWED;
+        }
+
+        if (target_type == DISPLAY_TARGET) {
+            queries[n].target = t;
+            queries[n++].attr = NV_CTRL_DISPLAY_ENABLED;
+        }
+
+        /*
+         * get the enabled display device mask; for X screens and
+         * GPUs we query NV-CONTROL; for anything else
+         * (framelock), we just assign this to 0.
+         */
+
+        if (t->targetTypeInfo->uses_display_devices &&
+            t->system->has_nv_control) {
+            queries[n].target = t;
+            queries[n++].attr = NV_CTRL_ENABLED_DISPLAYS;
+            queries[n].target = t;
+            queries[n++].attr = NV_CTRL_CONNECTED_DISPLAYS;
         }
-        t->display.enabled = (d == NV_CTRL_DISPLAY_ENABLED_TRUE) ? 1 : 0;
     }
 
+    NvCtrlGetDisplayAttributesBatch(queries, n);
 
-    /*
-     * get the enabled display device mask; for X screens and
-     * GPUs we query NV-CONTROL; for anything else
-     * (framelock), we just assign this to 0.
-     */
+    for (i = 0; i < count; i++) {
+        CtrlTarget *t = targets[i];
+        const CtrlAttributeQuery *query = &queries[first[i]];
+        const CtrlTargetTypeInfo *targetTypeInfo;
+        CtrlTargetType target_type;
+        int targetId;
 
-    if (targetTypeInfo->uses_display_devices && system->has_nv_control) {
+        if (!t) {
+            continue;
+        }
 
-        status = NvCtrlGetAttribute(t,
-                                    NV_CTRL_ENABLED_DISPLAYS, &d);
+        targetTypeInfo = t->targetTypeInfo;
+        target_type = NvCtrlGetTargetType(t);
+        targetId = NvCtrlGetTargetId(t);
 
-        if (status != NvCtrlSuccess) {
-            nv_error_msg("Error querying enabled displays on "
-                         "%s %d (%s).", targetTypeInfo->name,
-                         targetId,
-                         NvCtrlAttributesStrError(status));
-            d = 0;
+        if (target_type == GPU_TARGET && t->system->has_nv_control) {
+            if (query->status != NvCtrlSuccess) {
+                nv_free_ctrl_target(t);
+                targets[i] = NULL;
+                continue;
+            }
+            query++;
         }
 
-        status = NvCtrlGetAttribute(t,
-                                    NV_CTRL_CONNECTED_DISPLAYS, &c);
+        if (target_type == DISPLAY_TARGET) {
+            int d = query->val;
 
-        if (status != NvCtrlSuccess) {
-            nv_error_msg("Error querying connected displays on "
-                         "%s %d (%s).", targetTypeInfo->name,
-                         targetId,
-                         NvCtrlAttributesStrError(status));
-            c = 0;
+            if (query->status != NvCtrlSuccess) {
+                nv_error_msg("Error querying enabled state of display %s %d "
+                             "(%s).", targetTypeInfo->name, targetId,
+                             NvCtrlAttributesStrError(query->status));
+                d = NV_CTRL_DISPLAY_ENABLED_FALSE;
+            }
+            t->display.enabled = (d == NV_CTRL_DISPLAY_ENABLED_TRUE) ? 1 : 0;
+            query++;
+        }
+
+        if (targetTypeInfo->uses_display_devices &&
+            t->system->has_nv_control) {
+
+            if (query[0].status != NvCtrlSuccess) {
+                nv_error_msg("Error querying enabled displays on "
+                             "%s %d (%s).", targetTypeInfo->name,
+                             targetId,
+                             NvCtrlAttributesStrError(query[0].status));
+                t->d = 0;
+            } else {
+                t->d = query[0].val;
+            }
+
+            if (query[1].status != NvCtrlSuccess) {
+                nv_error_msg("Error querying connected displays on "
+                             "%s %d (%s).", targetTypeInfo->name,
+                             targetId,
+                             NvCtrlAttributesStrError(query[1].status));
+                t->c = 0;
+            } else {
+                t->c = query[1].val;
+            }
+        } else {
+            t->d = 0;
+            t->c = 0;
         }
-    } else {
-        d = 0;
-        c = 0;
     }
 
-    t->d = d;
-    t->c = c;
+    nvfree(first);
+    nvfree(queries);
+}
+
+
+
+/*
+ * nv_alloc_ctrl_target() - Given the Display pointer, create an attribute
+ * handle and initialize the handle target.
+ */
+
+static CtrlTarget *nv_alloc_ctrl_target(CtrlSystem *system,
+                                        CtrlTargetType target_type,
+                                        int targetId,
+                                        int subsystem)
+{
+    CtrlTarget *t = new_ctrl_target(system, target_type, targetId, subsystem);
+
+    load_targets_info(&t, 1);
+    if (!t) {
+        return NULL;
+    }
+
+    load_targets_proto_names(&t, 1);
 
     return t;
 }
 
 
+/*
+ * Adds the given new CtrlTarget to the list of Targets of its CtrlSystem.
+ */
+
+static void track_target(CtrlSystem *system, CtrlTarget *target)
+{
+    NvCtrlTargetListAdd(&(system->targets[NvCtrlGetTargetType(target)]),
+                        target, FALSE);
+
+    if (system->cache_attributes) {
+        target->attr_cache = NvCtrlAttributeCacheNew();
+    }
+}
+
+
 /*
  * nv_add_target() - add a CtrlTarget of the given target type to the list of
  * Targets for the given CtrlSystem.
@@ -785,31 +961,25 @@ CtrlTarget *nv_add_target(CtrlSystem *system, CtrlTargetType target_type,
         return NULL;
     }
 
-    NvCtrlTargetListAdd(&(system->targets[target_type]), target, FALSE);
+    track_target(system, target);
 
     return target;
 }
 
 
 /*
- * Returns whether the NV-CONTROL protocol version is equal or greater than
- * 'major'.'minor'
+ * Returns whether the NV-CONTROL protocol version of the system's X server,
+ * as cached when its first NV-CONTROL target was initialized, is equal or
+ * greater than 'major'.'minor'
  */
 
-static Bool is_nvcontrol_protocol_valid(const CtrlTarget *ctrl_target,
+static Bool is_nvcontrol_protocol_valid(const CtrlSystem *system,
                                         int major, int minor)
 {
-    ReturnStatus ret1, ret2;
-    int nv_major, nv_minor;
-
-    ret1 = NvCtrlGetAttribute(ctrl_target,
-            NV_CTRL_ATTR_NV_MAJOR_VERSION,
-            &nv_major);
-    ret2 = NvCtrlGetAttribute(ctrl_target,
-            NV_CTRL_ATTR_NV_MINOR_VERSION,
-            &nv_minor);
+    int nv_major = system->nv_control_major;
+    int nv_minor = system->nv_control_minor;
 
-    if ((ret1 == NvCtrlSuccess) && (ret2 == NvCtrlSuccess) &&
+    if ((nv_major != 0) &&
         ((nv_major > major) || ((nv_major == major) && (nv_minor >= minor)))) {
 
         return TRUE;
@@ -829,12 +999,73 @@ static const char *get_display_name(CtrlSystem *system)
 }
 
 
+/*
+ * Whether Xlib was made thread safe by NvCtrlInitThreads().
+ */
+
+static Bool __threads_initialized = FALSE;
+
+
+/*
+ * Rebuilds the system recorded for the trace being replayed: its targets are
+ * created as they were found when recording, and answer every query from the
+ * trace.
+ */
+
+static Bool load_system_info_from_trace(CtrlSystem *system)
+{
+    NvCtrlTraceTarget *traced;
+    CtrlTarget **targets;
+    int i, count;
+
+    if (!NvCtrlTraceLoadSystem(system, &traced, &count)) {
+        nv_error_msg("No system was recorded for '%s' in the trace.",
+                     XDisplayName(system->display));
+        return FALSE;
+    }
+
+    targets = nvalloc((count + 1) * sizeof(CtrlTarget *));
+
+    for (i = 0; i < count; i++) {
+        targets[i] = new_ctrl_target(system, traced[i].target_type,
+                                     traced[i].target_id,
+                                     NV_CTRL_ATTRIBUTES_ALL_SUBSYSTEMS);
+    }
+
+    load_targets_info(targets, count);
+    load_targets_proto_names(targets, count);
+
+    for (i = 0; i < count; i++) {
+        if (!targets[i]) {
+            continue;
+        }
+        if (traced[i].physical) {
+            NvCtrlTargetListAdd(&(system->physical_screens), targets[i],
+                                FALSE);
+        } else {
+            track_target(system, targets[i]);
+        }
+    }
+
+    nvfree(targets);
+    nvfree(traced);
+
+    return TRUE;
+}
+
+
 static Bool load_system_info(CtrlSystem *system, const char *display)
 {
-    ReturnStatus status;
     CtrlTarget *xscreenQueryTarget = NULL;
     CtrlTarget *nvmlQueryTarget = NULL;
-    int i, target_type, val, len, target_count;
+    NvCtrlAttributePrivateHandle *h;
+    CtrlTargetCountQuery countQueries[MAX_TARGET_TYPES + 1];
+    CtrlBinaryAttributeQuery displayQuery;
+    CtrlTargetCountQuery *physicalScreensQuery = NULL;
+    CtrlTarget **targets = NULL;
+    int target_counts[MAX_TARGET_TYPES];
+    int i, target_type, val, numCountQueries = 0;
+    int numTargets, maxTargets, firstPhysicalScreen;
     int unused;
     int *pData = NULL;
     const CtrlTargetTypeInfo *targetTypeInfo;
@@ -851,6 +1082,12 @@ static Bool load_system_info(CtrlSystem *system, const char *display)
         system->display = NULL;
     }
 
+    system->trace_id = NvCtrlTraceAddSystem(display);
+
+    if (NvCtrlGetTraceMode() == NV_CTRL_TRACE_REPLAY) {
+        return load_system_info_from_trace(system);
+    }
+
     /* Try to open the X display connection */
     system->dpy = XOpenDisplay(system->display);
 
@@ -862,7 +1099,13 @@ static Bool load_system_info(CtrlSystem *system, const char *display)
             XNVCTRLQueryExtension(system->dpy, &unused, &unused);
     }
 
-    /* Try to initialize the NVML library */
+    /*
+     * Try to initialize the NVML library; the system keeps a reference to it
+     * and to the NV-CONTROL to NVML GPU mapping so that all of its targets
+     * share them.
+     */
+    system->nvml = NvCtrlInitNvmlSystem(system);
+
     nvmlQueryTarget = nv_alloc_ctrl_target(system, GPU_TARGET, 0, subsystems);
 
     system->has_nvml = (nvmlQueryTarget != NULL);
@@ -872,119 +1115,184 @@ static Bool load_system_info(CtrlSystem *system, const char *display)
         return FALSE;
     }
 
+    h = getPrivateHandle(nvmlQueryTarget);
+
+    /*
+     * get the number of X screens from Xlib's ScreenCount() (note: to
+     * support Xinerama: we'll want to use NvCtrlQueryTargetCount() rather
+     * than ScreenCount()), and create them first: the first NVIDIA X screen
+     * is used to query the number of targets of other types.
+     */
+
+    memset(target_counts, 0, sizeof(target_counts));
+
+    if (system->dpy != NULL) {
+        target_counts[X_SCREEN_TARGET] = ScreenCount(system->dpy);
+    }
+
+    maxTargets = target_counts[X_SCREEN_TARGET];
+    targets = nvalloc(maxTargets * sizeof(CtrlTarget *));
+
+    for (i = 0; i < target_counts[X_SCREEN_TARGET]; i++) {
+        targets[i] = new_ctrl_target(system, X_SCREEN_TARGET, i,
+                                     NV_CTRL_ATTRIBUTES_ALL_SUBSYSTEMS);
+
+        /*
+         * store this handle, if it exists, so that we can use it to
+         * query other target counts
+         */
+
+        if (!xscreenQueryTarget && targets[i] && targets[i]->h) {
+            xscreenQueryTarget = targets[i];
+        }
+    }
+    numTargets = target_counts[X_SCREEN_TARGET];
+
     /*
-     * loop over each target type and setup the appropriate
-     * information
+     * query the number of targets of every other target type, and of
+     * physical X screens, together
      */
 
+    memset(&displayQuery, 0, sizeof(displayQuery));
+    displayQuery.status = NvCtrlMissingExtension;
+
     for (target_type = 0;
          target_type < MAX_TARGET_TYPES;
          target_type++) {
-        NvCtrlAttributePrivateHandle *h = getPrivateHandle(nvmlQueryTarget);
-        targetTypeInfo = NvCtrlGetTargetTypeInfo(target_type);
-        target_count = 0;
+        CtrlTargetCountQuery *query = &countQueries[numCountQueries];
 
-        /*
-         * get the number of targets of this type; if this is an X
-         * screen target, just use Xlib's ScreenCount() (note: to
-         * support Xinerama: we'll want to use
-         * NvCtrlQueryTargetCount() rather than ScreenCount()); for
-         * other target types, use NvCtrlQueryTargetCount().
-         */
+        targetTypeInfo = NvCtrlGetTargetTypeInfo(target_type);
 
         if (target_type == X_SCREEN_TARGET) {
-            if (system->dpy != NULL) {
-                target_count = ScreenCount(system->dpy);
-            }
+            continue;
         }
         else if (target_type == MUX_TARGET) {
-
-            status = NvCtrlQueryTargetCount(nvmlQueryTarget,
-                                            target_type,
-                                            &val);
-            if (status == NvCtrlSuccess) {
-                target_count = val;
-            }
-
+            query->target = nvmlQueryTarget;
+            query->target_type = target_type;
+            numCountQueries++;
         }
         else if ((h != NULL) && (h->nvml != NULL) &&
                  TARGET_TYPE_IS_NVML_COMPATIBLE(target_type)) {
 
-            status = NvCtrlNvmlQueryTargetCount(nvmlQueryTarget,
-                                                target_type, &val);
-            if (status != NvCtrlSuccess) {
+            if (NvCtrlNvmlQueryTargetCount(nvmlQueryTarget, target_type,
+                                           &val) != NvCtrlSuccess) {
                 nv_warning_msg("Unable to determine number of NVIDIA %ss",
                                targetTypeInfo->name);
                 val = 0;
             }
-            target_count = val;
+            target_counts[target_type] = val;
+        }
+        else if (xscreenQueryTarget &&
+                 is_nvcontrol_protocol_valid(system,
+                                             targetTypeInfo->major,
+                                             targetTypeInfo->minor)) {
+
+            if (target_type != DISPLAY_TARGET) {
+                query->target = xscreenQueryTarget;
+                query->target_type = target_type;
+                numCountQueries++;
+            } else {
+                /* For targets that aren't simply enumerated,
+                 * query the list of valid IDs in pData which
+                 * will be used below
+                 */
+                displayQuery.target = xscreenQueryTarget;
+                displayQuery.attr = NV_CTRL_BINARY_DATA_DISPLAY_TARGETS;
+            }
         }
         else {
+            nv_warning_msg("Unable to determine number of NVIDIA "
+                           "%ss on '%s'.",
+                           targetTypeInfo->name,
+                           get_display_name(system));
+        }
+    }
 
-            /*
-             * note: xscreenQueryTarget should be assigned below by a
-             * previous iteration of this loop; depends on X screen
-             * targets getting handled first
-             */
+    targetTypeInfo = NvCtrlGetTargetTypeInfo(X_SCREEN_TARGET);
 
-            if (xscreenQueryTarget) {
+    if (xscreenQueryTarget &&
+        is_nvcontrol_protocol_valid(system,
+                                    targetTypeInfo->major,
+                                    targetTypeInfo->minor)) {
+        physicalScreensQuery = &countQueries[numCountQueries++];
+        physicalScreensQuery->target = xscreenQueryTarget;
+        physicalScreensQuery->target_type = X_SCREEN_TARGET;
+    } else {
+        nv_warning_msg("Unable to determine number of NVIDIA %ss on '%s'.",
+                       targetTypeInfo->name, get_display_name(system));
+    }
 
-                /*
-                 * check that the NV-CONTROL protocol is new enough to
-                 * recognize this target type
-                 */
+    NvCtrlQueryTargetCountsBatch(countQueries, numCountQueries);
 
-                if (is_nvcontrol_protocol_valid(xscreenQueryTarget,
-                                                targetTypeInfo->major,
-                                                targetTypeInfo->minor)) {
-
-                    if (target_type != DISPLAY_TARGET) {
-                        status = NvCtrlQueryTargetCount(xscreenQueryTarget,
-                                                        target_type,
-                                                        &val);
-                    } else {
-                        /* For targets that aren't simply enumerated,
-                         * query the list of valid IDs in pData which
-                         * will be used below
-                         */
-                        status =
-                            NvCtrlGetBinaryAttribute(xscreenQueryTarget, 0,
-                                                     NV_CTRL_BINARY_DATA_DISPLAY_TARGETS,
-                                                     (unsigned char **)(&pData), &len);
-                        if (status == NvCtrlSuccess) {
-                            val = pData[0];
-                        }
-                    }
-                } else {
-                    status = NvCtrlMissingExtension;
-                }
-            } else {
-                status = NvCtrlMissingExtension;
-            }
+    if (displayQuery.target) {
+        NvCtrlGetBinaryAttributesBatch(&displayQuery, 1);
+        pData = (int *) displayQuery.data;
 
-            if (status != NvCtrlSuccess) {
-                nv_warning_msg("Unable to determine number of NVIDIA "
-                               "%ss on '%s'.",
-                               targetTypeInfo->name,
-                               get_display_name(system));
-                val = 0;
-            }
+        if (displayQuery.status == NvCtrlSuccess) {
+            target_counts[DISPLAY_TARGET] = pData[0];
+        } else {
+            targetTypeInfo = NvCtrlGetTargetTypeInfo(DISPLAY_TARGET);
+            nv_warning_msg("Unable to determine number of NVIDIA "
+                           "%ss on '%s'.",
+                           targetTypeInfo->name,
+                           get_display_name(system));
+        }
+    }
+
+    for (i = 0; i < numCountQueries; i++) {
+        CtrlTargetCountQuery *query = &countQueries[i];
 
-            target_count = val;
+        if (query == physicalScreensQuery) {
+            continue;
+        }
+
+        if (query->status == NvCtrlSuccess) {
+            target_counts[query->target_type] = query->val;
+        } else if (query->target_type != MUX_TARGET) {
+            targetTypeInfo = NvCtrlGetTargetTypeInfo(query->target_type);
+            nv_warning_msg("Unable to determine number of NVIDIA "
+                           "%ss on '%s'.",
+                           targetTypeInfo->name,
+                           get_display_name(system));
         }
+    }
+
+    if (physicalScreensQuery &&
+        physicalScreensQuery->status != NvCtrlSuccess) {
+        targetTypeInfo = NvCtrlGetTargetTypeInfo(X_SCREEN_TARGET);
+        nv_warning_msg("Unable to determine number of NVIDIA %ss on '%s'.",
+                       targetTypeInfo->name, get_display_name(system));
+    }
+
+    /* Create the targets of all other types, then the physical X screens */
 
-        /* Add all the targets of this type to the CtrlSystem */
+    for (target_type = 0; target_type < MAX_TARGET_TYPES; target_type++) {
+        if (target_type != X_SCREEN_TARGET) {
+            maxTargets += target_counts[target_type];
+        }
+    }
+    if (physicalScreensQuery && physicalScreensQuery->status == NvCtrlSuccess) {
+        maxTargets += physicalScreensQuery->val;
+    }
 
-        for (i = 0; i < target_count; i++) {
+    if (maxTargets > numTargets) {
+        targets = nvrealloc(targets, maxTargets * sizeof(CtrlTarget *));
+    }
+
+    for (target_type = 0; target_type < MAX_TARGET_TYPES; target_type++) {
+
+        if (target_type == X_SCREEN_TARGET) {
+            continue;
+        }
+
+        for (i = 0; i < target_counts[target_type]; i++) {
             int targetId;
-            CtrlTarget *target;
 
             switch (target_type) {
             case DISPLAY_TARGET:
                 /* Grab the target Id from the pData list */
                 targetId = pData[i+1];
                 break;
-            case X_SCREEN_TARGET:
             case GPU_TARGET:
             case FRAMELOCK_TARGET:
             case COOLER_TARGET:
@@ -995,75 +1303,53 @@ static Bool load_system_info(CtrlSystem *system, const char *display)
                 targetId = i;
             }
 
-            target = nv_add_target(system, target_type, targetId);
-
-            /*
-             * store this handle, if it exists, so that we can use it to
-             * query other target counts later
-             */
-
-            if (!xscreenQueryTarget && (target_type == X_SCREEN_TARGET) &&
-                target && target->h) {
-
-                xscreenQueryTarget = target;
-            }
+            targets[numTargets++] =
+                new_ctrl_target(system, target_type, targetId,
+                                NV_CTRL_ATTRIBUTES_ALL_SUBSYSTEMS);
         }
-
-        free(pData);
-        pData = NULL;
     }
 
-    /*
-     * setup the appropriate information for physical screens
-     */
+    free(pData);
+    pData = NULL;
 
-    targetTypeInfo = NvCtrlGetTargetTypeInfo(X_SCREEN_TARGET);
+    firstPhysicalScreen = numTargets;
 
-    if (xscreenQueryTarget) {
+    for (; numTargets < maxTargets; numTargets++) {
+        targets[numTargets] =
+            new_ctrl_target(system, X_SCREEN_TARGET,
+                            numTargets - firstPhysicalScreen,
+                            NV_CTRL_ATTRIBUTES_NV_CONTROL_SUBSYSTEM);
+    }
 
-        /*
-         * check that the NV-CONTROL protocol is new enough to
-         * recognize this target type
-         */
+    /* Load the attributes and names of all the targets together */
 
-        if (is_nvcontrol_protocol_valid(xscreenQueryTarget,
-                                        targetTypeInfo->major,
-                                        targetTypeInfo->minor)) {
+    load_targets_info(targets, numTargets);
+    load_targets_proto_names(targets, numTargets);
 
-            status = NvCtrlQueryTargetCount(xscreenQueryTarget,
-                                            X_SCREEN_TARGET,
-                                            &val);
-        } else {
-            status = NvCtrlMissingExtension;
-        }
-    } else {
-        status = NvCtrlMissingExtension;
-    }
+    /* Add all the targets to the CtrlSystem, in the order of their types */
 
-    if (status != NvCtrlSuccess) {
-        nv_warning_msg("Unable to determine number of NVIDIA %ss on '%s'.",
-                       targetTypeInfo->name, get_display_name(system));
-        val = 0;
+    for (i = 0; i < firstPhysicalScreen; i++) {
+        if (targets[i]) {
+            track_target(system, targets[i]);
+        }
     }
 
-    target_count = val;
-
-    for (i = 0; i < target_count; i++) {
-        CtrlTarget *target;
-        target = nv_alloc_ctrl_target(system, X_SCREEN_TARGET, i,
-                                      NV_CTRL_ATTRIBUTES_NV_CONTROL_SUBSYSTEM);
-        if (!target) {
-            continue;
+    for (i = firstPhysicalScreen; i < numTargets; i++) {
+        if (targets[i]) {
+            NvCtrlTargetListAdd(&(system->physical_screens), targets[i],
+                                FALSE);
         }
-
-        NvCtrlTargetListAdd(&(system->physical_screens), target, FALSE);
     }
 
+    nvfree(targets);
+
     /* Clean up */
     if (nvmlQueryTarget != NULL) {
         nv_free_ctrl_target(nvmlQueryTarget);
     }
 
+    NvCtrlTraceRecordSystem(system);
+
     return TRUE;
 }
 
@@ -1077,8 +1363,10 @@ static Bool load_system_info(CtrlSystem *system, const char *display)
 static CtrlSystem *nv_alloc_ctrl_system(const char *display)
 {
     CtrlSystem *system;
+    CtrlTarget **targets;
+    CtrlTargetNode *node;
     Bool ret;
-    int i;
+    int i, count = 0;
 
     system = nvalloc(sizeof(*system));
 
@@ -1094,18 +1382,58 @@ static CtrlSystem *nv_alloc_ctrl_system(const char *display)
     /* Discover target relationships */
 
     for (i = 0; i < MAX_TARGET_TYPES; i++) {
-        CtrlTargetNode *node;
+        count += NvCtrlGetTargetTypeCount(system, i);
+    }
+
+    targets = nvalloc(count * sizeof(CtrlTarget *));
+    count = 0;
+
+    for (i = 0; i < MAX_TARGET_TYPES; i++) {
         for (node = system->targets[i]; node; node = node->next) {
-            load_target_relationships(node->t);
+            targets[count++] = node->t;
         }
     }
 
+    load_targets_relationships(targets, count);
+    nvfree(targets);
+
     return system;
 
 } /* nv_alloc_ctrl_system() */
 
 
 
+/*!
+ * Makes the X connections opened from now on safe to use from several
+ * threads.
+ *
+ * \return  TRUE on success, FALSE if Xlib was built without thread support.
+ */
+
+Bool NvCtrlInitThreads(void)
+{
+    __threads_initialized = (XInitThreads() != 0);
+
+    return __threads_initialized;
+}
+
+
+
+/*
+ * Adds a newly connected system to the list of systems.
+ */
+
+static void add_system(CtrlSystem *system, CtrlSystemList *systems)
+{
+    system->system_list = systems;
+    systems->array = nvrealloc(systems->array,
+                               sizeof(*(systems->array)) * (systems->n + 1));
+    systems->array[systems->n] = system;
+    systems->n++;
+}
+
+
+
 /*
  * Connect to (and track) a system, returning its control handles (for                                                                                                                                   
  * configuration).  If a connection was already made, return that connection's                                                                                                                           
@@ -1120,12 +1448,7 @@ CtrlSystem *NvCtrlConnectToSystem(const char *display, CtrlSystemList *systems)
         system = nv_alloc_ctrl_system(display);
 
         if (system) {
-            system->system_list = systems;
-            systems->array = nvrealloc(systems->array,
-                                       sizeof(*(systems->array))
-                                       * (systems->n + 1));
-            systems->array[systems->n] = system;
-            systems->n++;
+            add_system(system, systems);
         }
     }
 
@@ -1133,6 +1456,92 @@ CtrlSystem *NvCtrlConnectToSystem(const char *display, CtrlSystemList *systems)
 }
 
 
+
+typedef struct {
+    const char *display;
+    CtrlSystem *system;
+    pthread_t thread;
+    Bool started;
+} SystemConnection;
+
+static void *connect_thread(void *arg)
+{
+    SystemConnection *connection = arg;
+
+    connection->system = nv_alloc_ctrl_system(connection->display);
+
+    return NULL;
+}
+
+
+
+/*!
+ * Connects to (and tracks) all of the given systems, as
+ * NvCtrlConnectToSystem() would for each of them.
+ *
+ * Once NvCtrlInitThreads() succeeded, the systems not connected yet are
+ * connected to concurrently, one thread per system, so that connecting to
+ * several X servers takes about as long as connecting to the slowest one.
+ * Otherwise, they are connected to one after the other.
+ *
+ * \param[in]  displays  The names of the displays of the systems; NULL
+ *                       names the default display, and duplicates are
+ *                       connected to once.
+ * \param[in]  count     The number of entries in displays.
+ * \param[in]  systems   The list of systems to add the new systems to, in
+ *                       the order of displays.
+ */
+
+void NvCtrlConnectToSystems(const char **displays, int count,
+                            CtrlSystemList *systems)
+{
+    SystemConnection *connections;
+    int i, j, n = 0;
+
+    if (count <= 0) {
+        return;
+    }
+
+    connections = nvalloc(count * sizeof(SystemConnection));
+
+    for (i = 0; i < count; i++) {
+        if (NvCtrlGetSystem(displays[i], systems)) {
+            continue;
+        }
+        for (j = 0; j < n; j++) {
+            if (nv_strcasecmp(displays[i], connections[j].display)) {
+                break;
+            }
+        }
+        if (j == n) {
+            connections[n++].display = displays[i];
+        }
+    }
+
+    if (__threads_initialized && (n > 1)) {
+        for (i = 0; i < n; i++) {
+            connections[i].started =
+                (pthread_create(&connections[i].thread, NULL, connect_thread,
+                                &connections[i]) == 0);
+        }
+    }
+
+    for (i = 0; i < n; i++) {
+        if (connections[i].started) {
+            pthread_join(connections[i].thread, NULL);
+        } else {
+            connect_thread(&connections[i]);
+        }
+
+        if (connections[i].system) {
+            add_system(connections[i].system, systems);
+        }
+    }
+
+    nvfree(connections);
+}
+
+
 /*
  * Return the CtrlSystem matching the given string.
  */
@@ -75,6 +75,9 @@ typedef struct __libXrandrInfoRec {
 
 static __libXrandrInfo *__libXrandr = NULL;
 
+/* protects the library table and its reference count */
+static pthread_mutex_t __libXrandrLock = PTHREAD_MUTEX_INITIALIZER;
+
 
 
 /******************************************************************************
@@ -88,6 +91,8 @@ static Bool open_libxrandr(void)
     const char *error_str = NULL;
 
 
+    pthread_mutex_lock(&__libXrandrLock);
+
     /* Initialize bookkeeping structure */
     if ( !__libXrandr ) {
         __libXrandr = nvalloc(sizeof(__libXrandrInfo));
@@ -96,6 +101,7 @@ static Bool open_libxrandr(void)
     /* Library was already opened */
     if ( __libXrandr->handle ) {
         __libXrandr->ref_count++;
+        pthread_mutex_unlock(&__libXrandrLock);
         return True;
     }
 
@@ -143,6 +149,8 @@ static Bool open_libxrandr(void)
     /* Up the ref count */
     __libXrandr->ref_count++;
 
+    pthread_mutex_unlock(&__libXrandrLock);
+
     return True;
 
 
@@ -159,6 +167,7 @@ static Bool open_libxrandr(void)
         free(__libXrandr);
         __libXrandr = NULL;
     }
+    pthread_mutex_unlock(&__libXrandrLock);
     return False;
     
 } /* open_libxrandr() */
@@ -173,6 +182,8 @@ static Bool open_libxrandr(void)
 
 static void close_libxrandr(void)
 {
+    pthread_mutex_lock(&__libXrandrLock);
+
     if ( __libXrandr && __libXrandr->handle && __libXrandr->ref_count ) {
         __libXrandr->ref_count--;
     
@@ -186,6 +197,7 @@ static void close_libxrandr(void)
 #endif
     }
 
+    pthread_mutex_unlock(&__libXrandrLock);
 } /* close_libxrandr() */
 
 static RROutput GetRandRCrtcForGamma(NvCtrlAttributePrivateHandle *h,
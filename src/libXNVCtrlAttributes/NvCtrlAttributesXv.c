@@ -45,6 +45,9 @@ typedef struct __libXvInfoRec {
 
 static __libXvInfo *__libXv = NULL;
 
+/* protects the library table and its reference count */
+static pthread_mutex_t __libXvLock = PTHREAD_MUTEX_INITIALIZER;
+
 
 
 /*
@@ -56,6 +59,8 @@ static Bool open_libxv(void)
     const char *error_str = NULL;
 
 
+    pthread_mutex_lock(&__libXvLock);
+
     /* Initialize bookkeeping structure */
     if ( !__libXv ) {
         __libXv = nvalloc(sizeof(__libXvInfo));
@@ -65,6 +70,7 @@ static Bool open_libxv(void)
     /* Library was already opened */
     if ( __libXv->handle ) {
         __libXv->ref_count++;
+        pthread_mutex_unlock(&__libXvLock);
         return True;
     }
 
@@ -92,6 +98,8 @@ static Bool open_libxv(void)
     /* Up the ref count */
     __libXv->ref_count++;
 
+    pthread_mutex_unlock(&__libXvLock);
+
     return True;
 
 
@@ -107,6 +115,7 @@ static Bool open_libxv(void)
         free(__libXv);
         __libXv = NULL;
     }
+    pthread_mutex_unlock(&__libXvLock);
     return False;
     
 } /* open_libxv() */
@@ -119,6 +128,8 @@ static Bool open_libxv(void)
 
 static void close_libxv(void)
 {
+    pthread_mutex_lock(&__libXvLock);
+
     if ( __libXv && __libXv->handle && __libXv->ref_count ) {
         __libXv->ref_count--;
         if ( __libXv->ref_count == 0 ) {
@@ -128,6 +139,8 @@ static void close_libxv(void)
             __libXv = NULL;
         }
     }
+
+    pthread_mutex_unlock(&__libXvLock);
 } /* close_libxv() */
 
 
@@ -48,6 +48,21 @@ typedef struct {
                         CtrlSystem *, const char *);
 } GtkLibraryData;
 
+static int stats_format = -1;
+
+
+/*
+ * print_stats() - print the backend call statistics requested with
+ * '--stats'; registered with atexit(3) since most paths end with exit().
+ */
+
+static void print_stats(void)
+{
+    if (stats_format >= 0) {
+        NvCtrlPrintStats(stderr, stats_format);
+    }
+}
+
 
 /*
  * get_full_library_name() - build the library name to use by selecting the
@@ -242,6 +257,22 @@ int main(int argc, char **argv)
 
     op = parse_command_line(argc, argv, &systems);
 
+    if (op->stats) {
+        stats_format = op->stats_format;
+        atexit(print_stats);
+    }
+
+    if (op->record_trace) {
+        atexit(NvCtrlStopTrace);
+    }
+
+    /* this must happen before any other Xlib call */
+
+    if (op->parallel_connect && !NvCtrlInitThreads()) {
+        nv_warning_msg("Xlib does not support threads; connecting to the "
+                       "X servers one after the other.");
+    }
+
     /*
      * Using the default library names, along with a possible path or name
      * specified by the user, attempt to dlopen the appropriate user interface
@@ -287,6 +318,12 @@ int main(int argc, char **argv)
         return 1;
     }
 
+    /* replays default to the display the trace was recorded on */
+
+    if (op->ctrl_display == NULL && NvCtrlGetTraceDisplayName()) {
+        op->ctrl_display = strdup(NvCtrlGetTraceDisplayName());
+    }
+
     /* quit here if we don't have a ctrl_display - TY 2005-05-27 */
 
     if (op->ctrl_display == NULL) {
@@ -297,11 +334,25 @@ int main(int argc, char **argv)
 
     /* Allocate handle for ctrl_display */
 
+    if (op->num_assignments || op->num_queries) {
+        nv_connect_to_command_line_systems(op, &systems);
+    }
+
     NvCtrlConnectToSystem(op->ctrl_display, &systems);
 
     /* process any query or assignment commandline options */
 
     if (op->num_assignments || op->num_queries) {
+        /*
+         * The process is short lived, and writes drop the cached values
+         * they may affect, so cache attribute values even though events
+         * are not processed.
+         */
+        if (op->attribute_cache) {
+            system = NvCtrlGetSystem(op->ctrl_display, &systems);
+            NvCtrlEnableAttributeCache(system);
+        }
+
         ret = nv_process_assignments_and_queries(op, &systems);
         NvCtrlFreeAllSystems(&systems);
         return ret ? 0 : 1;
@@ -371,6 +422,16 @@ int main(int argc, char **argv)
         return 1;
     }
 
+    if (op->nvml_sample_interval > 0) {
+        NvCtrlStartNvmlSampler(system, op->nvml_sample_interval);
+    }
+
+    /* The GUI keeps the cache coherent by processing the system's events */
+
+    if (op->attribute_cache) {
+        NvCtrlEnableAttributeCache(system);
+    }
+
     /* pass control to the gui */
 
     libdata.fn_ctk_main(p, &conf, system, op->page);
@@ -0,0 +1,932 @@
+/*
+ * nvidia-settings: A tool for configuring the NVIDIA X driver on Unix
+ * and Linux systems.
+ *
+ * Copyright (C) 2024 NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses>.
+ */
+
+/*
+ * Stub NVML library
+ *
+ * Implements the NVML entry points resolved by LoadNvml() on top of a JSON
+ * fixture instead of a GPU, so that the NVML code paths of nvidia-settings
+ * can be exercised and timed on machines without an NVIDIA GPU.  Build it
+ * with `make nvml-stub` and select it with:
+ *
+ *   NVIDIA_SETTINGS_NVML_LIBRARY=_out/.../libnvidia-ml-stub.so \
+ *   NVML_STUB_FIXTURE=nvml-stub/fixture.json nvidia-settings -q gpus
+ *
+ * The fixture describes the devices (see nvml-stub/fixture.json); a value
+ * missing from a device makes the corresponding call return
+ * NVML_ERROR_NOT_SUPPORTED.  Every call sleeps for the latency given by the
+ * fixture "latency_us" entry, which is either a number of microseconds for
+ * all calls or an object mapping NVML function names (and "default") to
+ * their latency.  NVML_STUB_LATENCY_US, if set, overrides the default.
+ */
+
+#define NVML_NO_UNVERSIONED_FUNC_DEFS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include <jansson.h>
+
+#include "nvml.h"
+
+struct nvmlDevice_st {
+    json_t *json;
+};
+
+struct nvmlEventSet_st {
+    unsigned long long eventTypes;
+};
+
+static pthread_mutex_t stubLock = PTHREAD_MUTEX_INITIALIZER;
+static int initCount = 0;
+static json_t *fixture = NULL;
+static struct nvmlDevice_st *devices = NULL;
+static unsigned int deviceCount = 0;
+static long defaultLatencyUs = 0;
+
+
+
+/*
+ * Sleep for the latency configured for the given NVML function
+ */
+
+static void injectLatency(const char *func)
+{
+    struct timespec ts;
+    long latencyUs = defaultLatencyUs;
+    json_t *latency, *value;
+
+    latency = (fixture != NULL) ? json_object_get(fixture, "latency_us") : NULL;
+    if (json_is_object(latency)) {
+        value = json_object_get(latency, func);
+        if (json_is_integer(value)) {
+            latencyUs = json_integer_value(value);
+        }
+    }
+
+    if (latencyUs <= 0) {
+        return;
+    }
+
+    ts.tv_sec = latencyUs / 1000000;
+    ts.tv_nsec = (latencyUs % 1000000) * 1000;
+    nanosleep(&ts, NULL);
+}
+
+#define STUB_ENTER()                                \
+    do {                                            \
+        if (initCount == 0) {                       \
+            return NVML_ERROR_UNINITIALIZED;        \
+        }                                           \
+        injectLatency(__func__);                    \
+    } while (0)
+
+#define STUB_ENTER_DEVICE(_device)                  \
+    do {                                            \
+        STUB_ENTER();                               \
+        if (!isValidDevice(_device)) {              \
+            return NVML_ERROR_INVALID_ARGUMENT;     \
+        }                                           \
+    } while (0)
+
+
+
+static int isValidDevice(nvmlDevice_t device)
+{
+    return (device != NULL) &&
+           (device >= devices) && (device < devices + deviceCount);
+}
+
+
+
+/*
+ * Accessors for the values of a device (or of the whole fixture if 'device'
+ * is NULL)
+ */
+
+static nvmlReturn_t getULongLong(nvmlDevice_t device, const char *key,
+                                 unsigned long long *val)
+{
+    json_t *value;
+    nvmlReturn_t ret = NVML_ERROR_NOT_SUPPORTED;
+
+    if (val == NULL) {
+        return NVML_ERROR_INVALID_ARGUMENT;
+    }
+
+    pthread_mutex_lock(&stubLock);
+
+    value = json_object_get((device != NULL) ? device->json : fixture, key);
+    if (json_is_integer(value)) {
+        *val = json_integer_value(value);
+        ret = NVML_SUCCESS;
+    }
+
+    pthread_mutex_unlock(&stubLock);
+
+    return ret;
+}
+
+
+
+static nvmlReturn_t getUInt(nvmlDevice_t device, const char *key,
+                            unsigned int *val)
+{
+    unsigned long long v;
+    nvmlReturn_t ret;
+
+    if (val == NULL) {
+        return NVML_ERROR_INVALID_ARGUMENT;
+    }
+
+    ret = getULongLong(device, key, &v);
+    if (ret == NVML_SUCCESS) {
+        *val = (unsigned int) v;
+    }
+
+    return ret;
+}
+
+
+
+static nvmlReturn_t getString(nvmlDevice_t device, const char *key,
+                              char *buf, unsigned int length)
+{
+    const char *str;
+    nvmlReturn_t ret = NVML_ERROR_NOT_SUPPORTED;
+
+    if (buf == NULL) {
+        return NVML_ERROR_INVALID_ARGUMENT;
+    }
+
+    pthread_mutex_lock(&stubLock);
+
+    str = json_string_value(json_object_get((device != NULL) ?
+                                            device->json : fixture, key));
+    if (str != NULL) {
+        if (strlen(str) < length) {
+            strcpy(buf, str);
+            ret = NVML_SUCCESS;
+        } else {
+            ret = NVML_ERROR_INSUFFICIENT_SIZE;
+        }
+    }
+
+    pthread_mutex_unlock(&stubLock);
+
+    return ret;
+}
+
+
+
+static void setULongLong(nvmlDevice_t device, const char *key,
+                         unsigned long long val)
+{
+    pthread_mutex_lock(&stubLock);
+    json_object_set_new(device->json, key, json_integer(val));
+    pthread_mutex_unlock(&stubLock);
+}
+
+
+
+static const char *eccCounterKey(nvmlMemoryErrorType_t errorType,
+                                 nvmlEccCounterType_t counterType)
+{
+    if (counterType == NVML_VOLATILE_ECC) {
+        return (errorType == NVML_MEMORY_ERROR_TYPE_CORRECTED) ?
+            "ecc_volatile_sbe" : "ecc_volatile_dbe";
+    }
+
+    return (errorType == NVML_MEMORY_ERROR_TYPE_CORRECTED) ?
+        "ecc_aggregate_sbe" : "ecc_aggregate_dbe";
+}
+
+
+
+/*
+ * Initialization
+ */
+
+nvmlReturn_t nvmlInit(void)
+{
+    const char *path, *env;
+    json_t *array;
+    json_error_t error;
+    unsigned int i;
+
+    pthread_mutex_lock(&stubLock);
+
+    if (initCount > 0) {
+        initCount++;
+        pthread_mutex_unlock(&stubLock);
+        return NVML_SUCCESS;
+    }
+
+    path = getenv("NVML_STUB_FIXTURE");
+    if (path == NULL) {
+        fprintf(stderr, "NVML stub: NVML_STUB_FIXTURE is not set.\n");
+        pthread_mutex_unlock(&stubLock);
+        return NVML_ERROR_UNKNOWN;
+    }
+
+    fixture = json_load_file(path, 0, &error);
+    if (!json_is_object(fixture)) {
+        fprintf(stderr, "NVML stub: unable to load '%s': %s (line %d).\n",
+                path, error.text, error.line);
+        json_decref(fixture);
+        fixture = NULL;
+        pthread_mutex_unlock(&stubLock);
+        return NVML_ERROR_UNKNOWN;
+    }
+
+    array = json_object_get(fixture, "devices");
+    deviceCount = json_is_array(array) ? json_array_size(array) : 0;
+    devices = calloc(deviceCount ? deviceCount : 1, sizeof(*devices));
+    for (i = 0; i < deviceCount; i++) {
+        devices[i].json = json_array_get(array, i);
+    }
+
+    defaultLatencyUs = 0;
+    if (json_is_integer(json_object_get(fixture, "latency_us"))) {
+        defaultLatencyUs =
+            json_integer_value(json_object_get(fixture, "latency_us"));
+    } else if (json_is_integer(json_object_get(json_object_get(fixture,
+                                                               "latency_us"),
+                                               "default"))) {
+        defaultLatencyUs =
+            json_integer_value(json_object_get(json_object_get(fixture,
+                                                               "latency_us"),
+                                               "default"));
+    }
+
+    env = getenv("NVML_STUB_LATENCY_US");
+    if (env != NULL) {
+        defaultLatencyUs = strtol(env, NULL, 0);
+    }
+
+    initCount = 1;
+
+    pthread_mutex_unlock(&stubLock);
+
+    injectLatency(__func__);
+
+    return NVML_SUCCESS;
+}
+
+
+
+nvmlReturn_t nvmlShutdown(void)
+{
+    STUB_ENTER();
+
+    pthread_mutex_lock(&stubLock);
+
+    if (--initCount == 0) {
+        free(devices);
+        devices = NULL;
+        deviceCount = 0;
+        json_decref(fixture);
+        fixture = NULL;
+    }
+
+    pthread_mutex_unlock(&stubLock);
+
+    return NVML_SUCCESS;
+}
+
+
+
+/*
+ * System queries
+ */
+
+nvmlReturn_t nvmlSystemGetDriverVersion(char *version, unsigned int length)
+{
+    STUB_ENTER();
+    return getString(NULL, "driver_version", version, length);
+}
+
+
+
+nvmlReturn_t nvmlSystemGetNVMLVersion(char *version, unsigned int length)
+{
+    STUB_ENTER();
+    return getString(NULL, "nvml_version", version, length);
+}
+
+
+
+/*
+ * Device handles
+ */
+
+nvmlReturn_t nvmlDeviceGetCount(unsigned int *count)
+{
+    STUB_ENTER();
+
+    if (count == NULL) {
+        return NVML_ERROR_INVALID_ARGUMENT;
+    }
+
+    *count = deviceCount;
+
+    return NVML_SUCCESS;
+}
+
+
+
+nvmlReturn_t nvmlDeviceGetHandleByIndex(unsigned int index,
+                                        nvmlDevice_t *device)
+{
+    STUB_ENTER();
+
+    if ((index >= deviceCount) || (device == NULL)) {
+        return NVML_ERROR_INVALID_ARGUMENT;
+    }
+
+    *device = &devices[index];
+
+    return NVML_SUCCESS;
+}
+
+
+
+nvmlReturn_t nvmlDeviceGetHandleByUUID(const char *uuid, nvmlDevice_t *device)
+{
+    char buf[NVML_DEVICE_UUID_V2_BUFFER_SIZE];
+    unsigned int i;
+
+    STUB_ENTER();
+
+    if ((uuid == NULL) || (device == NULL)) {
+        return NVML_ERROR_INVALID_ARGUMENT;
+    }
+
+    for (i = 0; i < deviceCount; i++) {
+        if ((getString(&devices[i], "uuid", buf, sizeof(buf)) ==
+             NVML_SUCCESS) &&
+            (strcmp(buf, uuid) == 0)) {
+            *device = &devices[i];
+            return NVML_SUCCESS;
+        }
+    }
+
+    return NVML_ERROR_NOT_FOUND;
+}
+
+
+
+/*
+ * Device queries
+ */
+
+nvmlReturn_t nvmlDeviceGetUUID(nvmlDevice_t device, char *uuid,
+                               unsigned int length)
+{
+    STUB_ENTER_DEVICE(device);
+    return getString(device, "uuid", uuid, length);
+}
+
+
+
+nvmlReturn_t nvmlDeviceGetName(nvmlDevice_t device, char *name,
+                               unsigned int length)
+{
+    STUB_ENTER_DEVICE(device);
+    return getString(device, "name", name, length);
+}
+
+
+
+nvmlReturn_t nvmlDeviceGetVbiosVersion(nvmlDevice_t device, char *version,
+                                       unsigned int length)
+{
+    STUB_ENTER_DEVICE(device);
+    return getString(device, "vbios_version", version, length);
+}
+
+
+
+nvmlReturn_t nvmlDeviceGetPciInfo(nvmlDevice_t device, nvmlPciInfo_t *pci)
+{
+    nvmlReturn_t ret;
+
+    STUB_ENTER_DEVICE(device);
+
+    if (pci == NULL) {
+        return NVML_ERROR_INVALID_ARGUMENT;
+    }
+
+    memset(pci, 0, sizeof(*pci));
+
+    ret = getString(device, "pci_bus_id", pci->busId, sizeof(pci->busId));
+    if (ret != NVML_SUCCESS) {
+        return ret;
+    }
+
+    /* The legacy id is shorter: keep what fits */
+    snprintf(pci->busIdLegacy, sizeof(pci->busIdLegacy), "%.*s",
+             (int) sizeof(pci->busIdLegacy) - 1, pci->busId);
+    getUInt(device, "pci_domain", &pci->domain);
+    getUInt(device, "pci_bus", &pci->bus);
+    getUInt(device, "pci_device", &pci->device);
+    getUInt(device, "pci_device_id", &pci->pciDeviceId);
+    getUInt(device, "pci_subsystem_id", &pci->pciSubSystemId);
+
+    return NVML_SUCCESS;
+}
+
+
+
+nvmlReturn_t nvmlDeviceGetTemperature(nvmlDevice_t device,
+                                      nvmlTemperatureSensors_t sensorType,
+                                      unsigned int *temp)
+{
+    STUB_ENTER_DEVICE(device);
+
+    if (sensorType != NVML_TEMPERATURE_GPU) {
+        return NVML_ERROR_INVALID_ARGUMENT;
+    }
+
+    return getUInt(device, "temperature", temp);
+}
+
+
+
+nvmlReturn_t nvmlDeviceGetTemperatureThreshold(nvmlDevice_t device,
+                                               nvmlTemperatureThresholds_t thresholdType,
+                                               unsigned int *temp)
+{
+    STUB_ENTER_DEVICE(device);
+
+    switch (thresholdType) {
+        case NVML_TEMPERATURE_THRESHOLD_SHUTDOWN:
+            return getUInt(device, "temperature_shutdown", temp);
+        case NVML_TEMPERATURE_THRESHOLD_SLOWDOWN:
+            return getUInt(device, "temperature_slowdown", temp);
+        default:
+            return NVML_ERROR_NOT_SUPPORTED;
+    }
+}
+
+
+
+nvmlReturn_t nvmlDeviceGetNumFans(nvmlDevice_t device, unsigned int *numFans)
+{
+    json_t *fans;
+
+    STUB_ENTER_DEVICE(device);
+
+    if (numFans == NULL) {
+        return NVML_ERROR_INVALID_ARGUMENT;
+    }
+
+    pthread_mutex_lock(&stubLock);
+    fans = json_object_get(device->json, "fans");
+    *numFans = json_is_array(fans) ? json_array_size(fans) : 0;
+    pthread_mutex_unlock(&stubLock);
+
+    return json_is_array(fans) ? NVML_SUCCESS : NVML_ERROR_NOT_SUPPORTED;
+}
+
+
+
+nvmlReturn_t nvmlDeviceGetFanSpeed_v2(nvmlDevice_t device, unsigned int fan,
+                                      unsigned int *speed)
+{
+    json_t *value;
+    nvmlReturn_t ret = NVML_ERROR_NOT_SUPPORTED;
+
+    STUB_ENTER_DEVICE(device);
+
+    if (speed == NULL) {
+        return NVML_ERROR_INVALID_ARGUMENT;
+    }
+
+    pthread_mutex_lock(&stubLock);
+    value = json_array_get(json_object_get(device->json, "fans"), fan);
+    if (json_is_integer(value)) {
+        *speed = json_integer_value(value);
+        ret = NVML_SUCCESS;
+    }
+    pthread_mutex_unlock(&stubLock);
+
+    return ret;
+}
+
+
+
+nvmlReturn_t nvmlDeviceGetMemoryInfo(nvmlDevice_t device, nvmlMemory_t *memory)
+{
+    unsigned long long total, used;
+
+    STUB_ENTER_DEVICE(device);
+
+    if (memory == NULL) {
+        return NVML_ERROR_INVALID_ARGUMENT;
+    }
+
+    if ((getULongLong(device, "memory_total", &total) != NVML_SUCCESS) ||
+        (getULongLong(device, "memory_used", &used) != NVML_SUCCESS)) {
+        return NVML_ERROR_NOT_SUPPORTED;
+    }
+
+    memory->total = total;
+    memory->used = used;
+    memory->free = total - used;
+
+    return NVML_SUCCESS;
+}
+
+
+
+nvmlReturn_t nvmlDeviceGetMemoryInfo_v2(nvmlDevice_t device,
+                                        nvmlMemory_v2_t *memory)
+{
+    unsigned long long total, used, reserved = 0;
+
+    STUB_ENTER_DEVICE(device);
+
+    if (memory == NULL) {
+        return NVML_ERROR_INVALID_ARGUMENT;
+    }
+
+    if ((getULongLong(device, "memory_total", &total) != NVML_SUCCESS) ||
+        (getULongLong(device, "memory_used", &used) != NVML_SUCCESS)) {
+        return NVML_ERROR_NOT_SUPPORTED;
+    }
+    getULongLong(device, "memory_reserved", &reserved);
+
+    memory->total = total;
+    memory->reserved = reserved;
+    memory->used = used;
+    memory->free = total - used - reserved;
+
+    return NVML_SUCCESS;
+}
+
+
+
+nvmlReturn_t nvmlDeviceGetUtilizationRates(nvmlDevice_t device,
+                                           nvmlUtilization_t *utilization)
+{
+    STUB_ENTER_DEVICE(device);
+
+    if (utilization == NULL) {
+        return NVML_ERROR_INVALID_ARGUMENT;
+    }
+
+    if ((getUInt(device, "utilization_gpu",
+                 &utilization->gpu) != NVML_SUCCESS) ||
+        (getUInt(device, "utilization_memory",
+                 &utilization->memory) != NVML_SUCCESS)) {
+        return NVML_ERROR_NOT_SUPPORTED;
+    }
+
+    return NVML_SUCCESS;
+}
+
+
+
+nvmlReturn_t nvmlDeviceGetCurrPcieLinkWidth(nvmlDevice_t device,
+                                            unsigned int *currLinkWidth)
+{
+    STUB_ENTER_DEVICE(device);
+    return getUInt(device, "pcie_link_width", currLinkWidth);
+}
+
+
+
+nvmlReturn_t nvmlDeviceGetMaxPcieLinkWidth(nvmlDevice_t device,
+                                           unsigned int *maxLinkWidth)
+{
+    STUB_ENTER_DEVICE(device);
+    return getUInt(device, "pcie_max_link_width", maxLinkWidth);
+}
+
+
+
+nvmlReturn_t nvmlDeviceGetMaxPcieLinkGeneration(nvmlDevice_t device,
+                                                unsigned int *maxLinkGen)
+{
+    STUB_ENTER_DEVICE(device);
+    return getUInt(device, "pcie_max_link_generation", maxLinkGen);
+}
+
+
+
+nvmlReturn_t nvmlDeviceGetVirtualizationMode(nvmlDevice_t device,
+                                             nvmlGpuVirtualizationMode_t *pVirtualMode)
+{
+    unsigned int mode;
+    nvmlReturn_t ret;
+
+    STUB_ENTER_DEVICE(device);
+
+    if (pVirtualMode == NULL) {
+        return NVML_ERROR_INVALID_ARGUMENT;
+    }
+
+    ret = getUInt(device, "virtualization_mode", &mode);
+    if (ret == NVML_SUCCESS) {
+        *pVirtualMode = mode;
+    }
+
+    return ret;
+}
+
+
+
+nvmlReturn_t nvmlDeviceGetGridLicensableFeatures_v4(nvmlDevice_t device,
+                                                    nvmlGridLicensableFeatures_t *pGridLicensableFeatures)
+{
+    STUB_ENTER_DEVICE(device);
+    return NVML_ERROR_NOT_SUPPORTED;
+}
+
+
+
+nvmlReturn_t nvmlDeviceGetNumGpuCores(nvmlDevice_t device,
+                                      unsigned int *numCores)
+{
+    STUB_ENTER_DEVICE(device);
+    return getUInt(device, "cores", numCores);
+}
+
+
+
+nvmlReturn_t nvmlDeviceGetMemoryBusWidth(nvmlDevice_t device,
+                                         unsigned int *busWidth)
+{
+    STUB_ENTER_DEVICE(device);
+    return getUInt(device, "memory_bus_width", busWidth);
+}
+
+
+
+nvmlReturn_t nvmlDeviceGetIrqNum(nvmlDevice_t device, unsigned int *irqNum)
+{
+    STUB_ENTER_DEVICE(device);
+    return getUInt(device, "irq", irqNum);
+}
+
+
+
+nvmlReturn_t nvmlDeviceGetPowerSource(nvmlDevice_t device,
+                                      nvmlPowerSource_t *powerSource)
+{
+    STUB_ENTER_DEVICE(device);
+    return getUInt(device, "power_source", powerSource);
+}
+
+
+
+/*
+ * ECC
+ */
+
+nvmlReturn_t nvmlDeviceGetEccMode(nvmlDevice_t device,
+                                  nvmlEnableState_t *current,
+                                  nvmlEnableState_t *pending)
+{
+    unsigned int cur, pend;
+
+    STUB_ENTER_DEVICE(device);
+
+    if ((current == NULL) || (pending == NULL)) {
+        return NVML_ERROR_INVALID_ARGUMENT;
+    }
+
+    if ((getUInt(device, "ecc_mode", &cur) != NVML_SUCCESS) ||
+        (getUInt(device, "ecc_pending_mode", &pend) != NVML_SUCCESS)) {
+        return NVML_ERROR_NOT_SUPPORTED;
+    }
+
+    *current = cur ? NVML_FEATURE_ENABLED : NVML_FEATURE_DISABLED;
+    *pending = pend ? NVML_FEATURE_ENABLED : NVML_FEATURE_DISABLED;
+
+    return NVML_SUCCESS;
+}
+
+
+
+nvmlReturn_t nvmlDeviceSetEccMode(nvmlDevice_t device, nvmlEnableState_t ecc)
+{
+    unsigned int pend;
+
+    STUB_ENTER_DEVICE(device);
+
+    if (getUInt(device, "ecc_pending_mode", &pend) != NVML_SUCCESS) {
+        return NVML_ERROR_NOT_SUPPORTED;
+    }
+
+    setULongLong(device, "ecc_pending_mode", ecc == NVML_FEATURE_ENABLED);
+
+    return NVML_SUCCESS;
+}
+
+
+
+nvmlReturn_t nvmlDeviceGetTotalEccErrors(nvmlDevice_t device,
+                                         nvmlMemoryErrorType_t errorType,
+                                         nvmlEccCounterType_t counterType,
+                                         unsigned long long *eccCounts)
+{
+    STUB_ENTER_DEVICE(device);
+    return getULongLong(device, eccCounterKey(errorType, counterType),
+                        eccCounts);
+}
+
+
+
+nvmlReturn_t nvmlDeviceGetMemoryErrorCounter(nvmlDevice_t device,
+                                             nvmlMemoryErrorType_t errorType,
+                                             nvmlEccCounterType_t counterType,
+                                             nvmlMemoryLocation_t locationType,
+                                             unsigned long long *count)
+{
+    STUB_ENTER_DEVICE(device);
+
+    /* Only the totals are described by the fixture */
+    return NVML_ERROR_NOT_SUPPORTED;
+}
+
+
+
+nvmlReturn_t nvmlDeviceClearEccErrorCounts(nvmlDevice_t device,
+                                           nvmlEccCounterType_t counterType)
+{
+    unsigned long long count;
+    const char *key;
+
+    STUB_ENTER_DEVICE(device);
+
+    key = eccCounterKey(NVML_MEMORY_ERROR_TYPE_CORRECTED, counterType);
+    if (getULongLong(device, key, &count) == NVML_SUCCESS) {
+        setULongLong(device, key, 0);
+    }
+
+    key = eccCounterKey(NVML_MEMORY_ERROR_TYPE_UNCORRECTED, counterType);
+    if (getULongLong(device, key, &count) == NVML_SUCCESS) {
+        setULongLong(device, key, 0);
+    }
+
+    return NVML_SUCCESS;
+}
+
+
+
+/*
+ * Field values; only the ECC fields are known, derived from the same
+ * values as the ECC queries above.
+ */
+
+nvmlReturn_t nvmlDeviceGetFieldValues(nvmlDevice_t device, int valuesCount,
+                                      nvmlFieldValue_t *values)
+{
+    struct timeval tv;
+    const char *key;
+    int i;
+
+    STUB_ENTER_DEVICE(device);
+
+    if ((valuesCount < 0) || (values == NULL)) {
+        return NVML_ERROR_INVALID_ARGUMENT;
+    }
+
+    gettimeofday(&tv, NULL);
+
+    for (i = 0; i < valuesCount; i++) {
+        switch (values[i].fieldId) {
+            case NVML_FI_DEV_ECC_CURRENT:       key = "ecc_mode";          break;
+            case NVML_FI_DEV_ECC_PENDING:       key = "ecc_pending_mode";  break;
+            case NVML_FI_DEV_ECC_SBE_VOL_TOTAL: key = "ecc_volatile_sbe";  break;
+            case NVML_FI_DEV_ECC_DBE_VOL_TOTAL: key = "ecc_volatile_dbe";  break;
+            case NVML_FI_DEV_ECC_SBE_AGG_TOTAL: key = "ecc_aggregate_sbe"; break;
+            case NVML_FI_DEV_ECC_DBE_AGG_TOTAL: key = "ecc_aggregate_dbe"; break;
+            default:                            key = NULL;                break;
+        }
+
+        values[i].timestamp = (long long) tv.tv_sec * 1000000 + tv.tv_usec;
+        values[i].latencyUsec = 0;
+        values[i].valueType = NVML_VALUE_TYPE_UNSIGNED_LONG_LONG;
+        values[i].nvmlReturn = (key != NULL) ?
+            getULongLong(device, key, &values[i].value.ullVal) :
+            NVML_ERROR_NOT_SUPPORTED;
+    }
+
+    return NVML_SUCCESS;
+}
+
+
+
+/*
+ * Events; the fixture only sets the supported event types, no event is
+ * ever delivered.
+ */
+
+nvmlReturn_t nvmlEventSetCreate(nvmlEventSet_t *set)
+{
+    STUB_ENTER();
+
+    if (set == NULL) {
+        return NVML_ERROR_INVALID_ARGUMENT;
+    }
+
+    *set = calloc(1, sizeof(struct nvmlEventSet_st));
+
+    return (*set != NULL) ? NVML_SUCCESS : NVML_ERROR_MEMORY;
+}
+
+
+
+nvmlReturn_t nvmlEventSetFree(nvmlEventSet_t set)
+{
+    STUB_ENTER();
+
+    free(set);
+
+    return NVML_SUCCESS;
+}
+
+
+
+nvmlReturn_t nvmlDeviceGetSupportedEventTypes(nvmlDevice_t device,
+                                              unsigned long long *eventTypes)
+{
+    STUB_ENTER_DEVICE(device);
+
+    if (eventTypes == NULL) {
+        return NVML_ERROR_INVALID_ARGUMENT;
+    }
+
+    if (getULongLong(device, "event_types", eventTypes) != NVML_SUCCESS) {
+        *eventTypes = 0;
+    }
+
+    return NVML_SUCCESS;
+}
+
+
+
+nvmlReturn_t nvmlDeviceRegisterEvents(nvmlDevice_t device,
+                                      unsigned long long eventTypes,
+                                      nvmlEventSet_t set)
+{
+    unsigned long long supported = 0;
+
+    STUB_ENTER_DEVICE(device);
+
+    if (set == NULL) {
+        return NVML_ERROR_INVALID_ARGUMENT;
+    }
+
+    getULongLong(device, "event_types", &supported);
+    if ((eventTypes & ~supported) != 0) {
+        return NVML_ERROR_NOT_SUPPORTED;
+    }
+
+    set->eventTypes |= eventTypes;
+
+    return NVML_SUCCESS;
+}
+
+
+
+nvmlReturn_t nvmlEventSetWait_v2(nvmlEventSet_t set, nvmlEventData_t *data,
+                                 unsigned int timeoutms)
+{
+    struct timespec ts;
+
+    STUB_ENTER();
+
+    if ((set == NULL) || (data == NULL)) {
+        return NVML_ERROR_INVALID_ARGUMENT;
+    }
+
+    ts.tv_sec = timeoutms / 1000;
+    ts.tv_nsec = (timeoutms % 1000) * 1000000;
+    nanosleep(&ts, NULL);
+
+    return NVML_ERROR_TIMEOUT;
+}
@@ -209,6 +209,55 @@ static const NVGetoptOption __options[] = {
       "appropriately named library. If this is the exact location, the "
       "'use-gtk2' option is ignored.\n" },
 
+    { "nvml-sample-interval", NVML_SAMPLE_INTERVAL_OPTION,
+      NVGETOPT_INTEGER_ARGUMENT | NVGETOPT_HELP_ALWAYS, NULL,
+      "Sample the GPU telemetry (temperatures, utilization, memory usage, "
+      "fan speeds...) on a background thread every &NVML-SAMPLE-INTERVAL& "
+      "milliseconds, rather than querying the driver when the graphical "
+      "user interface refreshes." },
+
+    { "parallel-connect", PARALLEL_CONNECT_OPTION, NVGETOPT_HELP_ALWAYS, NULL,
+      "Connect to all of the X servers referenced by the commandline "
+      "assignments and queries, or by the configuration file, at the same "
+      "time rather than one after the other.  This shortens startup when "
+      "several X servers are controlled at once." },
+
+    { "attribute-cache", ATTRIBUTE_CACHE_OPTION, NVGETOPT_HELP_ALWAYS, NULL,
+      "Cache the integer attribute values read from the X server and NVML, "
+      "so that repeated reads of the same attribute do not each cost a "
+      "round trip.  Cached values are dropped when the attribute is "
+      "reported as changed or when it is written by nvidia-settings; "
+      "attributes that change without notice are cached briefly, if at "
+      "all." },
+
+    { "stats", STATS_OPTION,
+      NVGETOPT_STRING_ARGUMENT | NVGETOPT_ARGUMENT_IS_OPTIONAL |
+      NVGETOPT_HELP_ALWAYS, NULL,
+      "Print, on exit, the number of calls made to each backend (NV-CONTROL, "
+      "NVML, GLX, EGL, XRandR, XF86VidMode, XVideo and the attribute cache), "
+      "their errors, payload bytes and latency distribution, per backend and "
+      "per attribute, to standard error.  Valid formats are ^'text'^ (the "
+      "default) and ^'json'^." },
+
+    { "record-trace", RECORD_TRACE_OPTION,
+      NVGETOPT_STRING_ARGUMENT | NVGETOPT_HELP_ALWAYS, NULL,
+      "Record every call made to the backends (NV-CONTROL, NVML, GLX, EGL, "
+      "XRandR, ...), with its arguments, results and duration, to the trace "
+      "file &RECORD-TRACE&, for use with ^--replay-trace^." },
+
+    { "replay-trace", REPLAY_TRACE_OPTION,
+      NVGETOPT_STRING_ARGUMENT | NVGETOPT_HELP_ALWAYS, NULL,
+      "Answer every call made to the backends from the trace file "
+      "&REPLAY-TRACE&, recorded with ^--record-trace^, rather than from the "
+      "GPUs and X servers, which need not be present: e.g. ^--query=all^ "
+      "reports what was recorded.  The control display defaults to the one "
+      "recorded.  The graphical user interface still needs an X server to "
+      "display itself on." },
+
+    { "replay-timing", REPLAY_TIMING_OPTION, NVGETOPT_HELP_ALWAYS, NULL,
+      "When replaying a trace, make each call take as long as it did when "
+      "recorded." },
+
     { NULL, 0, 0, NULL, NULL},
 };
 
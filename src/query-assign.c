@@ -65,6 +65,55 @@ static void print_additional_info(const char *name,
 static ReturnStatus get_framelock_sync_state(CtrlTarget *target,
                                              int *enabled);
 
+/*
+ * nv_connect_to_command_line_systems() - connect to the control display and
+ * to all of the systems referenced by the assignments and queries specified
+ * on the commandline, so that connections can be made concurrently.
+ * Assignments and queries that do not parse are skipped here; they are
+ * reported when they are processed.
+ */
+
+void nv_connect_to_command_line_systems(const Options *op,
+                                        CtrlSystemList *systems)
+{
+    char **strings[2] = { op->queries, op->assignments };
+    int nums[2] = { op->num_queries, op->num_assignments };
+    int types[2] = { NV_PARSER_QUERY, NV_PARSER_ASSIGNMENT };
+    char **displays;
+    int i, j, n = 0;
+
+    displays = nvalloc((1 + op->num_queries + op->num_assignments) *
+                       sizeof(char *));
+
+    displays[n++] = op->ctrl_display ? nvstrdup(op->ctrl_display) : NULL;
+
+    for (i = 0; i < 2; i++) {
+        for (j = 0; j < nums[i]; j++) {
+            ParsedAttribute a;
+
+            if (nv_parse_attribute_string(strings[i][j], types[i], &a) !=
+                NV_PARSER_STATUS_SUCCESS) {
+                continue;
+            }
+
+            nv_assign_default_display(&a, op->ctrl_display);
+            displays[n++] = a.display ? nvstrdup(a.display) : NULL;
+
+            nv_parsed_attribute_clean(&a);
+        }
+    }
+
+    NvCtrlConnectToSystems((const char **) displays, n, systems);
+
+    for (i = 0; i < n; i++) {
+        nvfree(displays[i]);
+    }
+    nvfree(displays);
+
+} /* nv_connect_to_command_line_systems() */
+
+
+
 /*
  * nv_process_assignments_and_queries() - process any assignments or
  * queries specified on the commandline.  If an error occurs, return
@@ -1361,6 +1410,69 @@ static void print_additional_info(const char *name,
 
 
 
+/*
+ * query_all_integer_attributes() - query the values of the integer
+ * attributes that query_all() prints for the given target, at the first
+ * display mask it considers, all at once rather than with a round trip
+ * per attribute.  Returns an array indexed like attributeTable, which the
+ * caller must free; the entries of the attributes that were not queried
+ * have a NULL target.  *first_mask receives the display mask used.
+ */
+
+static CtrlAttributeQuery *query_all_integer_attributes(CtrlTarget *t,
+                                                        uint32 *first_mask)
+{
+    const CtrlTargetTypeInfo *targetTypeInfo = t->targetTypeInfo;
+    CtrlAttributeQuery *queries;
+    CtrlAttributePerms perms;
+    ReturnStatus status;
+    int bit, entry;
+
+    /* Match the first display device of the loop in query_all() */
+
+    *first_mask = 1;
+
+    if (targetTypeInfo->uses_display_devices && t->d) {
+        for (bit = 0; bit < 24; bit++) {
+            if (t->d & (1 << bit)) {
+                *first_mask = 1 << bit;
+                break;
+            }
+        }
+    }
+
+    queries = nvalloc(attributeTableLen * sizeof(CtrlAttributeQuery));
+
+    for (entry = 0; entry < attributeTableLen; entry++) {
+        const AttributeTableEntry *a = &attributeTable[entry];
+
+        if ((a->type != CTRL_ATTRIBUTE_TYPE_INTEGER) ||
+            a->flags.no_query_all) {
+            continue;
+        }
+
+        /* Only query the attributes the target can report */
+
+        status = NvCtrlGetAttributePerms(t, a->type, a->attr, &perms);
+        if ((status != NvCtrlSuccess) || !perms.read ||
+            !(perms.valid_targets &
+              (CTRL_TARGET_PERM_BIT(NvCtrlGetTargetType(t)) |
+               CTRL_TARGET_PERM_BIT(DISPLAY_TARGET)))) {
+            continue;
+        }
+
+        queries[entry].target = t;
+        queries[entry].display_mask = *first_mask;
+        queries[entry].attr = a->attr;
+    }
+
+    NvCtrlGetDisplayAttributesBatch(queries, attributeTableLen);
+
+    return queries;
+}
+
+
+
 /*
  * query_all() - loop through all target types, and query all attributes
  * for those targets.  The current attribute values for all display
@@ -1399,9 +1511,13 @@ static int query_all(const Options *op, const char *display_name,
 
         for (node = system->targets[target_type]; node; node = node->next) {
             CtrlTarget *t = node->t;
+            CtrlAttributeQuery *values;
+            uint32 first_mask;
 
             if (!t->h) continue;
 
+            values = query_all_integer_attributes(t, &first_mask);
+
             nv_msg(NULL, "Attributes queryable via %s:", t->name);
 
             if (!op->terse) {
@@ -1500,8 +1616,13 @@ static int query_all(const Options *op, const char *display_name,
                             goto exit_bit_loop;
                         }
 
-                        status = NvCtrlGetDisplayAttribute(t, mask, a->attr,
-                                                           &val);
+                        if (values[entry].target && (mask == first_mask)) {
+                            status = values[entry].status;
+                            val = values[entry].val;
+                        } else {
+                            status = NvCtrlGetDisplayAttribute(t, mask,
+                                                               a->attr, &val);
+                        }
 
                         if (status == NvCtrlAttributeNotAvailable) {
                             goto exit_bit_loop;
@@ -1542,6 +1663,8 @@ exit_bit_loop:
 
             } /* entry */
 
+            nvfree(values);
+
         } /* j (targets) */
 
     } /* target_type */
@@ -31,6 +31,9 @@
 #include "command-line.h"
 
 
+void nv_connect_to_command_line_systems(const Options *op,
+                                        CtrlSystemList *systems);
+
 int nv_process_assignments_and_queries(const Options *op,
                                        CtrlSystemList *systems);
 
@@ -94,6 +94,10 @@ LIB_XNVCTRL_ATTRIBUTES_SRC += libXNVCtrlAttributes/NvCtrlAttributesEgl.c
 LIB_XNVCTRL_ATTRIBUTES_SRC += libXNVCtrlAttributes/NvCtrlAttributesXrandr.c
 LIB_XNVCTRL_ATTRIBUTES_SRC += libXNVCtrlAttributes/NvCtrlAttributesUtils.c
 LIB_XNVCTRL_ATTRIBUTES_SRC += libXNVCtrlAttributes/NvCtrlAttributesNvml.c
+LIB_XNVCTRL_ATTRIBUTES_SRC += libXNVCtrlAttributes/NvCtrlAttributesCache.c
+LIB_XNVCTRL_ATTRIBUTES_SRC += libXNVCtrlAttributes/NvCtrlAttributesAsync.c
+LIB_XNVCTRL_ATTRIBUTES_SRC += libXNVCtrlAttributes/NvCtrlAttributesStats.c
+LIB_XNVCTRL_ATTRIBUTES_SRC += libXNVCtrlAttributes/NvCtrlAttributesTrace.c
 
 NVIDIA_SETTINGS_SRC += $(LIB_XNVCTRL_ATTRIBUTES_SRC)
 
@@ -266,6 +270,17 @@ JANSSON_EXTRA_DIST += jansson/utf.h
 
 NVIDIA_SETTINGS_EXTRA_DIST += $(JANSSON_EXTRA_DIST)
 
+#
+# files in the src/nvml-stub directory of nvidia-settings; the stub NVML
+# library is not part of the default build (see the nvml-stub target)
+#
+NVML_STUB_SRC += nvml-stub/nvml-stub.c
+
+NVML_STUB_EXTRA_DIST += nvml-stub/fixture.json
+
+NVIDIA_SETTINGS_EXTRA_DIST += $(NVML_STUB_SRC)
+NVIDIA_SETTINGS_EXTRA_DIST += $(NVML_STUB_EXTRA_DIST)
+
 NVIDIA_SETTINGS_DIST_FILES += $(NVIDIA_SETTINGS_SRC)
 NVIDIA_SETTINGS_DIST_FILES += $(GTK_SRC)
 NVIDIA_SETTINGS_DIST_FILES += $(NVIDIA_SETTINGS_EXTRA_DIST)